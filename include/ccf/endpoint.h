@@ -90,13 +90,21 @@ namespace ccf::endpoints
     std::string js_module;
     /// JavaScript function name
     std::string js_function;
+    /// Whether a single request may execute a batch of operations
+    bool batchable = false;
   };
 
   DECLARE_JSON_TYPE_WITH_OPTIONAL_FIELDS(EndpointProperties);
   DECLARE_JSON_REQUIRED_FIELDS(
     EndpointProperties, forwarding_required, authn_policies);
   DECLARE_JSON_OPTIONAL_FIELDS(
-    EndpointProperties, openapi, openapi_hidden, mode, js_module, js_function);
+    EndpointProperties,
+    openapi,
+    openapi_hidden,
+    mode,
+    js_module,
+    js_function,
+    batchable);
 
   struct EndpointDefinition
   {
@@ -350,6 +358,23 @@ namespace ccf::endpoints
      */
     Endpoint& set_execute_outside_consensus(ExecuteOutsideConsensus v);
 
+    /** Allows a single request to this Endpoint to carry a batch of
+     * operations, executed in order within one transaction.
+     *
+     * A batch request sets the x-ms-ccf-batch header to "true", and its body
+     * is a JSON array with the body of each operation. Each operation is
+     * executed as if it was a separate request to this Endpoint. If one fails
+     * or does not apply its writes, only its own writes are rolled back. The
+     * response body is a JSON array with the status and body of each
+     * operation, and the transaction is committed once for all of them.
+     *
+     * By default, endpoints are not batchable.
+     *
+     * @param batchable Whether the Endpoint accepts batch requests
+     * @return This Endpoint for further modification
+     */
+    Endpoint& set_batchable(bool batchable);
+
     void install()
     {
       if (installer == nullptr)
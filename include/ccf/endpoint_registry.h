@@ -8,6 +8,7 @@
 #include "ds/ccf_deprecated.h"
 #include "ds/json_schema.h"
 #include "ds/openapi.h"
+#include "endpoints/path_router.h"
 #include "http/http_consts.h"
 #include "node/certs.h"
 #include "node/rpc/serialization.h"
@@ -16,17 +17,10 @@
 #include <functional>
 #include <llhttp/llhttp.h>
 #include <nlohmann/json.hpp>
-#include <regex>
 #include <set>
 
 namespace ccf::endpoints
 {
-  struct PathTemplateSpec
-  {
-    std::regex template_regex;
-    std::vector<std::string> template_component_names;
-  };
-
   struct PathTemplatedEndpoint : public Endpoint
   {
     PathTemplatedEndpoint(const Endpoint& e) : Endpoint(e) {}
@@ -34,44 +28,6 @@ namespace ccf::endpoints
     PathTemplateSpec spec;
   };
 
-  inline std::optional<PathTemplateSpec> parse_path_template(
-    const std::string& uri)
-  {
-    auto template_start = uri.find_first_of('{');
-    if (template_start == std::string::npos)
-    {
-      return std::nullopt;
-    }
-
-    PathTemplateSpec spec;
-
-    std::string regex_s = uri;
-    template_start = regex_s.find_first_of('{');
-    while (template_start != std::string::npos)
-    {
-      const auto template_end = regex_s.find_first_of('}', template_start);
-      if (template_end == std::string::npos)
-      {
-        throw std::logic_error(
-          fmt::format("Invalid templated path - missing closing '}': {}", uri));
-      }
-
-      spec.template_component_names.push_back(
-        regex_s.substr(template_start + 1, template_end - template_start - 1));
-      regex_s.replace(
-        template_start, template_end - template_start + 1, "([^/]+)");
-      template_start = regex_s.find_first_of('{', template_start + 1);
-    }
-
-    LOG_TRACE_FMT("Parsed a templated endpoint: {} became {}", uri, regex_s);
-    LOG_TRACE_FMT(
-      "Component names are: {}",
-      fmt::join(spec.template_component_names, ", "));
-    spec.template_regex = std::regex(regex_s);
-
-    return spec;
-  }
-
   /** The EndpointRegistry records the user-defined endpoints for a given
    * CCF application.
    *
@@ -159,6 +115,7 @@ namespace ccf::endpoints
       std::string,
       std::map<RESTVerb, std::shared_ptr<PathTemplatedEndpoint>>>
       templated_endpoints;
+    PathRouter<std::shared_ptr<PathTemplatedEndpoint>> templated_router;
 
     std::mutex metrics_lock;
     std::map<std::string, std::map<std::string, Metrics>> metrics;
@@ -181,6 +181,23 @@ namespace ccf::historical
     virtual std::vector<StorePtr> get_store_range(
       RequestHandle handle, ccf::SeqNo start_seqno, ccf::SeqNo end_seqno) = 0;
 
+    /** Retrieve a range of full states at the given indices, including their
+     * Stores, TxIDs and receipts.
+     *
+     * See @c get_store_range for a description of the caching behaviour.
+     */
+    virtual std::vector<StatePtr> get_state_range(
+      RequestHandle handle,
+      ccf::SeqNo start_seqno,
+      ccf::SeqNo end_seqno,
+      ExpiryDuration seconds_until_expiry) = 0;
+
+    /** Same as @c get_state_range but uses default expiry value.
+     * @see get_state_range
+     */
+    virtual std::vector<StatePtr> get_state_range(
+      RequestHandle handle, ccf::SeqNo start_seqno, ccf::SeqNo end_seqno) = 0;
+
     /** Drop state for the given handle.
      *
      * May be used to free up space once a historical query has been resolved,
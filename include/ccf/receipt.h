@@ -4,6 +4,7 @@
 #pragma once
 
 #include "ccf/entity_id.h"
+#include "ccf/tx_id.h"
 #include "ds/json.h"
 
 namespace ccf
@@ -28,4 +29,46 @@ namespace ccf
   DECLARE_JSON_OPTIONAL_FIELDS(Receipt::Element, left, right)
   DECLARE_JSON_TYPE(Receipt)
   DECLARE_JSON_REQUIRED_FIELDS(Receipt, signature, root, proof, leaf, node_id)
-}
\ No newline at end of file
+
+  /** Receipts for a range of transactions, grouped by the signature which
+   * covers them. Each group lists the distinct hashes in its receipts' proofs
+   * once, and the proofs refer to them by index.
+   */
+  struct Receipts
+  {
+    struct Element
+    {
+      std::optional<size_t> left = std::nullopt;
+      std::optional<size_t> right = std::nullopt;
+    };
+
+    struct Entry
+    {
+      ccf::SeqNo seqno;
+      std::string leaf;
+      std::vector<Element> proof = {};
+    };
+
+    struct Signature
+    {
+      std::string signature;
+      std::string root;
+      ccf::NodeId node_id;
+      std::vector<std::string> hashes = {};
+      std::vector<Entry> receipts = {};
+    };
+
+    std::vector<Signature> signatures = {};
+  };
+
+  DECLARE_JSON_TYPE_WITH_OPTIONAL_FIELDS(Receipts::Element)
+  DECLARE_JSON_REQUIRED_FIELDS(Receipts::Element);
+  DECLARE_JSON_OPTIONAL_FIELDS(Receipts::Element, left, right)
+  DECLARE_JSON_TYPE(Receipts::Entry)
+  DECLARE_JSON_REQUIRED_FIELDS(Receipts::Entry, seqno, leaf, proof)
+  DECLARE_JSON_TYPE(Receipts::Signature)
+  DECLARE_JSON_REQUIRED_FIELDS(
+    Receipts::Signature, signature, root, node_id, hashes, receipts)
+  DECLARE_JSON_TYPE(Receipts)
+  DECLARE_JSON_REQUIRED_FIELDS(Receipts, signatures)
+}
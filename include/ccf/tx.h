@@ -4,6 +4,7 @@
 
 #include "ccf/tx_id.h"
 #include "crypto/hash.h"
+#include "ds/arena.h"
 #include "ds/ccf_assert.h"
 #include "kv/kv_types.h"
 #include "kv/untyped_map.h"
@@ -13,6 +14,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace kv
 {
@@ -43,6 +45,13 @@ namespace kv
   // stable order to avoid deadlocks. This ordered map will claim in name-order
   using OrderedChanges = std::map<std::string, MapChanges>;
 
+  // Position in the writes of each change set of a transaction, by map name.
+  // Change sets created after the savepoint are rolled back entirely.
+  struct Savepoint
+  {
+    std::map<std::string, size_t> positions;
+  };
+
   // Manages a collection of MapHandles. Derived implementations should call
   // get_handle_by_name to retrieve handles over their desired maps.
   class BaseTx
@@ -60,6 +69,17 @@ namespace kv
     using PossibleHandles = std::list<std::unique_ptr<AbstractHandle>>;
     std::map<std::string, PossibleHandles> all_handles;
 
+    // Entries of all_changes and all_handles, indexed by MapId. Handles
+    // requested from a map instance are found here, after the first request,
+    // without looking up the map's name. Handles requested by name only use
+    // the maps above.
+    struct MapSlot
+    {
+      MapChanges* changes = nullptr;
+      PossibleHandles* handles = nullptr;
+    };
+    std::vector<MapSlot> map_slots;
+
     // Note: read_txid version is set to NoVersion for the first transaction in
     // the service, before anything has been applied to the KV.
     std::optional<TxID> read_txid = std::nullopt;
@@ -69,34 +89,45 @@ namespace kv
 
     std::optional<crypto::Sha256Hash> root_at_read_version = std::nullopt;
 
+    // The reads and writes of this transaction's change sets are allocated
+    // from this arena, which is shared with the change sets so that it lives
+    // as long as the last of them
+    std::shared_ptr<ds::Arena> arena = nullptr;
+
+    // If set, change sets are pinned at the latest state of their map without
+    // locking it, and do not record reads. The transaction can then only be
+    // read from.
+    bool read_only_snapshot = false;
+
+    // Set once a savepoint has been taken, so that change sets created later
+    // can be rolled back to their creation
+    bool record_undo = false;
+
     template <typename THandle>
-    THandle* get_or_insert_handle(
-      untyped::ChangeSet& change_set, const std::string& name)
+    THandle* get_or_insert_typed_handle(
+      PossibleHandles& handles,
+      untyped::ChangeSet& change_set,
+      const std::string& name)
     {
-      auto it = all_handles.find(name);
-      if (it == all_handles.end())
-      {
-        PossibleHandles handles;
-        auto typed_handle = new THandle(change_set, name);
-        handles.emplace_back(std::unique_ptr<AbstractHandle>(typed_handle));
-        all_handles[name] = std::move(handles);
-        return typed_handle;
-      }
-      else
+      for (auto& handle : handles)
       {
-        PossibleHandles& handles = it->second;
-        for (auto& handle : handles)
+        auto typed_handle = dynamic_cast<THandle*>(handle.get());
+        if (typed_handle != nullptr)
         {
-          auto typed_handle = dynamic_cast<THandle*>(handle.get());
-          if (typed_handle != nullptr)
-          {
-            return typed_handle;
-          }
+          return typed_handle;
         }
-        auto typed_handle = new THandle(change_set, name);
-        handles.emplace_back(std::unique_ptr<AbstractHandle>(typed_handle));
-        return typed_handle;
       }
+      auto typed_handle = new THandle(change_set, name);
+      handles.emplace_back(std::unique_ptr<AbstractHandle>(typed_handle));
+      return typed_handle;
+    }
+
+    template <typename THandle>
+    THandle* get_or_insert_handle(
+      untyped::ChangeSet& change_set, const std::string& name)
+    {
+      return get_or_insert_typed_handle<THandle>(
+        all_handles[name], change_set, name);
     }
 
     template <typename THandle>
@@ -120,7 +151,9 @@ namespace kv
       return typed_handle;
     }
 
-    auto get_map_and_change_set_by_name(const std::string& map_name)
+    auto get_map_and_change_set_by_name(
+      const std::string& map_name,
+      std::optional<MapId> map_id = std::nullopt)
     {
       if (!read_txid.has_value())
       {
@@ -133,7 +166,9 @@ namespace kv
           store->current_txid_and_commit_term();
       }
 
-      auto abstract_map = store->get_map(read_txid->version, map_name);
+      auto abstract_map = map_id.has_value() ?
+        store->get_map(read_txid->version, map_id.value(), map_name) :
+        store->get_map(read_txid->version, map_name);
       if (abstract_map == nullptr)
       {
         // Store doesn't know this map yet - create it dynamically
@@ -153,7 +188,8 @@ namespace kv
           map_name,
           kv::get_security_domain(map_name),
           store->is_map_replicated(map_name),
-          store->should_track_dependencies(map_name));
+          store->should_track_dependencies(map_name),
+          store->is_map_ordered(map_name));
         created_maps[map_name] = new_map;
 
         abstract_map = new_map;
@@ -167,8 +203,20 @@ namespace kv
           fmt::format("Map {} has unexpected type", map_name));
       }
 
-      return std::make_pair(
-        abstract_map, untyped_map->create_change_set(read_txid->version));
+      if (arena == nullptr)
+      {
+        arena = std::make_shared<ds::Arena>();
+      }
+
+      auto change_set = read_only_snapshot ?
+        untyped_map->create_read_only_change_set(read_txid->version, arena) :
+        untyped_map->create_change_set(read_txid->version, arena);
+      if (record_undo && change_set != nullptr)
+      {
+        change_set->savepoint();
+      }
+
+      return std::make_pair(abstract_map, std::move(change_set));
     }
 
     template <class THandle>
@@ -188,6 +236,40 @@ namespace kv
         std::move(change_set), map_name, abstract_map);
     }
 
+    template <class THandle>
+    THandle* get_handle(const NamedHandleMixin& m)
+    {
+      const auto map_id = store->get_map_id(m);
+      if (map_id < map_slots.size() && map_slots[map_id].changes != nullptr)
+      {
+        auto& slot = map_slots[map_id];
+        return get_or_insert_typed_handle<THandle>(
+          *slot.handles, *slot.changes->changeset, m.get_name());
+      }
+
+      const auto& map_name = m.get_name();
+      auto search = all_changes.find(map_name);
+      if (search == all_changes.end())
+      {
+        auto [abstract_map, change_set] =
+          get_map_and_change_set_by_name(map_name, map_id);
+        check_and_store_change_set<THandle>(
+          std::move(change_set), map_name, abstract_map);
+        search = all_changes.find(map_name);
+      }
+
+      if (map_id >= map_slots.size())
+      {
+        map_slots.resize(map_id + 1);
+      }
+      auto& slot = map_slots[map_id];
+      slot.changes = &search->second;
+      slot.handles = &all_handles[map_name];
+
+      return get_or_insert_typed_handle<THandle>(
+        *slot.handles, *slot.changes->changeset, map_name);
+    }
+
   public:
     BaseTx(AbstractStore* _store) : store(_store) {}
 
@@ -225,7 +307,7 @@ namespace kv
       // NB: Always creates a (writeable) MapHandle, which is cast to
       // ReadOnlyHandle on return. This is so that other calls (before or
       // after) can retrieve writeable handles over the same map.
-      return get_handle_by_name<typename M::Handle>(m.get_name());
+      return get_handle<typename M::Handle>(m);
     }
 
     /** Get a read-only handle by map name. Map type must be specified
@@ -265,7 +347,7 @@ namespace kv
     template <class M>
     typename M::Handle* rw(M& m)
     {
-      return get_handle_by_name<typename M::Handle>(m.get_name());
+      return get_handle<typename M::Handle>(m);
     }
 
     /** Get a read-write handle by map name. Map type must be specified
@@ -288,7 +370,7 @@ namespace kv
     {
       // As with ro, this returns a full-featured Handle
       // which is cast to only show its writeable facet.
-      return get_handle_by_name<typename M::Handle>(m.get_name());
+      return get_handle<typename M::Handle>(m);
     }
 
     /** Get a read-write handle by map name. Map type must be specified
@@ -301,5 +383,39 @@ namespace kv
     {
       return get_handle_by_name<typename M::Handle>(map_name);
     }
+
+    /** Create a savepoint, to which the writes made by this transaction can
+     * later be rolled back.
+     *
+     * Note that reads are not rolled back: the transaction still depends on
+     * the keys read after the savepoint.
+     *
+     * @return Savepoint to pass to @c rollback_to
+     */
+    Savepoint savepoint()
+    {
+      record_undo = true;
+
+      Savepoint s;
+      for (auto& [map_name, changes] : all_changes)
+      {
+        s.positions[map_name] = changes.changeset->savepoint();
+      }
+      return s;
+    }
+
+    /** Undo the writes made by this transaction since a savepoint.
+     *
+     * @param s Savepoint previously created by this transaction
+     */
+    void rollback_to(const Savepoint& s)
+    {
+      for (auto& [map_name, changes] : all_changes)
+      {
+        const auto it = s.positions.find(map_name);
+        changes.changeset->rollback_to(
+          it == s.positions.end() ? 0 : it->second);
+      }
+    }
   };
 }
@@ -34,7 +34,10 @@ export type JsonCompatible<T> = any;
  *
  * `KVMap` is modelled after JavaScript's `Map` object,
  * except that keys and values must be of type `ArrayBuffer`
- * and no guarantees on iteration order are provided.
+ * and no guarantees on the iteration order of `forEach` are provided.
+ * `range`, `forEachWithPrefix` and `lowerBound` visit keys in the order
+ * of their bytes, and are efficient on maps which the application has
+ * declared as ordered.
  */
 export interface KvMap {
   has(key: ArrayBuffer): boolean;
@@ -45,6 +48,39 @@ export interface KvMap {
   forEach(
     callback: (value: ArrayBuffer, key: ArrayBuffer, kvmap: KvMap) => void
   ): void;
+  /**
+   * Calls `callback` on each entry with a key in `[from, to)`, in the
+   * order of the keys' bytes. If `to` is `undefined`, the range
+   * extends to the end of the map. Iteration stops if `callback`
+   * returns `false`.
+   */
+  range(
+    from: ArrayBuffer,
+    to: ArrayBuffer | undefined,
+    callback: (
+      value: ArrayBuffer,
+      key: ArrayBuffer,
+      kvmap: KvMap
+    ) => boolean | void
+  ): void;
+  /**
+   * Calls `callback` on each entry with a key starting with `prefix`,
+   * in the order of the keys' bytes. Iteration stops if `callback`
+   * returns `false`.
+   */
+  forEachWithPrefix(
+    prefix: ArrayBuffer,
+    callback: (
+      value: ArrayBuffer,
+      key: ArrayBuffer,
+      kvmap: KvMap
+    ) => boolean | void
+  ): void;
+  /**
+   * Returns the first `[key, value]` entry with a key not less than
+   * `key`, in the order of the keys' bytes.
+   */
+  lowerBound(key: ArrayBuffer): [ArrayBuffer, ArrayBuffer] | undefined;
   size: number;
 }
 
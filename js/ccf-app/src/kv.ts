@@ -71,6 +71,45 @@ export class TypedKvMap<K, V> {
     });
   }
 
+  range(
+    from: K,
+    to: K | undefined,
+    callback: (value: V, key: K, table: TypedKvMap<K, V>) => boolean | void
+  ): void {
+    let kt = this.kt;
+    let vt = this.vt;
+    let typedMap = this;
+    this.kv.range(
+      kt.encode(from),
+      to === undefined ? undefined : kt.encode(to),
+      function (raw_v: ArrayBuffer, raw_k: ArrayBuffer, table: KvMap) {
+        return callback(vt.decode(raw_v), kt.decode(raw_k), typedMap);
+      }
+    );
+  }
+
+  forEachWithPrefix(
+    prefix: K,
+    callback: (value: V, key: K, table: TypedKvMap<K, V>) => boolean | void
+  ): void {
+    let kt = this.kt;
+    let vt = this.vt;
+    let typedMap = this;
+    this.kv.forEachWithPrefix(
+      kt.encode(prefix),
+      function (raw_v: ArrayBuffer, raw_k: ArrayBuffer, table: KvMap) {
+        return callback(vt.decode(raw_v), kt.decode(raw_k), typedMap);
+      }
+    );
+  }
+
+  lowerBound(key: K): [K, V] | undefined {
+    const entry = this.kv.lowerBound(this.kt.encode(key));
+    return entry === undefined
+      ? undefined
+      : [this.kt.decode(entry[0]), this.vt.decode(entry[1])];
+  }
+
   get size(): number {
     return this.kv.size;
   }
@@ -63,6 +63,54 @@ class KvMapPolyfill implements KvMap {
       callback(value, unbase64(key), this);
     });
   }
+  range(
+    from: ArrayBuffer,
+    to: ArrayBuffer | undefined,
+    callback: (
+      value: ArrayBuffer,
+      key: ArrayBuffer,
+      kvmap: KvMap
+    ) => boolean | void
+  ): void {
+    const keys = Array.from(this.map.keys())
+      .map((key) => unbase64(key))
+      .filter(
+        (key) =>
+          compareBytes(key, from) >= 0 &&
+          (to === undefined || compareBytes(key, to) < 0)
+      )
+      .sort(compareBytes);
+    for (const key of keys) {
+      if (callback(this.map.get(base64(key))!, key, this) === false) {
+        break;
+      }
+    }
+  }
+  forEachWithPrefix(
+    prefix: ArrayBuffer,
+    callback: (
+      value: ArrayBuffer,
+      key: ArrayBuffer,
+      kvmap: KvMap
+    ) => boolean | void
+  ): void {
+    const p = Buffer.from(prefix);
+    this.range(prefix, undefined, (value, key) => {
+      const k = Buffer.from(key);
+      if (k.length < p.length || !k.subarray(0, p.length).equals(p)) {
+        return false;
+      }
+      return callback(value, key, this);
+    });
+  }
+  lowerBound(key: ArrayBuffer): [ArrayBuffer, ArrayBuffer] | undefined {
+    let entry: [ArrayBuffer, ArrayBuffer] | undefined = undefined;
+    this.range(key, undefined, (v, k) => {
+      entry = [k, v];
+      return false;
+    });
+    return entry;
+  }
   get size(): number {
     return this.map.size;
   }
@@ -315,6 +363,10 @@ function base64(buf: ArrayBuffer): string {
   return Buffer.from(buf).toString("base64");
 }
 
+function compareBytes(a: ArrayBuffer, b: ArrayBuffer): number {
+  return Buffer.compare(Buffer.from(a), Buffer.from(b));
+}
+
 function unbase64(s: string): ArrayBuffer {
   return nodeBufToArrBuf(Buffer.from(s, "base64"));
 }
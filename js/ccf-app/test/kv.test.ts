@@ -58,4 +58,33 @@ describe("typedKv", function () {
     foo.clear();
     assert.equal(foo.size, 0);
   });
+
+  it("range", function () {
+    foo.set("c", 4);
+    foo.set("ab", 2);
+    foo.set("b", 3);
+    foo.set("a", 1);
+
+    let keys: string[] = [];
+    foo.range("ab", "c", (v, k) => {
+      keys.push(k);
+    });
+    assert.deepEqual(keys, ["ab", "b"]);
+
+    keys = [];
+    foo.range("a", undefined, (v, k) => {
+      keys.push(k);
+      return keys.length < 3;
+    });
+    assert.deepEqual(keys, ["a", "ab", "b"]);
+
+    keys = [];
+    foo.forEachWithPrefix("a", (v, k) => {
+      keys.push(k);
+    });
+    assert.deepEqual(keys, ["a", "ab"]);
+
+    assert.deepEqual(foo.lowerBound("aa"), ["ab", 2]);
+    assert.equal(foo.lowerBound("d"), undefined);
+  });
 });
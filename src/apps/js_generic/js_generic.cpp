@@ -8,11 +8,15 @@
 #include "crypto/entropy.h"
 #include "crypto/key_wrap.h"
 #include "crypto/rsa_key_pair.h"
+#include "ds/thread_messaging.h"
 #include "js/wrap.h"
 #include "kv/untyped_map.h"
 #include "named_auth_policies.h"
 
+#include <array>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <quickjs/quickjs-exports.h>
 #include <quickjs/quickjs.h>
 #include <stdexcept>
@@ -34,6 +38,155 @@ namespace ccfapp
     ccfapp::AbstractNodeContext& context;
     metrics::Tracker metrics_tracker;
 
+    // Router over the templated paths in the endpoints table, tagged with the
+    // state of the table it was built from. Only rebuilt when the table
+    // changes.
+    struct TemplatedRouter
+    {
+      std::pair<size_t, kv::Version> map_state_version;
+      ccf::endpoints::PathRouter<ccf::endpoints::EndpointKey> router;
+    };
+
+    std::mutex templated_router_lock;
+    std::shared_ptr<const TemplatedRouter> templated_router = nullptr;
+
+    std::shared_ptr<const TemplatedRouter> get_templated_router(
+      ccf::endpoints::EndpointsMap::ReadOnlyHandle* endpoints)
+    {
+      const auto map_state_version = endpoints->get_map_state_version();
+
+      {
+        std::lock_guard<std::mutex> guard(templated_router_lock);
+        if (
+          templated_router != nullptr &&
+          templated_router->map_state_version == map_state_version)
+        {
+          return templated_router;
+        }
+      }
+
+      auto new_router = std::make_shared<TemplatedRouter>();
+      new_router->map_state_version = map_state_version;
+      endpoints->foreach([&new_router](const auto& key, const auto&) {
+        const auto opt_spec = ccf::endpoints::parse_path_template(key.uri_path);
+        if (opt_spec.has_value())
+        {
+          new_router->router.insert(opt_spec.value(), key);
+        }
+        return true;
+      });
+
+      LOG_DEBUG_FMT(
+        "Rebuilt router over {} templated JS endpoints",
+        new_router->router.size());
+
+      std::lock_guard<std::mutex> guard(templated_router_lock);
+      templated_router = new_router;
+      return new_router;
+    }
+
+    // A QuickJS runtime and context which are reused by successive requests
+    // on the same thread. Class definitions and globals are registered once,
+    // and each module is loaded and evaluated once, so an interpreter is only
+    // valid for the version of the app's modules it was created from.
+    struct Interpreter
+    {
+      js::Runtime rt;
+      js::Context ctx;
+      js::TxContext txctx{nullptr, js::TxAccess::APP};
+
+      const std::pair<size_t, kv::Version> modules_version;
+      std::map<std::string, JSModuleDef*> modules;
+      std::map<std::pair<std::string, std::string>, JSValue> functions;
+
+      static JSRuntime* with_ccf_classdefs(js::Runtime& rt)
+      {
+        rt.add_ccf_classdefs();
+        return rt;
+      }
+
+      Interpreter(const std::pair<size_t, kv::Version>& modules_version_) :
+        rt(),
+        ctx(with_ccf_classdefs(rt)),
+        modules_version(modules_version_)
+      {
+        js::register_request_body_class(ctx);
+        js::populate_global_console(ctx);
+        js::populate_global_openenclave(ctx);
+      }
+
+      ~Interpreter()
+      {
+        for (auto& [name, func] : functions)
+        {
+          JS_FreeValue(ctx, func);
+        }
+      }
+
+      JSValue get_function(
+        const std::string& module_name,
+        const std::string& function_name,
+        kv::Tx& tx)
+      {
+        const auto key = std::make_pair(module_name, function_name);
+        const auto it = functions.find(key);
+        if (it != functions.end())
+        {
+          return it->second;
+        }
+
+        JSValue func;
+        const auto module_it = modules.find(module_name);
+        if (module_it == modules.end())
+        {
+          auto module_val =
+            js::load_app_module(ctx, module_name.c_str(), &tx);
+          auto module_def = (JSModuleDef*)JS_VALUE_GET_PTR(module_val);
+          func = ctx.function(module_val, function_name, module_name);
+          modules.emplace(module_name, module_def);
+        }
+        else
+        {
+          func = ctx.get_exported_function(
+            module_it->second, function_name, module_name);
+        }
+
+        functions.emplace(key, func);
+        return func;
+      }
+    };
+
+    // Interpreters are only used by the thread that created them
+    std::array<
+      std::unique_ptr<Interpreter>,
+      threading::ThreadMessaging::max_num_threads>
+      interpreters;
+
+    Interpreter& get_interpreter(kv::Tx& tx)
+    {
+      const auto modules_version =
+        tx.ro<ccf::Modules>(ccf::Tables::MODULES)->get_map_state_version();
+
+      auto& interpreter = interpreters[threading::get_current_thread_id()];
+      if (
+        interpreter == nullptr ||
+        interpreter->modules_version != modules_version)
+      {
+        LOG_DEBUG_FMT(
+          "Creating JS interpreter for modules at {}.{}",
+          modules_version.first,
+          modules_version.second);
+        interpreter = std::make_unique<Interpreter>(modules_version);
+      }
+
+      return *interpreter;
+    }
+
+    void discard_interpreter()
+    {
+      interpreters[threading::get_current_thread_id()] = nullptr;
+    }
+
     static JSValue create_json_obj(const nlohmann::json& j, JSContext* ctx)
     {
       const auto buf = j.dump();
@@ -212,6 +365,8 @@ namespace ccfapp
       const auto& request_body = endpoint_ctx.rpc_ctx->get_request_body();
       auto body_ = JS_NewObjectClass(ctx, js::body_class_id);
       JS_SetOpaque(body_, (void*)&request_body);
+      static_cast<js::Context*>(JS_GetContextOpaque(ctx))
+        ->add_request_scoped_object(body_);
       JS_SetPropertyStr(ctx, request, "body", body_);
 
       JS_SetPropertyStr(
@@ -259,19 +414,18 @@ namespace ccfapp
       const std::optional<ccf::TxID>& transaction_id,
       ccf::historical::TxReceiptPtr receipt)
     {
-      js::Runtime rt;
-      rt.add_ccf_classdefs();
+      auto& interpreter = get_interpreter(endpoint_ctx.tx);
+      auto& ctx = interpreter.ctx;
 
+      // The runtime's stack limit is relative to the stack depth it was last
+      // entered at, which differs between requests
+      JS_UpdateStackTop(interpreter.rt);
       JS_SetModuleLoaderFunc(
-        rt, nullptr, js::js_app_module_loader, &endpoint_ctx.tx);
-
-      js::Context ctx(rt);
-      js::TxContext txctx{&target_tx, js::TxAccess::APP};
+        interpreter.rt, nullptr, js::js_app_module_loader, &endpoint_ctx.tx);
 
-      js::register_request_body_class(ctx);
-      js::populate_global_console(ctx);
+      interpreter.txctx.tx = &target_tx;
       js::populate_global_ccf(
-        &txctx,
+        &interpreter.txctx,
         endpoint_ctx.rpc_ctx.get(),
         transaction_id,
         receipt,
@@ -279,18 +433,17 @@ namespace ccfapp
         &context.get_node_state(),
         nullptr,
         ctx);
-      js::populate_global_openenclave(ctx);
 
       JSValue export_func;
       try
       {
-        auto module_val =
-          js::load_app_module(ctx, props.js_module.c_str(), &endpoint_ctx.tx);
-        export_func =
-          ctx.function(module_val, props.js_function, props.js_module);
+        export_func = interpreter.get_function(
+          props.js_module, props.js_function, endpoint_ctx.tx);
       }
       catch (const std::exception& exc)
       {
+        // Modules may have been partially loaded, so start afresh next time
+        discard_interpreter();
         endpoint_ctx.rpc_ctx->set_error(
           HTTP_STATUS_INTERNAL_SERVER_ERROR,
           ccf::errors::InternalError,
@@ -298,13 +451,33 @@ namespace ccfapp
         return;
       }
 
+      try
+      {
+        execute_function(endpoint_ctx, ctx, export_func);
+      }
+      catch (...)
+      {
+        discard_interpreter();
+        throw;
+      }
+
+      // Only reset the state belonging to this request, so that the
+      // interpreter can be reused by the next one
+      interpreter.txctx.tx = nullptr;
+      ctx.detach_request_scoped_objects();
+    }
+
+    void execute_function(
+      ccf::endpoints::EndpointContext& endpoint_ctx,
+      js::Context& ctx,
+      JSValue export_func)
+    {
       // Call exported function
       auto request = create_request_obj(endpoint_ctx, ctx);
       int argc = 1;
       JSValueConst* argv = (JSValueConst*)&request;
       auto val = ctx(JS_Call(ctx, export_func, JS_UNDEFINED, argc, argv));
       JS_FreeValue(ctx, request);
-      JS_FreeValue(ctx, export_func);
 
       if (JS_IsException(val))
       {
@@ -509,54 +682,39 @@ namespace ccfapp
         return endpoint_def;
       }
 
-      // If that doesn't exist, look through _all_ the endpoints to find
+      // If that doesn't exist, look through the templated endpoints to find
       // templated matches. If there is one, that's a match. More is an error,
       // none means delegate to the base class.
       {
+        const auto router = get_templated_router(endpoints);
+        const auto router_matches = router->router.match(
+          key.uri_path,
+          [&key](const auto& other_key) { return key.verb == other_key.verb; });
+
         std::vector<ccf::endpoints::EndpointDefinitionPtr> matches;
+        for (const auto& match : router_matches)
+        {
+          const auto& other_key = *match.value;
+          const auto properties = endpoints->get(other_key);
+          if (!properties.has_value())
+          {
+            continue;
+          }
 
-        endpoints->foreach([this, &matches, &key, &rpc_ctx](
-                             const auto& other_key, const auto& properties) {
-          if (key.verb == other_key.verb)
+          if (matches.empty())
           {
-            const auto opt_spec =
-              ccf::endpoints::parse_path_template(other_key.uri_path);
-            if (opt_spec.has_value())
-            {
-              const auto& template_spec = opt_spec.value();
-              // This endpoint has templates in its path, and the correct verb
-              // - now check if template matches the current request's path
-              std::smatch match;
-              if (std::regex_match(
-                    key.uri_path, match, template_spec.template_regex))
-              {
-                if (matches.empty())
-                {
-                  // Populate the request_path_params while we have the match,
-                  // though this will be discarded on error if we later find
-                  // multiple matches
-                  auto& path_params = rpc_ctx.get_request_path_params();
-                  for (size_t i = 0;
-                       i < template_spec.template_component_names.size();
-                       ++i)
-                  {
-                    const auto& template_name =
-                      template_spec.template_component_names[i];
-                    const auto& template_value = match[i + 1].str();
-                    path_params[template_name] = template_value;
-                  }
-                }
-
-                auto endpoint = std::make_shared<JSDynamicEndpoint>();
-                endpoint->dispatch = other_key;
-                endpoint->properties = properties;
-                instantiate_authn_policies(*endpoint);
-                matches.push_back(endpoint);
-              }
-            }
+            // Populate the request_path_params while we have the match,
+            // though this will be discarded on error if we later find
+            // multiple matches
+            match.populate(rpc_ctx.get_request_path_params());
           }
-          return true;
-        });
+
+          auto endpoint = std::make_shared<JSDynamicEndpoint>();
+          endpoint->dispatch = other_key;
+          endpoint->properties = properties.value();
+          instantiate_authn_policies(*endpoint);
+          matches.push_back(endpoint);
+        }
 
         if (matches.size() > 1)
         {
@@ -41,6 +41,7 @@
 #include "raft_types.h"
 
 #include <algorithm>
+#include <atomic>
 #include <deque>
 #include <list>
 #include <mutex>
@@ -165,6 +166,24 @@ namespace aft
     // append entries
     bool public_only = false;
 
+    // When this is set, entries received in append entries are prepared
+    // (i.e. decrypted) on all worker threads before being applied in order
+    bool parallel_deserialisation = false;
+
+    // When this is set, entries are only acknowledged, by followers to the
+    // leader and by the leader to itself, once the host reports that they are
+    // durable in the local ledger
+    bool wait_for_ledger_flush = false;
+    Index flushed_idx = 0;
+    // Generation of the local ledger, advanced on each truncation. The host
+    // reports the generation of the last truncation it processed with each
+    // durable index, so that reports which predate a truncation are ignored.
+    // Truncations requested before consensus is created (e.g. on recovery or
+    // on join from a snapshot) are all at generation 0.
+    size_t ledger_generation = 0;
+    // Last index accepted by this follower from its current leader
+    Index accepted_idx = 0;
+
     // Randomness
     std::uniform_int_distribution<int> distrib;
     std::default_random_engine rand;
@@ -197,7 +216,9 @@ namespace aft
       std::chrono::milliseconds view_change_timeout_,
       size_t sig_tx_interval_ = 0,
       bool public_only_ = false,
-      kv::ReplicaState initial_state_ = kv::ReplicaState::Follower) :
+      kv::ReplicaState initial_state_ = kv::ReplicaState::Follower,
+      bool parallel_deserialisation_ = false,
+      bool wait_for_ledger_flush_ = false) :
       consensus_type(consensus_type_),
       store(std::move(store_)),
 
@@ -215,6 +236,8 @@ namespace aft
       view_change_timeout(view_change_timeout_),
       sig_tx_interval(sig_tx_interval_),
       public_only(public_only_),
+      parallel_deserialisation(parallel_deserialisation_),
+      wait_for_ledger_flush(wait_for_ledger_flush_),
 
       distrib(0, (int)election_timeout_.count() / 2),
       rand((int)(uintptr_t)this),
@@ -402,6 +425,7 @@ namespace aft
       state->current_view = term;
       state->last_idx = index;
       state->commit_idx = commit_idx_;
+      flushed_idx = index;
       state->view_history.initialise(terms);
       state->view_history.update(index, term);
       state->current_view += starting_view_change;
@@ -417,6 +441,7 @@ namespace aft
 
       state->last_idx = index;
       state->commit_idx = index;
+      flushed_idx = index;
 
       state->view_history.initialise(term_history);
 
@@ -431,6 +456,38 @@ namespace aft
       return state->last_idx;
     }
 
+    // Called when the host reports that the local ledger is durable up to
+    // idx, as of the truncation at generation
+    void ledger_flushed(Index idx, size_t generation)
+    {
+      std::lock_guard<std::mutex> guard(state->lock);
+      if (
+        !wait_for_ledger_flush || generation != ledger_generation ||
+        idx <= flushed_idx)
+      {
+        return;
+      }
+
+      flushed_idx = idx;
+
+      if (replica_state == kv::ReplicaState::Leader)
+      {
+        update_commit();
+      }
+      else if (
+        replica_state == kv::ReplicaState::Follower && leader_id.has_value() &&
+        accepted_idx > 0)
+      {
+        // Acknowledge entries accepted earlier which are now durable
+        AppendEntriesResponse response = {{raft_append_entries_response},
+                                          state->current_view,
+                                          get_durable_idx(accepted_idx),
+                                          AppendEntriesResponseType::OK};
+        channels->send_authenticated(
+          leader_id.value(), ccf::NodeMsgType::consensus_msg, response);
+      }
+    }
+
     Index get_commit_idx()
     {
       std::lock_guard<std::mutex> guard(state->lock);
@@ -1499,6 +1556,7 @@ namespace aft
       if (!leader_id.has_value() || leader_id.value() != from)
       {
         leader_id = from;
+        accepted_idx = 0;
         LOG_DEBUG_FMT(
           "Node {} thinks leader is {}", state->my_node_id, leader_id.value());
       }
@@ -1621,7 +1679,15 @@ namespace aft
         std::move(r),
         confirm_evidence);
 
-      if (threading::ThreadMessaging::thread_count > 1)
+      // Worker threads are 1 to thread_count - 1
+      const size_t worker_count = threading::ThreadMessaging::thread_count - 1;
+      if (
+        parallel_deserialisation && worker_count > 1 &&
+        msg->data.append_entries.size() > 1)
+      {
+        prepare_append_entries(std::move(msg), worker_count);
+      }
+      else if (threading::ThreadMessaging::thread_count > 1)
       {
         threading::ThreadMessaging::thread_messaging.add_task(
           threading::ThreadMessaging::get_execution_thread(
@@ -1634,6 +1700,82 @@ namespace aft
       }
     }
 
+    struct PreparedAppendEntries
+    {
+      PreparedAppendEntries(
+        std::unique_ptr<threading::Tmsg<AsyncExecution>> execution_msg_,
+        size_t pending_) :
+        execution_msg(std::move(execution_msg_)),
+        pending(pending_)
+      {}
+
+      std::unique_ptr<threading::Tmsg<AsyncExecution>> execution_msg;
+      std::atomic<size_t> pending;
+    };
+
+    struct AsyncPrepare
+    {
+      AsyncPrepare(
+        std::shared_ptr<PreparedAppendEntries> batch_,
+        size_t begin_,
+        size_t end_) :
+        batch(batch_),
+        begin(begin_),
+        end(end_)
+      {}
+
+      std::shared_ptr<PreparedAppendEntries> batch;
+      size_t begin;
+      size_t end;
+    };
+
+    void prepare_append_entries(
+      std::unique_ptr<threading::Tmsg<AsyncExecution>> msg,
+      size_t worker_count)
+    {
+      // Split the entries in contiguous ranges, one per worker thread. The
+      // last worker to finish hands the whole batch over to the execution
+      // thread, which applies the entries in order.
+      const auto entry_count = msg->data.append_entries.size();
+      const auto task_count = std::min(worker_count, entry_count);
+      const auto entries_per_task = (entry_count + task_count - 1) / task_count;
+
+      auto batch = std::make_shared<PreparedAppendEntries>(
+        std::move(msg), (entry_count + entries_per_task - 1) / entries_per_task);
+
+      uint32_t task_idx = 0;
+      for (size_t begin = 0; begin < entry_count; begin += entries_per_task)
+      {
+        auto prepare_msg = std::make_unique<threading::Tmsg<AsyncPrepare>>(
+          prepare_append_entries_cb,
+          batch,
+          begin,
+          std::min(begin + entries_per_task, entry_count));
+        threading::ThreadMessaging::thread_messaging.add_task(
+          threading::ThreadMessaging::get_execution_thread(task_idx++),
+          std::move(prepare_msg));
+      }
+    }
+
+    static void prepare_append_entries_cb(
+      std::unique_ptr<threading::Tmsg<AsyncPrepare>> msg)
+    {
+      auto& batch = msg->data.batch;
+      auto& append_entries = batch->execution_msg->data.append_entries;
+      for (auto i = msg->data.begin; i < msg->data.end; ++i)
+      {
+        std::get<0>(append_entries[i])->prepare();
+      }
+
+      if (--batch->pending == 0)
+      {
+        threading::ThreadMessaging::thread_messaging.add_task(
+          threading::ThreadMessaging::get_execution_thread(
+            threading::MAIN_THREAD_ID),
+          std::move(batch->execution_msg));
+      }
+    }
+
     struct AsyncExecutionRet
     {
       AsyncExecutionRet(
@@ -1735,7 +1877,7 @@ namespace aft
         if (apply_success == kv::ApplyResult::FAIL)
         {
           state->last_idx = i - 1;
-          ledger->truncate(state->last_idx);
+          truncate_ledger(state->last_idx);
           send_append_entries_response(from, AppendEntriesResponseType::FAIL);
           return;
         }
@@ -1762,7 +1904,7 @@ namespace aft
           {
             LOG_FAIL_FMT("Follower failed to apply log entry: {}", i);
             state->last_idx--;
-            ledger->truncate(state->last_idx);
+            truncate_ledger(state->last_idx);
             send_append_entries_response(
               msg->data.from, AppendEntriesResponseType::FAIL);
             break;
@@ -1857,7 +1999,7 @@ namespace aft
         else
         {
           state->last_idx = i - 1;
-          ledger->truncate(state->last_idx);
+          truncate_ledger(state->last_idx);
         }
         send_append_entries_response(from, AppendEntriesResponseType::FAIL);
         return false;
@@ -1885,7 +2027,7 @@ namespace aft
         {
           LOG_FAIL_FMT("Follower failed to apply log entry: {}", i);
           state->last_idx--;
-          ledger->truncate(state->last_idx);
+          truncate_ledger(state->last_idx);
           send_append_entries_response(from, AppendEntriesResponseType::FAIL);
           break;
         }
@@ -2112,11 +2254,19 @@ namespace aft
     void send_append_entries_response(
       ccf::NodeId to, AppendEntriesResponseType answer)
     {
+      // Successful responses only acknowledge entries which are durable
+      auto last_log_idx = state->last_idx;
+      if (answer == AppendEntriesResponseType::OK)
+      {
+        accepted_idx = state->last_idx;
+        last_log_idx = get_durable_idx(accepted_idx);
+      }
+
       LOG_DEBUG_FMT(
         "Send append entries response from {} to {} for index {}: {}",
         state->my_node_id.trim(),
         to.trim(),
-        state->last_idx,
+        last_log_idx,
         answer);
 
       if (answer == AppendEntriesResponseType::REQUIRE_EVIDENCE)
@@ -2126,7 +2276,7 @@ namespace aft
 
       AppendEntriesResponse response = {{raft_append_entries_response},
                                         state->current_view,
-                                        state->last_idx,
+                                        last_log_idx,
                                         answer};
 
       channels->send_authenticated(
@@ -2849,6 +2999,19 @@ namespace aft
       }
     }
 
+    // Highest index up to idx which can be acknowledged as durable
+    Index get_durable_idx(Index idx)
+    {
+      return wait_for_ledger_flush ? std::min(idx, flushed_idx) : idx;
+    }
+
+    void truncate_ledger(Index idx)
+    {
+      ledger->truncate(idx, ++ledger_generation);
+      flushed_idx = std::min(flushed_idx, idx);
+      accepted_idx = std::min(accepted_idx, idx);
+    }
+
     void update_commit()
     {
       // If there exists some idx in the current term such that
@@ -2876,7 +3039,7 @@ namespace aft
         {
           if (node.first == state->my_node_id)
           {
-            match.push_back(state->last_idx);
+            match.push_back(get_durable_idx(state->last_idx));
           }
           else
           {
@@ -3134,7 +3297,7 @@ namespace aft
       snapshotter->rollback(idx);
       store->rollback({get_term_internal(idx), idx}, state->current_view);
       LOG_DEBUG_FMT("Setting term in store to: {}", state->current_view);
-      ledger->truncate(idx);
+      truncate_ledger(idx);
       state->last_idx = idx;
       LOG_DEBUG_FMT("Rolled back at {}", idx);
 
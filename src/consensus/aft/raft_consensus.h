@@ -166,6 +166,11 @@ namespace aft
       aft->enable_all_domains();
     }
 
+    void ledger_flushed(ccf::SeqNo seqno, size_t generation) override
+    {
+      aft->ledger_flushed(seqno, generation);
+    }
+
     void emit_signature() override {}
 
     bool on_request(const kv::TxHistory::RequestCallbackArgs& args) override
@@ -51,7 +51,7 @@ namespace aft
       return {data, data + size};
     }
 
-    void truncate(Index idx)
+    void truncate(Index idx, size_t generation)
     {
       ledger.resize(idx);
 #ifdef STUB_LOG
@@ -244,6 +244,8 @@ namespace aft
     public:
       ExecutionWrapper(const std::vector<uint8_t>& data_) : data(data_) {}
 
+      void prepare() override {}
+
       kv::ApplyResult apply() override
       {
         return kv::ApplyResult::PASS;
@@ -120,6 +120,67 @@ DOCTEST_TEST_CASE("Single node commit" * doctest::test_suite("single"))
   }
 }
 
+DOCTEST_TEST_CASE(
+  "Single node commit waits for ledger flush" * doctest::test_suite("single"))
+{
+  ccf::NodeId node_id = kv::test::PrimaryNodeId;
+  auto kv_store = std::make_shared<Store>(node_id);
+  ms election_timeout(150);
+
+  TRaft r0(
+    ConsensusType::CFT,
+    std::make_unique<Adaptor>(kv_store),
+    std::make_unique<aft::LedgerStubProxy>(node_id),
+    std::make_shared<aft::ChannelStubProxy>(),
+    std::make_shared<aft::StubSnapshotter>(),
+    nullptr,
+    nullptr,
+    cert,
+    std::make_shared<aft::State>(node_id),
+    nullptr,
+    nullptr,
+    nullptr,
+    ms(10),
+    election_timeout,
+    ms(1000),
+    0,
+    false,
+    kv::ReplicaState::Follower,
+    false,
+    true);
+
+  aft::Configuration::Nodes config;
+  config[node_id] = {};
+  r0.add_configuration(0, config);
+
+  r0.periodic(election_timeout * 2);
+  DOCTEST_REQUIRE(r0.is_primary());
+
+  DOCTEST_INFO("Observe that data is not committed until it is durable");
+
+  for (size_t i = 1; i <= 5; ++i)
+  {
+    auto entry = std::make_shared<std::vector<uint8_t>>();
+    entry->push_back(1);
+
+    auto hooks = std::make_shared<kv::ConsensusHookPtrs>();
+
+    r0.replicate(kv::BatchVector{{i, entry, true, hooks}}, 1);
+    DOCTEST_REQUIRE(r0.get_last_idx() == i);
+    DOCTEST_REQUIRE(r0.get_commit_idx() == 0);
+  }
+
+  r0.ledger_flushed(3, 0);
+  DOCTEST_REQUIRE(r0.get_commit_idx() == 3);
+
+  DOCTEST_INFO("Durable indices reported at another generation are ignored");
+  r0.ledger_flushed(5, 1);
+  DOCTEST_REQUIRE(r0.get_commit_idx() == 3);
+
+  r0.ledger_flushed(5, 0);
+  DOCTEST_REQUIRE(r0.get_commit_idx() == 5);
+}
+
 DOCTEST_TEST_CASE(
   "Multiple nodes startup and election" * doctest::test_suite("multiple"))
 {
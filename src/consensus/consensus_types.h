@@ -15,6 +15,8 @@ namespace consensus
     size_t raft_election_timeout;
     size_t bft_view_change_timeout;
     size_t bft_status_interval;
+    bool parallel_deserialisation;
+    bool wait_for_ledger_flush = false;
   };
   DECLARE_JSON_TYPE(Configuration);
   DECLARE_JSON_REQUIRED_FIELDS(
@@ -23,7 +25,9 @@ namespace consensus
     raft_request_timeout,
     raft_election_timeout,
     bft_view_change_timeout,
-    bft_status_interval);
+    bft_status_interval,
+    parallel_deserialisation,
+    wait_for_ledger_flush);
 
 #pragma pack(push, 1)
   template <typename T>
@@ -103,10 +103,13 @@ namespace consensus
      * Truncate the ledger at a given index.
      *
      * @param idx Index to truncate from
+     * @param generation Generation of the ledger after this truncation, which
+     * the host reports with subsequent durable indices (see ledger_flushed)
      */
-    void truncate(Index idx)
+    void truncate(Index idx, size_t generation)
     {
-      RINGBUFFER_WRITE_MESSAGE(consensus::ledger_truncate, to_host, idx);
+      RINGBUFFER_WRITE_MESSAGE(
+        consensus::ledger_truncate, to_host, idx, generation);
     }
 
     /**
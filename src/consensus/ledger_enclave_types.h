@@ -24,15 +24,40 @@ namespace consensus
     DEFINE_RINGBUFFER_MSG_TYPE(ledger_entry),
     DEFINE_RINGBUFFER_MSG_TYPE(ledger_no_entry),
 
+    /// Request contiguous range of ledger entries. Enclave -> Host
+    DEFINE_RINGBUFFER_MSG_TYPE(ledger_get_range),
+
+    /// Respond to ledger_get_range. A single request may be answered by
+    /// several consecutive ledger_entry_range messages. Host -> Enclave
+    DEFINE_RINGBUFFER_MSG_TYPE(ledger_entry_range),
+    DEFINE_RINGBUFFER_MSG_TYPE(ledger_no_entry_range),
+
     /// Modify the local ledger. Enclave -> Host
     DEFINE_RINGBUFFER_MSG_TYPE(ledger_append),
     DEFINE_RINGBUFFER_MSG_TYPE(ledger_truncate),
     DEFINE_RINGBUFFER_MSG_TYPE(ledger_commit),
     DEFINE_RINGBUFFER_MSG_TYPE(ledger_init),
 
-    /// Create and commit a snapshot. Enclave -> Host
+    /// Notify that the local ledger is durable up to an index, as of the
+    /// generation of the last ledger_truncate message processed (group commit
+    /// only). Host -> Enclave
+    DEFINE_RINGBUFFER_MSG_TYPE(ledger_flushed),
+
+    /// Create and commit a snapshot. A snapshot is sent as one or more
+    /// snapshot_chunk messages, followed by either snapshot or snapshot_abort.
+    /// Enclave -> Host
+    DEFINE_RINGBUFFER_MSG_TYPE(snapshot_chunk),
     DEFINE_RINGBUFFER_MSG_TYPE(snapshot),
+    DEFINE_RINGBUFFER_MSG_TYPE(snapshot_abort),
     DEFINE_RINGBUFFER_MSG_TYPE(snapshot_commit),
+
+    /// Request the chunk of the snapshot to start from (on join or recovery)
+    /// at a byte offset. Enclave -> Host
+    DEFINE_RINGBUFFER_MSG_TYPE(startup_snapshot_get),
+
+    /// Respond to startup_snapshot_get. Host -> Enclave
+    DEFINE_RINGBUFFER_MSG_TYPE(startup_snapshot_chunk),
+    DEFINE_RINGBUFFER_MSG_TYPE(startup_snapshot_no_chunk),
   };
 }
 
@@ -47,6 +72,22 @@ DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
   consensus::ledger_no_entry,
   consensus::Index,
   consensus::LedgerRequestPurpose);
+DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
+  consensus::ledger_get_range,
+  consensus::Index /* from */,
+  consensus::Index /* to */,
+  consensus::LedgerRequestPurpose);
+DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
+  consensus::ledger_entry_range,
+  consensus::Index /* from */,
+  consensus::Index /* to */,
+  consensus::LedgerRequestPurpose,
+  std::vector<uint8_t> /* framed entries */);
+DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
+  consensus::ledger_no_entry_range,
+  consensus::Index /* from */,
+  consensus::Index /* to */,
+  consensus::LedgerRequestPurpose);
 DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(consensus::ledger_init, consensus::Index);
 DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
   consensus::ledger_append,
@@ -54,14 +95,33 @@ DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
   bool /* force chunk */,
   std::vector<uint8_t>);
 DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
-  consensus::ledger_truncate, consensus::Index);
+  consensus::ledger_truncate,
+  consensus::Index,
+  size_t /* generation */);
 DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(consensus::ledger_commit, consensus::Index);
 DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
-  consensus::snapshot,
+  consensus::ledger_flushed,
+  consensus::Index,
+  size_t /* generation */);
+DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
+  consensus::snapshot_chunk,
   consensus::Index /* snapshot idx */,
-  consensus::Index /* evidence idx */,
   std::vector<uint8_t>);
+DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
+  consensus::snapshot,
+  consensus::Index /* snapshot idx */,
+  consensus::Index /* evidence idx */);
+DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
+  consensus::snapshot_abort, consensus::Index /* snapshot idx */);
 DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
   consensus::snapshot_commit,
   consensus::Index /* snapshot idx */,
   consensus::Index /* evidence commit idx */);
+DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
+  consensus::startup_snapshot_get, size_t /* offset */);
+DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
+  consensus::startup_snapshot_chunk,
+  size_t /* offset */,
+  std::vector<uint8_t>);
+DECLARE_RINGBUFFER_MESSAGE_PAYLOAD(
+  consensus::startup_snapshot_no_chunk, size_t /* offset */);
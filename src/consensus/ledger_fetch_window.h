@@ -0,0 +1,204 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#pragma once
+
+#include "consensus/ledger_enclave_types.h"
+#include "ds/serialized.h"
+#include "kv/serialised_entry_format.h"
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace consensus
+{
+  /** Tracks the ledger entries requested from the host ahead of being
+   * replayed (e.g. on recovery), so that the host reads the next entries while
+   * the current ones are deserialised.
+   *
+   * Up to window entries after the last one handed out for replay are
+   * requested, in ranges of batch_size entries. Entries may be received in any
+   * order, and are only handed out once all the entries before them have
+   * been. Once the host reports that a range is not available, the remaining
+   * entries are requested one by one from its start, and the first entry
+   * reported missing on its own marks the end of the ledger.
+   */
+  class LedgerFetchWindow
+  {
+  public:
+    // Inclusive range of entries to request from the host
+    using Range = std::pair<Index, Index>;
+
+  private:
+    size_t batch_size;
+    size_t window;
+
+    // Last entry handed out for replay
+    Index received_idx = 0;
+    // Last entry requested from the host
+    Index fetched_idx = 0;
+    // If set, no entry after this one is requested
+    std::optional<Index> last_idx = std::nullopt;
+    // Last entry in the ledger, once known
+    std::optional<Index> end_idx = std::nullopt;
+    bool one_by_one = false;
+
+    // Entries received ahead of received_idx
+    std::map<Index, std::vector<uint8_t>> pending;
+
+    bool is_expected(Index idx) const
+    {
+      return idx > received_idx && idx <= fetched_idx &&
+        (!end_idx.has_value() || idx <= end_idx.value());
+    }
+
+  public:
+    LedgerFetchWindow(size_t batch_size_ = 1, size_t window_ = 1) :
+      batch_size(std::max<size_t>(batch_size_, 1)),
+      window(std::max(window_, batch_size))
+    {}
+
+    /** Starts fetching the entries after @p last_replayed, up to and
+     * including @p last if set. Returns the ranges to request from the host.
+     */
+    std::vector<Range> start(
+      Index last_replayed, std::optional<Index> last = std::nullopt)
+    {
+      received_idx = last_replayed;
+      fetched_idx = last_replayed;
+      last_idx = last;
+      end_idx = std::nullopt;
+      one_by_one = false;
+      pending.clear();
+      return fetch();
+    }
+
+    /** Returns the ranges to request from the host so that the window is
+     * full again.
+     */
+    std::vector<Range> fetch()
+    {
+      std::vector<Range> ranges;
+      const auto batch = one_by_one ? 1 : batch_size;
+      const auto limit = received_idx + (one_by_one ? 1 : window);
+      while (fetched_idx < limit)
+      {
+        const auto from = fetched_idx + 1;
+        if (
+          (last_idx.has_value() && from > last_idx.value()) ||
+          (end_idx.has_value() && from > end_idx.value()))
+        {
+          break;
+        }
+
+        if (pending.find(from) != pending.end())
+        {
+          // Already received, from a range requested earlier
+          fetched_idx = from;
+          continue;
+        }
+
+        auto to = std::min<Index>(from + batch - 1, limit);
+        if (last_idx.has_value())
+        {
+          to = std::min(to, last_idx.value());
+        }
+
+        ranges.emplace_back(from, to);
+        fetched_idx = to;
+      }
+      return ranges;
+    }
+
+    /** Records the framed entries from @p from to @p to received from the
+     * host, and returns the entries which can now be replayed, in order.
+     * Entries which have already been received, or were not requested, are
+     * ignored.
+     */
+    std::vector<std::vector<uint8_t>> receive(
+      Index from, Index to, const std::vector<uint8_t>& framed_entries)
+    {
+      const uint8_t* data = framed_entries.data();
+      size_t size = framed_entries.size();
+      for (auto idx = from; idx <= to; ++idx)
+      {
+        if (size < kv::serialised_entry_header_size)
+        {
+          throw std::logic_error(fmt::format(
+            "Range of ledger entries {}-{} is truncated at {}", from, to, idx));
+        }
+
+        auto header = serialized::peek<kv::SerialisedEntryHeader>(data, size);
+        const auto entry_size = kv::serialised_entry_header_size + header.size;
+        if (size < entry_size)
+        {
+          throw std::logic_error(fmt::format(
+            "Range of ledger entries {}-{} is truncated at {}", from, to, idx));
+        }
+
+        if (is_expected(idx))
+        {
+          pending.emplace(idx, std::vector<uint8_t>(data, data + entry_size));
+        }
+        serialized::skip(data, size, entry_size);
+      }
+
+      std::vector<std::vector<uint8_t>> entries;
+      auto it = pending.begin();
+      while (it != pending.end() && it->first == received_idx + 1)
+      {
+        entries.push_back(std::move(it->second));
+        received_idx = it->first;
+        it = pending.erase(it);
+      }
+      return entries;
+    }
+
+    /** Records that the host could not read all the entries from @p from to
+     * @p to. Returns the ranges to request from the host instead.
+     */
+    std::vector<Range> missing(Index from, Index to)
+    {
+      if (to <= received_idx || from > fetched_idx)
+      {
+        // Response to a request made before the window was restarted
+        return {};
+      }
+
+      const auto first = std::max(from, received_idx + 1);
+      if (first == to && one_by_one)
+      {
+        if (pending.find(first) == pending.end())
+        {
+          // The ledger ends before this entry
+          if (!end_idx.has_value() || first - 1 < end_idx.value())
+          {
+            end_idx = first - 1;
+          }
+          pending.erase(pending.upper_bound(end_idx.value()), pending.end());
+        }
+        return {};
+      }
+
+      // The end of the ledger (or a failed read) lies somewhere in this range.
+      // Retry its entries one by one to find out which.
+      one_by_one = true;
+      fetched_idx = std::min(fetched_idx, first - 1);
+      return fetch();
+    }
+
+    /** True once all the entries before the end of the ledger have been
+     * handed out for replay
+     */
+    bool at_end() const
+    {
+      return end_idx.has_value() && received_idx >= end_idx.value();
+    }
+
+    Index get_received_idx() const
+    {
+      return received_idx;
+    }
+  };
+}
@@ -0,0 +1,602 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#include "sha256_multi.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#  include <cpuid.h>
+#  include <immintrin.h>
+#  define SHA256_MULTI_X86
+#endif
+
+namespace crypto
+{
+  namespace
+  {
+    constexpr size_t block_size = 64;
+    constexpr size_t half_block_size = block_size / 2;
+
+    alignas(64) constexpr uint32_t K[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+      0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+      0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+      0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+      0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+      0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+    constexpr uint32_t IV[8] = {
+      0x6a09e667,
+      0xbb67ae85,
+      0x3c6ef372,
+      0xa54ff53a,
+      0x510e527f,
+      0x9b05688c,
+      0x1f83d9ab,
+      0x5be0cd19};
+
+    // Padding block following an input of exactly one block, such as the
+    // concatenation of two digests
+    alignas(64) constexpr uint8_t pair_padding[block_size] = {
+      0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 0x00};
+
+    inline uint32_t load_be32(const uint8_t* p)
+    {
+      return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+        (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    inline void store_be32(uint8_t* p, uint32_t v)
+    {
+      p[0] = v >> 24;
+      p[1] = v >> 16;
+      p[2] = v >> 8;
+      p[3] = v;
+    }
+
+    // The blocks of an input in the order they are compressed: the whole
+    // blocks of the input itself, then one or two blocks holding its last
+    // bytes and the padding
+    struct PaddedInput
+    {
+      const uint8_t* data = nullptr;
+      size_t whole_blocks = 0;
+      size_t total_blocks = 0;
+      uint8_t tail[2 * block_size];
+
+      void reset(const CBuffer& input)
+      {
+        data = input.p;
+        whole_blocks = input.n / block_size;
+
+        const auto rest = input.n % block_size;
+        total_blocks = whole_blocks + (rest + 9 <= block_size ? 1 : 2);
+
+        std::memset(tail, 0, sizeof(tail));
+        if (rest != 0)
+        {
+          std::memcpy(tail, data + whole_blocks * block_size, rest);
+        }
+        tail[rest] = 0x80;
+
+        const uint64_t bits = uint64_t(input.n) * 8;
+        auto end = tail + (total_blocks - whole_blocks) * block_size;
+        for (size_t i = 1; i <= 8; ++i)
+        {
+          end[-i] = uint8_t(bits >> (8 * (i - 1)));
+        }
+      }
+
+      const uint8_t* block(size_t i) const
+      {
+        return i < whole_blocks ? data + i * block_size :
+                                  tail + (i - whole_blocks) * block_size;
+      }
+    };
+
+    void portable_pairs(
+      const uint8_t* const* lefts,
+      const uint8_t* const* rights,
+      uint8_t* const* outputs,
+      size_t count)
+    {
+      uint8_t block[block_size];
+      for (size_t i = 0; i < count; ++i)
+      {
+        std::memcpy(block, lefts[i], half_block_size);
+        std::memcpy(block + half_block_size, rights[i], half_block_size);
+        default_sha256({block, block_size}, outputs[i]);
+      }
+    }
+
+#ifdef SHA256_MULTI_X86
+    // SHA-NI
+
+    __attribute__((target("sha,sse4.1"))) inline __m128i shani_load(
+      const uint8_t* p, const __m128i& byte_swap)
+    {
+      return _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), byte_swap);
+    }
+
+    // Compresses one block, given as its two halves, into state, which holds
+    // the working variables packed as ABEF and CDGH
+    __attribute__((target("sha,sse4.1"))) inline void shani_compress(
+      __m128i& abef, __m128i& cdgh, const uint8_t* lo, const uint8_t* hi)
+    {
+      const __m128i byte_swap =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+      __m128i w[4] = {
+        shani_load(lo, byte_swap),
+        shani_load(lo + 16, byte_swap),
+        shani_load(hi, byte_swap),
+        shani_load(hi + 16, byte_swap)};
+
+      const auto abef_saved = abef;
+      const auto cdgh_saved = cdgh;
+
+      // Four rounds at a time, extending the message schedule by four words
+      // as soon as the oldest ones have been used
+      for (size_t i = 0; i < 16; ++i)
+      {
+        auto msg =
+          _mm_add_epi32(w[i % 4], _mm_load_si128((const __m128i*)&K[4 * i]));
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0e);
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, msg);
+
+        if (i < 12)
+        {
+          const auto& w1 = w[(i + 1) % 4];
+          const auto& w2 = w[(i + 2) % 4];
+          const auto& w3 = w[(i + 3) % 4];
+          auto next = _mm_sha256msg1_epu32(w[i % 4], w1);
+          next = _mm_add_epi32(next, _mm_alignr_epi8(w3, w2, 4));
+          w[i % 4] = _mm_sha256msg2_epu32(next, w3);
+        }
+      }
+
+      abef = _mm_add_epi32(abef, abef_saved);
+      cdgh = _mm_add_epi32(cdgh, cdgh_saved);
+    }
+
+    __attribute__((target("sha,sse4.1"))) inline void shani_init(
+      __m128i& abef, __m128i& cdgh)
+    {
+      const auto dcba = _mm_loadu_si128((const __m128i*)&IV[0]);
+      const auto hgfe = _mm_loadu_si128((const __m128i*)&IV[4]);
+      const auto cdab = _mm_shuffle_epi32(dcba, 0xb1);
+      const auto efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+      abef = _mm_alignr_epi8(cdab, efgh, 8);
+      cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+    }
+
+    __attribute__((target("sha,sse4.1"))) inline void shani_store(
+      const __m128i& abef, const __m128i& cdgh, uint8_t* out)
+    {
+      const __m128i byte_swap =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+      const auto feba = _mm_shuffle_epi32(abef, 0x1b);
+      const auto dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+      const auto dcba = _mm_blend_epi16(feba, dchg, 0xf0);
+      const auto hgfe = _mm_alignr_epi8(dchg, feba, 8);
+      _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(dcba, byte_swap));
+      _mm_storeu_si128((__m128i*)(out + 16), _mm_shuffle_epi8(hgfe, byte_swap));
+    }
+
+    __attribute__((target("sha,sse4.1"))) void shani_multi(
+      const CBuffer* inputs, uint8_t* const* outputs, size_t count)
+    {
+      PaddedInput input;
+      for (size_t i = 0; i < count; ++i)
+      {
+        input.reset(inputs[i]);
+
+        __m128i abef, cdgh;
+        shani_init(abef, cdgh);
+        for (size_t b = 0; b < input.total_blocks; ++b)
+        {
+          const auto block = input.block(b);
+          shani_compress(abef, cdgh, block, block + half_block_size);
+        }
+        shani_store(abef, cdgh, outputs[i]);
+      }
+    }
+
+    __attribute__((target("sha,sse4.1"))) void shani_pairs(
+      const uint8_t* const* lefts,
+      const uint8_t* const* rights,
+      uint8_t* const* outputs,
+      size_t count)
+    {
+      for (size_t i = 0; i < count; ++i)
+      {
+        __m128i abef, cdgh;
+        shani_init(abef, cdgh);
+        shani_compress(abef, cdgh, lefts[i], rights[i]);
+        shani_compress(
+          abef, cdgh, pair_padding, pair_padding + half_block_size);
+        shani_store(abef, cdgh, outputs[i]);
+      }
+    }
+
+    // AVX2
+
+    constexpr size_t lanes = 8;
+
+    // The state of eight independent digests, word-major so that each word
+    // of the state is one vector
+    struct alignas(32) LaneState
+    {
+      uint32_t words[8][lanes];
+
+      void reset(size_t lane)
+      {
+        for (size_t j = 0; j < 8; ++j)
+        {
+          words[j][lane] = IV[j];
+        }
+      }
+
+      void store(size_t lane, uint8_t* out) const
+      {
+        for (size_t j = 0; j < 8; ++j)
+        {
+          store_be32(out + 4 * j, words[j][lane]);
+        }
+      }
+    };
+
+    template <int N>
+    __attribute__((target("avx2"))) inline __m256i rotr(__m256i x)
+    {
+      return _mm256_or_si256(
+        _mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N));
+    }
+
+    __attribute__((target("avx2"))) inline __m256i add(__m256i a, __m256i b)
+    {
+      return _mm256_add_epi32(a, b);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i x3(
+      __m256i a, __m256i b, __m256i c)
+    {
+      return _mm256_xor_si256(_mm256_xor_si256(a, b), c);
+    }
+
+    // Compresses one block into each lane of state. Each block is given as
+    // its two halves, so that pairs of digests need not be copied together.
+    __attribute__((target("avx2"))) void avx2_compress(
+      LaneState& state,
+      const uint8_t* const* lo,
+      const uint8_t* const* hi)
+    {
+      alignas(32) uint32_t words[16][lanes];
+      for (size_t l = 0; l < lanes; ++l)
+      {
+        for (size_t t = 0; t < 8; ++t)
+        {
+          words[t][l] = load_be32(lo[l] + 4 * t);
+          words[t + 8][l] = load_be32(hi[l] + 4 * t);
+        }
+      }
+
+      __m256i w[16];
+      for (size_t t = 0; t < 16; ++t)
+      {
+        w[t] = _mm256_load_si256((const __m256i*)words[t]);
+      }
+
+      __m256i s[8];
+      for (size_t j = 0; j < 8; ++j)
+      {
+        s[j] = _mm256_load_si256((const __m256i*)state.words[j]);
+      }
+
+      auto a = s[0], b = s[1], c = s[2], d = s[3];
+      auto e = s[4], f = s[5], g = s[6], h = s[7];
+
+      for (size_t t = 0; t < 64; ++t)
+      {
+        if (t >= 16)
+        {
+          const auto w15 = w[(t - 15) % 16];
+          const auto w2 = w[(t - 2) % 16];
+          const auto sigma0 =
+            x3(rotr<7>(w15), rotr<18>(w15), _mm256_srli_epi32(w15, 3));
+          const auto sigma1 =
+            x3(rotr<17>(w2), rotr<19>(w2), _mm256_srli_epi32(w2, 10));
+          w[t % 16] =
+            add(add(w[t % 16], sigma0), add(w[(t - 7) % 16], sigma1));
+        }
+
+        const auto big_sigma1 = x3(rotr<6>(e), rotr<11>(e), rotr<25>(e));
+        const auto ch = _mm256_xor_si256(
+          _mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        const auto t1 = add(
+          add(h, big_sigma1),
+          add(ch, add(_mm256_set1_epi32(K[t]), w[t % 16])));
+
+        const auto big_sigma0 = x3(rotr<2>(a), rotr<13>(a), rotr<22>(a));
+        const auto maj = _mm256_or_si256(
+          _mm256_and_si256(a, b),
+          _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        const auto t2 = add(big_sigma0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = add(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = add(t1, t2);
+      }
+
+      const __m256i out[8] = {a, b, c, d, e, f, g, h};
+      for (size_t j = 0; j < 8; ++j)
+      {
+        _mm256_store_si256((__m256i*)state.words[j], add(s[j], out[j]));
+      }
+    }
+
+    void avx2_multi(
+      const CBuffer* inputs, uint8_t* const* outputs, size_t count)
+    {
+      // Each lane compresses the blocks of one input, and is handed the next
+      // input as soon as it is done, so that inputs of different lengths do
+      // not leave lanes idle. Idle lanes at the end of the batch compress a
+      // dummy block.
+      static constexpr uint8_t idle_block[block_size] = {};
+
+      LaneState state;
+      std::array<PaddedInput, lanes> padded;
+      std::array<size_t, lanes> input_of;
+      std::array<size_t, lanes> next_block;
+      std::array<bool, lanes> busy = {};
+      size_t next_input = 0;
+
+      const uint8_t* lo[lanes];
+      const uint8_t* hi[lanes];
+
+      while (true)
+      {
+        size_t busy_lanes = 0;
+        for (size_t l = 0; l < lanes; ++l)
+        {
+          if (!busy[l] && next_input < count)
+          {
+            padded[l].reset(inputs[next_input]);
+            input_of[l] = next_input++;
+            next_block[l] = 0;
+            state.reset(l);
+            busy[l] = true;
+          }
+
+          if (busy[l])
+          {
+            lo[l] = padded[l].block(next_block[l]);
+            busy_lanes++;
+          }
+          else
+          {
+            lo[l] = idle_block;
+          }
+          hi[l] = lo[l] + half_block_size;
+        }
+
+        if (busy_lanes == 0)
+        {
+          return;
+        }
+
+        avx2_compress(state, lo, hi);
+
+        for (size_t l = 0; l < lanes; ++l)
+        {
+          if (busy[l] && ++next_block[l] == padded[l].total_blocks)
+          {
+            state.store(l, outputs[input_of[l]]);
+            busy[l] = false;
+          }
+        }
+      }
+    }
+
+    void avx2_pairs(
+      const uint8_t* const* lefts,
+      const uint8_t* const* rights,
+      uint8_t* const* outputs,
+      size_t count)
+    {
+      const uint8_t* padding_lo[lanes];
+      const uint8_t* padding_hi[lanes];
+      for (size_t l = 0; l < lanes; ++l)
+      {
+        padding_lo[l] = pair_padding;
+        padding_hi[l] = pair_padding + half_block_size;
+      }
+
+      LaneState state;
+      for (size_t i = 0; i < count; i += lanes)
+      {
+        const auto n = std::min(lanes, count - i);
+
+        // The last lanes of an incomplete batch recompute the first pair
+        const uint8_t* lo[lanes];
+        const uint8_t* hi[lanes];
+        for (size_t l = 0; l < lanes; ++l)
+        {
+          const auto j = l < n ? i + l : i;
+          lo[l] = lefts[j];
+          hi[l] = rights[j];
+          state.reset(l);
+        }
+
+        avx2_compress(state, lo, hi);
+        avx2_compress(state, padding_lo, padding_hi);
+
+        for (size_t l = 0; l < n; ++l)
+        {
+          state.store(l, outputs[i + l]);
+        }
+      }
+    }
+
+    struct CpuFeatures
+    {
+      bool avx2 = false;
+      bool sha = false;
+
+      CpuFeatures()
+      {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        {
+          return;
+        }
+
+        const bool sse41 = ecx & bit_SSE4_1;
+        const bool osxsave = ecx & bit_OSXSAVE;
+        const bool avx = ecx & bit_AVX;
+
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        {
+          return;
+        }
+
+        sha = sse41 && (ebx & bit_SHA);
+
+        if (osxsave && avx)
+        {
+          // The OS must also save the upper halves of the YMM registers
+          uint32_t xcr0_lo, xcr0_hi;
+          asm volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+          avx2 = (ebx & bit_AVX2) && (xcr0_lo & 0x6) == 0x6;
+        }
+      }
+    };
+
+    const CpuFeatures& cpu_features()
+    {
+      static const CpuFeatures features;
+      return features;
+    }
+#endif
+  }
+
+  bool sha256_kernel_supported(Sha256Kernel kernel)
+  {
+    switch (kernel)
+    {
+      case Sha256Kernel::Portable:
+        return true;
+#ifdef SHA256_MULTI_X86
+      case Sha256Kernel::AVX2:
+        return cpu_features().avx2;
+      case Sha256Kernel::SHANI:
+        return cpu_features().sha;
+#endif
+      default:
+        return false;
+    }
+  }
+
+  Sha256Kernel sha256_default_kernel()
+  {
+    static const auto kernel = []() {
+      // SHA-NI computes a single digest faster than AVX2 computes eight
+      for (auto k : {Sha256Kernel::SHANI, Sha256Kernel::AVX2})
+      {
+        if (sha256_kernel_supported(k))
+        {
+          return k;
+        }
+      }
+      return Sha256Kernel::Portable;
+    }();
+    return kernel;
+  }
+
+  void sha256_multi(
+    const CBuffer* inputs,
+    uint8_t* const* outputs,
+    size_t count,
+    Sha256Kernel kernel)
+  {
+    if (!sha256_kernel_supported(kernel))
+    {
+      throw std::logic_error("SHA-256 kernel not supported by this CPU");
+    }
+
+    switch (kernel)
+    {
+#ifdef SHA256_MULTI_X86
+      case Sha256Kernel::AVX2:
+        avx2_multi(inputs, outputs, count);
+        return;
+      case Sha256Kernel::SHANI:
+        shani_multi(inputs, outputs, count);
+        return;
+#endif
+      default:
+        for (size_t i = 0; i < count; ++i)
+        {
+          default_sha256(inputs[i], outputs[i]);
+        }
+        return;
+    }
+  }
+
+  std::vector<Sha256Hash> sha256_multi(const std::vector<CBuffer>& inputs)
+  {
+    std::vector<Sha256Hash> hashes(inputs.size());
+    std::vector<uint8_t*> outputs(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+      outputs[i] = hashes[i].h.data();
+    }
+    sha256_multi(inputs.data(), outputs.data(), inputs.size());
+    return hashes;
+  }
+
+  void sha256_pairs(
+    const uint8_t* const* lefts,
+    const uint8_t* const* rights,
+    uint8_t* const* outputs,
+    size_t count,
+    Sha256Kernel kernel)
+  {
+    if (!sha256_kernel_supported(kernel))
+    {
+      throw std::logic_error("SHA-256 kernel not supported by this CPU");
+    }
+
+    switch (kernel)
+    {
+#ifdef SHA256_MULTI_X86
+      case Sha256Kernel::AVX2:
+        avx2_pairs(lefts, rights, outputs, count);
+        return;
+      case Sha256Kernel::SHANI:
+        shani_pairs(lefts, rights, outputs, count);
+        return;
+#endif
+      default:
+        portable_pairs(lefts, rights, outputs, count);
+        return;
+    }
+  }
+}
@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#pragma once
+
+#include "hash_provider.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace crypto
+{
+  /** Implementations of the batched SHA-256 functions below. All of them
+   * produce the same digests, but only Portable is available on every CPU.
+   */
+  enum class Sha256Kernel
+  {
+    /// One digest at a time, with default_sha256
+    Portable,
+    /// Eight independent digests at a time, one per 32-bit AVX2 lane
+    AVX2,
+    /// One digest at a time, with the SHA-NI instructions
+    SHANI
+  };
+
+  /** Whether the CPU we are running on supports @p kernel */
+  bool sha256_kernel_supported(Sha256Kernel kernel);
+
+  /** The fastest kernel supported by the CPU we are running on, detected
+   * once on first use
+   */
+  Sha256Kernel sha256_default_kernel();
+
+  /** Compute the SHA-256 digests of @p count independent inputs at once
+   * @param inputs The @p count inputs to compute the digests of
+   * @param outputs The @p count buffers of Sha256Hash::SIZE bytes to write
+   * the digests to
+   * @param count The number of inputs
+   * @param kernel The implementation to use, which must be supported
+   */
+  void sha256_multi(
+    const CBuffer* inputs,
+    uint8_t* const* outputs,
+    size_t count,
+    Sha256Kernel kernel = sha256_default_kernel());
+
+  /** Compute the SHA-256 digests of @p inputs at once
+   * @param inputs The inputs to compute the digests of
+   */
+  std::vector<Sha256Hash> sha256_multi(const std::vector<CBuffer>& inputs);
+
+  /** Compute the SHA-256 digests of @p count concatenations of two
+   * Sha256Hash::SIZE byte digests, as for the nodes of a Merkle tree
+   * @param lefts The first halves of the inputs
+   * @param rights The second halves of the inputs
+   * @param outputs The @p count buffers to write the digests to
+   * @param count The number of inputs
+   * @param kernel The implementation to use, which must be supported
+   */
+  void sha256_pairs(
+    const uint8_t* const* lefts,
+    const uint8_t* const* rights,
+    uint8_t* const* outputs,
+    size_t count,
+    Sha256Kernel kernel = sha256_default_kernel());
+}
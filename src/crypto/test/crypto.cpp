@@ -14,6 +14,7 @@
 #include "crypto/openssl/symmetric_key.h"
 #include "crypto/openssl/verifier.h"
 #include "crypto/rsa_key_pair.h"
+#include "crypto/sha256_multi.h"
 #include "crypto/symmetric_key.h"
 #include "crypto/verifier.h"
 #include "tls/base64.h"
@@ -589,4 +590,78 @@ TEST_CASE("AES-GCM convenience functions")
   auto encrypted = aes_gcm_encrypt(key, contents);
   auto decrypted = aes_gcm_decrypt(key, encrypted);
   REQUIRE(decrypted == contents);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Batched SHA-256 kernels")
+{
+  EntropyPtr entropy = create_entropy();
+
+  // Lengths around the block boundaries, where the padding spills over into
+  // an extra block, and inputs of very different lengths in the same batch
+  std::vector<std::vector<uint8_t>> data;
+  for (size_t n : {0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000, 4099})
+  {
+    data.push_back(entropy->random(n));
+  }
+  for (size_t i = 0; i < 37; ++i)
+  {
+    data.push_back(entropy->random(entropy->random64() % 300));
+  }
+
+  std::vector<std::vector<uint8_t>> halves;
+  for (size_t i = 0; i < 2 * 37; ++i)
+  {
+    halves.push_back(entropy->random(Sha256Hash::SIZE));
+  }
+
+  for (auto kernel :
+       {Sha256Kernel::Portable, Sha256Kernel::AVX2, Sha256Kernel::SHANI})
+  {
+    if (!sha256_kernel_supported(kernel))
+    {
+      continue;
+    }
+
+    INFO("Kernel " << static_cast<int>(kernel));
+
+    for (size_t count : {(size_t)1, (size_t)8, data.size()})
+    {
+      std::vector<CBuffer> inputs;
+      std::vector<Sha256Hash> hashes(count);
+      std::vector<uint8_t*> outputs;
+      for (size_t i = 0; i < count; ++i)
+      {
+        inputs.emplace_back(data[i].data(), data[i].size());
+        outputs.push_back(hashes[i].h.data());
+      }
+
+      sha256_multi(inputs.data(), outputs.data(), count, kernel);
+
+      for (size_t i = 0; i < count; ++i)
+      {
+        REQUIRE(hashes[i] == Sha256Hash(inputs[i]));
+      }
+    }
+
+    const auto count = halves.size() / 2;
+    std::vector<const uint8_t*> lefts, rights;
+    std::vector<Sha256Hash> hashes(count);
+    std::vector<uint8_t*> outputs;
+    for (size_t i = 0; i < count; ++i)
+    {
+      lefts.push_back(halves[2 * i].data());
+      rights.push_back(halves[2 * i + 1].data());
+      outputs.push_back(hashes[i].h.data());
+    }
+
+    sha256_pairs(lefts.data(), rights.data(), outputs.data(), count, kernel);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      const auto& right = halves[2 * i + 1];
+      auto pair = halves[2 * i];
+      pair.insert(pair.end(), right.begin(), right.end());
+      REQUIRE(hashes[i] == Sha256Hash(pair));
+    }
+  }
+}
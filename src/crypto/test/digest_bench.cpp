@@ -4,6 +4,7 @@
 #include "crypto/hash.h"
 #include "crypto/mbedtls/hash.h"
 #include "crypto/openssl/hash.h"
+#include "crypto/sha256_multi.h"
 
 #define PICOBENCH_IMPLEMENT_WITH_MAIN
 #include <picobench/picobench.hpp>
@@ -49,3 +50,123 @@ PICOBENCH(mbedtls_digest_sha256).iterations(hash_sizes).baseline();
 
 auto openssl_digest_sha256 = sha256_bench<HashImpl::openssl>;
 PICOBENCH(openssl_digest_sha256).iterations(hash_sizes).baseline();
+
+// Many independent digests at once, as for the leaves of the Merkle tree,
+// with each input in turn or with the batched kernels
+static constexpr size_t batch_size = 64;
+
+template <crypto::Sha256Kernel KERNEL>
+static void sha256_multi_bench(picobench::state& s)
+{
+  if (!crypto::sha256_kernel_supported(KERNEL))
+  {
+    return;
+  }
+
+  std::vector<std::vector<uint8_t>> data(batch_size);
+  std::vector<CBuffer> inputs;
+  std::vector<crypto::Sha256Hash> hashes(batch_size);
+  std::vector<uint8_t*> outputs;
+  for (size_t i = 0; i < batch_size; ++i)
+  {
+    data[i].resize(s.iterations());
+    for (auto& b : data[i])
+    {
+      b = rand();
+    }
+    inputs.emplace_back(data[i].data(), data[i].size());
+    outputs.push_back(hashes[i].h.data());
+  }
+
+  s.start_timer();
+  for (size_t i = 0; i < 10; ++i)
+  {
+    if constexpr (KERNEL == crypto::Sha256Kernel::Portable)
+    {
+      for (size_t j = 0; j < batch_size; ++j)
+      {
+        crypto::openssl_sha256(inputs[j], outputs[j]);
+      }
+    }
+    else
+    {
+      crypto::sha256_multi(inputs.data(), outputs.data(), batch_size, KERNEL);
+    }
+  }
+  s.stop_timer();
+}
+
+// Node hashes of the Merkle tree, each over the concatenation of two digests
+template <crypto::Sha256Kernel KERNEL>
+static void sha256_pairs_bench(picobench::state& s)
+{
+  if (!crypto::sha256_kernel_supported(KERNEL))
+  {
+    return;
+  }
+
+  std::vector<crypto::Sha256Hash> hashes(s.iterations() + 1);
+  for (auto& h : hashes)
+  {
+    for (auto& b : h.h)
+    {
+      b = rand();
+    }
+  }
+
+  std::vector<const uint8_t*> lefts, rights;
+  std::vector<uint8_t*> outputs;
+  for (size_t i = 0; i < s.iterations(); ++i)
+  {
+    lefts.push_back(hashes[i].h.data());
+    rights.push_back(hashes[i + 1].h.data());
+    outputs.push_back(hashes[i].h.data());
+  }
+
+  s.start_timer();
+  if constexpr (KERNEL == crypto::Sha256Kernel::Portable)
+  {
+    uint8_t block[2 * crypto::Sha256Hash::SIZE];
+    for (size_t i = 0; i < lefts.size(); ++i)
+    {
+      std::copy(lefts[i], lefts[i] + crypto::Sha256Hash::SIZE, block);
+      std::copy(
+        rights[i],
+        rights[i] + crypto::Sha256Hash::SIZE,
+        block + crypto::Sha256Hash::SIZE);
+      crypto::openssl_sha256({block, sizeof(block)}, outputs[i]);
+    }
+  }
+  else
+  {
+    crypto::sha256_pairs(
+      lefts.data(), rights.data(), outputs.data(), lefts.size(), KERNEL);
+  }
+  s.stop_timer();
+}
+
+const std::vector<int> batch_hash_sizes = {2 << 5, 2 << 7, 2 << 9, 2 << 12};
+
+PICOBENCH_SUITE("SHA-256 batch of 64");
+
+auto openssl_batch_sha256 = sha256_multi_bench<crypto::Sha256Kernel::Portable>;
+PICOBENCH(openssl_batch_sha256).iterations(batch_hash_sizes).baseline();
+
+auto avx2_batch_sha256 = sha256_multi_bench<crypto::Sha256Kernel::AVX2>;
+PICOBENCH(avx2_batch_sha256).iterations(batch_hash_sizes);
+
+auto shani_batch_sha256 = sha256_multi_bench<crypto::Sha256Kernel::SHANI>;
+PICOBENCH(shani_batch_sha256).iterations(batch_hash_sizes);
+
+const std::vector<int> pair_counts = {2 << 6, 2 << 10, 2 << 14};
+
+PICOBENCH_SUITE("SHA-256 pairs");
+
+auto openssl_pairs_sha256 = sha256_pairs_bench<crypto::Sha256Kernel::Portable>;
+PICOBENCH(openssl_pairs_sha256).iterations(pair_counts).baseline();
+
+auto avx2_pairs_sha256 = sha256_pairs_bench<crypto::Sha256Kernel::AVX2>;
+PICOBENCH(avx2_pairs_sha256).iterations(pair_counts);
+
+auto shani_pairs_sha256 = sha256_pairs_bench<crypto::Sha256Kernel::SHANI>;
+PICOBENCH(shani_pairs_sha256).iterations(pair_counts);
@@ -0,0 +1,125 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace ds
+{
+  /**
+   * A bump allocator, for many small allocations which share a lifetime.
+   * Memory is first carved out of a block held inline, then out of heap blocks
+   * which grow geometrically. It is only released when the Arena itself is
+   * destroyed - deallocate() is a no-op. Not thread-safe.
+   */
+  class Arena
+  {
+  private:
+    static constexpr size_t inline_block_size = 2048;
+    static constexpr size_t max_block_size = 1 << 20;
+
+    alignas(std::max_align_t) uint8_t inline_block[inline_block_size];
+
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    uint8_t* next = inline_block;
+    size_t remaining = inline_block_size;
+    size_t next_block_size = 2 * inline_block_size;
+
+    void add_block(size_t min_size)
+    {
+      const auto size = std::max(next_block_size, min_size);
+      // NB: Not value-initialised
+      blocks.emplace_back(new uint8_t[size]);
+      next = blocks.back().get();
+      remaining = size;
+      next_block_size = std::min(next_block_size * 2, max_block_size);
+    }
+
+  public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+      auto p = static_cast<void*>(next);
+      if (std::align(align, size, p, remaining) == nullptr)
+      {
+        add_block(size + align);
+        p = next;
+        std::align(align, size, p, remaining);
+      }
+
+      next = static_cast<uint8_t*>(p) + size;
+      remaining -= size;
+      return p;
+    }
+
+    // Number of heap blocks allocated so far
+    size_t get_block_count() const
+    {
+      return blocks.size();
+    }
+  };
+
+  /**
+   * Standard allocator over an Arena. A default-constructed ArenaAllocator has
+   * no arena, and falls back to the global allocator, so containers using it
+   * remain usable outside of an arena's scope. Containers allocating from an
+   * arena must not outlive it.
+   */
+  template <typename T>
+  class ArenaAllocator
+  {
+  private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    Arena* arena = nullptr;
+
+  public:
+    using value_type = T;
+
+    ArenaAllocator() = default;
+    ArenaAllocator(Arena* arena_) : arena(arena_) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena)
+    {}
+
+    T* allocate(size_t n)
+    {
+      if (arena == nullptr)
+      {
+        return std::allocator<T>().allocate(n);
+      }
+
+      return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+      if (arena == nullptr)
+      {
+        std::allocator<T>().deallocate(p, n);
+      }
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const
+    {
+      return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const
+    {
+      return arena != other.arena;
+    }
+  };
+}
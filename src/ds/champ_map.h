@@ -8,6 +8,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -74,6 +75,18 @@ namespace champ
     }
   };
 
+  // Nodes created by a transient map (see Map::Transient) are tagged with its
+  // edit token, and are mutated in place by further writes to that transient
+  // map. Nodes of persistent maps are never mutated.
+  using EditToken = uint64_t;
+  static constexpr EditToken no_edit = 0;
+
+  static inline EditToken make_edit_token()
+  {
+    static std::atomic<EditToken> next_edit_token = no_edit + 1;
+    return next_edit_token++;
+  }
+
   template <class K, class V, class H>
   struct SubNodes;
 
@@ -119,6 +132,7 @@ namespace champ
   struct Collisions
   {
     std::array<std::vector<std::shared_ptr<Entry<K, V>>>, collision_bins> bins;
+    EditToken edit = no_edit;
 
     const V* getp(Hash hash, const K& k) const
     {
@@ -186,6 +200,7 @@ namespace champ
     std::vector<Node<K, V, H>> nodes;
     Bitmap node_map;
     Bitmap data_map;
+    EditToken edit = no_edit;
 
     SubNodes() {}
 
@@ -226,7 +241,14 @@ namespace champ
       return node_as<SubNodes<K, V, H>>(c_idx)->getp(depth + 1, hash, k);
     }
 
-    size_t put_mut(SmallIndex depth, Hash hash, const K& k, const V& v)
+    // Mutates this node, and copies the children on the path to k before
+    // mutating them, unless they are already owned by edit
+    size_t put_mut(
+      SmallIndex depth,
+      Hash hash,
+      const K& k,
+      const V& v,
+      EditToken edit_ = no_edit)
     {
       const auto idx = mask(hash, depth);
       auto c_idx = compressed_idx(idx);
@@ -242,20 +264,13 @@ namespace champ
 
       if (node_map.check(idx))
       {
-        size_t insert;
         if (depth < (collision_depth - 1))
         {
-          auto sn = *node_as<SubNodes<K, V, H>>(c_idx);
-          insert = sn.put_mut(depth + 1, hash, k, v);
-          nodes[c_idx] = std::make_shared<SubNodes<K, V, H>>(std::move(sn));
-        }
-        else
-        {
-          auto sn = *node_as<Collisions<K, V, H>>(c_idx);
-          insert = sn.put_mut(hash, k, v);
-          nodes[c_idx] = std::make_shared<Collisions<K, V, H>>(std::move(sn));
+          return editable_node<SubNodes<K, V, H>>(c_idx, edit_).put_mut(
+            depth + 1, hash, k, v, edit_);
         }
-        return insert;
+        return editable_node<Collisions<K, V, H>>(c_idx, edit_)
+          .put_mut(hash, k, v);
       }
 
       const auto& entry0 = node_as<Entry<K, V>>(c_idx);
@@ -273,7 +288,8 @@ namespace champ
         const auto idx0 = mask(hash0, depth + 1);
         auto sub_node =
           SubNodes<K, V, H>({entry0}, Bitmap(0), Bitmap(0).set(idx0));
-        sub_node.put_mut(depth + 1, hash, k, v);
+        sub_node.edit = edit_;
+        sub_node.put_mut(depth + 1, hash, k, v, edit_);
 
         nodes.erase(nodes.begin() + c_idx);
         data_map = data_map.clear(idx);
@@ -286,6 +302,7 @@ namespace champ
       else
       {
         auto sub_node = Collisions<K, V, H>();
+        sub_node.edit = edit_;
         const auto hash0 = H()(entry0->key);
         const auto idx0 = mask(hash0, collision_depth);
         sub_node.bins[idx0].push_back(entry0);
@@ -307,12 +324,14 @@ namespace champ
       SmallIndex depth, Hash hash, const K& k, const V& v) const
     {
       auto node = *this;
+      node.edit = no_edit;
       auto r = node.put_mut(depth, hash, k, v);
       return std::make_pair(
         std::make_shared<SubNodes<K, V, H>>(std::move(node)), r);
     }
 
-    size_t remove_mut(SmallIndex depth, Hash hash, const K& k)
+    size_t remove_mut(
+      SmallIndex depth, Hash hash, const K& k, EditToken edit_ = no_edit)
     {
       const auto idx = mask(hash, depth);
       const auto c_idx = compressed_idx(idx);
@@ -334,22 +353,19 @@ namespace champ
 
       if (depth == (collision_depth - 1))
       {
-        auto sn = *node_as<Collisions<K, V, H>>(c_idx);
-        const auto diff = sn.remove_mut(hash, k);
-        nodes[c_idx] = std::make_shared<Collisions<K, V, H>>(std::move(sn));
-        return diff;
+        return editable_node<Collisions<K, V, H>>(c_idx, edit_)
+          .remove_mut(hash, k);
       }
 
-      auto sn = *node_as<SubNodes<K, V, H>>(c_idx);
-      const auto diff = sn.remove_mut(depth + 1, hash, k);
-      nodes[c_idx] = std::make_shared<SubNodes<K, V, H>>(std::move(sn));
-      return diff;
+      return editable_node<SubNodes<K, V, H>>(c_idx, edit_)
+        .remove_mut(depth + 1, hash, k, edit_);
     }
 
     std::pair<std::shared_ptr<SubNodes<K, V, H>>, size_t> remove(
       SmallIndex depth, Hash hash, const K& k) const
     {
       auto node = *this;
+      node.edit = no_edit;
       auto r = node.remove_mut(depth, hash, k);
       return std::make_pair(
         std::make_shared<SubNodes<K, V, H>>(std::move(node)), r);
@@ -388,6 +404,23 @@ namespace champ
     {
       return reinterpret_cast<const std::shared_ptr<A>&>(nodes[c_idx]);
     }
+
+    // Returns the child node at c_idx if it is owned by edit_, or else
+    // replaces it with a copy owned by edit_
+    template <class A>
+    A& editable_node(SmallIndex c_idx, EditToken edit_)
+    {
+      const auto& node = node_as<A>(c_idx);
+      if (edit_ != no_edit && node->edit == edit_)
+      {
+        return *node;
+      }
+
+      auto copy = std::make_shared<A>(*node);
+      copy->edit = edit_;
+      nodes[c_idx] = copy;
+      return *copy;
+    }
   };
 
   template <class K, class V, class H = std::hash<K>>
@@ -410,12 +443,15 @@ namespace champ
   public:
     Map() : root(std::make_shared<SubNodes<K, V, H>>()) {}
 
-    static Map<K, V, H> deserialize_map(CBuffer serialized_state)
+    // If the serialised state is only a segment of a map's entries, the
+    // remaining segments can be added to the map deserialised so far
+    static Map<K, V, H> deserialize_map(
+      CBuffer serialized_state, Map<K, V, H> map = {})
     {
-      Map<K, V, H> map;
       const uint8_t* data = serialized_state.p;
       size_t size = serialized_state.rawSize();
 
+      auto transient = map.transient();
       while (size != 0)
       {
         // Deserialize the key
@@ -429,9 +465,9 @@ namespace champ
         V value = champ::deserialize<V>(data, size);
         value_size -= size;
         serialized::skip(data, size, get_padding(value_size));
-        map = map.put(key, value);
+        transient.put(key, value);
       }
-      return map;
+      return transient.persistent();
     }
 
     size_t size() const
@@ -490,6 +526,92 @@ namespace champ
     {
       return root->foreach(0, std::forward<F>(f));
     }
+
+    // A transient map applies a batch of writes to a map in place: the nodes
+    // it shares with the original map are copied the first time they are
+    // written to, but nodes it has created are then mutated directly, rather
+    // than path-copied by every write. persistent() returns the resulting
+    // map, and the transient map can keep on being written to afterwards
+    // without affecting it.
+    class Transient
+    {
+    private:
+      std::shared_ptr<SubNodes<K, V, H>> root;
+      size_t map_size;
+      size_t serialized_size;
+      EditToken edit;
+
+      SubNodes<K, V, H>& editable_root()
+      {
+        if (root->edit != edit)
+        {
+          auto copy = std::make_shared<SubNodes<K, V, H>>(*root);
+          copy->edit = edit;
+          root = std::move(copy);
+        }
+        return *root;
+      }
+
+    public:
+      Transient(const Map<K, V, H>& map) :
+        root(map.root),
+        map_size(map.map_size),
+        serialized_size(map.serialized_size),
+        edit(make_edit_token())
+      {}
+
+      size_t size() const
+      {
+        return map_size;
+      }
+
+      const V* getp(const K& key) const
+      {
+        return root->getp(0, H()(key), key);
+      }
+
+      std::optional<V> get(const K& key) const
+      {
+        auto v = getp(key);
+        if (v)
+          return *v;
+        else
+          return {};
+      }
+
+      void put(const K& key, const V& value)
+      {
+        auto r = editable_root().put_mut(0, H()(key), key, value, edit);
+        if (r == 0)
+          map_size++;
+
+        int64_t size_change = get_size_with_padding<K, V>(key, value) - r;
+        serialized_size += size_change;
+      }
+
+      void remove(const K& key)
+      {
+        auto r = editable_root().remove_mut(0, H()(key), key, edit);
+        if (r > 0)
+          map_size--;
+
+        serialized_size -= r;
+      }
+
+      Map<K, V, H> persistent()
+      {
+        // The nodes owned by this transient map now belong to the returned
+        // map, so further writes must copy them again
+        edit = make_edit_token();
+        auto root_ = root;
+        return Map(std::move(root_), map_size, serialized_size);
+      }
+    };
+
+    Transient transient() const
+    {
+      return Transient(*this);
+    }
   };
 
   template <class K, class V, class H = std::hash<K>>
@@ -504,11 +626,23 @@ namespace champ
       K* k;
       Hash h_k;
       V* v;
-
-      KVTuple(K* k_, Hash h_k_, V* v_) : k(k_), h_k(h_k_), v(v_) {}
+      uint32_t size;
+
+      KVTuple(K* k_, Hash h_k_, V* v_, uint32_t size_) :
+        k(k_),
+        h_k(h_k_),
+        v(v_),
+        size(size_)
+      {}
     };
     const uintptr_t padding = 0;
 
+    // If set, entries are serialised in key order rather than hash order
+    bool order_by_key = false;
+
+    // Entries in serialisation order, only populated once required
+    std::vector<KVTuple> ordered_state;
+
     uint32_t add_padding(uint32_t data_size, uint8_t*& data, size_t& size) const
     {
       uint32_t padding_size = get_padding(data_size);
@@ -520,25 +654,13 @@ namespace champ
       return padding_size;
     }
 
-  public:
-    Snapshot(Map<K, V, H>& map_)
-    {
-      map = map_;
-    }
-
-    size_t get_serialized_size()
+    void order_state()
     {
-      return map.get_serialized_size();
-    }
-
-    CBuffer& get_serialized_buffer()
-    {
-      return serialized_buffer;
-    }
+      if (ordered_state.size() == map.size())
+      {
+        return;
+      }
 
-    void serialize(uint8_t* data)
-    {
-      std::vector<KVTuple> ordered_state;
       ordered_state.reserve(map.size());
       size_t size = 0;
 
@@ -552,17 +674,28 @@ namespace champ
 
         size += (key_size + value_size);
 
-        ordered_state.emplace_back(k, static_cast<Hash>(H()(key)), v);
+        ordered_state.emplace_back(
+          k, static_cast<Hash>(H()(key)), v, key_size + value_size);
 
         return true;
       });
 
       // Sort keys to be able to generate byte-for-byte serialised snapshot from
       // the same state
-      std::sort(
-        ordered_state.begin(), ordered_state.end(), [](KVTuple& i, KVTuple& j) {
-          return i.h_k < j.h_k;
-        });
+      if (order_by_key)
+      {
+        std::sort(
+          ordered_state.begin(),
+          ordered_state.end(),
+          [](KVTuple& i, KVTuple& j) { return *i.k < *j.k; });
+      }
+      else
+      {
+        std::sort(
+          ordered_state.begin(),
+          ordered_state.end(),
+          [](KVTuple& i, KVTuple& j) { return i.h_k < j.h_k; });
+      }
 
       CCF_ASSERT_FMT(
         size == map.get_serialized_size(),
@@ -571,11 +704,77 @@ namespace champ
         map.get_serialized_size(),
         map.size(),
         ordered_state.size());
+    }
+
+  public:
+    Snapshot(Map<K, V, H>& map_, bool order_by_key_ = false) :
+      order_by_key(order_by_key_)
+    {
+      map = map_;
+    }
+
+    size_t size() const
+    {
+      return map.size();
+    }
+
+    size_t get_serialized_size()
+    {
+      return map.get_serialized_size();
+    }
+
+    CBuffer& get_serialized_buffer()
+    {
+      return serialized_buffer;
+    }
+
+    void serialize(uint8_t* data)
+    {
+      order_state();
+      serialize_segment(0, ordered_state.size(), data);
 
       serialized_buffer = CBuffer(data, map.get_serialized_size());
+    }
+
+    /** Returns the end of the segment of entries starting at entry @p from
+     * which fits in @p max_size bytes, and the serialised size of that
+     * segment. A segment always contains at least one entry, unless all
+     * entries are before @p from.
+     */
+    std::pair<size_t, size_t> get_segment(size_t from, size_t max_size)
+    {
+      order_state();
+
+      size_t to = from;
+      size_t size = 0;
+      while (to < ordered_state.size() &&
+             (to == from || size + ordered_state[to].size <= max_size))
+      {
+        size += ordered_state[to].size;
+        ++to;
+      }
+
+      return {to, size};
+    }
 
-      for (const auto& p : ordered_state)
+    /** Serialises entries [@p from, @p to) into @p data, which must be large
+     * enough to hold them (see get_segment()). Deserialising each segment in
+     * turn into the same map yields the original map.
+     */
+    void serialize_segment(size_t from, size_t to, uint8_t* data)
+    {
+      order_state();
+
+      size_t size = 0;
+      for (auto i = from; i < to; ++i)
       {
+        size += ordered_state[i].size;
+      }
+
+      for (auto i = from; i < to; ++i)
+      {
+        const auto& p = ordered_state[i];
+
         // Serialize the key
         uint32_t key_size = champ::serialize(*p.k, data, size);
         add_padding(key_size, data, size);
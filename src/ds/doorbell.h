@@ -0,0 +1,236 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#if defined(INSIDE_ENCLAVE) && !defined(VIRTUAL_ENCLAVE)
+#  include <openenclave/bits/result.h>
+
+extern "C"
+{
+  // OCalls (see edl/ccf.edl). Futexes are a host kernel facility, so an SGX
+  // enclave thread can only block on one by exiting the enclave.
+  oe_result_t host_futex_wait(
+    void* word, uint32_t expected, uint64_t timeout_us);
+  oe_result_t host_futex_wake(void* word);
+}
+#else
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <time.h>
+#  include <unistd.h>
+#endif
+
+// Ideally this would be _mm_pause or similar, but finding cross-platform
+// headers that expose this neatly through OE (ie - non-standard std libs) is
+// awkward. Instead we resort to copying OE, and implementing this directly
+// ourselves.
+#define CCF_PAUSE() asm volatile("pause")
+
+namespace threading
+{
+  using FutexWord = std::atomic<uint32_t>;
+  static_assert(sizeof(FutexWord) == sizeof(uint32_t));
+
+  inline void futex_wait(
+    FutexWord* word, uint32_t expected, std::chrono::microseconds timeout)
+  {
+#if defined(INSIDE_ENCLAVE) && !defined(VIRTUAL_ENCLAVE)
+    host_futex_wait(word, expected, timeout.count());
+#else
+    const auto s = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    const auto ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - s);
+    timespec ts = {s.count(), ns.count()};
+    ::syscall(
+      SYS_futex,
+      reinterpret_cast<uint32_t*>(word),
+      FUTEX_WAIT_PRIVATE,
+      expected,
+      &ts,
+      nullptr,
+      0);
+#endif
+  }
+
+  inline void futex_wake(FutexWord* word)
+  {
+#if defined(INSIDE_ENCLAVE) && !defined(VIRTUAL_ENCLAVE)
+    host_futex_wake(word);
+#else
+    ::syscall(
+      SYS_futex,
+      reinterpret_cast<uint32_t*>(word),
+      FUTEX_WAKE_PRIVATE,
+      INT32_MAX,
+      nullptr,
+      nullptr,
+      0);
+#endif
+  }
+
+  /** Lets an idle consumer thread block until a producer signals that there
+   * is new work for it, rather than polling for it.
+   */
+  class Doorbell
+  {
+  public:
+    virtual ~Doorbell() = default;
+
+    /** Called by producers once new work has been published. This is only a
+     * fence and a load when no consumer is waiting.
+     */
+    virtual void ring() = 0;
+
+    /** Blocks until the doorbell is rung or the timeout elapses. has_work is
+     * checked once the caller has registered as a waiter, so that work
+     * published just before the wait is never missed.
+     */
+    virtual void wait(
+      const std::function<bool()>& has_work,
+      std::chrono::microseconds timeout) = 0;
+  };
+
+  /// Doorbell for threads sharing an address space, outside of an SGX
+  /// enclave. Its timed wait relies on the condition variable, which inside
+  /// an enclave would not block on the host: enclave threads block on a
+  /// SharedDoorbell in host memory instead.
+  class LocalDoorbell : public Doorbell
+  {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::atomic<size_t> waiters = 0;
+
+  public:
+    void ring() override
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waiters.load() != 0)
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        cv.notify_all();
+      }
+    }
+
+    void wait(
+      const std::function<bool()>& has_work,
+      std::chrono::microseconds timeout) override
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      waiters.fetch_add(1);
+      if (!has_work())
+      {
+        cv.wait_for(guard, timeout);
+      }
+      waiters.fetch_sub(1);
+    }
+  };
+
+  /// State of a doorbell which lives in memory shared by the host and the
+  /// enclave, such as ringbuffer offsets. Waiters block on a futex.
+  struct SharedDoorbellState
+  {
+    // Futex word, incremented by each ring which may need to wake a waiter
+    FutexWord rings = {0};
+    std::atomic<uint32_t> waiters = {0};
+
+    void ring()
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waiters.load() != 0)
+      {
+        rings.fetch_add(1);
+        futex_wake(&rings);
+      }
+    }
+
+    void wait(
+      const std::function<bool()>& has_work, std::chrono::microseconds timeout)
+    {
+      // If the doorbell is rung after this, the futex wait returns immediately
+      const auto seen = rings.load();
+      waiters.fetch_add(1);
+      if (!has_work())
+      {
+        futex_wait(&rings, seen, timeout);
+      }
+      waiters.fetch_sub(1);
+    }
+  };
+
+  class SharedDoorbell : public Doorbell
+  {
+    SharedDoorbellState& state;
+
+  public:
+    SharedDoorbell(SharedDoorbellState& state_) : state(state_) {}
+
+    void ring() override
+    {
+      state.ring();
+    }
+
+    void wait(
+      const std::function<bool()>& has_work,
+      std::chrono::microseconds timeout) override
+    {
+      state.wait(has_work, timeout);
+    }
+  };
+
+  /** How a thread waits for new work once it is idle: first spinning, then
+   * yielding its core, and finally blocking on a doorbell until a producer
+   * rings it.
+   */
+  struct IdlePolicy
+  {
+    // Consecutive idle iterations spent spinning
+    size_t spin_count = 10000;
+    // Further consecutive idle iterations spent yielding
+    size_t yield_count = 100;
+    // Maximum time blocked before checking for work again
+    std::chrono::milliseconds block_timeout = std::chrono::milliseconds(50);
+  };
+
+  /// Idles a single thread according to its policy and how long it has
+  /// been idle for
+  class Idler
+  {
+    IdlePolicy policy;
+    size_t consecutive_idles = 0;
+
+  public:
+    Idler(const IdlePolicy& policy_ = {}) : policy(policy_) {}
+
+    void idle(Doorbell& doorbell, const std::function<bool()>& has_work)
+    {
+      if (consecutive_idles < policy.spin_count)
+      {
+        CCF_PAUSE();
+      }
+      else if (consecutive_idles < policy.spin_count + policy.yield_count)
+      {
+        std::this_thread::yield();
+      }
+      else
+      {
+        doorbell.wait(has_work, policy.block_timeout);
+      }
+
+      ++consecutive_idles;
+    }
+
+    void reset()
+    {
+      consecutive_idles = 0;
+    }
+  };
+}
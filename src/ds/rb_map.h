@@ -98,6 +98,21 @@ public:
     }
   }
 
+  // Calls f on each entry whose key is not less than from, in key order, until
+  // f returns false. Returns false iff f did.
+  template <class F>
+  bool foreach_from(const K& from, F&& f) const
+  {
+    if (empty())
+      return true;
+
+    if (rootKey() < from)
+      return right().foreach_from(from, f);
+
+    return left().foreach_from(from, f) && f(rootKey(), rootValue()) &&
+      right().foreach_from(from, f);
+  }
+
 private:
   std::shared_ptr<const Node> _root;
 
@@ -7,12 +7,6 @@
 #include <cstring>
 #include <functional>
 
-// Ideally this would be _mm_pause or similar, but finding cross-platform
-// headers that expose this neatly through OE (ie - non-standard std libs) is
-// awkward. Instead we resort to copying OE, and implementing this directly
-// ourselves.
-#define CCF_PAUSE() asm volatile("pause")
-
 // This file implements a Multiple-Producer Single-Consumer ringbuffer.
 
 // A single Reader instance owns an underlying memory buffer, and a single
@@ -158,6 +152,19 @@ namespace ringbuffer
       return count;
     }
 
+    /// Returns true if anything has been written to the buffer since it was
+    /// last read, including messages which are still being written.
+    bool has_pending() const
+    {
+      return bd.offsets->tail.load() !=
+        bd.offsets->head.load(std::memory_order_relaxed);
+    }
+
+    threading::SharedDoorbellState& get_doorbell()
+    {
+      return bd.offsets->doorbell;
+    }
+
   private:
     uint64_t read64(size_t index)
     {
@@ -270,6 +277,9 @@ namespace ringbuffer
         const auto index = marker.value() - Const::header_size();
         auto size = read32(index);
         write32(index, size & length_mask);
+
+        // Wake the reader if it is blocked waiting for messages
+        bd.offsets->doorbell.ring();
       }
     }
 
@@ -2,6 +2,7 @@
 // Licensed under the Apache 2.0 License.
 #pragma once
 
+#include "doorbell.h"
 #include "ds/nonstd.h"
 #include "hash.h"
 #include "serializer.h"
@@ -23,6 +24,8 @@ namespace ringbuffer
     std::atomic<size_t> head_cache = {0};
     std::atomic<size_t> tail = {0};
     alignas(CACHELINE_SIZE) std::atomic<size_t> head = {0};
+    // Rung by writers so that an idle reader can block rather than poll
+    alignas(CACHELINE_SIZE) threading::SharedDoorbellState doorbell = {};
   };
 
   class message_error : public std::logic_error
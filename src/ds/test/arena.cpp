@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+
+#include "../arena.h"
+
+#include <algorithm>
+#include <doctest/doctest.h>
+#include <map>
+#include <string>
+
+TEST_CASE("Arena allocation" * doctest::test_suite("arena"))
+{
+  ds::Arena arena;
+
+  INFO("Allocations are aligned and do not overlap");
+  {
+    auto a = static_cast<uint8_t*>(arena.allocate(1, 1));
+    auto b = static_cast<uint64_t*>(arena.allocate(sizeof(uint64_t), 8));
+    auto c = static_cast<uint8_t*>(arena.allocate(3, 1));
+    REQUIRE(reinterpret_cast<uintptr_t>(b) % 8 == 0);
+    REQUIRE(reinterpret_cast<uint8_t*>(b) >= a + 1);
+    REQUIRE(c >= reinterpret_cast<uint8_t*>(b + 1));
+    REQUIRE(arena.get_block_count() == 0);
+  }
+
+  INFO("Large allocations get a block of their own");
+  {
+    constexpr auto large = 1 << 16;
+    auto p = static_cast<uint8_t*>(arena.allocate(large, 64));
+    REQUIRE(reinterpret_cast<uintptr_t>(p) % 64 == 0);
+    std::fill(p, p + large, 0xff);
+    REQUIRE(arena.get_block_count() == 1);
+  }
+}
+
+TEST_CASE("Arena allocator" * doctest::test_suite("arena"))
+{
+  using Alloc = ds::ArenaAllocator<std::pair<const size_t, std::string>>;
+  using Map = std::map<size_t, std::string, std::less<size_t>, Alloc>;
+
+  constexpr auto n = 1000;
+
+  INFO("Containers can allocate from an arena");
+  {
+    ds::Arena arena;
+    Map m{Alloc(&arena)};
+    for (size_t i = 0; i < n; ++i)
+    {
+      m[i] = std::to_string(i);
+    }
+    for (size_t i = 0; i < n; i += 2)
+    {
+      m.erase(i);
+    }
+
+    REQUIRE(m.size() == n / 2);
+    REQUIRE(m.at(1) == "1");
+    REQUIRE(arena.get_block_count() > 1);
+
+    Map copy(m);
+    REQUIRE(copy == m);
+    REQUIRE(copy.get_allocator() == m.get_allocator());
+  }
+
+  INFO("Containers without an arena use the global allocator");
+  {
+    Map m;
+    for (size_t i = 0; i < n; ++i)
+    {
+      m[i] = std::to_string(i);
+    }
+    REQUIRE(m.size() == n);
+    REQUIRE(m.get_allocator() == Alloc(nullptr));
+  }
+}
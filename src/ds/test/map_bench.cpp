@@ -66,6 +66,43 @@ static void benchmark_put(picobench::state& s)
   s.stop_timer();
 }
 
+// Writes a batch of s.iterations() keys to a map of batch_base_size entries,
+// as a transaction commit does
+static constexpr size_t batch_base_size = 1 << 12;
+
+template <class M>
+static void benchmark_put_batch(picobench::state& s)
+{
+  auto v = gen_val(val_size);
+  auto map = gen_map<M>(batch_base_size);
+  s.start_timer();
+  auto res = map;
+  for (auto _ : s)
+  {
+    res = res.put(batch_base_size + _, v);
+  }
+  do_not_optimize(res);
+  clobber_memory();
+  s.stop_timer();
+}
+
+template <class M>
+static void benchmark_put_batch_transient(picobench::state& s)
+{
+  auto v = gen_val(val_size);
+  auto map = gen_map<M>(batch_base_size);
+  s.start_timer();
+  auto transient = map.transient();
+  for (auto _ : s)
+  {
+    transient.put(batch_base_size + _, v);
+  }
+  auto res = transient.persistent();
+  do_not_optimize(res);
+  clobber_memory();
+  s.stop_timer();
+}
+
 template <class M>
 static void benchmark_get(picobench::state& s)
 {
@@ -125,6 +162,13 @@ PICOBENCH(bench_rb_map_put).iterations(sizes).samples(10).baseline();
 auto bench_champ_map_put = benchmark_put<champ::Map<K, V>>;
 PICOBENCH(bench_champ_map_put).iterations(sizes).samples(10);
 
+PICOBENCH_SUITE("put batch");
+auto bench_champ_map_put_batch = benchmark_put_batch<champ::Map<K, V>>;
+PICOBENCH(bench_champ_map_put_batch).iterations(sizes).samples(10).baseline();
+auto bench_champ_map_put_batch_transient =
+  benchmark_put_batch_transient<champ::Map<K, V>>;
+PICOBENCH(bench_champ_map_put_batch_transient).iterations(sizes).samples(10);
+
 PICOBENCH_SUITE("get");
 auto bench_rb_map_get = benchmark_get<RBMap<K, V>>;
 PICOBENCH(bench_rb_map_get).iterations(sizes).samples(10).baseline();
@@ -2,6 +2,7 @@
 // Licensed under the Apache 2.0 License.
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "../champ_map.h"
+#include "../rb_map.h"
 
 #include <doctest/doctest.h>
 #include <random>
@@ -198,6 +199,71 @@ TEST_CASE("persistent map operations")
   }
 }
 
+TEST_CASE("transient map operations")
+{
+  // The same operations are applied to persistent maps one at a time, and to
+  // a transient map in batches
+  constexpr size_t batch_size = 50;
+
+  champ::Map<K, V, H> champ;
+  champ::Map<K, V, H> frozen;
+  champ::Map<K, V, H> frozen_model;
+  auto transient = frozen.transient();
+
+  auto ops = gen_ops(500);
+  for (size_t i = 0; i < ops.size(); ++i)
+  {
+    auto& op = ops[i];
+    if (auto put = dynamic_cast<Put*>(op.get()))
+    {
+      champ = champ.put(put->k, put->v);
+      transient.put(put->k, put->v);
+    }
+    else if (auto remove = dynamic_cast<Remove*>(op.get()))
+    {
+      champ = champ.remove(remove->k);
+      transient.remove(remove->k);
+    }
+    REQUIRE(transient.size() == champ.size());
+
+    if ((i + 1) % batch_size != 0)
+    {
+      continue;
+    }
+
+    INFO("check previously frozen map is unchanged by later writes");
+    {
+      size_t n = 0;
+      frozen.foreach([&](const auto& k, const auto& v) {
+        n++;
+        auto frozen_value = frozen_model.get(k);
+        REQUIRE(frozen_value.has_value());
+        REQUIRE(frozen_value.value() == v);
+        return true;
+      });
+      REQUIRE(n == frozen.size());
+      REQUIRE(frozen.size() == frozen_model.size());
+    }
+
+    frozen = transient.persistent();
+    frozen_model = champ;
+
+    INFO("check consistency of frozen map");
+    {
+      size_t n = 0;
+      frozen.foreach([&](const auto& k, const auto& v) {
+        n++;
+        auto champ_value = champ.get(k);
+        REQUIRE(champ_value.has_value());
+        REQUIRE(champ_value.value() == v);
+        return true;
+      });
+      REQUIRE(n == champ.size());
+      REQUIRE(frozen.get_serialized_size() == champ.get_serialized_size());
+    }
+  }
+}
+
 static const champ::Map<K, V, H> gen_map(size_t size)
 {
   champ::Map<K, V, H> map;
@@ -287,6 +353,27 @@ TEST_CASE("serialize map")
     REQUIRE_EQ(s_1, s_2);
   }
 
+  INFO("Serialize map in key order");
+  {
+    champ::Snapshot<K, V, H> snapshot(map, true);
+    std::vector<uint8_t> s(map.get_serialized_size());
+    snapshot.serialize(s.data());
+
+    std::vector<K> keys;
+    const uint8_t* data = s.data();
+    size_t size = s.size();
+    while (size != 0)
+    {
+      size_t entry_size = size;
+      keys.push_back(champ::deserialize<K>(data, size));
+      champ::deserialize<V>(data, size);
+      entry_size -= size;
+      serialized::skip(data, size, champ::get_padding(entry_size));
+    }
+    REQUIRE(std::is_sorted(keys.begin(), keys.end()));
+    REQUIRE_EQ(std::set<K>(keys.begin(), keys.end()).size(), map.size());
+  }
+
   INFO("Serialize map with different key sizes");
   {
     using SerialisedKey = champ::serialisers::SerialisedEntry;
@@ -305,3 +392,36 @@ TEST_CASE("serialize map")
     snapshot.serialize(s.data());
   }
 }
+
+TEST_CASE("ordered map range")
+{
+  RBMap<K, V> map;
+  for (K k = 0; k < 100; k += 2)
+  {
+    map = map.put(k, k);
+  }
+
+  std::vector<K> keys;
+  auto completed = map.foreach_from(41, [&keys](const K& k, const V& v) {
+    REQUIRE_EQ(k, v);
+    keys.push_back(k);
+    return k < 50;
+  });
+  REQUIRE_FALSE(completed);
+  REQUIRE_EQ(keys, std::vector<K>{42, 44, 46, 48, 50});
+
+  keys.clear();
+  completed = map.foreach_from(96, [&keys](const K& k, const V&) {
+    keys.push_back(k);
+    return true;
+  });
+  REQUIRE(completed);
+  REQUIRE_EQ(keys, std::vector<K>{96, 98});
+
+  keys.clear();
+  map.foreach_from(100, [&keys](const K& k, const V&) {
+    keys.push_back(k);
+    return true;
+  });
+  REQUIRE(keys.empty());
+}
@@ -514,3 +514,32 @@ TEST_CASE("Multiple threads can wait" * doctest::test_suite("ringbuffer"))
     }
   }
 }
+
+TEST_CASE("Blocked reader is woken by writer" * doctest::test_suite("ringbuffer"))
+{
+  constexpr size_t size = 32u;
+  auto buffer = std::make_unique<ringbuffer::TestBuffer>(size);
+  Reader r(buffer->bd);
+  threading::SharedDoorbell doorbell(r.get_doorbell());
+
+  const auto timeout = std::chrono::seconds(30);
+  const auto start = std::chrono::steady_clock::now();
+
+  std::thread writer([&r]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    Writer w(r);
+    w.write(small_message, (uint8_t)42);
+  });
+
+  while (!r.has_pending())
+  {
+    doorbell.wait([&r]() { return r.has_pending(); }, timeout);
+  }
+  writer.join();
+
+  REQUIRE(std::chrono::steady_clock::now() - start < timeout);
+  REQUIRE(r.read(1, handle_message) == 1);
+  REQUIRE(last_message_body.size() == 1);
+  REQUIRE(last_message_body[0] == 42);
+  REQUIRE(!r.has_pending());
+}
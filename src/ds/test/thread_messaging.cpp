@@ -59,4 +59,58 @@ TEST_CASE("Unpopped messages are freed")
   CHECK(Foo::count == 0);
 
   CHECK(happened);
-}
\ No newline at end of file
+}
+
+static std::atomic<bool> woken = false;
+
+static void wake(std::unique_ptr<threading::Tmsg<Foo>>)
+{
+  woken = true;
+}
+
+// Blocks a worker immediately, with a timeout far longer than it should take
+// to be woken by a new task, and then once finished
+static void check_idle_worker_is_woken(threading::ThreadMessaging& tm)
+{
+  threading::IdlePolicy policy;
+  policy.spin_count = 0;
+  policy.yield_count = 0;
+  policy.block_timeout = std::chrono::seconds(30);
+
+  woken = false;
+  const auto start = std::chrono::steady_clock::now();
+  std::thread worker([&tm, &policy]() { tm.run(policy); });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  tm.add_task<Foo>(0, std::make_unique<threading::Tmsg<Foo>>(&wake));
+  while (!woken)
+  {
+    std::this_thread::yield();
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  tm.set_finished();
+  worker.join();
+
+  CHECK(std::chrono::steady_clock::now() - start < policy.block_timeout);
+}
+
+TEST_CASE("Idle worker is woken by new tasks")
+{
+  threading::ThreadMessaging tm(1);
+  check_idle_worker_is_woken(tm);
+}
+
+TEST_CASE("Idle worker is woken through a doorbell in shared memory")
+{
+  // As enclave worker threads are, so that they block on the host
+  threading::ThreadMessaging tm(1);
+  threading::SharedDoorbellState state;
+  threading::SharedDoorbell doorbell(state);
+  tm.get_task(0).set_doorbell(&doorbell);
+
+  check_idle_worker_is_woken(tm);
+  CHECK(state.waiters.load() == 0);
+
+  tm.get_task(0).set_doorbell(nullptr);
+}
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "ds/ccf_assert.h"
+#include "ds/doorbell.h"
 #include "ds/logger.h"
 #include "ds/thread_ids.h"
 
@@ -48,9 +49,30 @@ namespace threading
     std::atomic<ThreadMsg*> item_head = nullptr;
     ThreadMsg* local_msg = nullptr;
 
+    LocalDoorbell local_doorbell;
+    std::atomic<Doorbell*> doorbell = &local_doorbell;
+
   public:
     Task() = default;
 
+    bool has_pending() const
+    {
+      return local_msg != nullptr || item_head.load() != nullptr;
+    }
+
+    Doorbell& get_doorbell()
+    {
+      return *doorbell.load();
+    }
+
+    /// Rings the given doorbell when tasks are added, rather than the task's
+    /// own. This lets a thread which also waits on other sources of work be
+    /// woken by either. If nullptr, the task's own doorbell is restored.
+    void set_doorbell(Doorbell* doorbell_)
+    {
+      doorbell = doorbell_ != nullptr ? doorbell_ : &local_doorbell;
+    }
+
     bool run_next_task()
     {
       if (local_msg == nullptr && item_head != nullptr)
@@ -79,6 +101,8 @@ namespace threading
         tmp_head = item_head.load();
         item->next = tmp_head;
       } while (!item_head.compare_exchange_strong(tmp_head, item));
+
+      doorbell.load()->ring();
     }
 
     struct TimerEntry
@@ -239,15 +263,30 @@ namespace threading
     void set_finished(bool v = true)
     {
       finished.store(v);
+
+      for (auto& t : tasks)
+      {
+        t.get_doorbell().ring();
+      }
     }
 
-    void run()
+    void run(const IdlePolicy& idle_policy = {})
     {
       Task& task = get_task(get_current_thread_id());
+      Idler idler(idle_policy);
 
       while (!is_finished())
       {
-        task.run_next_task();
+        if (task.run_next_task())
+        {
+          idler.reset();
+        }
+        else
+        {
+          idler.idle(task.get_doorbell(), [this, &task]() {
+            return is_finished() || task.has_pending();
+          });
+        }
       }
     }
 
@@ -12,6 +12,7 @@
 #include "node/network_state.h"
 #include "node/node_state.h"
 #include "node/node_types.h"
+#include "node/receipt_cache.h"
 #include "node/rpc/forwarder.h"
 #include "node/rpc/member_frontend.h"
 #include "node/rpc/node_frontend.h"
@@ -38,6 +39,13 @@ namespace enclave
     std::chrono::microseconds last_tick_time;
     ENGINE* rdrand_engine = nullptr;
 
+    // Rung by the host when it writes to the inbound ringbuffer, and by other
+    // enclave threads when they send a message to the main thread
+    threading::SharedDoorbell inbound_doorbell;
+    threading::IdlePolicy idle_policy;
+    threading::SharedDoorbellState* worker_doorbells;
+    size_t worker_doorbells_count;
+
     StartType start_type;
 
     struct NodeContext : public ccfapp::AbstractNodeContext
@@ -45,6 +53,7 @@ namespace enclave
       std::unique_ptr<ccf::historical::StateCache> historical_state_cache =
         nullptr;
       ccf::AbstractNodeState* node_state = nullptr;
+      std::unique_ptr<ccf::ReceiptCache> receipt_cache = nullptr;
 
       NodeContext() {}
 
@@ -57,6 +66,11 @@ namespace enclave
       {
         return *node_state;
       }
+
+      ccf::ReceiptCache* get_receipt_cache() override
+      {
+        return receipt_cache.get();
+      }
     };
 
     std::unique_ptr<NodeContext> context = nullptr;
@@ -76,6 +90,10 @@ namespace enclave
                               ec.from_enclave_buffer_offsets}),
       basic_writer_factory(circuit),
       writer_factory(basic_writer_factory, ec.writer_config),
+      inbound_doorbell(circuit.read_from_outside().get_doorbell()),
+      idle_policy(ec.idle_policy),
+      worker_doorbells(ec.worker_doorbells),
+      worker_doorbells_count(ec.worker_doorbells_count),
       network(consensus_config.consensus_type),
       share_manager(network),
       rpc_map(std::make_shared<RPCMap>()),
@@ -113,6 +131,8 @@ namespace enclave
           network.ledger_secrets,
           writer_factory.create_writer_to_outside());
       context->node_state = node.get();
+      context->receipt_cache =
+        std::make_unique<ccf::ReceiptCache>(*network.tables);
 
       rpc_map->register_frontend<ccf::ActorsType::members>(
         std::make_unique<ccf::MemberRpcFrontend>(
@@ -273,22 +293,7 @@ namespace enclave
             {
               case consensus::LedgerRequestPurpose::Recovery:
               {
-                if (
-                  node->is_reading_public_ledger() ||
-                  node->is_verifying_snapshot())
-                {
-                  node->recover_public_ledger_entry(body);
-                }
-                else if (node->is_reading_private_ledger())
-                {
-                  node->recover_private_ledger_entry(body);
-                }
-                else
-                {
-                  auto [s, _, __] = node->state();
-                  LOG_FAIL_FMT(
-                    "Cannot recover ledger entry: Unexpected node state {}", s);
-                }
+                node->recover_ledger_entries(index, index, body);
                 break;
               }
               case consensus::LedgerRequestPurpose::HistoricalQuery:
@@ -314,14 +319,7 @@ namespace enclave
             {
               case consensus::LedgerRequestPurpose::Recovery:
               {
-                if (node->is_verifying_snapshot())
-                {
-                  node->verify_snapshot_end();
-                }
-                else
-                {
-                  node->recover_ledger_end();
-                }
+                node->recover_ledger_missing(index, index);
                 break;
               }
               case consensus::LedgerRequestPurpose::HistoricalQuery:
@@ -336,12 +334,97 @@ namespace enclave
             }
           });
 
+        DISPATCHER_SET_MESSAGE_HANDLER(
+          bp,
+          consensus::ledger_entry_range,
+          [this](const uint8_t* data, size_t size) {
+            const auto [from, to, purpose, body] =
+              ringbuffer::read_message<consensus::ledger_entry_range>(
+                data, size);
+            switch (purpose)
+            {
+              case consensus::LedgerRequestPurpose::Recovery:
+              {
+                node->recover_ledger_entries(from, to, body);
+                break;
+              }
+              case consensus::LedgerRequestPurpose::HistoricalQuery:
+              {
+                context->historical_state_cache->handle_ledger_entries(
+                  from, to, body);
+                break;
+              }
+              default:
+              {
+                LOG_FAIL_FMT("Unhandled purpose: {}", purpose);
+              }
+            }
+          });
+
+        DISPATCHER_SET_MESSAGE_HANDLER(
+          bp,
+          consensus::ledger_no_entry_range,
+          [this](const uint8_t* data, size_t size) {
+            const auto [from, to, purpose] =
+              ringbuffer::read_message<consensus::ledger_no_entry_range>(
+                data, size);
+            switch (purpose)
+            {
+              case consensus::LedgerRequestPurpose::Recovery:
+              {
+                node->recover_ledger_missing(from, to);
+                break;
+              }
+              case consensus::LedgerRequestPurpose::HistoricalQuery:
+              {
+                context->historical_state_cache->handle_no_entry_range(
+                  from, to);
+                break;
+              }
+              default:
+              {
+                LOG_FAIL_FMT("Unhandled purpose: {}", purpose);
+              }
+            }
+          });
+
+        DISPATCHER_SET_MESSAGE_HANDLER(
+          bp,
+          consensus::ledger_flushed,
+          [this](const uint8_t* data, size_t size) {
+            const auto [idx, generation] =
+              ringbuffer::read_message<consensus::ledger_flushed>(data, size);
+            LOG_TRACE_FMT("Host ledger durable up to {}", idx);
+            node->ledger_flushed(idx, generation);
+          });
+
+        DISPATCHER_SET_MESSAGE_HANDLER(
+          bp,
+          consensus::startup_snapshot_chunk,
+          [this](const uint8_t* data, size_t size) {
+            const auto [offset, chunk] =
+              ringbuffer::read_message<consensus::startup_snapshot_chunk>(
+                data, size);
+            node->recover_startup_snapshot_chunk(offset, chunk);
+          });
+
+        DISPATCHER_SET_MESSAGE_HANDLER(
+          bp,
+          consensus::startup_snapshot_no_chunk,
+          [this](const uint8_t* data, size_t size) {
+            const auto [offset] =
+              ringbuffer::read_message<consensus::startup_snapshot_no_chunk>(
+                data, size);
+            node->recover_startup_snapshot_missing(offset);
+          });
+
         rpcsessions->register_message_handlers(bp.get_dispatcher());
 
         if (start_type == StartType::Join)
         {
-          // When joining from a snapshot, deserialise ledger suffix to verify
-          // snapshot evidence. Otherwise, attempt to join straight away
+          // When joining from a snapshot, read it from the host and
+          // deserialise ledger suffix to verify snapshot evidence. Otherwise,
+          // attempt to join straight away
           if (node->is_verifying_snapshot())
           {
             node->start_ledger_recovery();
@@ -360,7 +443,11 @@ namespace enclave
         // processed in a single iteration
         static constexpr size_t max_messages = 256;
 
-        size_t consecutive_idles = 0u;
+        auto& main_task = threading::ThreadMessaging::thread_messaging.get_task(
+          threading::MAIN_THREAD_ID);
+        main_task.set_doorbell(&inbound_doorbell);
+
+        threading::Idler idler(idle_policy);
         while (!bp.get_finished())
         {
           // First, read some messages from the ringbuffer
@@ -375,37 +462,23 @@ namespace enclave
           }
 
           // If no messages were read from the ringbuffer and no thread
-          // messages were executed, idle
+          // messages were executed, idle: spin, then yield, then block until
+          // either the host or another enclave thread has work for us
           if (read == 0 && thread_msg == 0)
           {
-            const auto time_now = enclave::get_enclave_time();
-            static std::chrono::microseconds idling_start_time;
-
-            if (consecutive_idles == 0)
-            {
-              idling_start_time = time_now;
-            }
-
-            // Handle initial idles by pausing, eventually sleep (in host)
-            constexpr std::chrono::milliseconds timeout(5);
-            if ((time_now - idling_start_time) > timeout)
-            {
-              std::this_thread::sleep_for(timeout * 10);
-            }
-            else
-            {
-              CCF_PAUSE();
-            }
-
-            consecutive_idles++;
+            idler.idle(inbound_doorbell, [this, &main_task]() {
+              return circuit.read_from_outside().has_pending() ||
+                main_task.has_pending();
+            });
           }
           else
           {
-            // If some messages were read, reset consecutive idles count
-            consecutive_idles = 0;
+            idler.reset();
           }
         }
 
+        main_task.set_doorbell(nullptr);
+
         LOG_INFO_FMT("Enclave stopped successfully. Stopping host...");
         RINGBUFFER_WRITE_MESSAGE(AdminMessage::stopped, to_host);
 
@@ -441,12 +514,26 @@ namespace enclave
       try
 #endif
       {
+        const auto tid = threading::get_current_thread_id();
+        auto& task =
+          threading::ThreadMessaging::thread_messaging.get_task(tid);
+
+        // Block on a doorbell in host memory when idle, as the main thread
+        // does, since an enclave thread can only block by exiting the enclave
+        std::optional<threading::SharedDoorbell> doorbell = std::nullopt;
+        if (tid > 0 && tid <= worker_doorbells_count)
+        {
+          doorbell.emplace(worker_doorbells[tid - 1]);
+          task.set_doorbell(&doorbell.value());
+        }
+
         auto msg = std::make_unique<threading::Tmsg<Msg>>(&init_thread_cb);
-        msg->data.tid = threading::get_current_thread_id();
+        msg->data.tid = tid;
         threading::ThreadMessaging::thread_messaging.add_task(
           msg->data.tid, std::move(msg));
 
-        threading::ThreadMessaging::thread_messaging.run();
+        threading::ThreadMessaging::thread_messaging.run(idle_policy);
+        task.set_doorbell(nullptr);
       }
 #ifndef VIRTUAL_ENCLAVE
       catch (const std::exception& e)
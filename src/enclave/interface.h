@@ -32,6 +32,13 @@ struct EnclaveConfig
 
   oversized::WriterConfig writer_config = {};
 
+  threading::IdlePolicy idle_policy = {};
+
+  // One doorbell per worker thread, in host memory, which it blocks on when
+  // idle
+  threading::SharedDoorbellState* worker_doorbells = nullptr;
+  size_t worker_doorbells_count = 0;
+
 #ifdef DEBUG_CONFIG
   struct DebugConfig
   {
@@ -46,11 +53,14 @@ struct CCFConfig
   consensus::Configuration consensus_config = {};
   ccf::NodeInfoNetwork node_info_network = {};
   size_t snapshot_tx_interval;
+  size_t snapshot_chunk_bytes;
+  bool snapshot_parallel_serialisation;
   size_t max_open_sessions_soft;
   size_t max_open_sessions_hard;
 
-  // Only if joining or recovering
-  std::vector<uint8_t> startup_snapshot;
+  // Only if joining or recovering. The snapshot itself is read from the host
+  // chunk by chunk once the node is created (see startup_snapshot_get).
+  size_t startup_snapshot_size = 0;
   size_t startup_snapshot_evidence_seqno;
 
   struct SignatureIntervals
@@ -59,6 +69,17 @@ struct CCFConfig
     size_t sig_ms_interval;
   };
   SignatureIntervals signature_intervals = {};
+  bool async_signatures = false;
+  size_t tree_keyframe_interval = 0;
+
+  struct LedgerRecovery
+  {
+    // Number of ledger entries requested from the host at once
+    size_t fetch_batch_size;
+    // Maximum number of ledger entries requested but not yet applied
+    size_t fetch_window;
+  };
+  LedgerRecovery ledger_recovery = {};
 
   struct Genesis
   {
@@ -89,6 +110,10 @@ DECLARE_JSON_TYPE(CCFConfig::SignatureIntervals);
 DECLARE_JSON_REQUIRED_FIELDS(
   CCFConfig::SignatureIntervals, sig_tx_interval, sig_ms_interval);
 
+DECLARE_JSON_TYPE(CCFConfig::LedgerRecovery);
+DECLARE_JSON_REQUIRED_FIELDS(
+  CCFConfig::LedgerRecovery, fetch_batch_size, fetch_window);
+
 DECLARE_JSON_TYPE(CCFConfig::Genesis);
 DECLARE_JSON_REQUIRED_FIELDS(
   CCFConfig::Genesis, members_info, constitution, recovery_threshold);
@@ -103,11 +128,16 @@ DECLARE_JSON_REQUIRED_FIELDS(
   consensus_config,
   node_info_network,
   snapshot_tx_interval,
+  snapshot_chunk_bytes,
+  snapshot_parallel_serialisation,
   max_open_sessions_soft,
   max_open_sessions_hard,
-  startup_snapshot,
+  startup_snapshot_size,
   startup_snapshot_evidence_seqno,
   signature_intervals,
+  async_signatures,
+  tree_keyframe_interval,
+  ledger_recovery,
   genesis,
   joining,
   subject_name,
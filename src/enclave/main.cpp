@@ -125,6 +125,15 @@ extern "C"
         return CreateNodeStatus::MemoryNotOutsideEnclave;
       }
 
+      if (
+        ec.worker_doorbells_count != 0 &&
+        !oe_is_outside_enclave(
+          ec.worker_doorbells,
+          ec.worker_doorbells_count * sizeof(threading::SharedDoorbellState)))
+      {
+        return CreateNodeStatus::MemoryNotOutsideEnclave;
+      }
+
       oe_lfence();
     }
 
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "ccf/historical_queries_interface.h"
+#include "node/receipt_cache.h"
 #include "node/rpc/node_interface.h"
 
 namespace ccfapp
@@ -13,5 +14,12 @@ namespace ccfapp
 
     virtual ccf::historical::AbstractStateCache& get_historical_state() = 0;
     virtual ccf::AbstractNodeState& get_node_state() = 0;
+
+    /** Receipts for recently committed transactions, if this node keeps them
+     */
+    virtual ccf::ReceiptCache* get_receipt_cache()
+    {
+      return nullptr;
+    }
   };
 }
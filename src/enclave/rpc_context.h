@@ -200,6 +200,13 @@ namespace enclave
     virtual void set_apply_writes(bool apply) = 0;
     virtual bool should_apply_writes() const = 0;
 
+    /// Batch requests, carrying several operations executed in order by the
+    /// same endpoint within a single transaction
+    virtual bool is_batch_request() = 0;
+    virtual std::vector<std::shared_ptr<RpcContext>> get_batch_operations() = 0;
+    virtual void set_batch_response(
+      const std::vector<std::shared_ptr<RpcContext>>& operations) = 0;
+
     virtual void reset_response() = 0;
 
     virtual std::vector<uint8_t> serialise_response() const = 0;
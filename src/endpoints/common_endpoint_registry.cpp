@@ -53,6 +53,62 @@ namespace ccf
 
       return tx_id_opt;
     }
+
+    // Adds the receipt for seqno to the last group in out, or to a new group
+    // if it is covered by a different signature. hash_indices maps the hashes
+    // already listed in the last group to their index.
+    void add_to_receipts(
+      ccf::Receipts& out,
+      std::map<std::string, size_t>& hash_indices,
+      ccf::SeqNo seqno,
+      const ccf::historical::TxReceipt& receipt)
+    {
+      auto signature = tls::b64_from_raw(receipt.signature);
+      auto root = receipt.root.to_string();
+      if (
+        out.signatures.empty() ||
+        out.signatures.back().signature != signature ||
+        out.signatures.back().root != root)
+      {
+        auto& group = out.signatures.emplace_back();
+        group.signature = std::move(signature);
+        group.root = std::move(root);
+        group.node_id = receipt.node_id;
+        hash_indices.clear();
+      }
+
+      auto& group = out.signatures.back();
+      auto& entry = group.receipts.emplace_back();
+      entry.seqno = seqno;
+      if (receipt.path == nullptr)
+      {
+        entry.leaf = group.root;
+        return;
+      }
+
+      entry.leaf = receipt.path->leaf().to_string();
+      for (const auto& node : *receipt.path)
+      {
+        auto hash = node.hash.to_string();
+        auto it = hash_indices.find(hash);
+        if (it == hash_indices.end())
+        {
+          it = hash_indices.emplace(hash, group.hashes.size()).first;
+          group.hashes.emplace_back(std::move(hash));
+        }
+
+        ccf::Receipts::Element e;
+        if (node.direction == ccf::HistoryTree::Path::Direction::PATH_LEFT)
+        {
+          e.left = it->second;
+        }
+        else
+        {
+          e.right = it->second;
+        }
+        entry.proof.push_back(e);
+      }
+    }
   }
 
   CommonEndpointRegistry::CommonEndpointRegistry(
@@ -263,19 +319,186 @@ namespace ccf
         ccf::jsonhandler::set_response(out, ctx.rpc_ctx, pack);
       };
 
-    make_endpoint(
-      "/receipt",
-      HTTP_GET,
-      ccf::historical::adapter(
-        get_receipt,
-        context.get_historical_state(),
-        is_tx_committed,
-        txid_from_query_string),
-      no_auth_required)
+    auto get_historical_receipt = ccf::historical::adapter(
+      get_receipt,
+      context.get_historical_state(),
+      is_tx_committed,
+      txid_from_query_string);
+
+    // Recently committed receipts are served from the node's receipt cache,
+    // falling back to a historical query for anything it does not hold
+    auto get_cached_receipt =
+      [this, is_tx_committed, get_historical_receipt](auto& ctx) {
+        auto receipt_cache = context.get_receipt_cache();
+        if (receipt_cache != nullptr)
+        {
+          const auto tx_id = txid_from_query_string(ctx);
+          if (!tx_id.has_value())
+          {
+            return;
+          }
+
+          std::string error_reason;
+          if (is_tx_committed(tx_id->view, tx_id->seqno, error_reason))
+          {
+            const auto receipt = receipt_cache->get(tx_id->seqno);
+            if (receipt != nullptr)
+            {
+              const auto [pack, params] =
+                ccf::jsonhandler::get_json_params(ctx.rpc_ctx);
+
+              ccf::Receipt out;
+              receipt->describe(out);
+              ctx.rpc_ctx->set_response_status(HTTP_STATUS_OK);
+              ccf::jsonhandler::set_response(out, ctx.rpc_ctx, pack);
+              return;
+            }
+          }
+        }
+
+        get_historical_receipt(ctx);
+      };
+
+    make_endpoint("/receipt", HTTP_GET, get_cached_receipt, no_auth_required)
       .set_execute_outside_consensus(
         ccf::endpoints::ExecuteOutsideConsensus::Locally)
       .set_auto_schema<void, ccf::Receipt>()
       .add_query_parameter<ccf::TxID>(tx_id_param_key)
       .install();
+
+    static constexpr size_t max_receipts_per_request = 1000;
+    auto get_receipts = [this, is_tx_committed](auto& ctx) {
+      auto receipt_cache = context.get_receipt_cache();
+      if (receipt_cache == nullptr || consensus == nullptr)
+      {
+        ctx.rpc_ctx->set_error(
+          HTTP_STATUS_INTERNAL_SERVER_ERROR,
+          ccf::errors::InternalError,
+          "Node is not fully configured");
+        return;
+      }
+
+      const auto parsed_query =
+        http::parse_query(ctx.rpc_ctx->get_request_query());
+
+      std::string error_reason;
+      ccf::SeqNo from_seqno;
+      ccf::SeqNo to_seqno;
+      if (
+        !http::get_query_value(
+          parsed_query, "from_seqno", from_seqno, error_reason) ||
+        !http::get_query_value(
+          parsed_query, "to_seqno", to_seqno, error_reason))
+      {
+        ctx.rpc_ctx->set_error(
+          HTTP_STATUS_BAD_REQUEST,
+          ccf::errors::InvalidQueryParameterValue,
+          std::move(error_reason));
+        return;
+      }
+
+      if (from_seqno < 1 || to_seqno < from_seqno)
+      {
+        ctx.rpc_ctx->set_error(
+          HTTP_STATUS_BAD_REQUEST,
+          ccf::errors::InvalidInput,
+          fmt::format(
+            "Invalid range: Starts at {} but ends at {}",
+            from_seqno,
+            to_seqno));
+        return;
+      }
+
+      if (
+        static_cast<size_t>(to_seqno - from_seqno) >= max_receipts_per_request)
+      {
+        ctx.rpc_ctx->set_error(
+          HTTP_STATUS_BAD_REQUEST,
+          ccf::errors::InvalidInput,
+          fmt::format(
+            "Invalid range: At most {} receipts may be requested at once",
+            max_receipts_per_request));
+        return;
+      }
+
+      if (!is_tx_committed(
+            consensus->get_view(to_seqno), to_seqno, error_reason))
+      {
+        ctx.rpc_ctx->set_error(
+          HTTP_STATUS_BAD_REQUEST,
+          ccf::errors::InvalidInput,
+          std::move(error_reason));
+        return;
+      }
+
+      auto receipts = receipt_cache->get_range(from_seqno, to_seqno);
+
+      // Receipts the cache does not hold are fetched by a historical query
+      // over the range they span, and the request should be retried until it
+      // completes
+      const auto is_missing = [](const auto& receipt) {
+        return receipt == nullptr;
+      };
+      const auto first_missing =
+        std::find_if(receipts.begin(), receipts.end(), is_missing);
+      if (first_missing != receipts.end())
+      {
+        const auto last_missing =
+          std::find_if(receipts.rbegin(), receipts.rend(), is_missing);
+        const ccf::SeqNo missing_from =
+          from_seqno + std::distance(receipts.begin(), first_missing);
+        const ccf::SeqNo missing_to =
+          to_seqno - std::distance(receipts.rbegin(), last_missing);
+
+        // Historical queries for a single receipt use their seqno as handle,
+        // so those for ranges are tagged to keep them apart
+        static constexpr ccf::historical::RequestHandle range_handle_tag =
+          size_t(1) << 63;
+        const auto states = context.get_historical_state().get_state_range(
+          range_handle_tag | missing_from, missing_from, missing_to);
+        if (states.empty())
+        {
+          ctx.rpc_ctx->set_response_status(HTTP_STATUS_ACCEPTED);
+          static constexpr size_t retry_after_seconds = 3;
+          ctx.rpc_ctx->set_response_header(
+            http::headers::RETRY_AFTER, retry_after_seconds);
+          ctx.rpc_ctx->set_response_header(
+            http::headers::CONTENT_TYPE, http::headervalues::contenttype::TEXT);
+          ctx.rpc_ctx->set_response_body(fmt::format(
+            "Historical transactions from {} to {} are not currently "
+            "available.",
+            missing_from,
+            missing_to));
+          return;
+        }
+
+        for (auto it = first_missing; it != last_missing.base(); ++it)
+        {
+          if (*it == nullptr)
+          {
+            *it = states[std::distance(first_missing, it)]->receipt;
+          }
+        }
+      }
+
+      ccf::Receipts out;
+      std::map<std::string, size_t> hash_indices;
+      for (size_t i = 0; i < receipts.size(); ++i)
+      {
+        add_to_receipts(out, hash_indices, from_seqno + i, *receipts[i]);
+      }
+
+      const auto [pack, params] =
+        ccf::jsonhandler::get_json_params(ctx.rpc_ctx);
+      ctx.rpc_ctx->set_response_status(HTTP_STATUS_OK);
+      ccf::jsonhandler::set_response(out, ctx.rpc_ctx, pack);
+    };
+    make_endpoint("/receipts", HTTP_GET, get_receipts, no_auth_required)
+      .set_execute_outside_consensus(
+        ccf::endpoints::ExecuteOutsideConsensus::Locally)
+      .set_auto_schema<void, ccf::Receipts>()
+      .add_query_parameter<ccf::SeqNo>("from_seqno")
+      .add_query_parameter<ccf::SeqNo>("to_seqno")
+      .install();
   }
 }
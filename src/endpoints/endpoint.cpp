@@ -75,4 +75,10 @@ namespace ccf::endpoints
     properties.execute_outside_consensus = v;
     return *this;
   }
+
+  Endpoint& Endpoint::set_batchable(bool batchable)
+  {
+    properties.batchable = batchable;
+    return *this;
+  }
 }
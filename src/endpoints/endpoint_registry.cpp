@@ -107,16 +107,19 @@ namespace ccf::endpoints
     const ReadOnlyEndpointFunction& f,
     const AuthnPolicies& ap)
   {
-    return make_endpoint(
-             method,
-             verb,
-             [f](EndpointContext& ctx) {
-               ReadOnlyEndpointContext ro_ctx(
-                 ctx.rpc_ctx, std::move(ctx.caller), ctx.tx);
-               f(ro_ctx);
-             },
-             ap)
-      .set_forwarding_required(ForwardingRequired::Sometimes);
+    auto endpoint = make_endpoint(
+      method,
+      verb,
+      [f](EndpointContext& ctx) {
+        ReadOnlyEndpointContext ro_ctx(
+          ctx.rpc_ctx, std::move(ctx.caller), ctx.tx);
+        f(ro_ctx);
+      },
+      ap);
+    endpoint.set_forwarding_required(ForwardingRequired::Sometimes);
+    // Executed over a snapshot of the KV, without committing
+    endpoint.properties.mode = Mode::ReadOnly;
+    return endpoint;
   }
 
   Endpoint EndpointRegistry::make_command_endpoint(
@@ -149,8 +152,28 @@ namespace ccf::endpoints
       auto templated_endpoint =
         std::make_shared<PathTemplatedEndpoint>(endpoint);
       templated_endpoint->spec = std::move(template_spec.value());
-      templated_endpoints[endpoint.dispatch.uri_path][endpoint.dispatch.verb] =
-        templated_endpoint;
+      auto& existing =
+        templated_endpoints[endpoint.dispatch.uri_path][endpoint.dispatch.verb];
+      const auto replacing = existing != nullptr;
+      existing = templated_endpoint;
+
+      if (replacing)
+      {
+        // Rare, so simply rebuild the router rather than removing the
+        // previous endpoint from it
+        templated_router.clear();
+        for (const auto& [path, verb_endpoints] : templated_endpoints)
+        {
+          for (const auto& [verb, e] : verb_endpoints)
+          {
+            templated_router.insert(e->spec, e);
+          }
+        }
+      }
+      else
+      {
+        templated_router.insert(templated_endpoint->spec, templated_endpoint);
+      }
     }
     else
     {
@@ -228,47 +251,26 @@ namespace ccf::endpoints
     // templated matches. Exactly one is a returnable match, more is an error,
     // fewer is fallthrough.
     {
-      std::vector<EndpointDefinitionPtr> matches;
+      const auto verb = rpc_ctx.get_request_verb();
+      const auto matches = templated_router.match(
+        method, [&verb](const auto& endpoint) {
+          return endpoint->dispatch.verb == verb;
+        });
 
-      std::smatch match;
-      for (auto& [original_method, verb_endpoints] : templated_endpoints)
+      if (matches.size() > 1)
       {
-        auto templated_endpoints_for_verb =
-          verb_endpoints.find(rpc_ctx.get_request_verb());
-        if (templated_endpoints_for_verb != verb_endpoints.end())
+        std::vector<EndpointDefinitionPtr> endpoints;
+        for (const auto& match : matches)
         {
-          auto& endpoint = templated_endpoints_for_verb->second;
-          if (std::regex_match(method, match, endpoint->spec.template_regex))
-          {
-            // Populate the request_path_params the first-time through. If we
-            // get a second match, we're just building up a list for
-            // error-reporting
-            if (matches.size() == 0)
-            {
-              auto& path_params = rpc_ctx.get_request_path_params();
-              for (size_t i = 0;
-                   i < endpoint->spec.template_component_names.size();
-                   ++i)
-              {
-                const auto& template_name =
-                  endpoint->spec.template_component_names[i];
-                const auto& template_value = match[i + 1].str();
-                path_params[template_name] = template_value;
-              }
-            }
-
-            matches.push_back(endpoint);
-          }
+          endpoints.push_back(*match.value);
         }
-      }
-
-      if (matches.size() > 1)
-      {
-        report_ambiguous_templated_path(method, matches);
+        report_ambiguous_templated_path(method, endpoints);
       }
       else if (matches.size() == 1)
       {
-        return matches[0];
+        const auto& match = matches[0];
+        match.populate(rpc_ctx.get_request_path_params());
+        return *match.value;
       }
     }
 
@@ -310,16 +312,9 @@ namespace ccf::endpoints
       }
     }
 
-    std::smatch match;
-    for (const auto& [original_method, verb_endpoints] : templated_endpoints)
+    for (const auto& match : templated_router.match(method))
     {
-      for (const auto& [verb, endpoint] : verb_endpoints)
-      {
-        if (std::regex_match(method, match, endpoint->spec.template_regex))
-        {
-          verbs.insert(verb);
-        }
-      }
+      verbs.insert((*match.value)->dispatch.verb);
     }
 
     return verbs;
@@ -0,0 +1,324 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#pragma once
+
+#include "ds/logger.h"
+#include "ds/nonstd.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ccf::endpoints
+{
+  /** A single '/'-separated segment of a templated path, such as "{id}" or
+   * "{name}.json". Each named template component matches a non-empty run of
+   * characters within the segment.
+   */
+  struct PathTemplateSegment
+  {
+    struct Part
+    {
+      bool is_component = false;
+      std::string literal = {};
+
+      bool operator==(const Part& other) const
+      {
+        return is_component == other.is_component && literal == other.literal;
+      }
+    };
+
+    std::vector<Part> parts;
+
+    bool operator==(const PathTemplateSegment& other) const
+    {
+      return parts == other.parts;
+    }
+
+    std::optional<std::string_view> get_literal() const
+    {
+      if (parts.size() == 1 && !parts[0].is_component)
+      {
+        return parts[0].literal;
+      }
+
+      return std::nullopt;
+    }
+
+    bool match(
+      const std::string_view& s,
+      std::vector<std::string_view>& component_values) const
+    {
+      return match_from(0, s, component_values);
+    }
+
+  private:
+    bool match_from(
+      size_t part_idx,
+      const std::string_view& s,
+      std::vector<std::string_view>& component_values) const
+    {
+      if (part_idx == parts.size())
+      {
+        return s.empty();
+      }
+
+      const auto& part = parts[part_idx];
+      if (!part.is_component)
+      {
+        if (s.compare(0, part.literal.size(), part.literal) != 0)
+        {
+          return false;
+        }
+
+        return match_from(
+          part_idx + 1, s.substr(part.literal.size()), component_values);
+      }
+
+      // Components are greedy, so that "{a}{b}" matches "xyz" with a = "xy"
+      for (auto n = s.size(); n > 0; --n)
+      {
+        component_values.push_back(s.substr(0, n));
+        if (match_from(part_idx + 1, s.substr(n), component_values))
+        {
+          return true;
+        }
+        component_values.pop_back();
+      }
+
+      return false;
+    }
+  };
+
+  struct PathTemplateSpec
+  {
+    std::vector<PathTemplateSegment> segments;
+    std::vector<std::string> template_component_names;
+  };
+
+  inline std::optional<PathTemplateSpec> parse_path_template(
+    const std::string& uri)
+  {
+    if (uri.find_first_of('{') == std::string::npos)
+    {
+      return std::nullopt;
+    }
+
+    PathTemplateSpec spec;
+
+    for (const auto& s : nonstd::split(uri, "/"))
+    {
+      PathTemplateSegment segment;
+
+      size_t pos = 0;
+      while (pos < s.size())
+      {
+        const auto template_start = s.find_first_of('{', pos);
+        if (template_start != pos)
+        {
+          segment.parts.push_back(
+            {false, std::string(s.substr(pos, template_start - pos))});
+          if (template_start == std::string::npos)
+          {
+            break;
+          }
+        }
+
+        const auto template_end = s.find_first_of('}', template_start);
+        if (template_end == std::string::npos)
+        {
+          throw std::logic_error(fmt::format(
+            "Invalid templated path - missing closing '}}': {}", uri));
+        }
+
+        segment.parts.push_back({true});
+        spec.template_component_names.emplace_back(
+          s.substr(template_start + 1, template_end - template_start - 1));
+        pos = template_end + 1;
+      }
+
+      if (segment.parts.empty())
+      {
+        segment.parts.push_back({false});
+      }
+
+      spec.segments.push_back(std::move(segment));
+    }
+
+    LOG_TRACE_FMT(
+      "Parsed a templated endpoint: {} has {} segments",
+      uri,
+      spec.segments.size());
+    LOG_TRACE_FMT(
+      "Component names are: {}",
+      fmt::join(spec.template_component_names, ", "));
+
+    return spec;
+  }
+
+  /** Routes request paths to values installed at templated paths.
+   *
+   * Templated paths are stored in a trie keyed by path segment, so a lookup
+   * only visits the segments which may match the request path, rather than
+   * testing every installed template. Literal segments are found by exact
+   * lookup, while templated segments are tested in turn at each level.
+   */
+  template <typename T>
+  class PathRouter
+  {
+  public:
+    struct Match
+    {
+      const T* value;
+      const std::vector<std::string>* component_names;
+      std::vector<std::string_view> component_values;
+
+      template <typename Params>
+      void populate(Params& params) const
+      {
+        for (size_t i = 0; i < component_names->size(); ++i)
+        {
+          params[component_names->at(i)] = std::string(component_values[i]);
+        }
+      }
+    };
+
+  private:
+    struct Route
+    {
+      std::vector<std::string> component_names;
+      T value;
+    };
+
+    struct Node
+    {
+      std::map<std::string, std::unique_ptr<Node>, std::less<>>
+        literal_children;
+      std::vector<std::pair<PathTemplateSegment, std::unique_ptr<Node>>>
+        template_children;
+      std::vector<Route> routes;
+    };
+
+    Node root;
+    size_t route_count = 0;
+
+    template <typename F>
+    static void match_node(
+      const Node& node,
+      const std::vector<std::string_view>& segments,
+      size_t idx,
+      std::vector<std::string_view>& component_values,
+      const F& accept,
+      std::vector<Match>& matches)
+    {
+      if (idx == segments.size())
+      {
+        for (const auto& route : node.routes)
+        {
+          if (accept(route.value))
+          {
+            matches.push_back(
+              {&route.value, &route.component_names, component_values});
+          }
+        }
+        return;
+      }
+
+      const auto& segment = segments[idx];
+
+      const auto it = node.literal_children.find(segment);
+      if (it != node.literal_children.end())
+      {
+        match_node(
+          *it->second, segments, idx + 1, component_values, accept, matches);
+      }
+
+      for (const auto& [template_segment, child] : node.template_children)
+      {
+        const auto n = component_values.size();
+        if (template_segment.match(segment, component_values))
+        {
+          match_node(
+            *child, segments, idx + 1, component_values, accept, matches);
+        }
+        component_values.resize(n);
+      }
+    }
+
+  public:
+    void insert(const PathTemplateSpec& spec, const T& value)
+    {
+      Node* node = &root;
+      for (const auto& segment : spec.segments)
+      {
+        const auto literal = segment.get_literal();
+        if (literal.has_value())
+        {
+          auto& child = node->literal_children[std::string(literal.value())];
+          if (child == nullptr)
+          {
+            child = std::make_unique<Node>();
+          }
+          node = child.get();
+        }
+        else
+        {
+          auto it = std::find_if(
+            node->template_children.begin(),
+            node->template_children.end(),
+            [&segment](const auto& entry) { return entry.first == segment; });
+          if (it == node->template_children.end())
+          {
+            node->template_children.emplace_back(
+              segment, std::make_unique<Node>());
+            it = std::prev(node->template_children.end());
+          }
+          node = it->second.get();
+        }
+      }
+
+      node->routes.push_back({spec.template_component_names, value});
+      ++route_count;
+    }
+
+    void clear()
+    {
+      root = {};
+      route_count = 0;
+    }
+
+    size_t size() const
+    {
+      return route_count;
+    }
+
+    /** Find all routes whose template matches the given path, and whose value
+     * is accepted by the given predicate. The returned component values are
+     * views into path.
+     */
+    template <typename F>
+    std::vector<Match> match(
+      const std::string_view& path, const F& accept) const
+    {
+      std::vector<Match> matches;
+      if (route_count == 0)
+      {
+        return matches;
+      }
+
+      const auto segments = nonstd::split(path, "/");
+      std::vector<std::string_view> component_values;
+      match_node(root, segments, 0, component_values, accept, matches);
+      return matches;
+    }
+
+    std::vector<Match> match(const std::string_view& path) const
+    {
+      return match(path, [](const T&) { return true; });
+    }
+  };
+}
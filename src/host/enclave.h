@@ -29,6 +29,20 @@ extern "C"
     uint64_t host_thread_id,
     const char* message)
   {}
+
+  // OCalls letting idle enclave threads block on a doorbell in host memory
+  void host_futex_wait(void* word, uint32_t expected, uint64_t timeout_us)
+  {
+    threading::futex_wait(
+      static_cast<threading::FutexWord*>(word),
+      expected,
+      std::chrono::microseconds(timeout_us));
+  }
+
+  void host_futex_wake(void* word)
+  {
+    threading::futex_wake(static_cast<threading::FutexWord*>(word));
+  }
 }
 
 // Marker to create virtual enclaves, should be distinct from any valid
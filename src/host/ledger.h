@@ -6,15 +6,27 @@
 #include "ds/logger.h"
 #include "ds/messaging.h"
 #include "ds/nonstd.h"
+#include "ds/serialized.h"
+#include "ds/serializer.h"
 #include "kv/serialised_entry_format.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
+#include <deque>
 #include <filesystem>
 #include <list>
 #include <map>
+#include <mutex>
 #include <string>
+#include <sys/mman.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -24,6 +36,26 @@ namespace asynchost
 {
   static constexpr size_t ledger_max_read_cache_files_default = 5;
 
+  // Maximum size of framed entries sent to the enclave in a single response
+  // to a range request (a single larger entry is still sent on its own)
+  static constexpr size_t ledger_max_range_response_size = 1 << 20;
+
+  struct LedgerGroupCommitConfig
+  {
+    // Maximum time an entry waits for other entries to be grouped with it
+    // before being written to disk. If 0, group commit is disabled and
+    // entries are written synchronously on the host thread.
+    std::chrono::microseconds max_delay = std::chrono::microseconds(0);
+
+    // A group is written out as soon as it contains at least this many bytes
+    size_t max_bytes = 1 << 20;
+
+    bool is_enabled() const
+    {
+      return max_delay.count() > 0;
+    }
+  };
+
   static constexpr auto ledger_committed_suffix = "committed";
   static constexpr auto ledger_start_idx_delimiter = "_";
   static constexpr auto ledger_last_idx_delimiter = "-";
@@ -127,6 +159,11 @@ namespace asynchost
     bool completed = false;
     bool committed = false;
 
+    // Read-only mapping of the whole file, only for committed files (which
+    // never change)
+    uint8_t* mapped = nullptr;
+    size_t mapped_size = 0;
+
   public:
     // Used when creating a new (empty) ledger file
     LedgerFile(const std::string& dir, size_t start_idx) :
@@ -242,12 +279,52 @@ namespace asynchost
 
     ~LedgerFile()
     {
+      if (mapped != nullptr)
+      {
+        munmap(mapped, mapped_size);
+      }
+
       if (file)
       {
         fclose(file);
       }
     }
 
+    // Maps committed file in memory so that entries can be read without
+    // copies. Returns false if the file cannot be mapped, in which case
+    // entries are read from the file as usual.
+    bool map()
+    {
+      if (mapped != nullptr)
+      {
+        return true;
+      }
+
+      if (!committed || !completed)
+      {
+        return false;
+      }
+
+      fseeko(file, 0, SEEK_END);
+      const auto file_size = ftello(file);
+      auto m = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, get_fd(), 0);
+      if (m == MAP_FAILED)
+      {
+        LOG_FAIL_FMT(
+          "Could not map ledger file {}: {}", file_name, strerror(errno));
+        return false;
+      }
+
+      mapped = static_cast<uint8_t*>(m);
+      mapped_size = file_size;
+      return true;
+    }
+
+    bool is_mapped() const
+    {
+      return mapped != nullptr;
+    }
+
     size_t get_start_idx() const
     {
       return start_idx;
@@ -273,6 +350,23 @@ namespace asynchost
       return completed;
     }
 
+    int get_fd() const
+    {
+      return fileno(file);
+    }
+
+    // Records a new entry of the given size at the end of the file, without
+    // writing it. The entry is expected to be written at the returned offset
+    // by the caller (see LedgerGroupWriter). Returns the new entry's index and
+    // its offset in the file.
+    std::pair<size_t, size_t> reserve_entry(size_t size)
+    {
+      const auto offset = total_len;
+      positions.push_back(offset);
+      total_len += size;
+      return {get_last_idx(), offset};
+    }
+
     size_t write_entry(const uint8_t* data, size_t size, bool committable)
     {
       fseeko(file, total_len, SEEK_SET);
@@ -322,6 +416,12 @@ namespace asynchost
       }
 
       auto len = framed_entries_size(idx, idx);
+      if (mapped != nullptr)
+      {
+        auto start = mapped + positions.at(idx - start_idx);
+        return std::vector<uint8_t>(start, start + len);
+      }
+
       std::vector<uint8_t> entry(len);
       fseeko(file, positions.at(idx - start_idx), SEEK_SET);
 
@@ -344,6 +444,12 @@ namespace asynchost
       }
 
       auto framed_size = framed_entries_size(from, to);
+      if (mapped != nullptr)
+      {
+        auto start = mapped + positions.at(from - start_idx);
+        return std::vector<uint8_t>(start, start + framed_size);
+      }
+
       std::vector<uint8_t> framed_entries(framed_size);
       fseeko(file, positions.at(from - start_idx), SEEK_SET);
 
@@ -356,6 +462,22 @@ namespace asynchost
       return framed_entries;
     }
 
+    // Returns a view onto the mapped framed entries, valid for as long as
+    // this file is alive. Only for mapped files.
+    std::optional<serializer::ByteRange> get_mapped_framed_entries(
+      size_t from, size_t to) const
+    {
+      if (
+        mapped == nullptr || (from < start_idx) || (to > get_last_idx()) ||
+        (to < from))
+      {
+        return std::nullopt;
+      }
+
+      return serializer::ByteRange{mapped + positions.at(from - start_idx),
+                                   framed_entries_size(from, to)};
+    }
+
     bool truncate(size_t idx)
     {
       if (committed || (idx < start_idx - 1) || (idx >= get_last_idx()))
@@ -488,6 +610,284 @@ namespace asynchost
     }
   };
 
+  // Contiguous framed ledger entries, made of one or more byte ranges. Ranges
+  // either point directly into memory-mapped committed ledger files or into
+  // buffers owned by this object. Mapped files are kept alive for as long as
+  // this object is, so that ranges can be written out without further copies.
+  class FramedEntries
+  {
+  private:
+    std::vector<std::shared_ptr<LedgerFile>> mapped_files;
+    std::vector<std::shared_ptr<std::vector<uint8_t>>> buffers;
+    std::vector<serializer::ByteRange> ranges;
+    size_t total_size = 0;
+
+  public:
+    void add_mapped(
+      const std::shared_ptr<LedgerFile>& file, serializer::ByteRange range)
+    {
+      mapped_files.push_back(file);
+      ranges.push_back(range);
+      total_size += range.size;
+    }
+
+    void add_buffer(const std::shared_ptr<std::vector<uint8_t>>& buffer)
+    {
+      buffers.push_back(buffer);
+      ranges.push_back({buffer->data(), buffer->size()});
+      total_size += buffer->size();
+    }
+
+    const std::vector<serializer::ByteRange>& get_ranges() const
+    {
+      return ranges;
+    }
+
+    size_t size() const
+    {
+      return total_size;
+    }
+
+    std::vector<uint8_t> to_vector() const
+    {
+      std::vector<uint8_t> v;
+      v.reserve(total_size);
+      for (const auto& r : ranges)
+      {
+        v.insert(v.end(), r.data, r.data + r.size);
+      }
+      return v;
+    }
+  };
+
+  // Writes ledger entries to disk on a dedicated thread, so that disk latency
+  // is not serialised onto the host's main (libuv) thread. Entries submitted
+  // within max_delay of the first entry of a group (or until the group
+  // reaches max_bytes) are written with a single pwritev() per contiguous run
+  // and made durable with a single fdatasync() per file.
+  class LedgerGroupWriter
+  {
+  private:
+    struct PendingWrite
+    {
+      std::shared_ptr<LedgerFile> file;
+      size_t idx;
+      size_t offset;
+      std::shared_ptr<std::vector<uint8_t>> data;
+    };
+
+    const LedgerGroupCommitConfig config;
+
+    std::mutex lock;
+    std::condition_variable work_cv;
+    std::condition_variable flushed_cv;
+
+    std::vector<PendingWrite> queue;
+    size_t queued_bytes = 0;
+    std::chrono::steady_clock::time_point group_start;
+    bool flush_requested = false;
+    bool writing = false;
+    bool finished = false;
+
+    // Index of last entry known to be durable on disk
+    std::atomic<size_t> durable_idx = 0;
+
+    std::thread writer_thread;
+
+    static void write_run(
+      int fd, size_t offset, std::vector<iovec>::iterator it, size_t count)
+    {
+      while (count > 0)
+      {
+        auto rc = pwritev(fd, &(*it), std::min<size_t>(count, IOV_MAX), offset);
+        if (rc < 0)
+        {
+          if (errno == EINTR)
+          {
+            continue;
+          }
+          throw std::logic_error(fmt::format(
+            "Failed to write entries to ledger: {}", strerror(errno)));
+        }
+
+        // Skip over fully-written buffers, and adjust the first partially
+        // written one
+        auto written = static_cast<size_t>(rc);
+        offset += written;
+        while (count > 0 && written >= it->iov_len)
+        {
+          written -= it->iov_len;
+          it++;
+          count--;
+        }
+        if (count > 0)
+        {
+          it->iov_base = static_cast<uint8_t*>(it->iov_base) + written;
+          it->iov_len -= written;
+        }
+      }
+    }
+
+    void write_group(std::vector<PendingWrite>& group)
+    {
+      std::vector<iovec> iov;
+      iov.reserve(group.size());
+      std::vector<int> fds_to_sync;
+
+      auto run_start = group.begin();
+      size_t run_iov_start = 0;
+      for (auto it = group.begin(); it != group.end(); ++it)
+      {
+        // A new run starts whenever the entry is not contiguous with the
+        // previous one (e.g. new file)
+        if (it != run_start)
+        {
+          const auto& prev = *std::prev(it);
+          if (
+            it->file != prev.file ||
+            it->offset != prev.offset + prev.data->size())
+          {
+            write_run(
+              run_start->file->get_fd(),
+              run_start->offset,
+              iov.begin() + run_iov_start,
+              iov.size() - run_iov_start);
+            run_start = it;
+            run_iov_start = iov.size();
+          }
+        }
+
+        iov.push_back({it->data->data(), it->data->size()});
+
+        const auto fd = it->file->get_fd();
+        if (
+          std::find(fds_to_sync.begin(), fds_to_sync.end(), fd) ==
+          fds_to_sync.end())
+        {
+          fds_to_sync.push_back(fd);
+        }
+      }
+
+      write_run(
+        run_start->file->get_fd(),
+        run_start->offset,
+        iov.begin() + run_iov_start,
+        iov.size() - run_iov_start);
+
+      for (auto fd : fds_to_sync)
+      {
+        if (fdatasync(fd) != 0)
+        {
+          throw std::logic_error(
+            fmt::format("Failed to sync ledger file: {}", strerror(errno)));
+        }
+      }
+
+      durable_idx.store(group.back().idx);
+    }
+
+    void run()
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      while (true)
+      {
+        work_cv.wait(guard, [this]() { return finished || !queue.empty(); });
+        if (queue.empty())
+        {
+          // Only reached when finished
+          break;
+        }
+
+        // Wait for more entries to be grouped with the first one
+        work_cv.wait_until(guard, group_start + config.max_delay, [this]() {
+          return finished || flush_requested ||
+            queued_bytes >= config.max_bytes;
+        });
+
+        std::vector<PendingWrite> group;
+        std::swap(group, queue);
+        queued_bytes = 0;
+        writing = true;
+
+        guard.unlock();
+        write_group(group);
+        group.clear();
+        guard.lock();
+
+        writing = false;
+        flushed_cv.notify_all();
+      }
+    }
+
+  public:
+    LedgerGroupWriter(const LedgerGroupCommitConfig& config) :
+      config(config),
+      writer_thread(&LedgerGroupWriter::run, this)
+    {}
+
+    ~LedgerGroupWriter()
+    {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        finished = true;
+      }
+      work_cv.notify_one();
+      writer_thread.join();
+    }
+
+    void write(
+      const std::shared_ptr<LedgerFile>& file,
+      size_t idx,
+      size_t offset,
+      const std::shared_ptr<std::vector<uint8_t>>& data)
+    {
+      bool notify = false;
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        if (queue.empty())
+        {
+          group_start = std::chrono::steady_clock::now();
+          notify = true;
+        }
+        queue.push_back({file, idx, offset, data});
+        queued_bytes += data->size();
+        notify |= queued_bytes >= config.max_bytes;
+      }
+
+      if (notify)
+      {
+        work_cv.notify_one();
+      }
+    }
+
+    // Blocks until all submitted entries are durable
+    void flush()
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      if (queue.empty() && !writing)
+      {
+        return;
+      }
+
+      flush_requested = true;
+      work_cv.notify_one();
+      flushed_cv.wait(guard, [this]() { return queue.empty() && !writing; });
+      flush_requested = false;
+    }
+
+    size_t get_durable_idx() const
+    {
+      return durable_idx.load();
+    }
+
+    // Should only be called once all submitted entries have been flushed,
+    // e.g. on truncation
+    void reset_durable_idx(size_t idx)
+    {
+      durable_idx.store(idx);
+    }
+  };
+
   class Ledger
   {
   private:
@@ -517,6 +917,42 @@ namespace asynchost
     // True if a new file should be created when writing an entry
     bool require_new_file;
 
+    // If group commit is enabled, entries are written asynchronously by
+    // group_writer. Entries which are not yet durable are kept in memory so
+    // that they can be read back in the meantime.
+    std::unique_ptr<LedgerGroupWriter> group_writer = nullptr;
+    std::deque<std::pair<size_t, std::shared_ptr<std::vector<uint8_t>>>>
+      pending_entries;
+    size_t last_acked_durable_idx = 0;
+
+    // Generation of the last truncation requested by the enclave, sent back
+    // with each durable index so that the enclave can ignore those which
+    // predate a truncation it requested
+    size_t truncation_generation = 0;
+
+    // Returns the index of the first entry that is not yet durable (and
+    // should be read from pending_entries rather than from disk), if any
+    std::optional<size_t> get_first_pending_idx()
+    {
+      if (group_writer == nullptr)
+      {
+        return std::nullopt;
+      }
+
+      const auto durable_idx = group_writer->get_durable_idx();
+      while (!pending_entries.empty() &&
+             pending_entries.front().first <= durable_idx)
+      {
+        pending_entries.pop_front();
+      }
+
+      if (pending_entries.empty())
+      {
+        return std::nullopt;
+      }
+      return pending_entries.front().first;
+    }
+
     auto get_it_contains_idx(size_t idx) const
     {
       if (idx == 0)
@@ -581,6 +1017,7 @@ namespace asynchost
       // the read cache is full
       auto match_file =
         std::make_shared<LedgerFile>(ledger_dir_, match.value());
+      match_file->map();
       files_read_cache.emplace_back(match_file);
       if (files_read_cache.size() > max_read_cache_files)
       {
@@ -630,13 +1067,23 @@ namespace asynchost
       ringbuffer::AbstractWriterFactory& writer_factory,
       size_t chunk_threshold,
       size_t max_read_cache_files = ledger_max_read_cache_files_default,
-      std::vector<std::string> read_ledger_dirs = {}) :
+      std::vector<std::string> read_ledger_dirs = {},
+      const LedgerGroupCommitConfig& group_commit = {}) :
       to_enclave(writer_factory.create_writer_to_inside()),
       ledger_dir(ledger_dir),
       read_ledger_dirs(read_ledger_dirs),
       max_read_cache_files(max_read_cache_files),
       chunk_threshold(chunk_threshold)
     {
+      if (group_commit.is_enabled())
+      {
+        group_writer = std::make_unique<LedgerGroupWriter>(group_commit);
+        LOG_INFO_FMT(
+          "Ledger group commit enabled (max delay: {}us, max bytes: {})",
+          group_commit.max_delay.count(),
+          group_commit.max_bytes);
+      }
+
       if (chunk_threshold == 0 || chunk_threshold > max_chunk_threshold_size)
       {
         throw std::logic_error(fmt::format(
@@ -789,6 +1236,14 @@ namespace asynchost
 
     Ledger(const Ledger& that) = delete;
 
+    ~Ledger()
+    {
+      if (group_writer != nullptr)
+      {
+        group_writer->flush();
+      }
+    }
+
     void init(size_t idx)
     {
       // Used to initialise the ledger when starting from a non-empty state,
@@ -822,6 +1277,13 @@ namespace asynchost
       LOG_INFO_FMT("Setting last known/commit index to {}", idx);
       last_idx = idx;
       committed_idx = idx;
+      if (group_writer != nullptr)
+      {
+        group_writer->flush();
+        group_writer->reset_durable_idx(idx);
+        pending_entries.clear();
+        last_acked_durable_idx = idx;
+      }
     }
 
     size_t get_last_idx() const
@@ -829,25 +1291,36 @@ namespace asynchost
       return last_idx;
     }
 
-    std::optional<std::vector<uint8_t>> read_entry(size_t idx)
+    // Index of the last entry known to be on disk. Always the last index if
+    // group commit is disabled.
+    size_t get_durable_idx() const
     {
-      auto f = get_file_from_idx(idx);
-      if (f == nullptr)
+      if (group_writer == nullptr)
       {
-        return std::nullopt;
+        return last_idx;
       }
-      return f->read_entry(idx);
+      return std::min(group_writer->get_durable_idx(), last_idx);
     }
 
-    std::optional<std::vector<uint8_t>> read_framed_entries(
-      size_t from, size_t to)
+    // Reads framed entries in [from, to]. Entries from committed ledger files
+    // and entries that are not yet durable (group commit) are not copied.
+    std::optional<FramedEntries> get_framed_entries(size_t from, size_t to)
     {
       if ((from <= 0) || (to > last_idx) || (to < from))
       {
         return std::nullopt;
       }
 
-      std::vector<uint8_t> entries;
+      // Entries that are not yet durable are read from memory
+      std::optional<size_t> to_pending = std::nullopt;
+      auto first_pending_idx = get_first_pending_idx();
+      if (first_pending_idx.has_value() && to >= first_pending_idx.value())
+      {
+        to_pending = to;
+        to = first_pending_idx.value() - 1;
+      }
+
+      FramedEntries entries;
       size_t idx = from;
       while (idx <= to)
       {
@@ -857,21 +1330,56 @@ namespace asynchost
           return std::nullopt;
         }
         auto to_ = std::min(f_from->get_last_idx(), to);
-        auto v = f_from->read_framed_entries(idx, to_);
-        if (!v.has_value())
+        if (f_from->is_mapped())
         {
-          return std::nullopt;
+          auto r = f_from->get_mapped_framed_entries(idx, to_);
+          if (!r.has_value())
+          {
+            return std::nullopt;
+          }
+          entries.add_mapped(f_from, r.value());
+        }
+        else
+        {
+          auto v = f_from->read_framed_entries(idx, to_);
+          if (!v.has_value())
+          {
+            return std::nullopt;
+          }
+          entries.add_buffer(
+            std::make_shared<std::vector<uint8_t>>(std::move(v.value())));
         }
-        entries.insert(
-          entries.end(),
-          std::make_move_iterator(v->begin()),
-          std::make_move_iterator(v->end()));
         idx = to_ + 1;
       }
 
+      if (to_pending.has_value())
+      {
+        for (; idx <= to_pending.value(); ++idx)
+        {
+          entries.add_buffer(
+            pending_entries.at(idx - first_pending_idx.value()).second);
+        }
+      }
+
       return entries;
     }
 
+    std::optional<std::vector<uint8_t>> read_entry(size_t idx)
+    {
+      return read_framed_entries(idx, idx);
+    }
+
+    std::optional<std::vector<uint8_t>> read_framed_entries(
+      size_t from, size_t to)
+    {
+      auto entries = get_framed_entries(from, to);
+      if (!entries.has_value())
+      {
+        return std::nullopt;
+      }
+      return entries->to_vector();
+    }
+
     size_t write_entry(
       const uint8_t* data, size_t size, bool committable, bool force_chunk)
     {
@@ -881,7 +1389,18 @@ namespace asynchost
         require_new_file = false;
       }
       auto f = get_latest_file();
-      last_idx = f->write_entry(data, size, committable);
+      if (group_writer != nullptr)
+      {
+        auto entry = std::make_shared<std::vector<uint8_t>>(data, data + size);
+        auto [idx, offset] = f->reserve_entry(size);
+        pending_entries.emplace_back(idx, entry);
+        group_writer->write(f, idx, offset, entry);
+        last_idx = idx;
+      }
+      else
+      {
+        last_idx = f->write_entry(data, size, committable);
+      }
 
       LOG_TRACE_FMT(
         "Wrote entry at {} [committable: {}, forced: {}]",
@@ -893,6 +1412,12 @@ namespace asynchost
         committable &&
         (force_chunk || f->get_current_size() >= chunk_threshold))
       {
+        // The positions table is written after the last entry, so all
+        // entries in the chunk should have been written first
+        if (group_writer != nullptr)
+        {
+          group_writer->flush();
+        }
         f->complete();
         require_new_file = true;
         LOG_DEBUG_FMT("Ledger chunk completed at {}", last_idx);
@@ -901,15 +1426,30 @@ namespace asynchost
       return last_idx;
     }
 
-    void truncate(size_t idx)
+    // Truncates the ledger after idx. The generation is chosen by the enclave,
+    // and reported back with subsequent durable indices even if the
+    // truncation has no effect.
+    void truncate(size_t idx, size_t generation = 0)
     {
       LOG_DEBUG_FMT("Ledger truncate: {}/{}", idx, last_idx);
 
+      truncation_generation = generation;
+
       if (idx >= last_idx || idx < committed_idx)
       {
         return;
       }
 
+      if (group_writer != nullptr)
+      {
+        // Pending writes for truncated entries should not land after the
+        // file has been truncated
+        group_writer->flush();
+        group_writer->reset_durable_idx(idx);
+        pending_entries.clear();
+        last_acked_durable_idx = std::min(last_acked_durable_idx, idx);
+      }
+
       require_new_file = true;
 
       auto f_from = get_it_contains_idx(idx + 1);
@@ -975,6 +1515,83 @@ namespace asynchost
       committed_idx = idx;
     }
 
+    // If group commit is enabled, notifies the enclave of the latest durable
+    // ledger index. Should be called regularly from the host thread.
+    void send_durable_acks()
+    {
+      if (group_writer == nullptr)
+      {
+        return;
+      }
+
+      const auto durable_idx = group_writer->get_durable_idx();
+      if (durable_idx > last_acked_durable_idx)
+      {
+        RINGBUFFER_WRITE_MESSAGE(
+          consensus::ledger_flushed,
+          to_enclave,
+          static_cast<consensus::Index>(durable_idx),
+          truncation_generation);
+        last_acked_durable_idx = durable_idx;
+      }
+    }
+
+    // Sends framed entries in [from, to] to the enclave, batched in as few
+    // ledger_entry_range messages as possible. Returns false if any of the
+    // entries cannot be read.
+    bool write_entries_range(
+      size_t from, size_t to, consensus::LedgerRequestPurpose purpose)
+    {
+      auto entries = get_framed_entries(from, to);
+      if (!entries.has_value())
+      {
+        return false;
+      }
+
+      size_t idx = from;
+      for (const auto& r : entries->get_ranges())
+      {
+        const uint8_t* data = r.data;
+        size_t size = r.size;
+        while (size > 0)
+        {
+          // Gather as many whole entries as fit in a single response
+          const auto batch_from = idx;
+          size_t batch_size = 0;
+          while (batch_size < size)
+          {
+            const uint8_t* entry_data = data + batch_size;
+            size_t entry_remaining = size - batch_size;
+            auto header = serialized::peek<kv::SerialisedEntryHeader>(
+              entry_data, entry_remaining);
+            const auto entry_size =
+              kv::serialised_entry_header_size + header.size;
+            if (
+              batch_size > 0 &&
+              batch_size + entry_size > ledger_max_range_response_size)
+            {
+              break;
+            }
+            batch_size += entry_size;
+            idx++;
+          }
+
+          RINGBUFFER_WRITE_MESSAGE(
+            consensus::ledger_entry_range,
+            to_enclave,
+            batch_from,
+            idx - 1,
+            purpose,
+            serializer::ByteRange{data, batch_size});
+
+          data += batch_size;
+          size -= batch_size;
+        }
+      }
+
+      return true;
+    }
+
     void register_message_handlers(
       messaging::Dispatcher<ringbuffer::Message>& disp)
     {
@@ -997,8 +1614,9 @@ namespace asynchost
         disp,
         consensus::ledger_truncate,
         [this](const uint8_t* data, size_t size) {
-          auto idx = serialized::read<consensus::Index>(data, size);
-          truncate(idx);
+          auto [idx, generation] =
+            ringbuffer::read_message<consensus::ledger_truncate>(data, size);
+          truncate(idx, generation);
         });
 
       DISPATCHER_SET_MESSAGE_HANDLER(
@@ -1014,12 +1632,17 @@ namespace asynchost
           auto [idx, purpose] =
             ringbuffer::read_message<consensus::ledger_get>(data, size);
 
-          auto entry = read_entry(idx);
+          auto entry = get_framed_entries(idx, idx);
 
           if (entry.has_value())
           {
+            // A single entry is always contiguous
             RINGBUFFER_WRITE_MESSAGE(
-              consensus::ledger_entry, to_enclave, idx, purpose, entry.value());
+              consensus::ledger_entry,
+              to_enclave,
+              idx,
+              purpose,
+              entry->get_ranges().front());
           }
           else
           {
@@ -1027,6 +1650,20 @@ namespace asynchost
               consensus::ledger_no_entry, to_enclave, idx, purpose);
           }
         });
+
+      DISPATCHER_SET_MESSAGE_HANDLER(
+        disp,
+        consensus::ledger_get_range,
+        [&](const uint8_t* data, size_t size) {
+          auto [from, to, purpose] =
+            ringbuffer::read_message<consensus::ledger_get_range>(data, size);
+
+          if (!write_entries_range(from, to, purpose))
+          {
+            RINGBUFFER_WRITE_MESSAGE(
+              consensus::ledger_no_entry_range, to_enclave, from, to, purpose);
+          }
+        });
     }
   };
 }
@@ -0,0 +1,27 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#pragma once
+
+#include "ledger.h"
+#include "timer.h"
+
+namespace asynchost
+{
+  // Regularly notifies the enclave of ledger entries made durable by the
+  // ledger group writer
+  class LedgerAcksImpl
+  {
+  private:
+    Ledger& ledger;
+
+  public:
+    LedgerAcksImpl(Ledger& ledger) : ledger(ledger) {}
+
+    void on_timer()
+    {
+      ledger.send_durable_acks();
+    }
+  };
+
+  using LedgerAcks = proxy_ptr<Timer<LedgerAcksImpl>>;
+}
@@ -10,6 +10,7 @@
 #include "ds/stacktrace_utils.h"
 #include "enclave.h"
 #include "handle_ring_buffer.h"
+#include "ledger_acks.h"
 #include "load_monitor.h"
 #include "node_connections.h"
 #include "process_launcher.h"
@@ -166,6 +167,48 @@ int main(int argc, char** argv)
     ->capture_default_str()
     ->transform(CLI::AsSizeValue(true)); // 1000 is kb
 
+  size_t ledger_group_commit_us = 0;
+  app
+    .add_option(
+      "--ledger-group-commit-us",
+      ledger_group_commit_us,
+      "Maximum time (microseconds) for which ledger entries are grouped "
+      "before being written to disk and synced by a dedicated ledger thread. "
+      "If 0 (default), ledger entries are written synchronously")
+    ->capture_default_str();
+
+  size_t ledger_group_commit_bytes = 1'000'000;
+  app
+    .add_option(
+      "--ledger-group-commit-bytes",
+      ledger_group_commit_bytes,
+      "Size (bytes) at which a group of ledger entries is written to disk "
+      "straight away (only if --ledger-group-commit-us is set)")
+    ->capture_default_str()
+    ->transform(CLI::AsSizeValue(true)); // 1000 is kb
+
+  size_t recovery_fetch_batch_size = 100;
+  app
+    .add_option(
+      "--recovery-fetch-batch-size",
+      recovery_fetch_batch_size,
+      "Number of ledger entries requested from the host at once when "
+      "replaying the ledger on recovery or on join from a snapshot")
+    ->capture_default_str()
+    ->check(CLI::PositiveNumber);
+
+  size_t recovery_fetch_window = 1'000;
+  app
+    .add_option(
+      "--recovery-fetch-window",
+      recovery_fetch_window,
+      "Maximum number of ledger entries requested but not yet replayed when "
+      "replaying the ledger on recovery or on join from a snapshot. If this "
+      "is not larger than --recovery-fetch-batch-size, entries are fetched "
+      "one batch at a time")
+    ->capture_default_str()
+    ->check(CLI::PositiveNumber);
+
   size_t snapshot_tx_interval = 10'000;
   app
     .add_option(
@@ -174,6 +217,25 @@ int main(int argc, char** argv)
       "Number of transactions between snapshots")
     ->capture_default_str();
 
+  size_t snapshot_chunk_bytes = 0;
+  app
+    .add_option(
+      "--snapshot-chunk-bytes",
+      snapshot_chunk_bytes,
+      "Approximate size (bytes, rounded up to a power of two) of each "
+      "independently encrypted chunk of a snapshot. Chunks are written to "
+      "disk as they are generated, so that the whole snapshot is never held "
+      "in memory. If 0, each snapshot is generated as a single chunk")
+    ->capture_default_str();
+
+  bool snapshot_parallel_serialisation = false;
+  app.add_flag(
+    "--parallel-snapshot-serialisation",
+    snapshot_parallel_serialisation,
+    "Serialise the maps of each snapshot concurrently on all worker threads "
+    "(only if --worker-threads > 1). The serialised snapshot is held in "
+    "memory until all maps have been serialised");
+
   size_t max_open_sessions = 1'000;
   app
     .add_option(
@@ -246,6 +308,23 @@ int main(int argc, char** argv)
       "--sig-ms-interval", sig_ms_interval, "Milliseconds between signatures")
     ->capture_default_str();
 
+  bool async_signatures = false;
+  app.add_flag(
+    "--async-signatures",
+    async_signatures,
+    "Sign the Merkle root of signature transactions on the main thread, while "
+    "other transactions keep executing (only if --worker-threads > 0)");
+
+  size_t tree_keyframe_interval = 0;
+  app
+    .add_option(
+      "--tree-keyframe-interval",
+      tree_keyframe_interval,
+      "Number of signatures between those recording the full Merkle tree. "
+      "Others only record a delta from the last full tree (0 to always record "
+      "the full tree)")
+    ->capture_default_str();
+
   size_t circuit_size_shift = 22;
   app
     .add_option(
@@ -295,6 +374,13 @@ int main(int argc, char** argv)
       "defined by this timer interval.")
     ->capture_default_str();
 
+  bool parallel_deserialisation = false;
+  app.add_flag(
+    "--parallel-deserialisation",
+    parallel_deserialisation,
+    "On backups, decrypt entries received from the primary on all worker "
+    "threads before applying them in order (only if --worker-threads > 1)");
+
   size_t client_connection_timeout = 2000;
   app
     .add_option(
@@ -336,6 +422,32 @@ int main(int argc, char** argv)
       "latency at a cost to throughput")
     ->capture_default_str();
 
+  threading::IdlePolicy idle_policy;
+  app
+    .add_option(
+      "--idle-spin-count",
+      idle_policy.spin_count,
+      "Number of consecutive idle iterations for which an enclave thread spins "
+      "while waiting for work, before yielding")
+    ->capture_default_str();
+
+  app
+    .add_option(
+      "--idle-yield-count",
+      idle_policy.yield_count,
+      "Number of further consecutive idle iterations for which an enclave "
+      "thread yields while waiting for work, before blocking until woken")
+    ->capture_default_str();
+
+  size_t idle_block_timeout_ms = idle_policy.block_timeout.count();
+  app
+    .add_option(
+      "--idle-block-timeout-ms",
+      idle_block_timeout_ms,
+      "Maximum time for which a blocked enclave thread waits to be woken "
+      "before checking for work again")
+    ->capture_default_str();
+
   std::string subject_name("CN=CCF Node");
   app
     .add_option(
@@ -590,6 +702,10 @@ int main(int argc, char** argv)
                                          from_enclave_buffer.size(),
                                          &from_enclave_offsets};
 
+  // Idle worker threads block on these, rather than waiting in the enclave
+  std::vector<threading::SharedDoorbellState> worker_doorbells(
+    num_worker_threads);
+
   ringbuffer::Circuit circuit(to_enclave_def, from_enclave_def);
   messaging::BufferProcessor bp("Host");
 
@@ -630,15 +746,28 @@ int main(int argc, char** argv)
     // graceful shutdown on sigterm
     asynchost::Sigterm sigterm(writer_factory);
 
+    asynchost::LedgerGroupCommitConfig ledger_group_commit;
+    ledger_group_commit.max_delay =
+      std::chrono::microseconds(ledger_group_commit_us);
+    ledger_group_commit.max_bytes = ledger_group_commit_bytes;
+
     asynchost::Ledger ledger(
       ledger_dir,
       writer_factory,
       ledger_chunk_bytes,
       asynchost::ledger_max_read_cache_files_default,
-      read_only_ledger_dirs);
+      read_only_ledger_dirs,
+      ledger_group_commit);
     ledger.register_message_handlers(bp.get_dispatcher());
 
-    asynchost::SnapshotManager snapshots(snapshot_dir, ledger);
+    // notify the enclave of durable ledger entries (group commit only)
+    std::unique_ptr<asynchost::LedgerAcks> ledger_acks = nullptr;
+    if (ledger_group_commit_us > 0)
+    {
+      ledger_acks = std::make_unique<asynchost::LedgerAcks>(1ms, ledger);
+    }
+
+    asynchost::SnapshotManager snapshots(snapshot_dir, ledger, writer_factory);
     snapshots.register_message_handlers(bp.get_dispatcher());
 
     // Begin listening for node-to-node and RPC messages.
@@ -691,6 +820,11 @@ int main(int argc, char** argv)
     enclave_config.from_enclave_buffer_offsets = &from_enclave_offsets;
 
     enclave_config.writer_config = writer_config;
+    idle_policy.block_timeout =
+      std::chrono::milliseconds(idle_block_timeout_ms);
+    enclave_config.idle_policy = idle_policy;
+    enclave_config.worker_doorbells = worker_doorbells.data();
+    enclave_config.worker_doorbells_count = worker_doorbells.size();
 #ifdef DEBUG_CONFIG
     enclave_config.debug_config = {memory_reserve_startup};
 #endif
@@ -700,8 +834,14 @@ int main(int argc, char** argv)
                                    raft_timeout,
                                    raft_election_timeout,
                                    bft_view_change_timeout,
-                                   bft_status_interval};
+                                   bft_status_interval,
+                                   parallel_deserialisation,
+                                   ledger_group_commit_us > 0};
     ccf_config.signature_intervals = {sig_tx_interval, sig_ms_interval};
+    ccf_config.async_signatures = async_signatures;
+    ccf_config.tree_keyframe_interval = tree_keyframe_interval;
+    ccf_config.ledger_recovery = {recovery_fetch_batch_size,
+                                  recovery_fetch_window};
     ccf_config.node_info_network = {rpc_address.hostname,
                                     public_rpc_address.hostname,
                                     node_address.hostname,
@@ -709,6 +849,9 @@ int main(int argc, char** argv)
                                     rpc_address.port,
                                     public_rpc_address.port};
     ccf_config.snapshot_tx_interval = snapshot_tx_interval;
+    ccf_config.snapshot_chunk_bytes = snapshot_chunk_bytes;
+    ccf_config.snapshot_parallel_serialisation =
+      snapshot_parallel_serialisation;
     ccf_config.max_open_sessions_soft = max_open_sessions;
     ccf_config.max_open_sessions_hard = max_open_sessions_hard;
 
@@ -800,14 +943,16 @@ int main(int argc, char** argv)
             snapshot));
         }
 
-        ccf_config.startup_snapshot = snapshots.read_snapshot(snapshot);
+        // The enclave reads the snapshot chunk by chunk once it is created
+        ccf_config.startup_snapshot_size =
+          snapshots.set_startup_snapshot(snapshot);
         ccf_config.startup_snapshot_evidence_seqno =
           snapshot_evidence_idx->first;
 
         LOG_INFO_FMT(
           "Found latest snapshot file: {} (size: {}, evidence seqno: {})",
           snapshot,
-          ccf_config.startup_snapshot.size(),
+          ccf_config.startup_snapshot_size,
           ccf_config.startup_snapshot_evidence_seqno);
       }
       else
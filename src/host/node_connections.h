@@ -293,18 +293,22 @@ namespace asynchost
 
             // Find the total frame size, and write it along with the header.
             uint32_t frame = (uint32_t)size_to_send;
-            std::optional<std::vector<uint8_t>> framed_entries = std::nullopt;
-
-            framed_entries =
-              ledger.read_framed_entries(ae.prev_idx + 1, ae.idx);
+            auto framed_entries =
+              ledger.get_framed_entries(ae.prev_idx + 1, ae.idx);
             if (framed_entries.has_value())
             {
               frame += (uint32_t)framed_entries->size();
               node.value()->write(sizeof(uint32_t), (uint8_t*)&frame);
               node.value()->write(size_to_send, data_to_send);
 
+              // Entries read from committed ledger files are written straight
+              // from their mapping
+              for (const auto& r : framed_entries->get_ranges())
+              {
+                node.value()->write(r.size, r.data);
+              }
+
               frame = (uint32_t)framed_entries->size();
-              node.value()->write(frame, framed_entries->data());
             }
             else
             {
@@ -4,12 +4,15 @@
 
 #include "consensus/ledger_enclave_types.h"
 #include "ds/files.h"
+#include "ds/serialized.h"
 #include "host/ledger.h"
+#include "kv/serialised_entry_format.h"
 
 #include <charconv>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <optional>
 
 namespace fs = std::filesystem;
@@ -89,10 +92,59 @@ namespace asynchost
   private:
     const std::string snapshot_dir;
     const Ledger& ledger;
+    ringbuffer::WriterPtr to_enclave;
 
     static constexpr auto snapshot_file_prefix = "snapshot";
     static constexpr auto snapshot_idx_delimiter = "_";
     static constexpr auto snapshot_committed_suffix = "committed";
+    static constexpr auto snapshot_partial_suffix = "partial";
+
+    // Snapshots whose chunks are still being received from the enclave. These
+    // are written to partial files until the evidence seqno is known.
+    struct PartialSnapshot
+    {
+      fs::path path;
+      std::ofstream file;
+      size_t size = 0;
+    };
+    std::map<consensus::Index, PartialSnapshot> partial_snapshots;
+
+    // Snapshot the node starts from (on join or recovery), whose chunks are
+    // read by the enclave one at a time
+    std::ifstream startup_snapshot_file;
+    size_t startup_snapshot_size = 0;
+
+    static bool is_snapshot_file_partial(const std::string& file_name)
+    {
+      const auto suffix = fmt::format(".{}", snapshot_partial_suffix);
+      return file_name.size() >= suffix.size() &&
+        file_name.compare(
+          file_name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    fs::path get_snapshot_path(
+      consensus::Index idx, consensus::Index evidence_idx)
+    {
+      auto snapshot_file_name = fmt::format(
+        "{}{}{}{}{}",
+        snapshot_file_prefix,
+        snapshot_idx_delimiter,
+        idx,
+        snapshot_idx_delimiter,
+        evidence_idx);
+      auto full_snapshot_path =
+        fs::path(snapshot_dir) / fs::path(snapshot_file_name);
+
+      if (fs::exists(full_snapshot_path))
+      {
+        throw std::logic_error(fmt::format(
+          "Cannot write snapshot at {} since file already exists: {}",
+          idx,
+          full_snapshot_path));
+      }
+
+      return full_snapshot_path;
+    }
 
     size_t get_snapshot_idx_from_file_name(const std::string& file_name)
     {
@@ -108,9 +160,13 @@ namespace asynchost
     }
 
   public:
-    SnapshotManager(const std::string& snapshot_dir_, const Ledger& ledger_) :
+    SnapshotManager(
+      const std::string& snapshot_dir_,
+      const Ledger& ledger_,
+      ringbuffer::AbstractWriterFactory& writer_factory) :
       snapshot_dir(snapshot_dir_),
-      ledger(ledger_)
+      ledger(ledger_),
+      to_enclave(writer_factory.create_writer_to_inside())
     {
       if (fs::is_directory(snapshot_dir))
       {
@@ -122,6 +178,18 @@ namespace asynchost
         throw std::logic_error(fmt::format(
           "Error: Could not create snapshot directory: {}", snapshot_dir));
       }
+
+      // Snapshots which were still being written when the host stopped can
+      // never be completed
+      for (auto const& f : fs::directory_iterator(snapshot_dir))
+      {
+        auto file_name = f.path().filename().string();
+        if (is_snapshot_file_partial(file_name))
+        {
+          LOG_INFO_FMT("Removing incomplete snapshot file \"{}\"", file_name);
+          fs::remove(f.path());
+        }
+      }
     }
 
     std::vector<uint8_t> read_snapshot(const std::string& file_name)
@@ -129,32 +197,89 @@ namespace asynchost
       return files::slurp(fs::path(snapshot_dir) / fs::path(file_name));
     }
 
+    /** Sets the snapshot the node starts from, which the enclave then reads
+     * chunk by chunk (see read_startup_snapshot_chunk()). Returns the size of
+     * the snapshot.
+     */
+    size_t set_startup_snapshot(const std::string& file_name)
+    {
+      const auto path = fs::path(snapshot_dir) / fs::path(file_name);
+      startup_snapshot_file.close();
+      startup_snapshot_file.clear();
+      startup_snapshot_file.open(path, std::ios::in | std::ios::binary);
+      if (!startup_snapshot_file)
+      {
+        throw std::logic_error(
+          fmt::format("Could not open snapshot file {}", path));
+      }
+      startup_snapshot_size = fs::file_size(path);
+      return startup_snapshot_size;
+    }
+
+    /** Reads the chunk of the startup snapshot starting at byte @p offset,
+     * i.e. a single serialised entry. Returns std::nullopt if there is no
+     * such chunk.
+     */
+    std::optional<std::vector<uint8_t>> read_startup_snapshot_chunk(
+      size_t offset)
+    {
+      if (
+        !startup_snapshot_file.is_open() ||
+        offset + kv::serialised_entry_header_size > startup_snapshot_size)
+      {
+        return std::nullopt;
+      }
+
+      std::vector<uint8_t> chunk(kv::serialised_entry_header_size);
+      startup_snapshot_file.clear();
+      startup_snapshot_file.seekg(offset);
+      startup_snapshot_file.read(
+        reinterpret_cast<char*>(chunk.data()), chunk.size());
+      if (!startup_snapshot_file)
+      {
+        return std::nullopt;
+      }
+
+      const uint8_t* data = chunk.data();
+      size_t size = chunk.size();
+      const auto header =
+        serialized::peek<kv::SerialisedEntryHeader>(data, size);
+      const auto chunk_size = kv::serialised_entry_header_size + header.size;
+      if (chunk_size > startup_snapshot_size - offset)
+      {
+        LOG_FAIL_FMT(
+          "Startup snapshot chunk at {} of size {} exceeds snapshot size {}",
+          offset,
+          chunk_size,
+          startup_snapshot_size);
+        return std::nullopt;
+      }
+
+      chunk.resize(chunk_size);
+      startup_snapshot_file.read(
+        reinterpret_cast<char*>(chunk.data()) +
+          kv::serialised_entry_header_size,
+        header.size);
+      if (!startup_snapshot_file)
+      {
+        return std::nullopt;
+      }
+
+      return chunk;
+    }
+
     void write_snapshot(
       consensus::Index idx,
       consensus::Index evidence_idx,
       const uint8_t* snapshot_data,
       size_t snapshot_size)
     {
-      auto snapshot_file_name = fmt::format(
-        "{}{}{}{}{}",
-        snapshot_file_prefix,
-        snapshot_idx_delimiter,
-        idx,
-        snapshot_idx_delimiter,
-        evidence_idx);
-      auto full_snapshot_path =
-        fs::path(snapshot_dir) / fs::path(snapshot_file_name);
-
-      if (fs::exists(full_snapshot_path))
-      {
-        throw std::logic_error(fmt::format(
-          "Cannot write snapshot at {} since file already exists: {}",
-          idx,
-          full_snapshot_path));
-      }
+      auto full_snapshot_path = get_snapshot_path(idx, evidence_idx);
 
       LOG_INFO_FMT(
-        "Writing new snapshot to {} [{}]", snapshot_file_name, snapshot_size);
+        "Writing new snapshot to {} [{}]",
+        full_snapshot_path.filename().string(),
+        snapshot_size);
 
       std::ofstream snapshot_file(
         full_snapshot_path, std::ios::out | std::ios::binary);
@@ -162,6 +287,70 @@ namespace asynchost
         reinterpret_cast<const char*>(snapshot_data), snapshot_size);
     }
 
+    void write_snapshot_chunk(
+      consensus::Index idx, const uint8_t* chunk_data, size_t chunk_size)
+    {
+      auto search = partial_snapshots.find(idx);
+      if (search == partial_snapshots.end())
+      {
+        auto partial_path = fs::path(snapshot_dir) /
+          fs::path(fmt::format(
+            "{}{}{}.{}",
+            snapshot_file_prefix,
+            snapshot_idx_delimiter,
+            idx,
+            snapshot_partial_suffix));
+
+        PartialSnapshot partial;
+        partial.path = partial_path;
+        partial.file.open(
+          partial_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        search = partial_snapshots.emplace(idx, std::move(partial)).first;
+      }
+
+      auto& partial = search->second;
+      partial.file.write(reinterpret_cast<const char*>(chunk_data), chunk_size);
+      partial.size += chunk_size;
+    }
+
+    void complete_snapshot(consensus::Index idx, consensus::Index evidence_idx)
+    {
+      auto search = partial_snapshots.find(idx);
+      if (search == partial_snapshots.end())
+      {
+        LOG_FAIL_FMT("Could not find snapshot chunks to complete at {}", idx);
+        return;
+      }
+
+      auto& partial = search->second;
+      partial.file.close();
+
+      auto full_snapshot_path = get_snapshot_path(idx, evidence_idx);
+
+      LOG_INFO_FMT(
+        "Writing new snapshot to {} [{}]",
+        full_snapshot_path.filename().string(),
+        partial.size);
+
+      fs::rename(partial.path, full_snapshot_path);
+      partial_snapshots.erase(search);
+    }
+
+    void abort_snapshot(consensus::Index idx)
+    {
+      auto search = partial_snapshots.find(idx);
+      if (search == partial_snapshots.end())
+      {
+        return;
+      }
+
+      LOG_INFO_FMT("Discarding incomplete snapshot at {}", idx);
+
+      search->second.file.close();
+      fs::remove(search->second.path);
+      partial_snapshots.erase(search);
+    }
+
     void commit_snapshot(
       consensus::Index snapshot_idx, consensus::Index evidence_commit_idx)
     {
@@ -173,6 +362,7 @@ namespace asynchost
         {
           auto file_name = f.path().filename().string();
           if (
+            !is_snapshot_file_partial(file_name) &&
             !get_snapshot_evidence_idx_from_file_name(file_name).has_value() &&
             get_snapshot_idx_from_file_name(file_name) == snapshot_idx)
           {
@@ -262,11 +452,50 @@ namespace asynchost
     void register_message_handlers(
       messaging::Dispatcher<ringbuffer::Message>& disp)
     {
+      DISPATCHER_SET_MESSAGE_HANDLER(
+        disp,
+        consensus::snapshot_chunk,
+        [this](const uint8_t* data, size_t size) {
+          auto idx = serialized::read<consensus::Index>(data, size);
+          write_snapshot_chunk(idx, data, size);
+        });
+
       DISPATCHER_SET_MESSAGE_HANDLER(
         disp, consensus::snapshot, [this](const uint8_t* data, size_t size) {
           auto idx = serialized::read<consensus::Index>(data, size);
           auto evidence_idx = serialized::read<consensus::Index>(data, size);
-          write_snapshot(idx, evidence_idx, data, size);
+          complete_snapshot(idx, evidence_idx);
+        });
+
+      DISPATCHER_SET_MESSAGE_HANDLER(
+        disp,
+        consensus::snapshot_abort,
+        [this](const uint8_t* data, size_t size) {
+          auto idx = serialized::read<consensus::Index>(data, size);
+          abort_snapshot(idx);
+        });
+
+      DISPATCHER_SET_MESSAGE_HANDLER(
+        disp,
+        consensus::startup_snapshot_get,
+        [this](const uint8_t* data, size_t size) {
+          auto [offset] =
+            ringbuffer::read_message<consensus::startup_snapshot_get>(
+              data, size);
+          auto chunk = read_startup_snapshot_chunk(offset);
+          if (chunk.has_value())
+          {
+            RINGBUFFER_WRITE_MESSAGE(
+              consensus::startup_snapshot_chunk,
+              to_enclave,
+              offset,
+              chunk.value());
+          }
+          else
+          {
+            RINGBUFFER_WRITE_MESSAGE(
+              consensus::startup_snapshot_no_chunk, to_enclave, offset);
+          }
         });
 
       DISPATCHER_SET_MESSAGE_HANDLER(
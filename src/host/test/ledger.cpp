@@ -3,12 +3,14 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "host/ledger.h"
 
+#include "consensus/ledger_fetch_window.h"
 #include "ds/serialized.h"
 #include "host/snapshot.h"
 #include "kv/serialised_entry_format.h"
 
 #include <doctest/doctest.h>
 #include <string>
+#include <thread>
 
 using namespace asynchost;
 
@@ -189,9 +191,9 @@ public:
         force_chunk) == last_idx);
   }
 
-  void truncate(size_t idx)
+  void truncate(size_t idx, size_t generation = 0)
   {
-    ledger.truncate(idx);
+    ledger.truncate(idx, generation);
 
     // Check that we can read until truncated entry but cannot read after it
     if (idx > 0)
@@ -782,6 +784,55 @@ TEST_CASE("Limit number of open files")
   }
 }
 
+TEST_CASE("Memory-mapped committed files")
+{
+  fs::remove_all(ledger_dir);
+
+  size_t chunk_threshold = 30;
+  size_t chunk_count = 4;
+  size_t max_read_cache_size = 1;
+  Ledger ledger(ledger_dir, wf, chunk_threshold, max_read_cache_size);
+  TestEntrySubmitter entry_submitter(ledger);
+
+  size_t end_of_first_chunk_idx =
+    initialise_ledger(entry_submitter, chunk_threshold, chunk_count);
+  entry_submitter.write(true);
+  auto last_idx = entry_submitter.get_last_idx();
+  auto last_committed_idx = chunk_count * end_of_first_chunk_idx;
+  ledger.commit(last_committed_idx);
+
+  INFO("Entries in committed files are read from their mapping");
+  {
+    auto entries = ledger.get_framed_entries(1, end_of_first_chunk_idx);
+    REQUIRE(entries.has_value());
+    REQUIRE(entries->get_ranges().size() == 1);
+    verify_framed_entries_range(
+      entries->to_vector(), 1, end_of_first_chunk_idx);
+  }
+
+  INFO("Mapped ranges outlive eviction from the read cache");
+  {
+    auto first_entries = ledger.get_framed_entries(1, end_of_first_chunk_idx);
+    REQUIRE(first_entries.has_value());
+
+    // Reading all other committed chunks evicts the first one from the cache
+    read_entries_range_from_ledger(
+      ledger, end_of_first_chunk_idx + 1, last_committed_idx);
+
+    verify_framed_entries_range(
+      first_entries->to_vector(), 1, end_of_first_chunk_idx);
+  }
+
+  INFO("Ranges spanning committed and uncommitted files");
+  {
+    auto entries = ledger.get_framed_entries(1, last_idx);
+    REQUIRE(entries.has_value());
+    // One range per committed chunk, plus one for the uncommitted chunk
+    REQUIRE(entries->get_ranges().size() == chunk_count + 1);
+    verify_framed_entries_range(entries->to_vector(), 1, last_idx);
+  }
+}
+
 TEST_CASE("Multiple ledger paths")
 {
   static constexpr auto ledger_dir_2 = "ledger_dir_2";
@@ -1036,6 +1087,305 @@ TEST_CASE("Delete committed file from main directory")
   }
 }
 
+TEST_CASE("Group commit")
+{
+  fs::remove_all(ledger_dir);
+
+  size_t chunk_threshold = 30;
+  size_t chunk_count = 3;
+  size_t end_of_first_chunk_idx = 0;
+  size_t last_written_idx = 0;
+
+  LedgerGroupCommitConfig group_commit;
+  // Long delay so that entries remain pending unless flushed
+  group_commit.max_delay = std::chrono::seconds(10);
+  group_commit.max_bytes = 1 << 20;
+
+  {
+    Ledger ledger(ledger_dir, wf, chunk_threshold, 1, {}, group_commit);
+    TestEntrySubmitter entry_submitter(ledger);
+
+    INFO("Entries are written across chunks");
+    {
+      end_of_first_chunk_idx =
+        initialise_ledger(entry_submitter, chunk_threshold, chunk_count);
+      entry_submitter.write(false);
+    }
+
+    INFO("Entries that are not yet durable can be read");
+    {
+      auto last_idx = entry_submitter.get_last_idx();
+      read_entry_from_ledger(ledger, last_idx);
+      REQUIRE_FALSE(ledger.read_entry(last_idx + 1).has_value());
+      read_entries_range_from_ledger(ledger, 1, last_idx);
+      read_entries_range_from_ledger(ledger, last_idx, last_idx);
+      read_entries_range_from_ledger(
+        ledger, end_of_first_chunk_idx, last_idx);
+    }
+
+    INFO("Truncation discards pending entries");
+    {
+      entry_submitter.write(false);
+      entry_submitter.write(false);
+      entry_submitter.truncate(entry_submitter.get_last_idx() - 1);
+      entry_submitter.write(true);
+      read_entries_range_from_ledger(
+        ledger, 1, entry_submitter.get_last_idx());
+    }
+
+    INFO("Commit");
+    {
+      ledger.commit(end_of_first_chunk_idx);
+      REQUIRE(number_of_committed_files_in_ledger_dir() == 1);
+      read_entries_range_from_ledger(
+        ledger, 1, entry_submitter.get_last_idx());
+    }
+
+    last_written_idx = entry_submitter.get_last_idx();
+  }
+
+  INFO("All entries are durable once the ledger is closed");
+  {
+    Ledger ledger(ledger_dir, wf, chunk_threshold);
+    REQUIRE(ledger.get_last_idx() == last_written_idx);
+    read_entries_range_from_ledger(ledger, 1, last_written_idx);
+  }
+
+  INFO("Groups are written once their byte budget is reached");
+  {
+    fs::remove_all(ledger_dir);
+    group_commit.max_bytes = 1;
+    Ledger ledger(ledger_dir, wf, chunk_threshold, 1, {}, group_commit);
+    TestEntrySubmitter entry_submitter(ledger);
+    entry_submitter.write(false);
+
+    // Entry is written well before max_delay expires
+    const auto ledger_file = fs::path(ledger_dir) / fs::path("ledger_1");
+    const auto expected_size = sizeof(size_t) +
+      kv::serialised_entry_header_size + sizeof(TestLedgerEntry);
+    size_t attempts = 0;
+    while (fs::file_size(ledger_file) < expected_size)
+    {
+      REQUIRE(attempts++ < 1000);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+TEST_CASE("Group commit durable acks across truncations")
+{
+  fs::remove_all(ledger_dir);
+
+  LedgerGroupCommitConfig group_commit;
+  // Each entry is written as soon as it is submitted
+  group_commit.max_delay = std::chrono::seconds(10);
+  group_commit.max_bytes = 1;
+
+  Ledger ledger(ledger_dir, wf, 1024, 1, {}, group_commit);
+  TestEntrySubmitter entry_submitter(ledger);
+
+  // Returns the last durable index and truncation generation reported to the
+  // enclave once all entries are on disk
+  auto ack_durable = [&ledger, &entry_submitter]() {
+    size_t attempts = 0;
+    while (ledger.get_durable_idx() < entry_submitter.get_last_idx())
+    {
+      REQUIRE(attempts++ < 1000);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ledger.send_durable_acks();
+
+    std::optional<std::pair<consensus::Index, size_t>> flushed = std::nullopt;
+    eio.read_from_outside().read(
+      -1, [&flushed](ringbuffer::Message m, const uint8_t* data, size_t size) {
+        if (m == consensus::ledger_flushed)
+        {
+          auto [idx, generation] =
+            ringbuffer::read_message<consensus::ledger_flushed>(data, size);
+          flushed = {idx, generation};
+        }
+      });
+    return flushed;
+  };
+
+  using Flushed = std::pair<consensus::Index, size_t>;
+
+  INFO("Truncations before consensus is created are at generation 0");
+  {
+    // e.g. at the end of public recovery, including no-op truncations
+    for (size_t i = 0; i < 5; ++i)
+    {
+      entry_submitter.write(true);
+    }
+    entry_submitter.truncate(3, 0);
+    entry_submitter.truncate(3, 0);
+    ledger.truncate(10, 0);
+    entry_submitter.write(true);
+    REQUIRE(ack_durable() == Flushed{4, 0});
+  }
+
+  INFO("Join from snapshot");
+  {
+    // Once the snapshot is verified, the ledger is truncated to the snapshot
+    // before consensus initialises the ledger at the snapshot
+    for (size_t i = 0; i < 3; ++i)
+    {
+      entry_submitter.write(true);
+    }
+    entry_submitter.truncate(6, 0);
+    ledger.init(6);
+    entry_submitter.write(true);
+    REQUIRE(ack_durable() == Flushed{7, 0});
+  }
+
+  INFO("Generation chosen by consensus is reported after each truncation");
+  {
+    entry_submitter.write(false);
+    entry_submitter.write(false);
+    entry_submitter.truncate(8, 1);
+    entry_submitter.write(true);
+    REQUIRE(ack_durable() == Flushed{9, 1});
+
+    // No-op truncations are reported too
+    ledger.truncate(20, 2);
+    entry_submitter.write(true);
+    REQUIRE(ack_durable() == Flushed{10, 2});
+  }
+}
+
+TEST_CASE("Recovery fetch window")
+{
+  fs::remove_all(ledger_dir);
+
+  Ledger ledger(ledger_dir, wf, 1024);
+  TestEntrySubmitter entry_submitter(ledger);
+  constexpr size_t last_idx = 20;
+  for (size_t i = 0; i < last_idx; ++i)
+  {
+    entry_submitter.write(true);
+  }
+
+  using Range = consensus::LedgerFetchWindow::Range;
+  using Ranges = std::vector<Range>;
+
+  // Serves a range requested by the fetch window from the ledger, as the host
+  // would, recording the values of the entries which are handed out for
+  // replay. Returns the ranges that the fetch window requests next.
+  auto serve = [&ledger](
+                 consensus::LedgerFetchWindow& fetch_window,
+                 const Range& range,
+                 std::vector<size_t>& replayed) {
+    const auto& [from, to] = range;
+    auto framed_entries = ledger.read_framed_entries(from, to);
+    if (!framed_entries.has_value())
+    {
+      return fetch_window.missing(from, to);
+    }
+
+    for (const auto& entry :
+         fetch_window.receive(from, to, framed_entries.value()))
+    {
+      const uint8_t* data = entry.data();
+      auto size = entry.size();
+      serialized::read<kv::SerialisedEntryHeader>(data, size);
+      replayed.push_back(TestLedgerEntry(data, size).value());
+    }
+    return fetch_window.fetch();
+  };
+
+  auto range_of_values = [](size_t from, size_t to) {
+    std::vector<size_t> values;
+    for (auto v = from; v <= to; ++v)
+    {
+      values.push_back(v);
+    }
+    return values;
+  };
+
+  consensus::LedgerFetchWindow fetch_window(3, 7);
+  std::vector<size_t> replayed;
+
+  INFO("Window advances as entries are replayed");
+  {
+    REQUIRE(fetch_window.start(0) == Ranges{{1, 3}, {4, 6}, {7, 7}});
+    REQUIRE(serve(fetch_window, {1, 3}, replayed) == Ranges{{8, 10}});
+    REQUIRE(replayed == range_of_values(1, 3));
+  }
+
+  INFO("Entries received out of order are replayed in order");
+  {
+    REQUIRE(serve(fetch_window, {7, 7}, replayed).empty());
+    REQUIRE(replayed == range_of_values(1, 3));
+
+    REQUIRE(
+      serve(fetch_window, {4, 6}, replayed) == Ranges{{11, 13}, {14, 14}});
+    REQUIRE(replayed == range_of_values(1, 7));
+
+    INFO("Entries received twice are only replayed once");
+    REQUIRE(serve(fetch_window, {4, 6}, replayed).empty());
+    REQUIRE(replayed == range_of_values(1, 7));
+  }
+
+  INFO("Ranges past the end of the ledger are retried one by one");
+  {
+    REQUIRE(serve(fetch_window, {8, 10}, replayed) == Ranges{{15, 17}});
+    REQUIRE(serve(fetch_window, {11, 13}, replayed) == Ranges{{18, 20}});
+    REQUIRE(serve(fetch_window, {14, 14}, replayed) == Ranges{{21, 21}});
+    REQUIRE(serve(fetch_window, {15, 17}, replayed) == Ranges{{22, 24}});
+    REQUIRE(replayed == range_of_values(1, 17));
+
+    // The end of the ledger is before this range, but earlier entries are
+    // still being fetched
+    REQUIRE(serve(fetch_window, {22, 24}, replayed).empty());
+    REQUIRE(serve(fetch_window, {18, 20}, replayed).empty());
+    REQUIRE_FALSE(fetch_window.at_end());
+
+    // Reports for ranges requested before entries were fetched one by one
+    // are ignored
+    REQUIRE(fetch_window.missing(22, 24).empty());
+    REQUIRE_FALSE(fetch_window.at_end());
+
+    REQUIRE(serve(fetch_window, {21, 21}, replayed).empty());
+    REQUIRE(fetch_window.at_end());
+    REQUIRE(replayed == range_of_values(1, last_idx));
+  }
+
+  INFO("Ranges that fail to be read are retried one by one");
+  {
+    replayed.clear();
+    consensus::LedgerFetchWindow retry_window(5, 5);
+    REQUIRE(retry_window.start(10) == Ranges{{11, 15}});
+
+    // Host fails to read entries which are in the ledger
+    auto requests = retry_window.missing(11, 15);
+    REQUIRE(requests == Ranges{{11, 11}});
+    while (!requests.empty())
+    {
+      REQUIRE(requests.size() == 1);
+      requests = serve(retry_window, requests.front(), replayed);
+    }
+    REQUIRE(retry_window.at_end());
+    REQUIRE(replayed == range_of_values(11, last_idx));
+  }
+
+  INFO("Responses to requests made before a restart are ignored");
+  {
+    replayed.clear();
+    consensus::LedgerFetchWindow restarted_window(2, 4);
+    REQUIRE(restarted_window.start(0) == Ranges{{1, 2}, {3, 4}});
+    REQUIRE(restarted_window.start(10, 12) == Ranges{{11, 12}});
+
+    REQUIRE(serve(restarted_window, {1, 2}, replayed).empty());
+    REQUIRE(restarted_window.missing(3, 4).empty());
+    REQUIRE(replayed.empty());
+
+    INFO("No entry is requested past the last one");
+    REQUIRE(serve(restarted_window, {11, 12}, replayed).empty());
+    REQUIRE(replayed == range_of_values(11, 12));
+    REQUIRE_FALSE(restarted_window.at_end());
+  }
+}
+
 TEST_CASE("Find latest snapshot with corresponding ledger chunk")
 {
   fs::remove_all(ledger_dir);
@@ -1048,7 +1398,7 @@ TEST_CASE("Find latest snapshot with corresponding ledger chunk")
   Ledger ledger(ledger_dir, wf, chunk_threshold);
   TestEntrySubmitter entry_submitter(ledger);
 
-  SnapshotManager snapshots(snapshot_dir, ledger);
+  SnapshotManager snapshots(snapshot_dir, ledger, wf);
 
   INFO("Write many entries on first ledger");
   {
@@ -1122,3 +1472,142 @@ TEST_CASE("Find latest snapshot with corresponding ledger chunk")
         snapshot_idx, snapshot_evidence_idx, snapshot_evidence_commit_idx));
   }
 }
+
+TEST_CASE("Snapshot written in chunks")
+{
+  fs::remove_all(ledger_dir);
+  fs::remove_all(snapshot_dir);
+
+  size_t chunk_threshold = 30;
+  size_t chunk_count = 2;
+
+  Ledger ledger(ledger_dir, wf, chunk_threshold);
+  TestEntrySubmitter entry_submitter(ledger);
+  initialise_ledger(entry_submitter, chunk_threshold, chunk_count);
+  auto last_idx = entry_submitter.get_last_idx();
+  ledger.commit(last_idx);
+
+  size_t snapshot_idx = last_idx / 2;
+  size_t snapshot_evidence_idx = snapshot_idx + 1;
+  size_t snapshot_evidence_commit_idx = snapshot_evidence_idx + 1;
+
+  std::vector<uint8_t> expected_snapshot;
+
+  {
+    SnapshotManager snapshots(snapshot_dir, ledger, wf);
+
+    INFO("Chunks of a snapshot are written as they arrive");
+    {
+      for (uint8_t i = 0; i < 3; i++)
+      {
+        std::vector<uint8_t> chunk(dummy_snapshot.size(), i);
+        snapshots.write_snapshot_chunk(snapshot_idx, chunk.data(), chunk.size());
+        expected_snapshot.insert(
+          expected_snapshot.end(), chunk.begin(), chunk.end());
+      }
+
+      // Chunks of an aborted snapshot are discarded
+      snapshots.write_snapshot_chunk(
+        snapshot_idx + 1, dummy_snapshot.data(), dummy_snapshot.size());
+      snapshots.abort_snapshot(snapshot_idx + 1);
+
+      // Incomplete snapshot cannot be committed
+      snapshots.commit_snapshot(snapshot_idx, snapshot_evidence_commit_idx);
+      REQUIRE_FALSE(snapshots.find_latest_committed_snapshot().has_value());
+    }
+
+    INFO("Completed snapshot can be committed");
+    {
+      snapshots.complete_snapshot(snapshot_idx, snapshot_evidence_idx);
+      snapshots.commit_snapshot(snapshot_idx, snapshot_evidence_commit_idx);
+
+      auto latest = snapshots.find_latest_committed_snapshot();
+      REQUIRE(latest.has_value());
+      REQUIRE(
+        fmt::format("{}/{}", snapshot_dir, latest.value()) ==
+        get_snapshot_file_name(
+          snapshot_idx, snapshot_evidence_idx, snapshot_evidence_commit_idx));
+      REQUIRE(snapshots.read_snapshot(latest.value()) == expected_snapshot);
+    }
+
+    // Chunks of a snapshot which is never completed are left behind
+    snapshots.write_snapshot_chunk(
+      snapshot_idx + 2, dummy_snapshot.data(), dummy_snapshot.size());
+  }
+
+  INFO("Incomplete snapshots are removed on startup");
+  {
+    SnapshotManager snapshots(snapshot_dir, ledger, wf);
+    size_t snapshot_files = 0;
+    for (auto const& f : fs::directory_iterator(snapshot_dir))
+    {
+      snapshot_files++;
+    }
+    REQUIRE(snapshot_files == 1);
+  }
+}
+
+TEST_CASE("Startup snapshot read chunk by chunk")
+{
+  fs::remove_all(ledger_dir);
+  fs::remove_all(snapshot_dir);
+
+  Ledger ledger(ledger_dir, wf, 30);
+  SnapshotManager snapshots(snapshot_dir, ledger, wf);
+
+  INFO("No chunk is read before a startup snapshot is set");
+  REQUIRE_FALSE(snapshots.read_startup_snapshot_chunk(0).has_value());
+
+  // Each chunk of a snapshot is a serialised entry of its own
+  std::vector<std::vector<uint8_t>> chunks;
+  std::vector<uint8_t> snapshot;
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    kv::SerialisedEntryHeader header;
+    header.set_size(dummy_snapshot.size() * (i + 1));
+    std::vector<uint8_t> chunk(kv::serialised_entry_header_size);
+    std::memcpy(chunk.data(), &header, sizeof(header));
+    chunk.resize(chunk.size() + header.size, i);
+
+    snapshot.insert(snapshot.end(), chunk.begin(), chunk.end());
+    chunks.push_back(std::move(chunk));
+  }
+
+  const auto file_name = "snapshot_10_11.committed_12";
+  {
+    std::ofstream f(
+      fs::path(snapshot_dir) / fs::path(file_name),
+      std::ios::out | std::ios::binary);
+    f.write(reinterpret_cast<const char*>(snapshot.data()), snapshot.size());
+  }
+
+  REQUIRE(snapshots.set_startup_snapshot(file_name) == snapshot.size());
+
+  INFO("Chunks are read one at a time, in any order");
+  {
+    size_t offset = 0;
+    for (const auto& chunk : chunks)
+    {
+      REQUIRE(snapshots.read_startup_snapshot_chunk(offset) == chunk);
+      offset += chunk.size();
+    }
+    REQUIRE_FALSE(snapshots.read_startup_snapshot_chunk(offset).has_value());
+    REQUIRE(snapshots.read_startup_snapshot_chunk(0) == chunks[0]);
+  }
+
+  INFO("Truncated chunks are not read");
+  {
+    std::ofstream f(
+      fs::path(snapshot_dir) / fs::path(file_name),
+      std::ios::out | std::ios::binary | std::ios::trunc);
+    f.write(
+      reinterpret_cast<const char*>(snapshot.data()), snapshot.size() - 1);
+    f.close();
+
+    REQUIRE(snapshots.set_startup_snapshot(file_name) == snapshot.size() - 1);
+    REQUIRE(snapshots.read_startup_snapshot_chunk(0) == chunks[0]);
+    REQUIRE_FALSE(snapshots.read_startup_snapshot_chunk(
+                    chunks[0].size() + chunks[1].size())
+                    .has_value());
+  }
+}
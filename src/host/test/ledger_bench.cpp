@@ -0,0 +1,103 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#define PICOBENCH_IMPLEMENT_WITH_MAIN
+#include "host/ledger.h"
+
+#include "ds/serialized.h"
+#include "kv/serialised_entry_format.h"
+
+#include <algorithm>
+#include <chrono>
+#include <picobench/picobench.hpp>
+
+using namespace asynchost;
+
+static constexpr auto ledger_dir = "ledger_bench_dir";
+static constexpr size_t chunk_threshold = 5'000'000;
+static constexpr size_t entry_size = 256;
+
+auto in_buffer = std::make_unique<ringbuffer::TestBuffer>(1 << 16);
+auto out_buffer = std::make_unique<ringbuffer::TestBuffer>(1 << 16);
+ringbuffer::Circuit eio(in_buffer->bd, out_buffer->bd);
+auto wf = ringbuffer::WriterFactory(eio);
+
+static std::vector<uint8_t> make_entry()
+{
+  std::vector<uint8_t> entry(kv::serialised_entry_header_size + entry_size, 42);
+  auto data = entry.data();
+  auto size = entry.size();
+  kv::SerialisedEntryHeader header;
+  header.set_size(entry_size);
+  serialized::write(data, size, header);
+  return entry;
+}
+
+// Writes s.iterations() committable entries and reports the p99 latency (in
+// microseconds) between submitting an entry and that entry being durable as
+// the benchmark result. Throughput (entries/s) is reported by picobench.
+template <size_t MaxDelayUs, size_t MaxBytes>
+static void write_entries(picobench::state& s)
+{
+  fs::remove_all(ledger_dir);
+
+  LedgerGroupCommitConfig group_commit;
+  group_commit.max_delay = std::chrono::microseconds(MaxDelayUs);
+  group_commit.max_bytes = MaxBytes;
+
+  const auto entry = make_entry();
+  const auto n = static_cast<size_t>(s.iterations());
+  std::vector<std::chrono::steady_clock::time_point> submitted(n);
+  std::vector<std::chrono::microseconds> latencies;
+  latencies.reserve(n);
+
+  {
+    Ledger ledger(ledger_dir, wf, chunk_threshold, 1, {}, group_commit);
+    size_t durable_idx = 0;
+
+    auto record_durable = [&]() {
+      const auto now = std::chrono::steady_clock::now();
+      const auto new_durable_idx = ledger.get_durable_idx();
+      for (; durable_idx < new_durable_idx; ++durable_idx)
+      {
+        latencies.push_back(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+            now - submitted[durable_idx]));
+      }
+    };
+
+    s.start_timer();
+    for (size_t i = 0; i < n; ++i)
+    {
+      submitted[i] = std::chrono::steady_clock::now();
+      ledger.write_entry(entry.data(), entry.size(), true, false);
+      record_durable();
+    }
+    while (durable_idx < n)
+    {
+      record_durable();
+    }
+    s.stop_timer();
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  s.set_result(latencies.at((latencies.size() * 99) / 100).count());
+
+  fs::remove_all(ledger_dir);
+}
+
+const std::vector<int> entry_counts = {1000, 10000};
+
+#define FIXED_PICO(NAME) \
+  PICOBENCH(NAME).iterations(entry_counts).samples(5)
+
+PICOBENCH_SUITE("ledger write (sync vs group commit)");
+auto sync_write = write_entries<0, 0>;
+FIXED_PICO(sync_write).baseline();
+auto group_100us_4k = write_entries<100, 4096>;
+FIXED_PICO(group_100us_4k);
+auto group_100us_64k = write_entries<100, 65536>;
+FIXED_PICO(group_100us_64k);
+auto group_1ms_64k = write_entries<1000, 65536>;
+FIXED_PICO(group_1ms_64k);
+auto group_1ms_1m = write_entries<1000, 1048576>;
+FIXED_PICO(group_1ms_1m);
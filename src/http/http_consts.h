@@ -19,6 +19,7 @@ namespace http
     static constexpr auto RETRY_AFTER = "retry-after";
     static constexpr auto WWW_AUTHENTICATE = "www-authenticate";
 
+    static constexpr auto CCF_BATCH = "x-ms-ccf-batch";
     static constexpr auto CCF_TX_ID = "x-ms-ccf-transaction-id";
   }
 
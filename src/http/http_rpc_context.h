@@ -268,6 +268,91 @@ namespace http
       return status_success(response_status);
     }
 
+    virtual bool is_batch_request() override
+    {
+      const auto batch = get_request_header(http::headers::CCF_BATCH);
+      return batch.has_value() && batch.value() == "true";
+    }
+
+    virtual std::vector<std::shared_ptr<enclave::RpcContext>>
+    get_batch_operations() override
+    {
+      // The body of a batch request is a JSON array of operation bodies. Each
+      // operation is otherwise identical to the batch request.
+      const auto bodies =
+        nlohmann::json::parse(request_body).get<std::vector<nlohmann::json>>();
+
+      auto headers = request_headers;
+      headers.erase(http::headers::CCF_BATCH);
+      headers[http::headers::CONTENT_TYPE] =
+        http::headervalues::contenttype::JSON;
+
+      std::vector<std::shared_ptr<enclave::RpcContext>> operations;
+      operations.reserve(bodies.size());
+      for (const auto& body : bodies)
+      {
+        const auto s = body.dump();
+        headers[http::headers::CONTENT_LENGTH] = fmt::format("{}", s.size());
+
+        auto op = std::make_shared<HttpRpcContext>(
+          request_index,
+          session,
+          verb.get_http_method().value(),
+          url,
+          headers,
+          std::vector<uint8_t>(s.begin(), s.end()));
+        op->set_method(path);
+        op->path_params = path_params;
+        op->is_create_request = is_create_request;
+        op->execute_on_node = execute_on_node;
+        operations.push_back(op);
+      }
+
+      return operations;
+    }
+
+    virtual void set_batch_response(
+      const std::vector<std::shared_ptr<enclave::RpcContext>>& operations)
+      override
+    {
+      auto results = nlohmann::json::array();
+      for (const auto& operation : operations)
+      {
+        const auto op = std::dynamic_pointer_cast<HttpRpcContext>(operation);
+        if (op == nullptr)
+        {
+          throw std::logic_error("Batch operation is not an HTTP request");
+        }
+
+        nlohmann::json body = nullptr;
+        if (!op->response_body.empty())
+        {
+          const auto it =
+            op->response_headers.find(http::headers::CONTENT_TYPE);
+          if (
+            it != op->response_headers.end() &&
+            it->second == http::headervalues::contenttype::JSON)
+          {
+            body = nlohmann::json::parse(op->response_body);
+          }
+          else
+          {
+            body = std::string(
+              op->response_body.begin(), op->response_body.end());
+          }
+        }
+
+        results.push_back(
+          {{"status", static_cast<int>(op->response_status)}, {"body", body}});
+      }
+
+      reset_response();
+      set_response_status(HTTP_STATUS_OK);
+      set_response_header(
+        http::headers::CONTENT_TYPE, http::headervalues::contenttype::JSON);
+      set_response_body(results.dump());
+    }
+
     virtual void reset_response() override
     {
       response_headers.clear();
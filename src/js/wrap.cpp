@@ -49,6 +49,12 @@ namespace js
     auto handle = static_cast<KVMap::Handle*>(
       JS_GetOpaque(this_val, kv_map_handle_class_id));
 
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
+
     if (argc != 1)
       return JS_ThrowTypeError(
         ctx, "Passed %d arguments, but expected 1", argc);
@@ -70,6 +76,12 @@ namespace js
     auto handle = static_cast<KVMap::Handle*>(
       JS_GetOpaque(this_val, kv_map_handle_class_id));
 
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
+
     if (argc != 1)
       return JS_ThrowTypeError(
         ctx, "Passed %d arguments, but expected 1", argc);
@@ -99,6 +111,12 @@ namespace js
   {
     auto handle = static_cast<KVMap::Handle*>(
       JS_GetOpaque(this_val, kv_map_handle_class_id));
+
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
     const uint64_t size = handle->size();
     if (size > INT64_MAX)
     {
@@ -114,6 +132,12 @@ namespace js
     auto handle = static_cast<KVMap::Handle*>(
       JS_GetOpaque(this_val, kv_map_handle_class_id));
 
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
+
     if (argc != 1)
       return JS_ThrowTypeError(
         ctx, "Passed %d arguments, but expected 1", argc);
@@ -141,6 +165,12 @@ namespace js
     auto handle = static_cast<KVMap::Handle*>(
       JS_GetOpaque(this_val, kv_map_handle_class_id));
 
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
+
     if (argc != 2)
       return JS_ThrowTypeError(
         ctx, "Passed %d arguments, but expected 2", argc);
@@ -171,6 +201,12 @@ namespace js
     auto handle = static_cast<KVMap::Handle*>(
       JS_GetOpaque(this_val, kv_map_handle_class_id));
 
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
+
     if (argc != 0)
     {
       return JS_ThrowTypeError(
@@ -194,6 +230,12 @@ namespace js
     auto handle = static_cast<KVMap::Handle*>(
       JS_GetOpaque(this_val, kv_map_handle_class_id));
 
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
+
     if (argc != 1)
       return JS_ThrowTypeError(
         ctx, "Passed %d arguments, but expected 1", argc);
@@ -239,6 +281,175 @@ namespace js
     return JS_UNDEFINED;
   }
 
+  // Returns a functor calling a JS callback as forEach does, which stops the
+  // iteration if the callback throws or returns false
+  static auto make_kv_map_range_callback(
+    JSContext* ctx, JSValueConst this_val, JSValue func, bool& failed)
+  {
+    return [ctx, this_val, func, &failed](const auto& k, const auto& v) {
+      JSValue args[3];
+
+      args[0] = JS_NewArrayBufferCopy(ctx, v.data(), v.size());
+      args[1] = JS_NewArrayBufferCopy(ctx, k.data(), k.size());
+      args[2] = JS_DupValue(ctx, this_val);
+
+      auto val = JS_Call(ctx, func, JS_UNDEFINED, 3, args);
+
+      JS_FreeValue(ctx, args[0]);
+      JS_FreeValue(ctx, args[1]);
+      JS_FreeValue(ctx, args[2]);
+
+      if (JS_IsException(val))
+      {
+        js_dump_error(ctx);
+        failed = true;
+        return false;
+      }
+
+      const auto stop = JS_IsBool(val) && !JS_ToBool(ctx, val);
+      JS_FreeValue(ctx, val);
+
+      return !stop;
+    };
+  }
+
+  static JSValue js_kv_map_range(
+    JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+  {
+    auto handle = static_cast<KVMap::Handle*>(
+      JS_GetOpaque(this_val, kv_map_handle_class_id));
+
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
+
+    if (argc != 3)
+      return JS_ThrowTypeError(
+        ctx, "Passed %d arguments, but expected 3", argc);
+
+    size_t from_size;
+    uint8_t* from = JS_GetArrayBuffer(ctx, &from_size, argv[0]);
+
+    if (!from)
+      return JS_ThrowTypeError(ctx, "First argument must be an ArrayBuffer");
+
+    std::optional<KVMap::Handle::KeyType> to = std::nullopt;
+    if (!JS_IsUndefined(argv[1]))
+    {
+      size_t to_size;
+      uint8_t* to_data = JS_GetArrayBuffer(ctx, &to_size, argv[1]);
+
+      if (!to_data)
+        return JS_ThrowTypeError(
+          ctx, "Second argument must be an ArrayBuffer or undefined");
+
+      to = KVMap::Handle::KeyType(to_data, to_data + to_size);
+    }
+
+    JSValue func = argv[2];
+
+    if (!JS_IsFunction(ctx, func))
+      return JS_ThrowTypeError(ctx, "Third argument must be a function");
+
+    bool failed = false;
+    handle->range(
+      {from, from + from_size},
+      to,
+      make_kv_map_range_callback(ctx, this_val, func, failed));
+
+    if (failed)
+    {
+      return JS_EXCEPTION;
+    }
+
+    return JS_UNDEFINED;
+  }
+
+  static JSValue js_kv_map_foreach_with_prefix(
+    JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+  {
+    auto handle = static_cast<KVMap::Handle*>(
+      JS_GetOpaque(this_val, kv_map_handle_class_id));
+
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
+
+    if (argc != 2)
+      return JS_ThrowTypeError(
+        ctx, "Passed %d arguments, but expected 2", argc);
+
+    size_t prefix_size;
+    uint8_t* prefix = JS_GetArrayBuffer(ctx, &prefix_size, argv[0]);
+
+    if (!prefix)
+      return JS_ThrowTypeError(ctx, "First argument must be an ArrayBuffer");
+
+    JSValue func = argv[1];
+
+    if (!JS_IsFunction(ctx, func))
+      return JS_ThrowTypeError(ctx, "Second argument must be a function");
+
+    bool failed = false;
+    handle->foreach_prefix(
+      {prefix, prefix + prefix_size},
+      make_kv_map_range_callback(ctx, this_val, func, failed));
+
+    if (failed)
+    {
+      return JS_EXCEPTION;
+    }
+
+    return JS_UNDEFINED;
+  }
+
+  static JSValue js_kv_map_lower_bound(
+    JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+  {
+    auto handle = static_cast<KVMap::Handle*>(
+      JS_GetOpaque(this_val, kv_map_handle_class_id));
+
+    if (handle == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Map handle is only valid during the request which created it");
+    }
+
+    if (argc != 1)
+      return JS_ThrowTypeError(
+        ctx, "Passed %d arguments, but expected 1", argc);
+
+    size_t key_size;
+    uint8_t* key = JS_GetArrayBuffer(ctx, &key_size, argv[0]);
+
+    if (!key)
+      return JS_ThrowTypeError(ctx, "Argument must be an ArrayBuffer");
+
+    auto entry = handle->lower_bound({key, key + key_size});
+
+    if (!entry.has_value())
+      return JS_UNDEFINED;
+
+    // Returned as a [key, value] pair, as by Map's iterators
+    auto pair = JS_NewArray(ctx);
+    JS_SetPropertyUint32(
+      ctx,
+      pair,
+      0,
+      JS_NewArrayBufferCopy(ctx, entry->first.data(), entry->first.size()));
+    JS_SetPropertyUint32(
+      ctx,
+      pair,
+      1,
+      JS_NewArrayBufferCopy(ctx, entry->second.data(), entry->second.size()));
+
+    return pair;
+  }
+
   static int js_kv_lookup(
     JSContext* ctx,
     JSPropertyDescriptor* desc,
@@ -256,6 +467,12 @@ namespace js
     auto tx_ctx_ptr =
       static_cast<TxContext*>(JS_GetOpaque(this_val, kv_class_id));
 
+    if (tx_ctx_ptr->tx == nullptr)
+    {
+      JS_ThrowInternalError(ctx, "No transaction available");
+      return -1;
+    }
+
     auto read_only = false;
     switch (access_category)
     {
@@ -298,6 +515,8 @@ namespace js
     // contents.
     auto view_val = JS_NewObjectClass(ctx, kv_map_handle_class_id);
     JS_SetOpaque(view_val, handle);
+    static_cast<Context*>(JS_GetContextOpaque(ctx))
+      ->add_request_scoped_object(view_val);
 
     JS_SetPropertyStr(
       ctx, view_val, "has", JS_NewCFunction(ctx, js_kv_map_has, "has", 1));
@@ -345,6 +564,26 @@ namespace js
       "forEach",
       JS_NewCFunction(ctx, js_kv_map_foreach, "forEach", 1));
 
+    // Range queries visit keys in the order of their bytes. They are only
+    // efficient on maps the store declares as ordered, and otherwise scan the
+    // map.
+    JS_SetPropertyStr(
+      ctx,
+      view_val,
+      "range",
+      JS_NewCFunction(ctx, js_kv_map_range, "range", 3));
+    JS_SetPropertyStr(
+      ctx,
+      view_val,
+      "forEachWithPrefix",
+      JS_NewCFunction(
+        ctx, js_kv_map_foreach_with_prefix, "forEachWithPrefix", 2));
+    JS_SetPropertyStr(
+      ctx,
+      view_val,
+      "lowerBound",
+      JS_NewCFunction(ctx, js_kv_map_lower_bound, "lowerBound", 1));
+
     desc->flags = 0;
     desc->value = view_val;
 
@@ -363,6 +602,12 @@ namespace js
 
     auto body = static_cast<const std::vector<uint8_t>*>(
       JS_GetOpaque(this_val, body_class_id));
+
+    if (body == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Request body is only valid during the request which created it");
+    }
     auto body_ = JS_NewStringLen(ctx, (const char*)body->data(), body->size());
     return body_;
   }
@@ -379,6 +624,12 @@ namespace js
 
     auto body = static_cast<const std::vector<uint8_t>*>(
       JS_GetOpaque(this_val, body_class_id));
+
+    if (body == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Request body is only valid during the request which created it");
+    }
     std::string body_str(body->begin(), body->end());
     auto body_ = JS_ParseJSON(ctx, body_str.c_str(), body->size(), "<body>");
     return body_;
@@ -396,6 +647,12 @@ namespace js
 
     auto body = static_cast<const std::vector<uint8_t>*>(
       JS_GetOpaque(this_val, body_class_id));
+
+    if (body == nullptr)
+    {
+      return JS_ThrowInternalError(
+        ctx, "Request body is only valid during the request which created it");
+    }
     auto body_ = JS_NewArrayBufferCopy(ctx, body->data(), body->size());
     return body_;
   }
@@ -1094,9 +1351,15 @@ namespace js
     }
     JS_FreeValue(ctx, eval_val);
 
-    // Get exported function from module
     assert(JS_VALUE_GET_TAG(module) == JS_TAG_MODULE);
     auto module_def = (JSModuleDef*)JS_VALUE_GET_PTR(module);
+    return get_exported_function(module_def, func, path);
+  }
+
+  JSValue Context::get_exported_function(
+    JSModuleDef* module_def, const std::string& func, const std::string& path)
+  {
+    // Get exported function from module
     auto export_count = JS_GetModuleExportEntriesCount(module_def);
     for (auto i = 0; i < export_count; i++)
     {
@@ -1122,6 +1385,21 @@ namespace js
       fmt::format("Failed to find export '{}' in module '{}'", func, path));
   }
 
+  void Context::add_request_scoped_object(JSValueConst obj)
+  {
+    request_scoped_objects.push_back(JS_DupValue(ctx, obj));
+  }
+
+  void Context::detach_request_scoped_objects()
+  {
+    for (auto& obj : request_scoped_objects)
+    {
+      JS_SetOpaque(obj, nullptr);
+      JS_FreeValue(ctx, obj);
+    }
+    request_scoped_objects.clear();
+  }
+
   void register_request_body_class(JSContext* ctx)
   {
     // Set prototype for request body class
@@ -1398,6 +1676,8 @@ namespace js
     {
       auto rpc = JS_NewObjectClass(ctx, rpc_class_id);
       JS_SetOpaque(rpc, rpc_ctx);
+      static_cast<Context*>(JS_GetContextOpaque(ctx))
+        ->add_request_scoped_object(rpc);
       JS_SetPropertyStr(ctx, ccf, "rpc", rpc);
       JS_SetPropertyStr(
         ctx,
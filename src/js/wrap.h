@@ -13,6 +13,7 @@
 #include <memory>
 #include <quickjs/quickjs-exports.h>
 #include <quickjs/quickjs.h>
+#include <vector>
 
 namespace js
 {
@@ -122,6 +123,10 @@ namespace js
   {
     JSContext* ctx;
 
+    // Objects whose opaque pointers refer to state which only lives as long as
+    // the current request, such as KV map handles
+    std::vector<JSValue> request_scoped_objects;
+
   public:
     inline Context(JSRuntime* rt)
     {
@@ -135,6 +140,7 @@ namespace js
 
     inline ~Context()
     {
+      detach_request_scoped_objects();
       JS_FreeContext(ctx);
     }
 
@@ -204,6 +210,18 @@ namespace js
       const std::string& path);
     JSValue function(
       JSValue module, const std::string& func, const std::string& path);
+    JSValue get_exported_function(
+      JSModuleDef* module_def,
+      const std::string& func,
+      const std::string& path);
+
+    void add_request_scoped_object(JSValueConst obj);
+
+    /** Clear the opaque pointers of all request-scoped objects, so that any
+     * reference kept to them by a context which outlives the request fails
+     * safely rather than dangling.
+     */
+    void detach_request_scoped_objects();
   };
 
 #pragma clang diagnostic pop
@@ -8,6 +8,7 @@
 
 #include <functional>
 #include <map>
+#include <vector>
 
 namespace kv
 {
@@ -46,34 +47,72 @@ namespace kv
     // and possibly committed, and then all maps with pending writes are
     // unlocked. This is to prevent transactions from being committed in an
     // interleaved fashion.
+    //
+    // Unless read versions are tracked, the keys read and written in each map
+    // are locked first instead, and the transaction is prepared without
+    // holding the map locks. The maps are then only locked to assign a version
+    // and publish the writes, so that transactions writing disjoint keys of
+    // the same map are mostly committed concurrently. Key locks are always
+    // acquired before map locks, in map order.
     Version version = NoVersion;
     bool has_writes = false;
     kv::Version max_conflict_version = 0;
 
-    std::map<std::string, std::unique_ptr<AbstractCommitter>> views;
+    // One committer per entry in changes, in the same (name) order
+    std::vector<std::unique_ptr<AbstractCommitter>> views;
+    views.reserve(changes.size());
     for (const auto& [map_name, mc] : changes)
     {
-      views[map_name] = mc.map->create_committer(mc.changeset.get());
+      views.push_back(mc.map->create_committer(mc.changeset.get()));
     }
 
-    for (auto it = changes.begin(); it != changes.end(); ++it)
+    const bool lock_keys = !track_read_versions;
+    bool prepare_unlocked = lock_keys;
+    size_t i = 0;
+    for (auto it = changes.begin(); it != changes.end(); ++it, ++i)
     {
-      bool changeset_has_writes = it->second.changeset->has_writes();
-      if (changeset_has_writes)
+      if (it->second.changeset->has_writes())
       {
         has_writes = true;
+        if (!views[i]->depends_on_keys_only())
+        {
+          prepare_unlocked = false;
+        }
       }
-      if (changeset_has_writes || track_read_versions)
+    }
+
+    if (lock_keys)
+    {
+      i = 0;
+      for (auto it = changes.begin(); it != changes.end(); ++it, ++i)
       {
-        it->second.map->lock();
+        if (it->second.changeset->has_writes())
+        {
+          views[i]->lock_keys(prepare_unlocked);
+        }
       }
     }
 
+    auto lock_maps = [&]() {
+      for (auto it = changes.begin(); it != changes.end(); ++it)
+      {
+        if (it->second.changeset->has_writes() || track_read_versions)
+        {
+          it->second.map->lock();
+        }
+      }
+    };
+
+    if (!prepare_unlocked)
+    {
+      lock_maps();
+    }
+
     bool ok = true;
     bool set_max_conflict_version_to_version = false;
     for (auto it = views.begin(); it != views.end(); ++it)
     {
-      if (!it->second->prepare(track_read_versions, max_conflict_version))
+      if (!(*it)->prepare(track_read_versions, max_conflict_version))
       {
         ok = false;
         break;
@@ -84,6 +123,23 @@ namespace kv
       }
     }
 
+    if (prepare_unlocked)
+    {
+      lock_maps();
+
+      if (ok)
+      {
+        for (auto it = views.begin(); it != views.end(); ++it)
+        {
+          if ((*it)->has_writes() && !(*it)->revalidate())
+          {
+            ok = false;
+            break;
+          }
+        }
+      }
+    }
+
     for (const auto& [map_name, map_ptr] : new_maps)
     {
       // Check that none of these pending maps have already been created.
@@ -144,8 +200,10 @@ namespace kv
         // have writes to them
         for (const auto& [map_name, map_ptr] : new_maps)
         {
-          const auto it = views.find(map_name);
-          if (it != views.end() && it->second->has_writes())
+          const auto it = changes.find(map_name);
+          if (
+            it != changes.end() &&
+            views[std::distance(changes.begin(), it)]->has_writes())
           {
             map_ptr->get_store()->add_dynamic_map(version, map_ptr);
           }
@@ -153,13 +211,13 @@ namespace kv
 
         for (auto it = views.begin(); it != views.end(); ++it)
         {
-          it->second->commit(version, track_read_versions);
+          (*it)->commit(version, track_read_versions);
         }
 
         // Collect ConsensusHooks
         for (auto it = views.begin(); it != views.end(); ++it)
         {
-          auto hook_ptr = it->second->post_commit();
+          auto hook_ptr = (*it)->post_commit();
           if (hook_ptr != nullptr)
           {
             hooks.push_back(std::move(hook_ptr));
@@ -181,6 +239,19 @@ namespace kv
       }
     }
 
+    if (lock_keys)
+    {
+      auto it = changes.rbegin();
+      for (auto view = views.rbegin(); view != views.rend(); ++view, ++it)
+      {
+        // Views with writes have locked their keys, see above
+        if (it->second.changeset->has_writes())
+        {
+          (*view)->unlock_keys();
+        }
+      }
+    }
+
     if (!ok)
     {
       return std::nullopt;
@@ -2,11 +2,17 @@
 // Licensed under the Apache 2.0 License.
 #pragma once
 
+#include "ds/arena.h"
 #include "ds/champ_map.h"
 #include "ds/hash.h"
+#include "ds/rb_map.h"
 #include "kv/kv_types.h"
 
+#include <functional>
 #include <map>
+#include <optional>
+#include <variant>
+#include <vector>
 
 namespace kv
 {
@@ -17,6 +23,34 @@ namespace kv
   template <typename K, typename V, typename H>
   using Snapshot = champ::Snapshot<K, VersionV<V>, H>;
 
+  // The keys of an ordered map, in order. Like the State, this includes keys
+  // which have been removed.
+  template <typename K>
+  using OrderedKeys = RBMap<K, std::monostate>;
+
+  // A secondary index maps each value of a map to (at most) one index key.
+  // Its state maps each index key to the set of keys whose values it was
+  // extracted from. Indexes are derived from the map's state on each node,
+  // and are not replicated.
+  template <typename K, typename V>
+  using IndexExtractor = std::function<std::optional<K>(const V&)>;
+
+  template <typename K, typename H>
+  using IndexedKeys = champ::Map<K, std::monostate, H>;
+
+  template <typename K, typename H>
+  using IndexState = champ::Map<K, IndexedKeys<K, H>, H>;
+
+  template <typename K, typename V, typename H>
+  struct Index
+  {
+    std::shared_ptr<const IndexExtractor<K, V>> extractor;
+    IndexState<K, H> state;
+  };
+
+  template <typename K, typename V, typename H>
+  using Indexes = std::map<std::string, Index<K, V, H>>;
+
   // This is a map of keys and with a tuple of the key's write version and the
   // version of last transaction which read the key and committed successfully
   using LastReadVersion = Version;
@@ -27,6 +61,24 @@ namespace kv
   template <typename K, typename V>
   using Write = std::map<K, std::optional<V>>;
 
+  // The reads and writes of an executing transaction are allocated from an
+  // arena owned by that transaction, if it has one, and are copied to a Write
+  // when (and if) they are committed
+  template <typename K>
+  using ChangeSetRead = std::map<
+    K,
+    std::tuple<DeletableVersion, LastReadVersion>,
+    std::less<K>,
+    ds::ArenaAllocator<
+      std::pair<const K, std::tuple<DeletableVersion, LastReadVersion>>>>;
+
+  template <typename K, typename V>
+  using ChangeSetWrite = std::map<
+    K,
+    std::optional<V>,
+    std::less<K>,
+    ds::ArenaAllocator<std::pair<const K, std::optional<V>>>>;
+
   // This is a container for a write-set + dependencies. It can be applied to a
   // given state, or used to track a set of operations on a state
   template <typename K, typename V, typename H>
@@ -40,20 +92,38 @@ namespace kv
     const State<K, V, H> state = {};
     const State<K, V, H> committed = {};
     const Version start_version = {};
+    // Only set if the map is ordered
+    const std::optional<OrderedKeys<K>> keys = std::nullopt;
+    const Indexes<K, V, H> indexes = {};
+
+    // Declared before reads and writes, so that it outlives them
+    const std::shared_ptr<ds::Arena> arena = nullptr;
 
     Version read_version = NoVersion;
-    Read<K> reads = {};
-    Write<K, V> writes = {};
+    // Unset for change sets which are only read from, and never committed
+    bool record_reads = true;
+    ChangeSetRead<K> reads = {};
+    ChangeSetWrite<K, V> writes = {};
 
     ChangeSet(
       size_t rollbacks,
-      State<K, V, H>& current_state,
-      State<K, V, H>& committed_state,
-      Version current_version) :
+      const State<K, V, H>& current_state,
+      const State<K, V, H>& committed_state,
+      Version current_version,
+      const std::optional<OrderedKeys<K>>& current_keys = std::nullopt,
+      const Indexes<K, V, H>& current_indexes = {},
+      const std::shared_ptr<ds::Arena>& arena_ = nullptr) :
       rollback_counter(rollbacks),
       state(current_state),
       committed(committed_state),
-      start_version(current_version)
+      start_version(current_version),
+      keys(current_keys),
+      indexes(current_indexes),
+      arena(arena_),
+      reads(ds::ArenaAllocator<typename ChangeSetRead<K>::value_type>(
+        arena_.get())),
+      writes(ds::ArenaAllocator<typename ChangeSetWrite<K, V>::value_type>(
+        arena_.get()))
     {}
 
     ChangeSet(ChangeSet&) = delete;
@@ -62,6 +132,62 @@ namespace kv
     {
       return !writes.empty();
     }
+
+    void set_write(const K& key, const std::optional<V>& value)
+    {
+      save_undo(key);
+      writes[key] = value;
+    }
+
+    void erase_write(const K& key)
+    {
+      save_undo(key);
+      writes.erase(key);
+    }
+
+    /** Returns a position in the writes of this change set, to which they
+     * can be rolled back with rollback_to(). Every later write then records
+     * the state it replaces.
+     */
+    size_t savepoint()
+    {
+      record_undo = true;
+      return undo.size();
+    }
+
+    void rollback_to(size_t savepoint)
+    {
+      while (undo.size() > savepoint)
+      {
+        auto& [key, previous] = undo.back();
+        if (previous.has_value())
+        {
+          writes[key] = std::move(previous.value());
+        }
+        else
+        {
+          writes.erase(key);
+        }
+        undo.pop_back();
+      }
+    }
+
+  private:
+    bool record_undo = false;
+    // The previous write of each key written since the first savepoint, or
+    // nullopt if it had none
+    std::vector<std::pair<K, std::optional<std::optional<V>>>> undo = {};
+
+    void save_undo(const K& key)
+    {
+      if (record_undo)
+      {
+        const auto it = writes.find(key);
+        undo.emplace_back(
+          key,
+          it == writes.end() ? std::nullopt : std::make_optional(it->second));
+      }
+    }
   };
 
   // This is a container for a snapshot. It has no dependencies as the snapshot
@@ -51,12 +51,7 @@ namespace kv
         throw std::logic_error("Transaction aborted");
 
       // If no transactions made changes, return a zero length vector.
-      const bool any_changes =
-        std::any_of(all_changes.begin(), all_changes.end(), [](const auto& it) {
-          return it.second.changeset->has_writes();
-        });
-
-      if (!any_changes)
+      if (!has_writes())
       {
         return {};
       }
@@ -94,6 +89,38 @@ namespace kv
   public:
     CommittableTx(AbstractStore* _store) : Tx(_store) {}
 
+    /** Serve the reads of this transaction from a snapshot of the store, and
+     * do not record them. The read version of the snapshot is acquired here,
+     * if it has not been set already, and every map accessed afterwards is
+     * read at that same version, pinned without locking the map where
+     * possible. This must be called before any map is accessed, and only on
+     * transactions that will not write: their commit() then succeeds without
+     * going through the store.
+     */
+    void set_read_only_snapshot()
+    {
+      if (!all_changes.empty())
+      {
+        throw std::logic_error(
+          "Cannot take a read-only snapshot after maps have been accessed");
+      }
+
+      read_only_snapshot = true;
+      if (!read_txid.has_value())
+      {
+        std::tie(read_txid, commit_view) =
+          store->current_txid_and_commit_term();
+      }
+    }
+
+    bool has_writes() const
+    {
+      return std::any_of(
+        all_changes.begin(), all_changes.end(), [](const auto& it) {
+          return it.second.changeset->has_writes();
+        });
+    }
+
     /** Commit this transaction to the local KV and submit it to consensus for
      * replication
      *
@@ -122,6 +149,21 @@ namespace kv
         return CommitResult::SUCCESS;
       }
 
+      if (read_only_snapshot)
+      {
+        // Reads were not recorded, so writes could not be checked for
+        // conflicts
+        if (has_writes())
+        {
+          throw std::logic_error(
+            "Cannot commit writes of a read-only snapshot transaction");
+        }
+
+        committed = true;
+        success = true;
+        return CommitResult::SUCCESS;
+      }
+
       // If this transaction creates any maps, ensure that commit gets a
       // consistent snapshot of the existing maps
       if (!created_maps.empty())
@@ -208,9 +250,19 @@ namespace kv
             return CommitResult::SUCCESS;
           }
 
+          // The entry is hashed here, concurrently with other committers,
+          // so that only its digest is inserted in the history when it is
+          // sequenced
+          std::optional<crypto::Sha256Hash> digest = std::nullopt;
+          if (store->get_history() != nullptr)
+          {
+            digest = crypto::Sha256Hash({data.data(), data.size()});
+          }
+
           return store->commit(
             {commit_view, version},
-            std::make_unique<MovePendingTx>(std::move(data), std::move(hooks)),
+            std::make_unique<MovePendingTx>(
+              std::move(data), std::move(hooks), digest),
             false);
         }
         catch (const std::exception& e)
@@ -5,6 +5,7 @@
 #include "apply_changes.h"
 #include "consensus/aft/request.h"
 #include "kv/committable_tx.h"
+#include "kv_serialiser.h"
 #include "kv_types.h"
 #include "node/progress_tracker.h"
 #include "node/signatures.h"
@@ -13,9 +14,30 @@
 
 namespace kv
 {
+  // A ledger entry whose header has been read and whose private domain has
+  // been decrypted, ready for its changes to be deserialised into the store
+  struct DecryptedEntry
+  {
+    std::unique_ptr<KvStoreDeserialiser> d;
+    kv::Version v;
+    kv::Version max_conflict_version;
+    kv::Term view;
+  };
+
   class ExecutionWrapperStore
   {
   public:
+    // Does not depend on the state of the store, so can be called for several
+    // entries concurrently, ahead of these being applied in order
+    virtual std::optional<DecryptedEntry> decrypt_entry(
+      const std::vector<uint8_t>& data, bool public_only) = 0;
+
+    virtual bool fill_maps(
+      DecryptedEntry& entry,
+      kv::OrderedChanges& changes,
+      kv::MapCollection& new_maps,
+      bool ignore_strict_versions = false) = 0;
+
     virtual bool fill_maps(
       const std::vector<uint8_t>& data,
       bool public_only,
@@ -46,6 +68,7 @@ namespace kv
     OrderedChanges changes;
     MapCollection new_maps;
     kv::ConsensusHookPtrs hooks;
+    std::optional<DecryptedEntry> decrypted = std::nullopt;
 
   public:
     CFTExecutionWrapper(
@@ -59,21 +82,54 @@ namespace kv
       public_only(public_only_)
     {}
 
+    void prepare() override
+    {
+      try
+      {
+        decrypted = store->decrypt_entry(data, public_only);
+      }
+      catch (const std::exception& e)
+      {
+        // The entry is deserialised from scratch by apply(), which reports
+        // the error
+        LOG_DEBUG_FMT("Could not prepare entry: {}", e.what());
+        decrypted = std::nullopt;
+      }
+    }
+
     ApplyResult apply() override
     {
-      kv::Version max_conflict_version;
+      // Entries prepared ahead of time were decrypted before the preceding
+      // entries were applied. If one of these introduced the ledger secret
+      // for this entry (e.g. on rekey), decryption failed then and the entry
+      // is decrypted again here.
       kv::Term view;
-      if (!store->fill_maps(
-            data,
-            public_only,
-            v,
-            max_conflict_version,
-            view,
-            changes,
-            new_maps,
-            true))
+      if (decrypted.has_value())
       {
-        return ApplyResult::FAIL;
+        v = decrypted->v;
+        view = decrypted->view;
+        auto ok = store->fill_maps(decrypted.value(), changes, new_maps, true);
+        decrypted = std::nullopt;
+        if (!ok)
+        {
+          return ApplyResult::FAIL;
+        }
+      }
+      else
+      {
+        kv::Version max_conflict_version;
+        if (!store->fill_maps(
+              data,
+              public_only,
+              v,
+              max_conflict_version,
+              view,
+              changes,
+              new_maps,
+              true))
+        {
+          return ApplyResult::FAIL;
+        }
       }
 
       if (!store->commit_deserialised(changes, v, view, new_maps, hooks))
@@ -86,10 +142,13 @@ namespace kv
       if (search != changes.end())
       {
         // Transactions containing a signature must only contain the signature
-        // and the serialised Merkle tree and must be verified
+        // and the serialised Merkle tree (or a delta from the last full one),
+        // and must be verified
         if (
           changes.size() > 2 ||
-          changes.find(ccf::Tables::SERIALISED_MERKLE_TREE) == changes.end())
+          (changes.find(ccf::Tables::SERIALISED_MERKLE_TREE) == changes.end() &&
+           changes.find(ccf::Tables::SERIALISED_MERKLE_TREE_DELTA) ==
+             changes.end()))
         {
           LOG_FAIL_FMT("Failed to deserialise");
           LOG_DEBUG_FMT("Unexpected contents in signature transaction {}", v);
@@ -263,6 +322,11 @@ namespace kv
     {
       return public_only;
     }
+
+    void prepare() override
+    {
+      // Entries are already deserialised on construction
+    }
   };
 
   class SignatureBFTExec : public BFTExecutionWrapper
@@ -11,12 +11,14 @@
 #include "serialiser_declare.h"
 
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <limits>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -339,6 +341,10 @@ namespace kv
       Term* term = nullptr, ccf::PrimarySignature* sig = nullptr) = 0;
     virtual void try_emit_signature() = 0;
     virtual void emit_signature() = 0;
+    // Signs and commits, on the calling thread, an asynchronous signature
+    // whose root is frozen but which has not been signed yet, if there is one.
+    // Returns true if there was.
+    virtual bool sign_frozen_signature() = 0;
     virtual crypto::Sha256Hash get_replicated_state_root() = 0;
     virtual std::tuple<
       kv::TxID /* TxID of last transaction seen by history */,
@@ -357,6 +363,23 @@ namespace kv
       const std::vector<uint8_t>& request,
       uint8_t frame_format) = 0;
     virtual void append(const std::vector<uint8_t>& data) = 0;
+
+    struct Entry
+    {
+      std::shared_ptr<std::vector<uint8_t>> data;
+      // Digest of data, if already computed
+      std::optional<crypto::Sha256Hash> digest;
+    };
+
+    // Appends the entries of consecutive transactions at once, so that those
+    // without a digest can be hashed together
+    virtual void append_entries(const std::vector<Entry>& entries)
+    {
+      for (const auto& entry : entries)
+      {
+        append(*entry.data);
+      }
+    }
     virtual void rollback(
       const kv::TxID& tx_id, kv::Term term_of_next_version_) = 0;
     virtual void compact(Version v) = 0;
@@ -451,6 +474,8 @@ namespace kv
 
     virtual void enable_all_domains() {}
 
+    virtual void ledger_flushed(ccf::SeqNo, size_t) {}
+
     virtual void emit_signature() = 0;
     virtual ConsensusType type() = 0;
   };
@@ -460,14 +485,20 @@ namespace kv
     CommitResult success;
     std::vector<uint8_t> data;
     std::vector<ConsensusHookPtr> hooks;
+    // Digest of data, if it was computed before the transaction was
+    // sequenced. Otherwise, it is computed by the history when data is
+    // appended to it.
+    std::optional<crypto::Sha256Hash> digest;
 
     PendingTxInfo(
       CommitResult success_,
       std::vector<uint8_t>&& data_,
-      std::vector<ConsensusHookPtr>&& hooks_) :
+      std::vector<ConsensusHookPtr>&& hooks_,
+      std::optional<crypto::Sha256Hash> digest_ = std::nullopt) :
       success(success_),
       data(std::move(data_)),
-      hooks(std::move(hooks_))
+      hooks(std::move(hooks_)),
+      digest(digest_)
     {}
   };
 
@@ -483,17 +514,22 @@ namespace kv
   private:
     std::vector<uint8_t> data;
     ConsensusHookPtrs hooks;
+    std::optional<crypto::Sha256Hash> digest;
 
   public:
-    MovePendingTx(std::vector<uint8_t>&& data_, ConsensusHookPtrs&& hooks_) :
+    MovePendingTx(
+      std::vector<uint8_t>&& data_,
+      ConsensusHookPtrs&& hooks_,
+      std::optional<crypto::Sha256Hash> digest_ = std::nullopt) :
       data(std::move(data_)),
-      hooks(std::move(hooks_))
+      hooks(std::move(hooks_)),
+      digest(digest_)
     {}
 
     PendingTxInfo call() override
     {
       return PendingTxInfo(
-        CommitResult::SUCCESS, std::move(data), std::move(hooks));
+        CommitResult::SUCCESS, std::move(data), std::move(hooks), digest);
     }
   };
 
@@ -542,6 +578,17 @@ namespace kv
     virtual bool prepare(bool track_commits, Version& max_conflict_version) = 0;
     virtual void commit(Version v, bool track_read_versions) = 0;
     virtual ConsensusHookPtr post_commit() = 0;
+
+    // Returns true if prepare() only depends on the keys read and written by
+    // the transaction, rather than on the whole map
+    virtual bool depends_on_keys_only() = 0;
+    // Locks the keys the transaction depends on, until unlock_keys() is
+    // called. If prepare_unlocked is true, prepare() is then called without
+    // holding the map lock, and the map is only locked to revalidate() and
+    // commit().
+    virtual void lock_keys(bool prepare_unlocked) = 0;
+    virtual void unlock_keys() = 0;
+    virtual bool revalidate() = 0;
   };
 
   class AbstractHandle
@@ -550,19 +597,47 @@ namespace kv
     virtual ~AbstractHandle() = default;
   };
 
+  // Dense integer identifier for a map name within a store (see
+  // Store::get_map_id), so that transactions can resolve maps by indexing
+  // rather than by comparing names.
+  using MapId = uint32_t;
+
   struct NamedHandleMixin
   {
   protected:
     std::string name;
 
+    // MapId of this map in the store it was last used with, tagged with that
+    // store's own id, so that both are read and written together. 0 until the
+    // map is first used with a store.
+    mutable std::atomic<uint64_t> tagged_map_id = 0;
+
   public:
     NamedHandleMixin(const std::string& s) : name(s) {}
+    NamedHandleMixin(const NamedHandleMixin& other) : name(other.name) {}
     virtual ~NamedHandleMixin() = default;
 
+    NamedHandleMixin& operator=(const NamedHandleMixin& other)
+    {
+      name = other.name;
+      tagged_map_id = 0;
+      return *this;
+    }
+
     const std::string& get_name() const
     {
       return name;
     }
+
+    uint64_t get_tagged_map_id() const
+    {
+      return tagged_map_id.load(std::memory_order_relaxed);
+    }
+
+    void set_tagged_map_id(uint64_t id) const
+    {
+      tagged_map_id.store(id, std::memory_order_relaxed);
+    }
   };
 
   class AbstractStore;
@@ -574,7 +649,12 @@ namespace kv
     {
     public:
       virtual ~Snapshot() = default;
-      virtual void serialise(KvStoreSerialiser& s) = 0;
+      // Serialises the entries from position from onwards, stopping before
+      // they exceed max_size bytes (but always serialising at least one
+      // entry). Returns the size of the serialised entries, and the position
+      // of the next entry to serialise if there are any left.
+      virtual std::pair<size_t, std::optional<size_t>> serialise_segment(
+        KvStoreSerialiser& s, size_t from, size_t max_size) = 0;
       virtual SecurityDomain get_security_domain() = 0;
     };
 
@@ -611,6 +691,9 @@ namespace kv
   {
   public:
     virtual ~AbstractExecutionWrapper() = default;
+    // Optional, order-independent part of deserialisation (e.g. decryption),
+    // which may be run on any thread before apply() is called
+    virtual void prepare() = 0;
     virtual kv::ApplyResult apply() = 0;
     virtual kv::ConsensusHookPtrs& get_hooks() = 0;
     virtual const std::vector<uint8_t>& get_entry() = 0;
@@ -638,6 +721,9 @@ namespace kv
     virtual bool should_rollback_to_last_committed() = 0;
   };
 
+  // Receives each chunk of a serialised snapshot, in order
+  using SnapshotChunkWriter = std::function<void(std::vector<uint8_t>&&)>;
+
   class AbstractStore
   {
   public:
@@ -648,6 +734,21 @@ namespace kv
       virtual Version get_version() const = 0;
       virtual std::vector<uint8_t> serialise(
         std::shared_ptr<AbstractTxEncryptor> encryptor) = 0;
+      virtual void serialise_chunks(
+        std::shared_ptr<AbstractTxEncryptor> encryptor,
+        size_t chunk_size,
+        const SnapshotChunkWriter& write_chunk) = 0;
+
+      // The following allow each map of the snapshot to be serialised
+      // concurrently, into chunks of its own. The serialised snapshot is the
+      // header chunk, followed by the chunks of each map in order.
+      virtual size_t get_map_count() const = 0;
+      virtual std::vector<uint8_t> serialise_header_chunk(
+        std::shared_ptr<AbstractTxEncryptor> encryptor) = 0;
+      virtual std::vector<std::vector<uint8_t>> serialise_map_chunks(
+        std::shared_ptr<AbstractTxEncryptor> encryptor,
+        size_t map_idx,
+        size_t chunk_size) = 0;
     };
 
     virtual ~AbstractStore() {}
@@ -668,9 +769,13 @@ namespace kv
 
     virtual std::shared_ptr<AbstractMap> get_map(
       Version v, const std::string& map_name) = 0;
+    virtual std::shared_ptr<AbstractMap> get_map(
+      Version v, MapId map_id, const std::string& map_name) = 0;
+    virtual MapId get_map_id(const NamedHandleMixin& m) = 0;
     virtual void add_dynamic_map(
       Version v, const std::shared_ptr<AbstractMap>& map) = 0;
     virtual bool is_map_replicated(const std::string& map_name) = 0;
+    virtual bool is_map_ordered(const std::string& map_name) = 0;
     virtual bool should_track_dependencies(const std::string& name) = 0;
 
     virtual std::shared_ptr<Consensus> get_consensus() = 0;
@@ -691,6 +796,10 @@ namespace kv
     virtual std::unique_ptr<AbstractSnapshot> snapshot(Version v) = 0;
     virtual std::vector<uint8_t> serialise_snapshot(
       std::unique_ptr<AbstractSnapshot> snapshot) = 0;
+    virtual void serialise_snapshot_chunks(
+      std::unique_ptr<AbstractSnapshot> snapshot,
+      size_t chunk_size,
+      const SnapshotChunkWriter& write_chunk) = 0;
     virtual ApplyResult deserialise_snapshot(
       const std::vector<uint8_t>& data,
       ConsensusHookPtrs& hooks,
@@ -93,6 +93,29 @@ namespace kv
         return hook(v, typed_writes);
       };
     }
+
+    /** Wraps a function returning the index key of a value, if it has one,
+     * so that it can be passed to @c kv::Store::set_index. The index can then
+     * be queried with @c kv::ReadableMapHandle::foreach_indexed, which must
+     * use the same IK and IKSerialiser.
+     */
+    template <
+      typename IK,
+      typename IKSerialiser = kv::serialisers::JsonSerialiser<IK>>
+    static kv::untyped::Map::IndexExtractor wrap_index_extractor(
+      const std::function<std::optional<IK>(const V&)>& extractor)
+    {
+      return [extractor](const kv::untyped::SerialisedEntry& v)
+               -> std::optional<kv::untyped::SerialisedEntry> {
+        const auto index_key = extractor(VSerialiser::from_serialised(v));
+        if (!index_key.has_value())
+        {
+          return std::nullopt;
+        }
+
+        return IKSerialiser::to_serialised(index_key.value());
+      };
+    }
   };
 
   template <
@@ -2,6 +2,7 @@
 // Licensed under the Apache 2.0 License.
 #pragma once
 
+#include "kv/serialise_entry_json.h"
 #include "kv/untyped_map.h"
 #include "kv/untyped_map_handle.h"
 #include "kv_types.h"
@@ -108,6 +109,22 @@ namespace kv
         KSerialiser::to_serialised(key));
     }
 
+    /** Get an identifier for the state of the whole map, as seen by this
+     * transaction.
+     *
+     * This changes whenever any key in the map is written to or the map is
+     * rolled back, so can be used to invalidate values computed from the
+     * entire contents of the map. Unlike @c get, this does not record a read
+     * dependency on any key.
+     *
+     * @return Pair of the map's rollback count and the version of the last
+     * applied transaction which wrote to the map
+     */
+    std::pair<size_t, Version> get_map_state_version() const
+    {
+      return read_handle.get_map_state_version();
+    }
+
     /** Iterate over all entries in the map.
      *
      * The passed functor should have the signature `bool(const K& k, const V&
@@ -148,6 +165,120 @@ namespace kv
       read_handle.foreach(g);
     }
 
+    /** Iterate over the entries in the map with keys in [from, to), in key
+     * order.
+     *
+     * Keys are ordered by their serialised form, compared as byte strings.
+     * This has the same dependencies and visibility of concurrent modifications
+     * as @c foreach. If the map is declared as ordered (see
+     * @c kv::Store::set_ordered), only the entries in the range are visited,
+     * otherwise the whole map is scanned.
+     *
+     * @tparam F Functor type. Should usually be derived implicitly from f
+     * @param from First key of the range
+     * @param to Key after the end of the range. If nullopt, the range extends
+     * to the end of the map
+     * @param f Functor instance, taking (const K& k, const V& v) and returning
+     * a bool. Return value determines whether the iteration should continue
+     * (true) or stop (false)
+     */
+    template <class F>
+    void range(const K& from, const std::optional<K>& to, F&& f)
+    {
+      auto g = [&](
+                 const kv::serialisers::SerialisedEntry& k_rep,
+                 const kv::serialisers::SerialisedEntry& v_rep) {
+        return f(
+          KSerialiser::from_serialised(k_rep),
+          VSerialiser::from_serialised(v_rep));
+      };
+      std::optional<kv::serialisers::SerialisedEntry> to_rep = std::nullopt;
+      if (to.has_value())
+      {
+        to_rep = KSerialiser::to_serialised(to.value());
+      }
+      read_handle.range(KSerialiser::to_serialised(from), to_rep, g);
+    }
+
+    /** Get the first entry in the map with a key not less than key, in the
+     * order used by @c range.
+     *
+     * @param key Key to search from
+     *
+     * @return Optional containing the entry, or nullopt if there is no such
+     * entry
+     */
+    std::optional<std::pair<K, V>> lower_bound(const K& key)
+    {
+      auto entry = read_handle.lower_bound(KSerialiser::to_serialised(key));
+      if (!entry.has_value())
+      {
+        return std::nullopt;
+      }
+
+      return std::make_pair(
+        KSerialiser::from_serialised(entry->first),
+        VSerialiser::from_serialised(entry->second));
+    }
+
+    /** Iterate over the entries in the map whose serialised keys start with
+     * the serialisation of prefix, in the order used by @c range.
+     *
+     * @tparam F Functor type. Should usually be derived implicitly from f
+     * @param prefix Key whose serialisation is the prefix to match
+     * @param f Functor instance, taking (const K& k, const V& v) and returning
+     * a bool. Return value determines whether the iteration should continue
+     * (true) or stop (false)
+     */
+    template <class F>
+    void foreach_prefix(const K& prefix, F&& f)
+    {
+      auto g = [&](
+                 const kv::serialisers::SerialisedEntry& k_rep,
+                 const kv::serialisers::SerialisedEntry& v_rep) {
+        return f(
+          KSerialiser::from_serialised(k_rep),
+          VSerialiser::from_serialised(v_rep));
+      };
+      read_handle.foreach_prefix(KSerialiser::to_serialised(prefix), g);
+    }
+
+    /** Iterate over the entries in the map whose values are mapped to
+     * index_key by a secondary index.
+     *
+     * The index must have been defined with @c kv::Store::set_index, from an
+     * extractor wrapped by @c kv::TypedMap::wrap_index_extractor with the same
+     * IK and IKSerialiser. Entries written by this transaction are included.
+     * Like @c foreach, this introduces a dependency on the whole map. The
+     * iteration order is undefined.
+     *
+     * @tparam IK Type of the index keys
+     * @tparam IKSerialiser Serialiser of the index keys
+     * @tparam F Functor type. Should usually be derived implicitly from f
+     * @param index_name Name of the index
+     * @param index_key Index key to look up
+     * @param f Functor instance, taking (const K& k, const V& v) and returning
+     * a bool. Return value determines whether the iteration should continue
+     * (true) or stop (false)
+     */
+    template <
+      typename IK,
+      typename IKSerialiser = kv::serialisers::JsonSerialiser<IK>,
+      class F>
+    void foreach_indexed(
+      const std::string& index_name, const IK& index_key, F&& f)
+    {
+      auto g = [&](
+                 const kv::serialisers::SerialisedEntry& k_rep,
+                 const kv::serialisers::SerialisedEntry& v_rep) {
+        return f(
+          KSerialiser::from_serialised(k_rep),
+          VSerialiser::from_serialised(v_rep));
+      };
+      read_handle.foreach_indexed(
+        index_name, IKSerialiser::to_serialised(index_key), g);
+    }
+
     /** Returns number of entries in this map.
      *
      * This is the count of all currently present keys, including both those
@@ -0,0 +1,213 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#pragma once
+
+#include "kv/kv_types.h"
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace kv
+{
+  /**
+   * Pending transactions, waiting to be sequenced in version order. Versions
+   * are dense, so each pending transaction is published into the slot of a
+   * fixed-size ring indexed by its version, without taking a lock. A single
+   * thread at a time then takes the contiguous run of transactions following
+   * the last one it sequenced.
+   *
+   * Each transaction is published with the epoch at which its committer last
+   * checked that it was still valid. clear() starts a new epoch, so that
+   * transactions published concurrently with it are dropped rather than
+   * sequenced.
+   */
+  class PendingTxRing
+  {
+  public:
+    // Enough for every transaction that can be in flight between the last
+    // sequenced version and the latest assigned version. A committer whose
+    // version is capacity or more ahead of the next one to be sequenced waits
+    // for its slot to be freed.
+    static constexpr size_t capacity = 1 << 12;
+
+    using Entry = std::tuple<Version, std::unique_ptr<PendingTx>, bool>;
+
+  private:
+    static constexpr size_t mask = capacity - 1;
+    static_assert((capacity & mask) == 0, "Capacity must be a power of two");
+
+    // A slot's state is empty, busy (being written or taken by one thread),
+    // or the version of the transaction published in it
+    static constexpr Version empty = NoVersion;
+    static constexpr Version busy = std::numeric_limits<Version>::max();
+
+    struct Slot
+    {
+      std::atomic<Version> state = empty;
+      // Atomic so that it can be checked by a thread waiting for the slot
+      std::atomic<size_t> epoch = 0;
+      std::unique_ptr<PendingTx> tx = nullptr;
+      bool committable = false;
+    };
+
+    std::unique_ptr<Slot[]> slots = std::make_unique<Slot[]>(capacity);
+    std::atomic<size_t> epoch = 0;
+
+    // Next version to be sequenced. Every slot is free for versions below
+    // next + capacity.
+    std::atomic<Version> next = 0;
+
+    Slot& slot_for(Version v)
+    {
+      return slots[v & mask];
+    }
+
+    // Takes ownership of a slot currently in state from
+    static bool acquire(Slot& slot, Version from)
+    {
+      return slot.state.compare_exchange_strong(
+        from, busy, std::memory_order_acquire);
+    }
+
+    // Sequentially consistent, so that a committer publishing a transaction
+    // and then checking whether another thread is sequencing cannot miss the
+    // sequencing thread's final check of is_ready()
+    static void release(Slot& slot, Version to)
+    {
+      slot.state.store(to);
+    }
+
+  public:
+    size_t get_epoch() const
+    {
+      return epoch.load(std::memory_order_acquire);
+    }
+
+    /** Publishes @p tx at version @p v. If the ring is full, waits for the
+     * slot of @p v to be freed, calling @p while_full (if set) in the
+     * meantime, so that the caller can help the transactions before @p v get
+     * published.
+     */
+    void publish(
+      Version v,
+      size_t epoch_,
+      std::unique_ptr<PendingTx> tx,
+      bool committable,
+      const std::function<void()>& while_full = nullptr)
+    {
+      auto& slot = slot_for(v);
+      while (true)
+      {
+        // Otherwise the slot may be empty only because the transaction
+        // capacity versions earlier has not been published yet
+        if (v < next.load() + static_cast<Version>(capacity))
+        {
+          auto state = slot.state.load(std::memory_order_acquire);
+          if (state == empty && acquire(slot, empty))
+          {
+            break;
+          }
+
+          // A transaction published before a clear() is dropped by whichever
+          // thread comes across it first
+          if (
+            state != empty && state != busy &&
+            slot.epoch.load(std::memory_order_relaxed) != get_epoch() &&
+            acquire(slot, state))
+          {
+            slot.tx = nullptr;
+            break;
+          }
+        }
+
+        // Only happens when the ring is full, so give the thread holding the
+        // next version to be sequenced a chance to publish it
+        if (while_full)
+        {
+          while_full();
+        }
+        std::this_thread::yield();
+      }
+
+      slot.epoch.store(epoch_, std::memory_order_relaxed);
+      slot.tx = std::move(tx);
+      slot.committable = committable;
+      release(slot, v);
+    }
+
+    bool is_ready(Version v)
+    {
+      return slot_for(v).state.load() == v;
+    }
+
+    /** Moves out the transactions published at contiguous versions from
+     * @p from onwards. Only one thread may take transactions at a time.
+     */
+    std::vector<Entry> take_from(Version from)
+    {
+      std::vector<Entry> ready;
+      const auto current_epoch = get_epoch();
+
+      auto v = from;
+      for (; true; ++v)
+      {
+        auto& slot = slot_for(v);
+        if (!acquire(slot, v))
+        {
+          break;
+        }
+
+        if (slot.epoch.load(std::memory_order_relaxed) != current_epoch)
+        {
+          // Published before a clear(), and not sequenced
+          slot.tx = nullptr;
+          release(slot, empty);
+          break;
+        }
+
+        ready.emplace_back(v, std::move(slot.tx), slot.committable);
+        release(slot, empty);
+      }
+
+      advance_to(v);
+      return ready;
+    }
+
+    /** Records that versions before @p next_ will not be published, because
+     * they were sequenced by other means (for instance, deserialised).
+     */
+    void advance_to(Version next_)
+    {
+      auto current = next.load();
+      while (current < next_ && !next.compare_exchange_weak(current, next_))
+      {
+      }
+    }
+
+    /** Drops every published transaction, and starts a new epoch in which
+     * @p next_ is the next version to be sequenced. Must not be called
+     * concurrently with take_from().
+     */
+    void clear(Version next_)
+    {
+      epoch.fetch_add(1, std::memory_order_acq_rel);
+      next.store(next_);
+
+      for (size_t i = 0; i < capacity; ++i)
+      {
+        auto& slot = slots[i];
+        auto state = slot.state.load(std::memory_order_acquire);
+        if (state != empty && state != busy && acquire(slot, state))
+        {
+          slot.tx = nullptr;
+          release(slot, empty);
+        }
+      }
+    }
+  };
+}
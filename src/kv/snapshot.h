@@ -4,6 +4,8 @@
 
 #include "kv/kv_types.h"
 
+#include <algorithm>
+
 namespace kv
 {
   class StoreSnapshot : public AbstractStore::AbstractSnapshot
@@ -18,9 +20,19 @@ namespace kv
   public:
     StoreSnapshot(Version version_) : version(version_) {}
 
+    // Map snapshots are kept in serialisation order: all public maps, then
+    // all private maps
     void add_map_snapshot(std::unique_ptr<kv::AbstractMap::Snapshot> snapshot)
     {
-      snapshots.push_back(std::move(snapshot));
+      auto pos = snapshots.end();
+      if (snapshot->get_security_domain() == SecurityDomain::PUBLIC)
+      {
+        pos = std::partition_point(
+          snapshots.begin(), snapshots.end(), [](const auto& s) {
+            return s->get_security_domain() == SecurityDomain::PUBLIC;
+          });
+      }
+      snapshots.insert(pos, std::move(snapshot));
     }
 
     void add_hash_at_snapshot(std::vector<uint8_t>&& hash_at_snapshot_)
@@ -39,15 +51,214 @@ namespace kv
     }
 
     std::vector<uint8_t> serialise(
-      std::shared_ptr<AbstractTxEncryptor> encryptor)
+      std::shared_ptr<AbstractTxEncryptor> encryptor) override
+    {
+      std::vector<uint8_t> serialised_snapshot;
+      serialise_chunks(
+        encryptor, 0, [&serialised_snapshot](std::vector<uint8_t>&& chunk) {
+          serialised_snapshot = std::move(chunk);
+        });
+      return serialised_snapshot;
+    }
+
+    void serialise_chunks(
+      std::shared_ptr<AbstractTxEncryptor> encryptor,
+      size_t chunk_size,
+      const SnapshotChunkWriter& write_chunk) override
+    {
+      // The snapshot is serialised as a sequence of chunks, each holding
+      // approximately chunk_size bytes (rounded up to a power of two) of map
+      // entries. Each chunk is a serialised entry of its own, encrypted
+      // independently. If chunk_size is 0, the snapshot is a single chunk.
+      const auto max_size = get_max_chunk_size(chunk_size);
+      const auto chunked_size =
+        chunk_size != 0 ? std::make_optional(chunk_size) : std::nullopt;
+
+      std::unique_ptr<KvStoreSerialiser> serialiser = nullptr;
+      size_t chunk_count = 0;
+      size_t chunk_used = 0;
+
+      auto start_chunk = [&]() {
+        serialiser =
+          make_chunk_serialiser(encryptor, chunked_size, chunk_count);
+        chunk_used = 0;
+      };
+
+      auto end_chunk = [&]() {
+        write_chunk(serialiser->get_raw_data());
+        serialiser.reset();
+        chunk_count++;
+      };
+
+      start_chunk();
+      serialise_header(*serialiser);
+
+      for (const auto& it : snapshots)
+      {
+        // Large maps are split into segments across consecutive chunks
+        std::optional<size_t> from = 0;
+        while (from.has_value())
+        {
+          if (chunk_used >= max_size)
+          {
+            end_chunk();
+            start_chunk();
+          }
+
+          auto [size, next] = it->serialise_segment(
+            *serialiser, from.value(), max_size - chunk_used);
+          chunk_used += size;
+          from = next;
+        }
+      }
+
+      end_chunk();
+    }
+
+    size_t get_map_count() const override
+    {
+      return snapshots.size();
+    }
+
+    std::vector<uint8_t> serialise_header_chunk(
+      std::shared_ptr<AbstractTxEncryptor> encryptor) override
+    {
+      // The header chunk holds no map entries, so is the same for all chunk
+      // sizes
+      auto serialiser =
+        make_chunk_serialiser(encryptor, size_t{0}, map_chunk_idx(0, 0), true);
+      serialise_header(*serialiser);
+      return serialiser->get_raw_data();
+    }
+
+    std::vector<std::vector<uint8_t>> serialise_map_chunks(
+      std::shared_ptr<AbstractTxEncryptor> encryptor,
+      size_t map_idx,
+      size_t chunk_size) override
+    {
+      // Unlike serialise_chunks(), each segment of the map is a chunk of its
+      // own, indexed by the map and the segment, so that maps can be
+      // serialised independently of each other
+      const auto max_size = get_max_chunk_size(chunk_size);
+      auto& map_snapshot = snapshots.at(map_idx);
+
+      std::vector<std::vector<uint8_t>> chunks;
+      std::optional<size_t> from = 0;
+      while (from.has_value())
+      {
+        auto serialiser = make_chunk_serialiser(
+          encryptor,
+          chunk_size,
+          map_chunk_idx(map_idx + 1, chunks.size()),
+          true);
+        from =
+          map_snapshot->serialise_segment(*serialiser, from.value(), max_size)
+            .second;
+        chunks.push_back(serialiser->get_raw_data());
+      }
+      return chunks;
+    }
+
+  private:
+    // The term of the IV of each chunk of a chunked snapshot records the
+    // layout of the chunks as well as the index of the chunk:
+    // | per-map (1 bit) | chunk size field (6 bits) | chunk idx + 1 (24 bits) |
+    // so that chunks generated with different chunk sizes, or by
+    // serialise_chunks() and serialise_map_chunks(), never share an IV at the
+    // same version. Chunk sizes are rounded up to a power of two, whose
+    // log2 + 1 is the chunk size field (0 if chunks are unbounded). The chunk
+    // idx of per-map chunks is split between the map (0 for the header
+    // chunk, then map idx + 1) and the segment of the map.
+    static constexpr size_t chunk_idx_bits = 24;
+    static constexpr size_t chunk_size_bits = 6;
+    static constexpr size_t per_map_bit = chunk_idx_bits + chunk_size_bits;
+    static constexpr size_t max_chunk_size_log2 = (1 << chunk_size_bits) - 2;
+    static constexpr size_t map_segment_bits = 14;
+
+    size_t map_chunk_idx(size_t map_field, size_t segment_idx) const
+    {
+      if (
+        map_field >= (size_t{1} << (chunk_idx_bits - map_segment_bits)) ||
+        segment_idx >= (size_t{1} << map_segment_bits) - 1)
+      {
+        throw std::logic_error(fmt::format(
+          "Snapshot at {} has too many maps ({}) or segments of a map ({}) to "
+          "be serialised per map",
+          version,
+          snapshots.size(),
+          segment_idx));
+      }
+
+      return (map_field << map_segment_bits) | segment_idx;
+    }
+
+    static std::optional<size_t> get_chunk_size_log2(size_t chunk_size)
+    {
+      if (chunk_size == 0)
+      {
+        return std::nullopt;
+      }
+
+      size_t log2 = 0;
+      while (log2 <= max_chunk_size_log2 && (size_t{1} << log2) < chunk_size)
+      {
+        log2++;
+      }
+
+      if (log2 > max_chunk_size_log2)
+      {
+        // Chunks this large are as good as unbounded
+        return std::nullopt;
+      }
+      return log2;
+    }
+
+    static size_t get_max_chunk_size(size_t chunk_size)
+    {
+      const auto log2 = get_chunk_size_log2(chunk_size);
+      return log2.has_value() ? size_t{1} << log2.value() :
+                                std::numeric_limits<size_t>::max();
+    }
+
+    Term get_chunk_term(size_t chunk_size, size_t chunk_idx, bool per_map) const
+    {
+      if (chunk_idx + 1 >= (size_t{1} << chunk_idx_bits))
+      {
+        throw std::logic_error(fmt::format(
+          "Snapshot at {} has too many chunks of size {}",
+          version,
+          get_max_chunk_size(chunk_size)));
+      }
+
+      const auto log2 = get_chunk_size_log2(chunk_size);
+      const size_t size_field = log2.has_value() ? log2.value() + 1 : 0;
+      return (size_t{per_map} << per_map_bit) |
+        (size_field << chunk_idx_bits) | (chunk_idx + 1);
+    }
+
+    std::unique_ptr<KvStoreSerialiser> make_chunk_serialiser(
+      std::shared_ptr<AbstractTxEncryptor> encryptor,
+      std::optional<size_t> chunk_size,
+      size_t chunk_idx = 0,
+      bool per_map = false)
     {
       // Set the execution dependency for the snapshot to be the version
       // previous to said snapshot to ensure that the correct snapshot is
       // serialized.
-      // Note: Snapshots are always taken at compacted state so version only is
-      // unique enough to prevent IV reuse
-      KvStoreSerialiser serialiser(encryptor, {0, version}, version - 1, true);
+      // Note: Snapshots are always taken at compacted state so version only
+      // is unique enough to prevent IV reuse for an unchunked snapshot (term
+      // 0). The chunks of a chunked snapshot (chunk_size set) instead use the
+      // layout of the chunks and their index as the term (see
+      // get_chunk_term()).
+      const Term chunk_term = chunk_size.has_value() ?
+        get_chunk_term(chunk_size.value(), chunk_idx, per_map) :
+        0;
+      return std::make_unique<KvStoreSerialiser>(
+        encryptor, TxID{chunk_term, version}, version - 1, true);
+    }
 
+    void serialise_header(KvStoreSerialiser& serialiser)
+    {
       if (hash_at_snapshot.has_value())
       {
         serialiser.serialise_raw(hash_at_snapshot.value());
@@ -57,19 +268,6 @@ namespace kv
       {
         serialiser.serialise_view_history(view_history.value());
       }
-
-      for (auto domain : {SecurityDomain::PUBLIC, SecurityDomain::PRIVATE})
-      {
-        for (const auto& it : snapshots)
-        {
-          if (it->get_security_domain() == domain)
-          {
-            it->serialise(serialiser);
-          }
-        }
-      }
-
-      return serialiser.get_raw_data();
     }
   };
-}
\ No newline at end of file
+}
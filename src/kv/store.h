@@ -6,6 +6,7 @@
 #include "deserialise.h"
 #include "ds/ccf_exception.h"
 #include "kv/committable_tx.h"
+#include "kv/pending_tx_ring.h"
 #include "kv_serialiser.h"
 #include "kv_types.h"
 #include "node/entities.h"
@@ -16,26 +17,129 @@
 #define FMT_HEADER_ONLY
 #include <fmt/format.h>
 
+#include <atomic>
+#include <limits>
+
 namespace kv
 {
+  // Dense index of a store's maps by MapId. Slots hold shared copies of
+  // entries, and are only written while holding the store's maps_lock, but
+  // may be read concurrently without it. A reader keeps the entry it was handed
+  // alive, even if the slot is cleared (eg - by a rollback) in the meantime.
+  // Slots are allocated in blocks which never move, each twice the size of the
+  // previous one, so the index can grow while it is being read and covers every
+  // MapId.
+  template <typename Entry>
+  class MapIndex
+  {
+  private:
+    using Slot = std::shared_ptr<const Entry>;
+
+    static constexpr size_t first_block_size = 256;
+    static constexpr size_t max_blocks = 25;
+    static_assert(
+      first_block_size * ((size_t(1) << max_blocks) - 1) >
+        std::numeric_limits<MapId>::max(),
+      "Blocks must cover every MapId");
+
+    std::array<std::atomic<Slot*>, max_blocks> blocks = {};
+
+    // Block b holds the first_block_size << b ids following those of the
+    // blocks before it
+    static std::pair<size_t, size_t> get_position(MapId id)
+    {
+      const size_t n = id / first_block_size + 1;
+      size_t b = 0;
+      while ((n >> (b + 1)) != 0)
+      {
+        ++b;
+      }
+      return {b, id - first_block_size * ((size_t(1) << b) - 1)};
+    }
+
+  public:
+    MapIndex() = default;
+    MapIndex(const MapIndex&) = delete;
+
+    ~MapIndex()
+    {
+      for (auto& block : blocks)
+      {
+        delete[] block.load();
+      }
+    }
+
+    std::shared_ptr<const Entry> get(MapId id) const
+    {
+      const auto [b, i] = get_position(id);
+      const auto block = blocks[b].load(std::memory_order_acquire);
+      if (block == nullptr)
+      {
+        return nullptr;
+      }
+
+      return std::atomic_load(&block[i]);
+    }
+
+    void set(MapId id, std::shared_ptr<const Entry> entry)
+    {
+      const auto [b, i] = get_position(id);
+      auto block = blocks[b].load(std::memory_order_relaxed);
+      if (block == nullptr)
+      {
+        if (entry == nullptr)
+        {
+          return;
+        }
+
+        block = new Slot[first_block_size << b];
+        blocks[b].store(block, std::memory_order_release);
+      }
+
+      std::atomic_store(&block[i], std::move(entry));
+    }
+
+    void clear()
+    {
+      for (size_t b = 0; b < max_blocks; ++b)
+      {
+        const auto block = blocks[b].load(std::memory_order_relaxed);
+        if (block != nullptr)
+        {
+          for (size_t i = 0; i < (first_block_size << b); ++i)
+          {
+            std::atomic_store(&block[i], Slot());
+          }
+        }
+      }
+    }
+  };
+
   class StoreState
   {
   protected:
     // All collections of Map must be ordered so that we lock their contained
     // maps in a stable order. The order here is by map name. The version
     // indicates the version at which the Map was created.
-    using Maps = std::
-      map<std::string, std::pair<kv::Version, std::shared_ptr<untyped::Map>>>;
+    using MapEntry = std::pair<kv::Version, std::shared_ptr<untyped::Map>>;
+    using Maps = std::map<std::string, MapEntry>;
     std::mutex maps_lock;
     Maps maps;
 
+    // Entries of maps, indexed by their MapId in this store (see
+    // Store::get_map_id). Updated alongside maps, so that transactions can
+    // find the maps they access without looking up names
+    MapIndex<MapEntry> maps_by_id;
+
     std::mutex version_lock;
     Version version = 0;
     Version last_new_map = kv::NoVersion;
     Version compacted = 0;
 
-    // Term at which write future transactions should be committed.
-    Term term_of_next_version = 0;
+    // Term at which write future transactions should be committed. Written
+    // under version_lock, but atomic so that committing transactions can check
+    // it without taking the lock.
+    std::atomic<Term> term_of_next_version = 0;
 
     // Term at which the last entry was committed. Further transactions
     // should read in that term. Note that it is assumed that the history of
@@ -47,8 +151,16 @@ namespace kv
     Version last_committable = 0;
     Version rollback_count = 0;
 
-    std::unordered_map<Version, std::pair<std::unique_ptr<PendingTx>, bool>>
-      pending_txs;
+    PendingTxRing pending_txs;
+
+    // Set while a thread is sequencing pending_txs. Any other committing
+    // thread then leaves its pending tx for that thread.
+    std::atomic<bool> sequencing = false;
+
+    // Held while pending transactions are called and appended to the history,
+    // in order. This does not block other transactions from being assigned a
+    // version, but prevents the store from being rolled back concurrently.
+    std::mutex commit_lock;
 
   public:
     void clear()
@@ -56,8 +168,9 @@ namespace kv
       std::lock_guard<std::mutex> mguard(maps_lock);
       std::lock_guard<std::mutex> vguard(version_lock);
 
+      maps_by_id.clear();
       maps.clear();
-      pending_txs.clear();
+      pending_txs.clear(1);
 
       version = 0;
       compacted = 0;
@@ -77,8 +190,12 @@ namespace kv
   private:
     using Hooks = std::map<std::string, kv::untyped::Map::CommitHook>;
     using MapHooks = std::map<std::string, kv::untyped::Map::MapHook>;
+    using MapIndexes = std::map<
+      std::string,
+      std::map<std::string, kv::untyped::Map::IndexExtractor>>;
     Hooks global_hooks;
     MapHooks map_hooks;
+    MapIndexes map_indexes;
 
     std::shared_ptr<Consensus> consensus = nullptr;
 
@@ -89,6 +206,9 @@ namespace kv
     kv::ReplicateType replicate_type = kv::ReplicateType::ALL;
     std::unordered_set<std::string> replicated_tables;
 
+    // Names of the maps which index their keys in order (see set_ordered)
+    std::unordered_set<std::string> ordered_maps;
+
     // Generally we will only accept deserialised views if they are contiguous -
     // at Version N we reject everything but N+1. The exception is when a Store
     // is used for historical queries, where it may deserialise arbitrary
@@ -99,6 +219,31 @@ namespace kv
     // If true, use historical ledger secrets to deserialise entries
     const bool is_historical = false;
 
+    // MapIds are tagged with the id of the store they were assigned by when
+    // they are cached in map instances, so that an instance used with several
+    // stores does not resolve to another store's maps
+    static constexpr size_t map_id_bits = 24;
+    static constexpr uint64_t max_tagged_map_id = (1ull << map_id_bits) - 1;
+    const uint64_t store_id = next_store_id();
+
+    static uint64_t next_store_id()
+    {
+      static std::atomic<uint64_t> next_id = 1;
+      return next_id++;
+    }
+
+    // Ids assigned to the names of the maps used with this store
+    std::mutex map_ids_lock;
+    std::unordered_map<std::string, MapId> map_ids;
+
+    MapId get_map_id(const std::string& map_name)
+    {
+      std::lock_guard<std::mutex> guard(map_ids_lock);
+      const auto [it, _] =
+        map_ids.emplace(map_name, static_cast<MapId>(map_ids.size()));
+      return it->second;
+    }
+
     bool commit_deserialised(
       OrderedChanges& changes,
       Version v,
@@ -120,6 +265,7 @@ namespace kv
         std::lock_guard<std::mutex> vguard(version_lock);
         version = v;
         last_replicated = version;
+        pending_txs.advance_to(last_replicated + 1);
         term_of_last_version = term;
       }
       return true;
@@ -159,6 +305,126 @@ namespace kv
       return {term_of_last_version, version};
     }
 
+    // Calls, appends to the history and replicates pending transactions in
+    // order, until none directly follows the last replicated one, which is
+    // then returned in next. Each pending transaction has already been
+    // serialised (and encrypted) by the thread that committed it. The version
+    // lock is only held for bookkeeping, so that other threads can keep
+    // executing and committing transactions meanwhile.
+    CommitResult sequence_pending_txs(
+      const std::shared_ptr<Consensus>& c, Version& next)
+    {
+      while (true)
+      {
+        BatchVector batch;
+        Version previous_last_replicated = 0;
+        Version next_last_replicated = 0;
+        Version previous_rollback_count = 0;
+        ccf::View replication_view = 0;
+
+        {
+          std::lock_guard<std::mutex> cguard(commit_lock);
+
+          {
+            std::lock_guard<std::mutex> vguard(version_lock);
+            next = last_replicated + 1;
+          }
+
+          auto ready = pending_txs.take_from(next);
+          if (ready.empty())
+          {
+            return CommitResult::SUCCESS;
+          }
+
+          auto h = get_history();
+          Version committable = 0;
+
+          // Entries are appended to the history in batches, so that they can
+          // be hashed together. Signatures read the root of the history, so
+          // every earlier entry must be appended before they are called.
+          std::vector<TxHistory::Entry> unappended;
+          auto append_entries = [&h, &unappended]() {
+            if (h && !unappended.empty())
+            {
+              h->append_entries(unappended);
+            }
+            unappended.clear();
+          };
+
+          for (auto& [version_, pending_tx_, committable_] : ready)
+          {
+            if (committable_)
+            {
+              append_entries();
+            }
+
+            auto [success_, data_, hooks_, digest_] = pending_tx_->call();
+            auto data_shared =
+              std::make_shared<std::vector<uint8_t>>(std::move(data_));
+            auto hooks_shared =
+              std::make_shared<kv::ConsensusHookPtrs>(std::move(hooks_));
+
+            // NB: this cannot happen currently. Regular Tx only make it here
+            // if they did succeed, and signatures cannot conflict because
+            // they execute in order with a read_version that's version - 1,
+            // so even two contiguous signatures are fine
+            if (success_ != CommitResult::SUCCESS)
+            {
+              LOG_DEBUG_FMT("Failed Tx commit {}", version_);
+            }
+
+            unappended.push_back({data_shared, digest_});
+
+            LOG_DEBUG_FMT("Batching {} ({})", version_, data_shared->size());
+
+            if (committable_)
+            {
+              committable = version_;
+            }
+
+            batch.emplace_back(
+              version_, data_shared, committable_, hooks_shared);
+          }
+          append_entries();
+
+          std::lock_guard<std::mutex> vguard(version_lock);
+          if (committable > last_committable)
+          {
+            last_committable = committable;
+          }
+
+          previous_rollback_count = rollback_count;
+          previous_last_replicated = last_replicated;
+          next_last_replicated = last_replicated + batch.size();
+          next = next_last_replicated + 1;
+
+          replication_view = term_of_next_version;
+
+          if (c->type() == ConsensusType::BFT && c->is_backup())
+          {
+            last_replicated = next_last_replicated;
+          }
+        }
+
+        if (c->replicate(batch, replication_view))
+        {
+          std::lock_guard<std::mutex> vguard(version_lock);
+          if (
+            last_replicated == previous_last_replicated &&
+            previous_rollback_count == rollback_count &&
+            !(c->type() == ConsensusType::BFT && c->is_backup()))
+          {
+            last_replicated = next_last_replicated;
+          }
+        }
+        else
+        {
+          LOG_DEBUG_FMT("Failed to replicate");
+          return CommitResult::FAIL_NO_REPLICATE;
+        }
+      }
+    }
+
   public:
     Store(bool strict_versions_ = true, bool is_historical_ = false) :
       strict_versions(strict_versions_),
@@ -236,17 +502,71 @@ namespace kv
       return get_map_internal(v, map_name);
     }
 
+    /** Get a map by its id, falling back to its name if the map is not
+     * indexed.
+     *
+     * @param v Version at which the map must exist
+     * @param map_id Id of requested map, from get_map_id
+     * @param map_name Name of requested map
+     *
+     * @return Abstract shared-owning pointer to requested map, or nullptr if no
+     * such map exists
+     */
+    std::shared_ptr<AbstractMap> get_map(
+      kv::Version v, MapId map_id, const std::string& map_name) override
+    {
+      const auto entry = maps_by_id.get(map_id);
+      if (entry != nullptr)
+      {
+        return get_map_at_version(v, *entry);
+      }
+
+      return get_map_internal(v, map_name);
+    }
+
+    /** Get the id of a map in this store, assigning one to its name if it has
+     * none yet. The id is cached in the map instance, so that later calls
+     * with the same instance do not look up its name.
+     *
+     * @param m Map instance
+     *
+     * @return Id of the map named by @p m in this store
+     */
+    MapId get_map_id(const NamedHandleMixin& m) override
+    {
+      const auto tagged = m.get_tagged_map_id();
+      if ((tagged >> map_id_bits) == store_id)
+      {
+        return static_cast<MapId>(tagged & max_tagged_map_id);
+      }
+
+      const auto map_id = get_map_id(m.get_name());
+      if (map_id <= max_tagged_map_id)
+      {
+        m.set_tagged_map_id((store_id << map_id_bits) | map_id);
+      }
+      return map_id;
+    }
+
     std::shared_ptr<kv::untyped::Map> get_map_internal(
       kv::Version v, const std::string& map_name)
     {
       auto search = maps.find(map_name);
       if (search != maps.end())
       {
-        const auto& [map_creation_version, map_ptr] = search->second;
-        if (v >= map_creation_version || map_creation_version == NoVersion)
-        {
-          return map_ptr;
-        }
+        return get_map_at_version(v, search->second);
+      }
+
+      return nullptr;
+    }
+
+    std::shared_ptr<kv::untyped::Map> get_map_at_version(
+      kv::Version v, const MapEntry& entry)
+    {
+      const auto& [map_creation_version, map_ptr] = entry;
+      if (v >= map_creation_version || map_creation_version == NoVersion)
+      {
+        return map_ptr;
       }
 
       return nullptr;
@@ -281,7 +601,10 @@ namespace kv
       }
 
       LOG_DEBUG_FMT("Adding newly created map '{}' at version {}", map_name, v);
-      maps[map_name] = std::make_pair(v, map);
+      auto& entry = maps[map_name];
+      entry = std::make_pair(v, map);
+      maps_by_id.set(
+        get_map_id(map_name), std::make_shared<const MapEntry>(entry));
 
       {
         // If we have any hooks for the given map name, set them on this new map
@@ -296,6 +619,15 @@ namespace kv
         {
           map->set_map_hook(map_it->second);
         }
+
+        const auto indexes_it = map_indexes.find(map_name);
+        if (indexes_it != map_indexes.end())
+        {
+          for (const auto& [index_name, extractor] : indexes_it->second)
+          {
+            map->set_index(index_name, extractor);
+          }
+        }
       }
     }
 
@@ -325,6 +657,11 @@ namespace kv
       }
     }
 
+    bool is_map_ordered(const std::string& name) override
+    {
+      return ordered_maps.find(name) != ordered_maps.end();
+    }
+
     bool should_track_dependencies(const std::string& name) override
     {
       return name.compare(ccf::Tables::AFT_REQUESTS) != 0;
@@ -397,140 +734,286 @@ namespace kv
       return snapshot->serialise(e);
     }
 
-    ApplyResult deserialise_snapshot(
-      const std::vector<uint8_t>& data,
-      kv::ConsensusHookPtrs& hooks,
-      std::vector<Version>* view_history = nullptr,
-      bool public_only = false) override
+    void serialise_snapshot_chunks(
+      std::unique_ptr<AbstractSnapshot> snapshot,
+      size_t chunk_size,
+      const SnapshotChunkWriter& write_chunk) override
     {
       auto e = get_encryptor();
-      auto d = KvStoreDeserialiser(
-        e,
-        public_only ? kv::SecurityDomain::PUBLIC :
-                      std::optional<kv::SecurityDomain>());
-
-      kv::Term term;
-      auto v_ = d.init(data.data(), data.size(), term, is_historical);
-      if (!v_.has_value())
-      {
-        LOG_FAIL_FMT("Initialisation of deserialise object failed");
-        return ApplyResult::FAIL;
-      }
-      auto [v, _] = v_.value();
+      snapshot->serialise_chunks(e, chunk_size, write_chunk);
+    }
 
-      std::lock_guard<std::mutex> mguard(maps_lock);
+    /** Applies the chunks of a snapshot (see
+     * StoreSnapshot::serialise_chunks()) one at a time, as they become
+     * available, so that the serialised snapshot does not have to be held in
+     * memory as a whole. The deserialised state is only committed to the
+     * store by finish(), once all chunks have been applied.
+     */
+    class SnapshotLoader
+    {
+    private:
+      Store& store;
+      std::vector<Version>* view_history;
+      const bool public_only;
 
-      for (auto& it : maps)
-      {
-        auto& [_, map] = it.second;
-        map->lock();
-      }
+      EncryptorPtr e;
+      std::shared_ptr<TxHistory> h;
 
+      std::optional<Version> v = std::nullopt;
       std::vector<uint8_t> hash_at_snapshot;
-      auto h = get_history();
-      if (h)
-      {
-        hash_at_snapshot = d.deserialise_raw();
-      }
-
       std::vector<Version> view_history_;
-      if (view_history)
-      {
-        view_history_ = d.deserialise_view_history();
-      }
 
       OrderedChanges changes;
       MapCollection new_maps;
 
-      for (auto r = d.start_map(); r.has_value(); r = d.start_map())
-      {
-        const auto map_name = r.value();
+      // Name of the last map deserialised, whose snapshot may continue in
+      // the next chunk
+      std::optional<std::string> last_map_name = std::nullopt;
+      bool failed = false;
 
-        std::shared_ptr<kv::untyped::Map> map = nullptr;
+      bool deserialise_chunk(const uint8_t* data, size_t size)
+      {
+        auto d = KvStoreDeserialiser(
+          e,
+          public_only ? kv::SecurityDomain::PUBLIC :
+                        std::optional<kv::SecurityDomain>());
+
+        kv::Term term;
+        auto chunk_v = d.init(data, size, term, store.is_historical);
+        if (!chunk_v.has_value())
+        {
+          LOG_FAIL_FMT("Initialisation of deserialise object failed");
+          return false;
+        }
+        auto [chunk_version, _] = chunk_v.value();
 
-        auto search = maps.find(map_name);
-        if (search == maps.end())
+        if (!v.has_value())
         {
-          map = std::make_shared<kv::untyped::Map>(
-            this,
-            map_name,
-            get_security_domain(map_name),
-            is_map_replicated(map_name),
-            should_track_dependencies(map_name));
-          new_maps[map_name] = map;
-          LOG_DEBUG_FMT(
-            "Creating map {} while deserialising snapshot at version {}",
-            map_name,
-            v);
+          v = chunk_version;
+
+          if (h)
+          {
+            hash_at_snapshot = d.deserialise_raw();
+          }
+
+          if (view_history)
+          {
+            view_history_ = d.deserialise_view_history();
+          }
         }
-        else
+        else if (chunk_version != v.value())
         {
-          map = search->second.second;
+          LOG_FAIL_FMT(
+            "Snapshot chunk at version {} does not match snapshot version {}",
+            chunk_version,
+            v.value());
+          return false;
         }
 
-        auto changes_search = changes.find(map_name);
-        if (changes_search != changes.end())
+        for (auto r = d.start_map(); r.has_value(); r = d.start_map())
         {
-          LOG_FAIL_FMT("Failed to deserialise snapshot at version {}", v);
-          LOG_DEBUG_FMT("Multiple writes on map {}", map_name);
-          return ApplyResult::FAIL;
+          const auto map_name = r.value();
+
+          auto changes_search = changes.find(map_name);
+          if (changes_search != changes.end())
+          {
+            // Only the segments of a single map may follow each other
+            if (map_name != last_map_name)
+            {
+              LOG_FAIL_FMT(
+                "Failed to deserialise snapshot at version {}", v.value());
+              LOG_DEBUG_FMT("Multiple writes on map {}", map_name);
+              return false;
+            }
+
+            auto& [map, changeset] = changes_search->second;
+            changeset = std::dynamic_pointer_cast<kv::untyped::Map>(map)
+                          ->deserialise_snapshot_changes(d, changeset.get());
+            continue;
+          }
+
+          std::shared_ptr<kv::untyped::Map> map = nullptr;
+
+          auto search = store.maps.find(map_name);
+          if (search == store.maps.end())
+          {
+            map = std::make_shared<kv::untyped::Map>(
+              &store,
+              map_name,
+              get_security_domain(map_name),
+              store.is_map_replicated(map_name),
+              store.should_track_dependencies(map_name),
+              store.is_map_ordered(map_name));
+            new_maps[map_name] = map;
+            LOG_DEBUG_FMT(
+              "Creating map {} while deserialising snapshot at version {}",
+              map_name,
+              v.value());
+          }
+          else
+          {
+            map = search->second.second;
+          }
+
+          auto deserialised_snapshot_changes =
+            map->deserialise_snapshot_changes(d);
+
+          // Take ownership of the produced change set, store it to be
+          // committed later
+          changes[map_name] = {map, std::move(deserialised_snapshot_changes)};
+
+          last_map_name = map_name;
         }
 
-        auto deserialised_snapshot_changes =
-          map->deserialise_snapshot_changes(d);
+        if (!d.end())
+        {
+          LOG_FAIL_FMT(
+            "Unexpected content in snapshot at version {}", v.value());
+          return false;
+        }
 
-        // Take ownership of the produced change set, store it to be committed
-        // later
-        changes[map_name] = {map, std::move(deserialised_snapshot_changes)};
+        return true;
       }
 
-      for (auto& it : maps)
+    public:
+      /** If @p view_history_ is set, the view history recorded in the
+       * snapshot is written to it once the snapshot is applied. If
+       * @p public_only_ is true, only public maps are deserialised.
+       */
+      SnapshotLoader(
+        Store& store_,
+        std::vector<Version>* view_history_ = nullptr,
+        bool public_only_ = false) :
+        store(store_),
+        view_history(view_history_),
+        public_only(public_only_),
+        e(store_.get_encryptor()),
+        h(store_.get_history())
+      {}
+
+      /** Deserialises the next chunk of the snapshot, which should be exactly
+       * @p size bytes long. Returns false if the chunk is invalid, in which
+       * case the snapshot cannot be applied.
+       */
+      bool load_chunk(const uint8_t* data, size_t size)
       {
-        auto& [_, map] = it.second;
-        map->unlock();
-      }
+        if (failed)
+        {
+          return false;
+        }
 
-      if (!d.end())
-      {
-        LOG_FAIL_FMT("Unexpected content in snapshot at version {}", v);
-        return ApplyResult::FAIL;
-      }
+        std::lock_guard<std::mutex> mguard(store.maps_lock);
 
-      // Each map is committed at a different version, independently of the
-      // overall snapshot version. The commit versions for each map are
-      // contained in the snapshot and applied when the snapshot is committed.
-      auto r = apply_changes(
-        changes,
-        [](bool) { return std::make_tuple(NoVersion, NoVersion); },
-        hooks,
-        new_maps);
-      if (!r.has_value())
-      {
-        LOG_FAIL_FMT("Failed to commit deserialised snapshot at version {}", v);
-        return ApplyResult::FAIL;
+        for (auto& it : store.maps)
+        {
+          auto& [_, map] = it.second;
+          map->lock();
+        }
+
+        failed = !deserialise_chunk(data, size);
+
+        for (auto& it : store.maps)
+        {
+          auto& [_, map] = it.second;
+          map->unlock();
+        }
+
+        return !failed;
       }
 
+      std::optional<Version> get_version() const
       {
-        std::lock_guard<std::mutex> vguard(version_lock);
-        version = v;
-        last_replicated = v;
-        last_committable = v;
+        return v;
       }
 
-      if (h)
+      /** Commits the state deserialised from all the chunks loaded so far to
+       * the store.
+       */
+      ApplyResult finish(kv::ConsensusHookPtrs& hooks)
       {
-        if (!h->init_from_snapshot(hash_at_snapshot))
+        if (failed || !v.has_value())
+        {
+          return ApplyResult::FAIL;
+        }
+
+        // Each map is committed at a different version, independently of the
+        // overall snapshot version. The commit versions for each map are
+        // contained in the snapshot and applied when the snapshot is
+        // committed.
+        auto r = apply_changes(
+          changes,
+          [](bool) { return std::make_tuple(NoVersion, NoVersion); },
+          hooks,
+          new_maps);
+        if (!r.has_value())
         {
+          LOG_FAIL_FMT(
+            "Failed to commit deserialised snapshot at version {}", v.value());
           return ApplyResult::FAIL;
         }
+
+        {
+          std::lock_guard<std::mutex> vguard(store.version_lock);
+          store.version = v.value();
+          store.last_replicated = v.value();
+          store.pending_txs.advance_to(store.last_replicated + 1);
+          store.last_committable = v.value();
+        }
+
+        if (h)
+        {
+          if (!h->init_from_snapshot(hash_at_snapshot))
+          {
+            return ApplyResult::FAIL;
+          }
+        }
+
+        if (view_history)
+        {
+          *view_history = std::move(view_history_);
+        }
+
+        return ApplyResult::PASS;
       }
+    };
 
-      if (view_history)
+    ApplyResult deserialise_snapshot(
+      const std::vector<uint8_t>& data,
+      kv::ConsensusHookPtrs& hooks,
+      std::vector<Version>* view_history = nullptr,
+      bool public_only = false) override
+    {
+      // The snapshot may be made of several chunks (see
+      // StoreSnapshot::serialise_chunks()), which are decrypted and
+      // deserialised one at a time
+      SnapshotLoader loader(*this, view_history, public_only);
+
+      auto data_ = data.data();
+      auto size_ = data.size();
+      while (size_ > 0)
       {
-        *view_history = std::move(view_history_);
+        const auto chunk_header =
+          serialized::peek<SerialisedEntryHeader>(data_, size_);
+        const auto chunk_size =
+          serialised_entry_header_size + chunk_header.size;
+        if (chunk_size > size_)
+        {
+          LOG_FAIL_FMT(
+            "Snapshot chunk of size {} exceeds remaining snapshot size {}",
+            chunk_size,
+            size_);
+          return ApplyResult::FAIL;
+        }
+
+        if (!loader.load_chunk(data_, chunk_size))
+        {
+          return ApplyResult::FAIL;
+        }
+
+        serialized::skip(data_, size_, chunk_size);
       }
 
-      return ApplyResult::PASS;
+      return loader.finish(hooks);
     }
 
     void compact(Version v) override
@@ -587,6 +1070,7 @@ namespace kv
       // at the specified version.
       // No transactions can be prepared or committed during rollback.
       std::lock_guard<std::mutex> mguard(maps_lock);
+      std::lock_guard<std::mutex> cguard(commit_lock);
 
       {
         std::lock_guard<std::mutex> vguard(version_lock);
@@ -620,7 +1104,7 @@ namespace kv
         last_replicated = tx_id.version;
         last_committable = tx_id.version;
         rollback_count++;
-        pending_txs.clear();
+        pending_txs.clear(tx_id.version + 1);
         auto e = get_encryptor();
         if (e)
         {
@@ -646,6 +1130,7 @@ namespace kv
           // Map was created more recently; its creation is being forgotten.
           // Erase our knowledge of it
           map->unlock();
+          maps_by_id.set(get_map_id(map->get_name()), nullptr);
           it = maps.erase(it);
         }
         else
@@ -688,26 +1173,42 @@ namespace kv
       OrderedChanges& changes,
       MapCollection& new_maps,
       bool ignore_strict_versions = false) override
+    {
+      auto entry = decrypt_entry_internal(data, public_only, is_historical);
+      if (!entry.has_value())
+      {
+        LOG_FAIL_FMT("Initialisation of deserialise object failed");
+        return false;
+      }
+      v = entry->v;
+      max_conflict_version = entry->max_conflict_version;
+      view = entry->view;
+
+      return fill_maps(entry.value(), changes, new_maps, ignore_strict_versions);
+    }
+
+    std::optional<DecryptedEntry> decrypt_entry(
+      const std::vector<uint8_t>& data, bool public_only) override
+    {
+      // Entries may be decrypted out of order here, so always look up the
+      // ledger secret for the entry's version rather than starting from the
+      // last secret used
+      return decrypt_entry_internal(data, public_only, true);
+    }
+
+    bool fill_maps(
+      DecryptedEntry& entry,
+      OrderedChanges& changes,
+      MapCollection& new_maps,
+      bool ignore_strict_versions = false) override
     {
       // This will return FAILED if the serialised transaction is being
       // applied out of order.
       // Processing transactions locally and also deserialising to the
       // same store will result in a store version mismatch and
       // deserialisation will then fail.
-      auto e = get_encryptor();
-
-      auto d = KvStoreDeserialiser(
-        e,
-        public_only ? kv::SecurityDomain::PUBLIC :
-                      std::optional<kv::SecurityDomain>());
-
-      auto v_ = d.init(data.data(), data.size(), view, is_historical);
-      if (!v_.has_value())
-      {
-        LOG_FAIL_FMT("Initialisation of deserialise object failed");
-        return false;
-      }
-      std::tie(v, max_conflict_version) = v_.value();
+      auto& d = *entry.d;
+      const auto v = entry.v;
 
       // Throw away any local commits that have not propagated via the
       // consensus.
@@ -743,7 +1244,8 @@ namespace kv
             map_name,
             get_security_domain(map_name),
             is_map_replicated(map_name),
-            should_track_dependencies(map_name));
+            should_track_dependencies(map_name),
+            is_map_ordered(map_name));
           map = new_map;
           new_maps[map_name] = new_map;
           LOG_DEBUG_FMT(
@@ -776,6 +1278,25 @@ namespace kv
       return true;
     }
 
+    std::optional<DecryptedEntry> decrypt_entry_internal(
+      const std::vector<uint8_t>& data, bool public_only, bool historical_hint)
+    {
+      auto d = std::make_unique<KvStoreDeserialiser>(
+        get_encryptor(),
+        public_only ? kv::SecurityDomain::PUBLIC :
+                      std::optional<kv::SecurityDomain>());
+
+      kv::Term view;
+      auto v_ = d->init(data.data(), data.size(), view, historical_hint);
+      if (!v_.has_value())
+      {
+        return std::nullopt;
+      }
+
+      auto [v, max_conflict_version] = v_.value();
+      return DecryptedEntry{std::move(d), v, max_conflict_version, view};
+    }
+
     std::unique_ptr<kv::AbstractExecutionWrapper> deserialize(
       const std::vector<uint8_t>& data,
       ConsensusType consensus_type,
@@ -990,109 +1511,67 @@ namespace kv
         txid.version,
         (globally_committable ? " globally_committable" : ""));
 
-      BatchVector batch;
-      Version previous_last_replicated = 0;
-      Version next_last_replicated = 0;
-      Version previous_rollback_count = 0;
-      ccf::View replication_view = 0;
-
+      // The epoch is read before the term is checked, so that if the store is
+      // rolled back after the check, this transaction is dropped rather than
+      // sequenced.
+      const auto epoch = pending_txs.get_epoch();
+      if (txid.term != term_of_next_version && c->is_primary())
       {
-        std::lock_guard<std::mutex> vguard(version_lock);
-        if (txid.term != term_of_next_version && consensus->is_primary())
-        {
-          // This can happen when a transaction started before a view change,
-          // but tries to commit after the view change is complete.
-          LOG_DEBUG_FMT(
-            "Want to commit for term {} but term is {}",
-            txid.term,
-            term_of_next_version);
+        // This can happen when a transaction started before a view change,
+        // but tries to commit after the view change is complete.
+        LOG_DEBUG_FMT(
+          "Want to commit for term {} but term is {}",
+          txid.term,
+          term_of_next_version.load());
 
-          return CommitResult::FAIL_NO_REPLICATE;
-        }
-
-        if (globally_committable && txid.version > last_committable)
-        {
-          last_committable = txid.version;
-        }
-
-        pending_txs.insert(
-          {txid.version,
-           std::make_pair(std::move(pending_tx), globally_committable)});
-
-        auto h = get_history();
-        auto c = get_consensus();
-
-        for (Version offset = 1; true; ++offset)
-        {
-          auto search = pending_txs.find(last_replicated + offset);
-          if (search == pending_txs.end())
-          {
-            break;
-          }
+        return CommitResult::FAIL_NO_REPLICATE;
+      }
 
-          auto& [pending_tx_, committable_] = search->second;
-          auto [success_, data_, hooks_] = pending_tx_->call();
-          auto data_shared =
-            std::make_shared<std::vector<uint8_t>>(std::move(data_));
-          auto hooks_shared =
-            std::make_shared<kv::ConsensusHookPtrs>(std::move(hooks_));
-
-          // NB: this cannot happen currently. Regular Tx only make it here if
-          // they did succeed, and signatures cannot conflict because they
-          // execute in order with a read_version that's version - 1, so even
-          // two contiguous signatures are fine
-          if (success_ != CommitResult::SUCCESS)
+      // The next version to be sequenced may be that of an async signature,
+      // waiting to be signed by a thread which is itself waiting for the ring.
+      // A committer waiting for the ring then signs it instead.
+      pending_txs.publish(
+        txid.version,
+        epoch,
+        std::move(pending_tx),
+        globally_committable,
+        [this]() {
+          auto h = get_history();
+          if (h != nullptr)
           {
-            LOG_DEBUG_FMT("Failed Tx commit {}", last_replicated + offset);
+            h->sign_frozen_signature();
           }
+        });
 
-          if (h)
+      // If another thread is sequencing, it takes this transaction. Otherwise
+      // this thread sequences pending transactions until none is ready. A
+      // transaction may be published after the sequencing thread last looked
+      // for one, but before it resets sequencing, so it checks again after.
+      while (!sequencing.exchange(true))
+      {
+        Version next = 0;
+        try
+        {
+          const auto result = sequence_pending_txs(c, next);
+          sequencing.store(false);
+          if (result != CommitResult::SUCCESS)
           {
-            h->append(*data_shared);
+            return result;
           }
-
-          LOG_DEBUG_FMT(
-            "Batching {} ({})", last_replicated + offset, data_shared->size());
-
-          batch.emplace_back(
-            last_replicated + offset, data_shared, committable_, hooks_shared);
-          pending_txs.erase(search);
         }
-
-        if (batch.size() == 0)
+        catch (...)
         {
-          return CommitResult::SUCCESS;
+          sequencing.store(false);
+          throw;
         }
 
-        previous_rollback_count = rollback_count;
-        previous_last_replicated = last_replicated;
-        next_last_replicated = last_replicated + batch.size();
-
-        replication_view = term_of_next_version;
-
-        if (consensus->type() == ConsensusType::BFT && consensus->is_backup())
+        if (!pending_txs.is_ready(next))
         {
-          last_replicated = next_last_replicated;
+          break;
         }
       }
 
-      if (c->replicate(batch, replication_view))
-      {
-        std::lock_guard<std::mutex> vguard(version_lock);
-        if (
-          last_replicated == previous_last_replicated &&
-          previous_rollback_count == rollback_count &&
-          !(consensus->type() == ConsensusType::BFT && consensus->is_backup()))
-        {
-          last_replicated = next_last_replicated;
-        }
-        return CommitResult::SUCCESS;
-      }
-      else
-      {
-        LOG_DEBUG_FMT("Failed to replicate");
-        return CommitResult::FAIL_NO_REPLICATE;
-      }
+      return CommitResult::SUCCESS;
     }
 
     void lock() override
@@ -1204,9 +1683,22 @@ namespace kv
               name,
               SecurityDomain::PRIVATE,
               is_map_replicated(name),
-              should_track_dependencies(name)));
+              should_track_dependencies(name),
+              is_map_ordered(name)));
           maps[name] = new_map;
+          maps_by_id.set(
+            get_map_id(name),
+            std::make_shared<const StoreState::MapEntry>(new_map));
           map = new_map.second;
+
+          const auto indexes_it = map_indexes.find(name);
+          if (indexes_it != map_indexes.end())
+          {
+            for (const auto& [index_name, extractor] : indexes_it->second)
+            {
+              new_map.second->set_index(index_name, extractor);
+            }
+          }
         }
         else
         {
@@ -1259,6 +1751,60 @@ namespace kv
       }
     }
 
+    /** Declares the map @p map_name as ordered: it additionally indexes its
+     * keys in (serialised) key order, so that the @c range, @c lower_bound and
+     * @c foreach_prefix methods of its handles visit only the keys they
+     * return, and its snapshots are serialised in key order. This is fixed
+     * when the map is created, so it must be declared before then, as all
+     * nodes should.
+     */
+    void set_ordered(const std::string& map_name)
+    {
+      std::lock_guard<std::mutex> mguard(maps_lock);
+      const auto it = maps.find(map_name);
+      if (it != maps.end() && !is_map_ordered(map_name))
+      {
+        throw std::logic_error(fmt::format(
+          "Cannot declare map {} as ordered after it has been created",
+          map_name));
+      }
+
+      ordered_maps.insert(map_name);
+    }
+
+    void set_index(
+      const std::string& map_name,
+      const std::string& index_name,
+      const kv::untyped::Map::IndexExtractor& extractor)
+    {
+      std::lock_guard<std::mutex> mguard(maps_lock);
+      map_indexes[map_name][index_name] = extractor;
+
+      const auto it = maps.find(map_name);
+      if (it != maps.end())
+      {
+        auto& map = it->second.second;
+        map->lock();
+        map->set_index(index_name, extractor);
+        map->unlock();
+      }
+    }
+
+    void unset_index(const std::string& map_name, const std::string& index_name)
+    {
+      std::lock_guard<std::mutex> mguard(maps_lock);
+      map_indexes[map_name].erase(index_name);
+
+      const auto it = maps.find(map_name);
+      if (it != maps.end())
+      {
+        auto& map = it->second.second;
+        map->lock();
+        map->unset_index(index_name);
+        map->unlock();
+      }
+    }
+
     void set_global_hook(
       const std::string& map_name, const kv::untyped::Map::CommitHook& hook)
     {
@@ -1294,8 +1840,8 @@ namespace kv
 
     ReservedTx create_reserved_tx(const TxID& tx_id)
     {
-      // version_lock should already been acquired in case term_of_last_version
-      // is incremented.
+      // Must lock in case term_of_last_version is being incremented.
+      std::lock_guard<std::mutex> vguard(version_lock);
       return ReservedTx(this, term_of_last_version, tx_id);
     }
   };
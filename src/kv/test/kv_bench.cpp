@@ -8,7 +8,9 @@
 
 #include <msgpack/msgpack.hpp>
 #include <picobench/picobench.hpp>
+#include <random>
 #include <string>
+#include <thread>
 
 using KeyType = kv::serialisers::SerialisedEntry;
 using ValueType = kv::serialisers::SerialisedEntry;
@@ -167,6 +169,91 @@ static void commit_latency(picobench::state& s)
   s.stop_timer();
 }
 
+// Each thread commits transactions which increment a few keys of a single
+// map, either from a range of keys of its own (disjoint) or from a small range
+// shared by all threads (overlapping), retrying those which conflict
+static void commit_throughput(
+  picobench::state& s, size_t thread_count, bool disjoint)
+{
+  logger::config::level() = logger::INFO;
+
+  constexpr size_t keys_per_tx = 4;
+  constexpr size_t keys_per_thread = 1024;
+  constexpr size_t overlapping_keys = 16;
+  constexpr size_t compaction_interval = 100;
+
+  kv::Store kv_store;
+  kv::Map<size_t, size_t> map("public:accounts");
+  const size_t tx_per_thread = s.iterations() / thread_count;
+
+  auto thread_fn = [&](size_t thread_idx) {
+    std::mt19937 rng(thread_idx);
+    for (size_t i = 0; i < tx_per_thread; ++i)
+    {
+      std::vector<size_t> keys;
+      for (size_t j = 0; j < keys_per_tx; ++j)
+      {
+        keys.push_back(
+          disjoint ? thread_idx * keys_per_thread + rng() % keys_per_thread :
+                     rng() % overlapping_keys);
+      }
+
+      while (true)
+      {
+        try
+        {
+          auto tx = kv_store.create_tx();
+          auto h = tx.rw(map);
+          for (const auto k : keys)
+          {
+            h->put(k, h->get(k).value_or(0) + 1);
+          }
+
+          if (tx.commit() == kv::CommitResult::SUCCESS)
+          {
+            break;
+          }
+        }
+        catch (const kv::CompactedVersionConflict& e)
+        {
+          // Retry on conflict
+        }
+      }
+
+      // Compact regularly, so that throughput does not depend on the number
+      // of previous transactions
+      if (i % compaction_interval == 0)
+      {
+        kv_store.compact(kv_store.current_version());
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  s.start_timer();
+  for (size_t i = 0; i < thread_count; ++i)
+  {
+    threads.emplace_back(thread_fn, i);
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+  s.stop_timer();
+}
+
+template <size_t THREADS>
+static void commit_throughput_disjoint(picobench::state& s)
+{
+  commit_throughput(s, THREADS, true);
+}
+
+template <size_t THREADS>
+static void commit_throughput_overlapping(picobench::state& s)
+{
+  commit_throughput(s, THREADS, false);
+}
+
 template <size_t KEY_COUNT>
 static void ser_snap(picobench::state& s)
 {
@@ -247,6 +334,39 @@ PICOBENCH_SUITE("commit_latency");
 PICOBENCH(commit_latency<10>).iterations(tx_count).samples(10).baseline();
 PICOBENCH(commit_latency<100>).iterations(tx_count).samples(10);
 
+const std::vector<int> contended_tx_count = {800, 8000};
+const uint32_t contended_sample_size = 10;
+
+PICOBENCH_SUITE("commit_throughput_disjoint");
+PICOBENCH(commit_throughput_disjoint<1>)
+  .iterations(contended_tx_count)
+  .samples(contended_sample_size)
+  .baseline();
+PICOBENCH(commit_throughput_disjoint<2>)
+  .iterations(contended_tx_count)
+  .samples(contended_sample_size);
+PICOBENCH(commit_throughput_disjoint<4>)
+  .iterations(contended_tx_count)
+  .samples(contended_sample_size);
+PICOBENCH(commit_throughput_disjoint<8>)
+  .iterations(contended_tx_count)
+  .samples(contended_sample_size);
+
+PICOBENCH_SUITE("commit_throughput_overlapping");
+PICOBENCH(commit_throughput_overlapping<1>)
+  .iterations(contended_tx_count)
+  .samples(contended_sample_size)
+  .baseline();
+PICOBENCH(commit_throughput_overlapping<2>)
+  .iterations(contended_tx_count)
+  .samples(contended_sample_size);
+PICOBENCH(commit_throughput_overlapping<4>)
+  .iterations(contended_tx_count)
+  .samples(contended_sample_size);
+PICOBENCH(commit_throughput_overlapping<8>)
+  .iterations(contended_tx_count)
+  .samples(contended_sample_size);
+
 PICOBENCH_SUITE("serialise");
 PICOBENCH(serialise<SD::PUBLIC>)
   .iterations(tx_count)
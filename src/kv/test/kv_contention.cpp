@@ -3,12 +3,14 @@
 #include "ds/logger.h"
 #include "kv/kv_serialiser.h"
 #include "kv/store.h"
+#include "kv/test/stub_consensus.h"
 
 #include <atomic>
 #include <chrono>
 #define DOCTEST_CONFIG_NO_SHORT_MACRO_NAMES
 
 #include <doctest/doctest.h>
+#include <random>
 #include <string>
 #include <thread>
 #include <vector>
@@ -209,6 +211,136 @@ DOCTEST_TEST_CASE("Concurrent kv access" * doctest::test_suite("concurrency"))
   }
 }
 
+DOCTEST_TEST_CASE(
+  "Concurrent increments on a single map are not lost" *
+  doctest::test_suite("concurrency"))
+{
+  // Each thread commits transactions which increment a few keys of a single
+  // map, either from a range of keys of its own (disjoint) or from a small
+  // range shared by all threads (overlapping), retrying those which conflict.
+  // Throughput is measured by the commit_throughput benchmarks.
+  using MapType = kv::Map<size_t, size_t>;
+
+  constexpr size_t thread_count = 4;
+  constexpr size_t tx_count = 500;
+  constexpr size_t keys_per_tx = 4;
+  constexpr size_t keys_per_thread = 1024;
+  constexpr size_t overlapping_keys = 16;
+  constexpr size_t compaction_interval = 100;
+
+  for (const auto disjoint : {true, false})
+  {
+    kv::Store kv_store;
+    MapType map("public:accounts");
+
+    auto thread_fn = [&](size_t thread_idx) {
+      std::mt19937 rng(thread_idx);
+      for (size_t i = 0; i < tx_count; ++i)
+      {
+        std::vector<size_t> keys;
+        for (size_t j = 0; j < keys_per_tx; ++j)
+        {
+          keys.push_back(
+            disjoint ? thread_idx * keys_per_thread + rng() % keys_per_thread :
+                       rng() % overlapping_keys);
+        }
+
+        while (true)
+        {
+          try
+          {
+            auto tx = kv_store.create_tx();
+            auto h = tx.rw(map);
+            for (const auto k : keys)
+            {
+              h->put(k, h->get(k).value_or(0) + 1);
+            }
+
+            if (tx.commit() == kv::CommitResult::SUCCESS)
+            {
+              break;
+            }
+          }
+          catch (const kv::CompactedVersionConflict& e)
+          {
+            // Retry on conflict
+          }
+        }
+
+        if (i % compaction_interval == 0)
+        {
+          kv_store.compact(kv_store.current_version());
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+      threads.emplace_back(thread_fn, i);
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+
+    auto tx = kv_store.create_tx();
+    auto h = tx.ro(map);
+    size_t total = 0;
+    h->foreach([&total](const auto&, const auto& v) {
+      total += v;
+      return true;
+    });
+    DOCTEST_REQUIRE(total == thread_count * tx_count * keys_per_tx);
+    DOCTEST_REQUIRE(kv_store.current_version() == thread_count * tx_count);
+  }
+}
+
+DOCTEST_TEST_CASE(
+  "Concurrent commits are replicated in order" *
+  doctest::test_suite("concurrency"))
+{
+  // Threads commit transactions concurrently. Whichever thread is sequencing
+  // pending transactions replicates them on behalf of the others, so every
+  // committed transaction must be replicated exactly once, in version order.
+  kv::Store kv_store;
+  auto consensus = std::make_shared<kv::test::StubConsensus>();
+  kv_store.set_consensus(consensus);
+
+  using MapType = kv::Map<size_t, size_t>;
+
+  constexpr size_t thread_count = 8;
+  constexpr size_t tx_count = 500;
+
+  auto thread_fn = [&](size_t thread_idx) {
+    MapType map(fmt::format("public:map_{}", thread_idx));
+    for (size_t i = 0; i < tx_count; ++i)
+    {
+      auto tx = kv_store.create_tx();
+      tx.rw(map)->put(i, thread_idx);
+      DOCTEST_REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < thread_count; ++i)
+  {
+    threads.emplace_back(thread_fn, i);
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  DOCTEST_REQUIRE(consensus->number_of_replicas() == thread_count * tx_count);
+  for (kv::Version v = 1; v <= thread_count * tx_count; ++v)
+  {
+    const auto entry = consensus->pop_oldest_entry();
+    DOCTEST_REQUIRE(entry.has_value());
+    DOCTEST_REQUIRE(std::get<0>(entry.value()) == v);
+  }
+}
+
 DOCTEST_TEST_CASE(
   "get_version_of_previous_write ordering" * doctest::test_suite("concurrency"))
 {
@@ -332,4 +464,93 @@ DOCTEST_TEST_CASE(
       }
     }
   }
-}
\ No newline at end of file
+}
+
+DOCTEST_TEST_CASE("Pending tx ring" * doctest::test_suite("concurrency"))
+{
+  kv::PendingTxRing ring;
+
+  auto make_tx = [](uint8_t b) {
+    return std::make_unique<kv::MovePendingTx>(
+      std::vector<uint8_t>{b}, kv::ConsensusHookPtrs());
+  };
+
+  {
+    DOCTEST_INFO("Only a contiguous run of versions is taken");
+    auto epoch = ring.get_epoch();
+    ring.publish(3, epoch, make_tx(3), false);
+    ring.publish(1, epoch, make_tx(1), true);
+    DOCTEST_REQUIRE(ring.is_ready(1));
+    DOCTEST_REQUIRE(!ring.is_ready(2));
+
+    auto ready = ring.take_from(1);
+    DOCTEST_REQUIRE(ready.size() == 1);
+    DOCTEST_REQUIRE(std::get<0>(ready[0]) == 1);
+    DOCTEST_REQUIRE(std::get<2>(ready[0]));
+
+    ring.publish(2, epoch, make_tx(2), false);
+    ready = ring.take_from(2);
+    DOCTEST_REQUIRE(ready.size() == 2);
+    DOCTEST_REQUIRE(std::get<0>(ready[1]) == 3);
+    DOCTEST_REQUIRE(std::get<1>(ready[1])->call().data[0] == 3);
+    DOCTEST_REQUIRE(!ring.is_ready(1));
+  }
+
+  {
+    DOCTEST_INFO("Transactions published before a clear are dropped");
+    auto epoch = ring.get_epoch();
+    ring.publish(4, epoch, make_tx(4), false);
+    ring.clear(4);
+    DOCTEST_REQUIRE(!ring.is_ready(4));
+
+    // Published by a committer that checked the term before the clear
+    ring.publish(4, epoch, make_tx(4), false);
+    DOCTEST_REQUIRE(ring.take_from(4).empty());
+
+    ring.publish(4, ring.get_epoch(), make_tx(4), false);
+    DOCTEST_REQUIRE(ring.take_from(4).size() == 1);
+  }
+
+  {
+    DOCTEST_INFO("Concurrent publishers are taken in version order");
+    constexpr size_t thread_count = 8;
+    constexpr size_t per_thread = 2 * kv::PendingTxRing::capacity;
+    constexpr kv::Version first = 5;
+    constexpr kv::Version last = first + thread_count * per_thread - 1;
+
+    std::atomic<kv::Version> next_version = first;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+      threads.emplace_back([&]() {
+        for (size_t n = 0; n < per_thread; ++n)
+        {
+          const auto v = next_version++;
+          ring.publish(v, ring.get_epoch(), make_tx((uint8_t)v), false);
+        }
+      });
+    }
+
+    kv::Version taken = first - 1;
+    while (taken < last)
+    {
+      auto ready = ring.take_from(taken + 1);
+      for (auto& [v, tx, committable] : ready)
+      {
+        DOCTEST_REQUIRE(v == taken + 1);
+        DOCTEST_REQUIRE(tx->call().data[0] == (uint8_t)v);
+        taken = v;
+      }
+
+      if (ready.empty())
+      {
+        std::this_thread::yield();
+      }
+    }
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+  }
+}
@@ -7,6 +7,7 @@
 
 #include <doctest/doctest.h>
 #undef FAIL
+#include <set>
 
 struct MapTypes
 {
@@ -285,4 +286,442 @@ TEST_CASE("Commit hooks with snapshot" * doctest::test_suite("snapshot"))
       REQUIRE_EQ(writes.at("baz"), "baz");
     }
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Chunked snapshot" * doctest::test_suite("snapshot"))
+{
+  auto encryptor = std::make_shared<kv::NullTxEncryptor>();
+  kv::Store store;
+  store.set_encryptor(encryptor);
+
+  constexpr auto public_map = "public:string_map";
+  constexpr auto private_map = "private_map";
+  constexpr auto empty_map = "public:empty_map";
+  constexpr size_t entry_count = 100;
+
+  kv::Version snapshot_version = kv::NoVersion;
+  INFO("Apply transactions to original store");
+  {
+    auto tx = store.create_tx();
+    auto public_handle = tx.rw<MapTypes::StringString>(public_map);
+    auto private_handle = tx.rw<MapTypes::NumNum>(private_map);
+    for (size_t i = 0; i < entry_count; i++)
+    {
+      public_handle->put(fmt::format("key {}", i), fmt::format("value {}", i));
+      private_handle->put(i, i * i);
+    }
+    auto empty_handle = tx.rw<MapTypes::StringString>(empty_map);
+    empty_handle->put("foo", "bar");
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+
+    auto tx2 = store.create_tx();
+    tx2.rw<MapTypes::StringString>(empty_map)->remove("foo");
+    REQUIRE(tx2.commit() == kv::CommitResult::SUCCESS);
+    snapshot_version = tx2.commit_version();
+  }
+
+  INFO("Unchunked snapshot is a single chunk");
+  {
+    std::vector<std::vector<uint8_t>> chunks;
+    store.serialise_snapshot_chunks(
+      store.snapshot(snapshot_version),
+      0,
+      [&chunks](std::vector<uint8_t>&& chunk) {
+        chunks.push_back(std::move(chunk));
+      });
+    REQUIRE(chunks.size() == 1);
+    REQUIRE(
+      chunks[0] ==
+      store.serialise_snapshot(store.snapshot(snapshot_version)));
+  }
+
+  constexpr size_t chunk_size = 256;
+  std::vector<uint8_t> serialised_snapshot;
+  size_t chunk_count = 0;
+  store.serialise_snapshot_chunks(
+    store.snapshot(snapshot_version),
+    chunk_size,
+    [&](std::vector<uint8_t>&& chunk) {
+      serialised_snapshot.insert(
+        serialised_snapshot.end(), chunk.begin(), chunk.end());
+      chunk_count++;
+    });
+
+  // Both maps are split across several chunks
+  REQUIRE(chunk_count > 2);
+
+  INFO("Apply chunked snapshot to new store");
+  {
+    kv::Store new_store;
+    new_store.set_encryptor(encryptor);
+
+    kv::ConsensusHookPtrs hooks;
+    REQUIRE_EQ(
+      new_store.deserialise_snapshot(serialised_snapshot, hooks),
+      kv::ApplyResult::PASS);
+    REQUIRE_EQ(new_store.current_version(), snapshot_version);
+
+    auto tx = new_store.create_tx();
+    auto public_handle = tx.ro<MapTypes::StringString>(public_map);
+    auto private_handle = tx.ro<MapTypes::NumNum>(private_map);
+    for (size_t i = 0; i < entry_count; i++)
+    {
+      REQUIRE_EQ(
+        public_handle->get(fmt::format("key {}", i)).value(),
+        fmt::format("value {}", i));
+      REQUIRE_EQ(private_handle->get(i).value(), i * i);
+    }
+    REQUIRE_EQ(public_handle->size(), entry_count);
+    REQUIRE_EQ(private_handle->size(), entry_count);
+    REQUIRE_EQ(tx.ro<MapTypes::StringString>(empty_map)->size(), 0);
+  }
+
+  INFO("Apply chunks to new store as they are serialised");
+  {
+    kv::Store new_store;
+    new_store.set_encryptor(encryptor);
+
+    kv::Store::SnapshotLoader loader(new_store);
+    store.serialise_snapshot_chunks(
+      store.snapshot(snapshot_version),
+      chunk_size,
+      [&loader](std::vector<uint8_t>&& chunk) {
+        REQUIRE(loader.load_chunk(chunk.data(), chunk.size()));
+      });
+
+    // Nothing is committed to the store until all chunks have been applied
+    REQUIRE_EQ(loader.get_version(), snapshot_version);
+    REQUIRE_EQ(new_store.current_version(), 0);
+
+    kv::ConsensusHookPtrs hooks;
+    REQUIRE_EQ(loader.finish(hooks), kv::ApplyResult::PASS);
+    REQUIRE_EQ(new_store.current_version(), snapshot_version);
+
+    auto tx = new_store.create_tx();
+    REQUIRE_EQ(tx.ro<MapTypes::StringString>(public_map)->size(), entry_count);
+    REQUIRE_EQ(tx.ro<MapTypes::NumNum>(private_map)->size(), entry_count);
+  }
+
+  INFO("Public-only application of chunked snapshot");
+  {
+    kv::Store new_store;
+    new_store.set_encryptor(encryptor);
+
+    kv::ConsensusHookPtrs hooks;
+    REQUIRE_EQ(
+      new_store.deserialise_snapshot(serialised_snapshot, hooks, nullptr, true),
+      kv::ApplyResult::PASS);
+
+    auto tx = new_store.create_tx();
+    REQUIRE_EQ(tx.ro<MapTypes::StringString>(public_map)->size(), entry_count);
+    REQUIRE_EQ(tx.ro<MapTypes::NumNum>(private_map)->size(), 0);
+  }
+
+  INFO("Truncated chunked snapshot cannot be applied");
+  {
+    kv::Store new_store;
+    new_store.set_encryptor(encryptor);
+
+    auto truncated_snapshot = serialised_snapshot;
+    truncated_snapshot.resize(truncated_snapshot.size() - 1);
+
+    kv::ConsensusHookPtrs hooks;
+    REQUIRE_EQ(
+      new_store.deserialise_snapshot(truncated_snapshot, hooks),
+      kv::ApplyResult::FAIL);
+  }
+}
+
+// Records the IV (term and version) and plaintext of each encrypted snapshot
+// chunk
+class ChunkIVRecorder : public kv::NullTxEncryptor
+{
+public:
+  std::map<std::pair<kv::Term, kv::Version>, std::vector<uint8_t>> chunks;
+
+  bool encrypt(
+    const std::vector<uint8_t>& plain,
+    const std::vector<uint8_t>& additional_data,
+    std::vector<uint8_t>& serialised_header,
+    std::vector<uint8_t>& cipher,
+    const kv::TxID& tx_id,
+    bool is_snapshot = false) override
+  {
+    if (is_snapshot)
+    {
+      // Only 31 bits of the term are part of the IV
+      REQUIRE(tx_id.term <= 0x7FFFFFFF);
+
+      // The same IV may only ever be used for the same plaintext
+      auto [it, inserted] =
+        chunks.emplace(std::make_pair(tx_id.term, tx_id.version), plain);
+      REQUIRE((inserted || it->second == plain));
+    }
+
+    return kv::NullTxEncryptor::encrypt(
+      plain, additional_data, serialised_header, cipher, tx_id, is_snapshot);
+  }
+};
+
+TEST_CASE("Chunked snapshot IVs" * doctest::test_suite("snapshot"))
+{
+  auto encryptor = std::make_shared<ChunkIVRecorder>();
+  kv::Store store;
+  store.set_encryptor(encryptor);
+
+  constexpr auto public_map = "public:string_map";
+  constexpr auto private_map = "private_map";
+  constexpr size_t entry_count = 100;
+
+  kv::Version snapshot_version = kv::NoVersion;
+  {
+    auto tx = store.create_tx();
+    auto public_handle = tx.rw<MapTypes::StringString>(public_map);
+    auto private_handle = tx.rw<MapTypes::NumNum>(private_map);
+    for (size_t i = 0; i < entry_count; i++)
+    {
+      public_handle->put(fmt::format("key {}", i), fmt::format("value {}", i));
+      private_handle->put(i, i * i);
+    }
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    snapshot_version = tx.commit_version();
+  }
+
+  auto serialise = [&](size_t chunk_size) {
+    std::vector<std::vector<uint8_t>> chunks;
+    store.serialise_snapshot_chunks(
+      store.snapshot(snapshot_version),
+      chunk_size,
+      [&chunks](std::vector<uint8_t>&& chunk) {
+        chunks.push_back(std::move(chunk));
+      });
+    return chunks;
+  };
+
+  // As serialised concurrently by the snapshotter
+  auto serialise_per_map = [&](size_t chunk_size) {
+    auto snapshot = store.snapshot(snapshot_version);
+    std::vector<std::vector<uint8_t>> chunks;
+    chunks.push_back(snapshot->serialise_header_chunk(encryptor));
+    for (size_t i = 0; i < snapshot->get_map_count(); ++i)
+    {
+      for (auto& chunk :
+           snapshot->serialise_map_chunks(encryptor, i, chunk_size))
+      {
+        chunks.push_back(std::move(chunk));
+      }
+    }
+    return chunks;
+  };
+
+  // Every layout is serialised at the same version. ChunkIVRecorder checks
+  // that no IV is used for different chunks.
+  std::map<size_t, std::vector<std::vector<uint8_t>>> layouts;
+  std::map<size_t, std::vector<std::vector<uint8_t>>> per_map_layouts;
+  size_t iv_count = 0;
+  for (size_t chunk_size : {0, 128, 256, 512, 1024, 4096})
+  {
+    INFO("Chunk size: " << chunk_size);
+    layouts[chunk_size] = serialise(chunk_size);
+    iv_count += layouts[chunk_size].size();
+    REQUIRE(encryptor->chunks.size() == iv_count);
+
+    per_map_layouts[chunk_size] = serialise_per_map(chunk_size);
+    // The header chunk is the same for all chunk sizes
+    iv_count += per_map_layouts[chunk_size].size() - (chunk_size == 0 ? 0 : 1);
+    REQUIRE(encryptor->chunks.size() == iv_count);
+  }
+  REQUIRE(layouts[256].size() > layouts[512].size());
+  REQUIRE(per_map_layouts[256].size() > per_map_layouts[512].size());
+
+  INFO("Chunk sizes are rounded up to a power of two");
+  {
+    REQUIRE(serialise(300) == layouts[512]);
+    REQUIRE(serialise(513) == layouts[1024]);
+    REQUIRE(serialise_per_map(300) == per_map_layouts[512]);
+    REQUIRE(encryptor->chunks.size() == iv_count);
+  }
+}
+
+TEST_CASE("Per-map snapshot serialisation" * doctest::test_suite("snapshot"))
+{
+  auto encryptor = std::make_shared<kv::NullTxEncryptor>();
+  kv::Store store;
+  store.set_encryptor(encryptor);
+
+  constexpr auto public_map = "public:string_map";
+  constexpr auto private_map = "private_map";
+  constexpr auto empty_map = "public:empty_map";
+  constexpr size_t entry_count = 100;
+
+  kv::Version snapshot_version = kv::NoVersion;
+  INFO("Apply transactions to original store");
+  {
+    auto tx = store.create_tx();
+    auto public_handle = tx.rw<MapTypes::StringString>(public_map);
+    auto private_handle = tx.rw<MapTypes::NumNum>(private_map);
+    for (size_t i = 0; i < entry_count; i++)
+    {
+      public_handle->put(fmt::format("key {}", i), fmt::format("value {}", i));
+      private_handle->put(i, i * i);
+    }
+    tx.rw<MapTypes::StringString>(empty_map);
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    snapshot_version = tx.commit_version();
+  }
+
+  // Maps are serialised in reverse order, as they may be when serialised
+  // concurrently, but chunks are concatenated in map order
+  auto serialise_per_map = [&](size_t chunk_size) {
+    auto snapshot = store.snapshot(snapshot_version);
+    const auto map_count = snapshot->get_map_count();
+
+    std::vector<std::vector<std::vector<uint8_t>>> map_chunks(map_count);
+    for (size_t i = map_count; i > 0; --i)
+    {
+      map_chunks[i - 1] =
+        snapshot->serialise_map_chunks(encryptor, i - 1, chunk_size);
+      REQUIRE_FALSE(map_chunks[i - 1].empty());
+    }
+
+    auto serialised_snapshot = snapshot->serialise_header_chunk(encryptor);
+    for (const auto& chunks : map_chunks)
+    {
+      for (const auto& chunk : chunks)
+      {
+        serialised_snapshot.insert(
+          serialised_snapshot.end(), chunk.begin(), chunk.end());
+      }
+    }
+    return serialised_snapshot;
+  };
+
+  for (size_t chunk_size : {0, 256})
+  {
+    INFO("Chunk size: " << chunk_size);
+
+    auto serialised_snapshot = serialise_per_map(chunk_size);
+    REQUIRE(serialised_snapshot == serialise_per_map(chunk_size));
+
+    kv::Store new_store;
+    new_store.set_encryptor(encryptor);
+
+    kv::ConsensusHookPtrs hooks;
+    REQUIRE_EQ(
+      new_store.deserialise_snapshot(serialised_snapshot, hooks),
+      kv::ApplyResult::PASS);
+    REQUIRE_EQ(new_store.current_version(), snapshot_version);
+
+    auto tx = new_store.create_tx();
+    auto public_handle = tx.ro<MapTypes::StringString>(public_map);
+    auto private_handle = tx.ro<MapTypes::NumNum>(private_map);
+    for (size_t i = 0; i < entry_count; i++)
+    {
+      REQUIRE_EQ(
+        public_handle->get(fmt::format("key {}", i)).value(),
+        fmt::format("value {}", i));
+      REQUIRE_EQ(private_handle->get(i).value(), i * i);
+    }
+    REQUIRE_EQ(public_handle->size(), entry_count);
+    REQUIRE_EQ(private_handle->size(), entry_count);
+  }
+}
+
+TEST_CASE("Ordered map snapshot" * doctest::test_suite("snapshot"))
+{
+  kv::Store store;
+  kv::RawCopySerialisedMap<std::string, size_t> ordered_map(
+    "public:ordered_map");
+  store.set_ordered(ordered_map.get_name());
+
+  constexpr size_t entry_count = 100;
+  INFO("Apply transactions to original store");
+  {
+    auto tx = store.create_tx();
+    auto handle = tx.rw(ordered_map);
+    for (size_t i = 0; i < entry_count; ++i)
+    {
+      handle->put(fmt::format("key{:03}", entry_count - i - 1), i);
+    }
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  auto snapshot = store.snapshot(store.current_version());
+  auto serialised_snapshot = store.serialise_snapshot(std::move(snapshot));
+
+  INFO("Ranges can be read from the ordered map after the snapshot is applied");
+  {
+    kv::Store new_store;
+    new_store.set_ordered(ordered_map.get_name());
+
+    kv::ConsensusHookPtrs hooks;
+    REQUIRE_EQ(
+      new_store.deserialise_snapshot(serialised_snapshot, hooks),
+      kv::ApplyResult::PASS);
+
+    auto tx = new_store.create_tx();
+    auto handle = tx.rw(ordered_map);
+    handle->put("key050a", entry_count);
+
+    std::vector<std::string> keys;
+    handle->range(
+      "key049", "key052", [&keys](const auto& k, const auto&) {
+        keys.push_back(k);
+        return true;
+      });
+    REQUIRE(
+      keys ==
+      std::vector<std::string>{"key049", "key050", "key050a", "key051"});
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+
+    auto tx2 = new_store.create_tx();
+    auto handle2 = tx2.ro(ordered_map);
+    auto entry = handle2->lower_bound("key0500");
+    REQUIRE(entry.has_value());
+    REQUIRE(entry->first == "key050a");
+    REQUIRE(entry->second == entry_count);
+  }
+}
+
+TEST_CASE("Secondary index after snapshot" * doctest::test_suite("snapshot"))
+{
+  kv::Store store;
+  MapTypes::StringString string_map("public:string_map");
+
+  {
+    auto tx = store.create_tx();
+    auto handle = tx.rw(string_map);
+    handle->put("foo", "bar");
+    handle->put("baz", "bar");
+    handle->put("qux", "quux");
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  auto snapshot = store.snapshot(store.current_version());
+  auto serialised_snapshot = store.serialise_snapshot(std::move(snapshot));
+
+  INFO("Index is rebuilt when the snapshot is applied");
+  {
+    kv::Store new_store;
+    new_store.set_index(
+      string_map.get_name(),
+      "by_value",
+      MapTypes::StringString::wrap_index_extractor<std::string>(
+        [](const std::string& v) { return v; }));
+
+    kv::ConsensusHookPtrs hooks;
+    REQUIRE_EQ(
+      new_store.deserialise_snapshot(serialised_snapshot, hooks),
+      kv::ApplyResult::PASS);
+
+    auto tx = new_store.create_tx();
+    auto handle = tx.ro(string_map);
+    std::set<std::string> keys;
+    handle->foreach_indexed<std::string>(
+      "by_value", "bar", [&keys](const auto& k, const auto&) {
+        keys.insert(k);
+        return true;
+      });
+    REQUIRE(keys == std::set<std::string>{"baz", "foo"});
+  }
+}
@@ -559,6 +559,103 @@ TEST_CASE("multiple handles")
   REQUIRE(*h2->get(k) == v2);
 }
 
+TEST_CASE("Map ids")
+{
+  kv::Store kv_store;
+
+  MapTypes::NumString map("public:map");
+  MapTypes::NumString same_map("public:map");
+  MapTypes::NumString other_map("public:other_map");
+
+  const auto map_id = kv_store.get_map_id(map);
+  REQUIRE(map_id == kv_store.get_map_id(same_map));
+  REQUIRE(map_id != kv_store.get_map_id(other_map));
+
+  INFO("Ids are scoped to the store");
+  {
+    kv::Store other_store;
+    auto tx = other_store.create_tx();
+    tx.rw(other_map)->put(42, "world");
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    REQUIRE(other_store.get_map_id(other_map) == 0);
+    REQUIRE(other_store.get_map_id(map) == 1);
+    REQUIRE(kv_store.get_map_id(map) == map_id);
+    REQUIRE(
+      kv_store.get_map(
+        kv_store.current_version(),
+        kv_store.get_map_id(other_map),
+        other_map.get_name()) == nullptr);
+  }
+
+  constexpr auto k = 42;
+  constexpr auto v1 = "hello";
+
+  INFO("Handles by instance and by name are shared");
+  {
+    auto tx = kv_store.create_tx();
+    auto h1 = tx.rw(map);
+    auto h2 = tx.rw(same_map);
+    auto h3 = tx.rw<MapTypes::NumString>(map.get_name());
+    REQUIRE(h1 == h2);
+    REQUIRE(h1 == h3);
+
+    auto tx2 = kv_store.create_tx();
+    auto h4 = tx2.rw<MapTypes::NumString>(map.get_name());
+    auto h5 = tx2.rw(map);
+    REQUIRE(h4 == h5);
+
+    h1->put(k, v1);
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  INFO("Maps created by earlier transactions are found by id");
+  {
+    auto tx = kv_store.create_tx();
+    auto h = tx.ro(map);
+    REQUIRE(h->get(k) == v1);
+    REQUIRE(
+      kv_store.get_map(kv_store.current_version(), map_id, "") !=
+      nullptr);
+  }
+
+  INFO("Maps forgotten on rollback are not found by id");
+  {
+    const auto version = kv_store.current_version();
+
+    auto tx = kv_store.create_tx();
+    tx.rw(other_map)->put(k, v1);
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    REQUIRE(
+      kv_store.get_map(
+        kv_store.current_version(),
+        kv_store.get_map_id(other_map),
+        other_map.get_name()) != nullptr);
+
+    kv_store.rollback({kv_store.commit_view(), version}, kv_store.commit_view());
+    REQUIRE(
+      kv_store.get_map(
+        kv_store.current_version(),
+        kv_store.get_map_id(other_map),
+        other_map.get_name()) == nullptr);
+
+    auto tx2 = kv_store.create_tx();
+    REQUIRE(!tx2.ro(other_map)->has(k));
+    tx2.rw(other_map)->put(k, v1);
+    REQUIRE(tx2.commit() == kv::CommitResult::SUCCESS);
+
+    auto tx3 = kv_store.create_tx();
+    REQUIRE(tx3.ro(other_map)->get(k) == v1);
+  }
+
+  INFO("Maps are not found by id after the store is cleared");
+  {
+    kv_store.clear();
+    REQUIRE(
+      kv_store.get_map(kv_store.current_version(), map_id, "") ==
+      nullptr);
+  }
+}
+
 TEST_CASE("clear")
 {
   kv::Store kv_store;
@@ -1284,6 +1381,435 @@ TEST_CASE("Modifications during foreach iteration")
   }
 }
 
+template <typename M>
+void test_range(kv::Store& kv_store, M& map)
+{
+  {
+    auto tx = kv_store.create_tx();
+    auto handle = tx.rw(map);
+    for (const auto& k : {"b", "ba", "bb", "c", "d", "e"})
+    {
+      handle->put(k, k[0]);
+    }
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  {
+    auto tx = kv_store.create_tx();
+    auto handle = tx.rw(map);
+    handle->remove("c");
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  using Entries = std::vector<std::pair<std::string, char>>;
+  auto get_range = [](auto handle, const auto& from, const auto& to) {
+    Entries entries;
+    handle->range(from, to, [&entries](const auto& k, const auto& v) {
+      entries.emplace_back(k, v);
+      return true;
+    });
+    return entries;
+  };
+
+  INFO("Range over committed state");
+  {
+    auto tx = kv_store.create_tx();
+    auto handle = tx.rw(map);
+    REQUIRE(get_range(handle, "a", "bb") == Entries{{"b", 'b'}, {"ba", 'b'}});
+    REQUIRE(get_range(handle, "bb", "e") == Entries{{"bb", 'b'}, {"d", 'd'}});
+    REQUIRE(get_range(handle, "e", std::nullopt) == Entries{{"e", 'e'}});
+    REQUIRE(get_range(handle, "d", "d").empty());
+    REQUIRE(get_range(handle, "f", std::nullopt).empty());
+
+    Entries entries;
+    handle->range("a", std::nullopt, [&entries](const auto& k, const auto& v) {
+      entries.emplace_back(k, v);
+      return entries.size() < 2;
+    });
+    REQUIRE(entries == Entries{{"b", 'b'}, {"ba", 'b'}});
+
+    entries.clear();
+    handle->foreach_prefix("b", [&entries](const auto& k, const auto& v) {
+      entries.emplace_back(k, v);
+      return true;
+    });
+    REQUIRE(entries == Entries{{"b", 'b'}, {"ba", 'b'}, {"bb", 'b'}});
+
+    REQUIRE(handle->lower_bound("bc") == std::make_pair(std::string("d"), 'd'));
+    REQUIRE(handle->lower_bound("c") == std::make_pair(std::string("d"), 'd'));
+    REQUIRE(!handle->lower_bound("f").has_value());
+  }
+
+  INFO("Range includes this transaction's writes");
+  {
+    auto tx = kv_store.create_tx();
+    auto handle = tx.rw(map);
+    handle->put("a", 'x');
+    handle->put("bb", 'x');
+    handle->remove("d");
+    handle->put("c", 'x');
+    handle->put("f", 'x');
+    REQUIRE(
+      get_range(handle, "a", std::nullopt) ==
+      Entries{
+        {"a", 'x'},
+        {"b", 'b'},
+        {"ba", 'b'},
+        {"bb", 'x'},
+        {"c", 'x'},
+        {"e", 'e'},
+        {"f", 'x'}});
+    REQUIRE(
+      get_range(handle, "ba", "d") ==
+      Entries{{"ba", 'b'}, {"bb", 'x'}, {"c", 'x'}});
+    REQUIRE(handle->lower_bound("cc") == std::make_pair(std::string("e"), 'e'));
+  }
+
+  INFO("Range conflicts with any concurrent write");
+  {
+    auto tx1 = kv_store.create_tx();
+    auto handle1 = tx1.rw(map);
+    get_range(handle1, "a", "b");
+    handle1->put("z", 'z');
+
+    auto tx2 = kv_store.create_tx();
+    tx2.rw(map)->put("e", 'x');
+    REQUIRE(tx2.commit() == kv::CommitResult::SUCCESS);
+
+    REQUIRE(tx1.commit() == kv::CommitResult::FAIL_CONFLICT);
+  }
+}
+
+TEST_CASE("Range queries")
+{
+  using StringChar = kv::RawCopySerialisedMap<std::string, char>;
+
+  kv::Store kv_store;
+
+  SUBCASE("Ordered map")
+  {
+    StringChar map("public:ordered");
+    kv_store.set_ordered(map.get_name());
+    test_range(kv_store, map);
+  }
+
+  SUBCASE("Unordered map")
+  {
+    StringChar map("public:unordered");
+    test_range(kv_store, map);
+  }
+}
+
+TEST_CASE("Ordered maps are declared on the store")
+{
+  using StringChar = kv::RawCopySerialisedMap<std::string, char>;
+  StringChar map("public:map");
+
+  kv::Store ordered_store;
+  ordered_store.set_ordered(map.get_name());
+  kv::Store unordered_store;
+
+  for (auto store : {&ordered_store, &unordered_store})
+  {
+    auto tx = store->create_tx();
+    tx.rw(map)->put("a", 'a');
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  REQUIRE(ordered_store.is_map_ordered(map.get_name()));
+  REQUIRE_FALSE(unordered_store.is_map_ordered(map.get_name()));
+
+  INFO("Maps cannot be declared as ordered once they have been created");
+  {
+    REQUIRE_THROWS_AS(
+      unordered_store.set_ordered(map.get_name()), std::logic_error);
+    REQUIRE_NOTHROW(ordered_store.set_ordered(map.get_name()));
+  }
+}
+
+TEST_CASE("Secondary indexes")
+{
+  kv::Store kv_store;
+  MapTypes::StringString map("public:map");
+
+  // Index each value by its first character
+  using Initial = std::string;
+  kv_store.set_index(
+    map.get_name(),
+    "by_initial",
+    MapTypes::StringString::wrap_index_extractor<Initial>(
+      [](const std::string& v) -> std::optional<Initial> {
+        if (v.empty())
+        {
+          return std::nullopt;
+        }
+        return v.substr(0, 1);
+      }));
+
+  auto get_indexed = [](auto handle, const Initial& initial) {
+    std::set<std::string> keys;
+    handle->template foreach_indexed<Initial>(
+      "by_initial", initial, [&keys](const auto& k, const auto&) {
+        keys.insert(k);
+        return true;
+      });
+    return keys;
+  };
+
+  {
+    auto tx = kv_store.create_tx();
+    auto handle = tx.rw(map);
+    handle->put("k1", "apple");
+    handle->put("k2", "avocado");
+    handle->put("k3", "banana");
+    handle->put("k4", "");
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  INFO("Index reflects committed values");
+  {
+    auto tx = kv_store.create_tx();
+    auto handle = tx.ro(map);
+    REQUIRE(get_indexed(handle, "a") == std::set<std::string>{"k1", "k2"});
+    REQUIRE(get_indexed(handle, "b") == std::set<std::string>{"k3"});
+    REQUIRE(get_indexed(handle, "c").empty());
+    REQUIRE_THROWS(handle->foreach_indexed<Initial>(
+      "unknown", "a", [](const auto&, const auto&) { return true; }));
+  }
+
+  INFO("Index includes this transaction's writes");
+  {
+    auto tx = kv_store.create_tx();
+    auto handle = tx.rw(map);
+    handle->put("k1", "blueberry");
+    handle->remove("k3");
+    handle->put("k5", "apricot");
+    REQUIRE(get_indexed(handle, "a") == std::set<std::string>{"k2", "k5"});
+    REQUIRE(get_indexed(handle, "b") == std::set<std::string>{"k1"});
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  INFO("Index is updated on commit");
+  {
+    auto tx = kv_store.create_tx();
+    auto handle = tx.ro(map);
+    REQUIRE(get_indexed(handle, "a") == std::set<std::string>{"k2", "k5"});
+    REQUIRE(get_indexed(handle, "b") == std::set<std::string>{"k1"});
+  }
+
+  INFO("Index lookups conflict with concurrent writes");
+  {
+    auto tx1 = kv_store.create_tx();
+    auto handle1 = tx1.rw(map);
+    get_indexed(handle1, "c");
+    handle1->put("k6", "x");
+
+    auto tx2 = kv_store.create_tx();
+    tx2.rw(map)->put("k7", "cherry");
+    REQUIRE(tx2.commit() == kv::CommitResult::SUCCESS);
+
+    REQUIRE(tx1.commit() == kv::CommitResult::FAIL_CONFLICT);
+  }
+
+  INFO("Index is rolled back with the map");
+  {
+    auto version = kv_store.current_version();
+    {
+      auto tx = kv_store.create_tx();
+      tx.rw(map)->put("k8", "coconut");
+      REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    }
+    kv_store.rollback({kv_store.commit_view(), version}, kv_store.commit_view());
+
+    auto tx = kv_store.create_tx();
+    REQUIRE(get_indexed(tx.ro(map), "c") == std::set<std::string>{"k7"});
+  }
+
+  INFO("Index is defined over existing state");
+  {
+    kv_store.set_index(
+      map.get_name(),
+      "by_length",
+      MapTypes::StringString::wrap_index_extractor<size_t>(
+        [](const std::string& v) { return v.size(); }));
+
+    auto tx = kv_store.create_tx();
+    auto handle = tx.ro(map);
+    std::set<std::string> keys;
+    handle->foreach_indexed<size_t>(
+      "by_length", 7, [&keys](const auto& k, const auto&) {
+        keys.insert(k);
+        return true;
+      });
+    REQUIRE(keys == std::set<std::string>{"k2", "k5"});
+  }
+}
+
+TEST_CASE("Read-only snapshot transactions")
+{
+  kv::Store kv_store;
+  MapTypes::StringString map_a("public:map_a");
+  MapTypes::StringString map_b("public:map_b");
+
+  {
+    auto tx = kv_store.create_tx();
+    tx.rw(map_a)->put("key", "a1");
+    tx.rw(map_b)->put("key", "b1");
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  INFO("Reads are served from the state at the read version");
+  {
+    auto tx = kv_store.create_tx();
+    tx.set_read_only_snapshot();
+    auto handle_a = tx.ro(map_a);
+    REQUIRE(handle_a->get("key") == "a1");
+
+    // Committed after the read version was acquired
+    auto tx2 = kv_store.create_tx();
+    tx2.rw(map_a)->put("key", "a2");
+    tx2.rw(map_b)->put("key", "b2");
+    REQUIRE(tx2.commit() == kv::CommitResult::SUCCESS);
+
+    REQUIRE(handle_a->get("key") == "a1");
+    REQUIRE(tx.ro(map_b)->get("key") == "b1");
+
+    // Unrecorded reads cannot conflict
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    REQUIRE(tx.get_version() == kv::NoVersion);
+    auto tx_id = tx.get_txid();
+    REQUIRE(tx_id.has_value());
+    REQUIRE(tx_id->version == kv_store.current_version() - 1);
+  }
+
+  INFO("Maps are read at the version acquired by the snapshot");
+  {
+    auto tx = kv_store.create_tx();
+    tx.set_read_only_snapshot();
+
+    // Committed after the snapshot was taken, but before any map is accessed
+    auto tx2 = kv_store.create_tx();
+    tx2.rw(map_a)->put("key", "a3");
+    tx2.rw(map_b)->put("key", "b3");
+    REQUIRE(tx2.commit() == kv::CommitResult::SUCCESS);
+
+    REQUIRE(tx.ro(map_a)->get("key") == "a2");
+
+    // Committed between accesses to different maps
+    auto tx3 = kv_store.create_tx();
+    tx3.rw(map_b)->put("key", "b4");
+    REQUIRE(tx3.commit() == kv::CommitResult::SUCCESS);
+
+    REQUIRE(tx.ro(map_b)->get("key") == "b2");
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    REQUIRE(tx.get_txid()->version == kv_store.current_version() - 2);
+
+    auto tx4 = kv_store.create_tx();
+    tx4.rw(map_a)->put("key", "a2");
+    tx4.rw(map_b)->put("key", "b2");
+    REQUIRE(tx4.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  INFO("Snapshots cannot be taken after maps have been accessed");
+  {
+    auto tx = kv_store.create_tx();
+    tx.ro(map_a)->get("key");
+    REQUIRE_THROWS_AS(tx.set_read_only_snapshot(), std::logic_error);
+  }
+
+  INFO("Latest state is pinned");
+  {
+    auto tx = kv_store.create_tx();
+    tx.set_read_only_snapshot();
+    REQUIRE(tx.ro(map_a)->get("key") == "a2");
+    REQUIRE(tx.ro(map_b)->get("key") == "b2");
+    REQUIRE_FALSE(tx.ro(map_b)->has("missing"));
+  }
+
+  INFO("Writes cannot be committed");
+  {
+    auto tx = kv_store.create_tx();
+    tx.set_read_only_snapshot();
+    tx.rw(map_a)->put("key", "a3");
+    REQUIRE(tx.has_writes());
+    REQUIRE_THROWS_AS(tx.commit(), std::logic_error);
+
+    auto tx2 = kv_store.create_tx();
+    REQUIRE(tx2.ro(map_a)->get("key") == "a2");
+  }
+
+  INFO("Pinned state follows rollback");
+  {
+    const auto txid = kv_store.current_txid();
+    auto tx = kv_store.create_tx();
+    tx.rw(map_a)->put("key", "a3");
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+
+    kv_store.rollback(txid, kv_store.commit_view());
+
+    auto tx2 = kv_store.create_tx();
+    tx2.set_read_only_snapshot();
+    REQUIRE(tx2.ro(map_a)->get("key") == "a2");
+  }
+}
+
+TEST_CASE("Savepoints")
+{
+  kv::Store kv_store;
+  MapTypes::StringString map_a("public:map_a");
+  MapTypes::StringString map_b("public:map_b");
+
+  {
+    auto tx = kv_store.create_tx();
+    tx.rw(map_a)->put("existing", "old");
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  auto tx = kv_store.create_tx();
+  auto handle_a = tx.rw(map_a);
+  handle_a->put("first", "1");
+
+  INFO("Writes after a savepoint are rolled back");
+  {
+    const auto savepoint = tx.savepoint();
+    handle_a->put("first", "overwritten");
+    handle_a->put("second", "2");
+    REQUIRE(handle_a->remove("existing"));
+    tx.rw(map_b)->put("other", "b");
+
+    tx.rollback_to(savepoint);
+    REQUIRE(handle_a->get("first") == "1");
+    REQUIRE_FALSE(handle_a->has("second"));
+    REQUIRE(handle_a->get("existing") == "old");
+    REQUIRE_FALSE(tx.rw(map_b)->has("other"));
+  }
+
+  INFO("Writes after a savepoint are kept if not rolled back");
+  {
+    const auto savepoint = tx.savepoint();
+    handle_a->put("third", "3");
+    handle_a->remove("first");
+
+    const auto inner = tx.savepoint();
+    handle_a->put("fourth", "4");
+    tx.rollback_to(inner);
+    REQUIRE_FALSE(handle_a->has("fourth"));
+    REQUIRE(handle_a->get("third") == "3");
+    REQUIRE_FALSE(handle_a->has("first"));
+  }
+
+  REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+
+  auto tx2 = kv_store.create_tx();
+  auto handle = tx2.ro(map_a);
+  REQUIRE(handle->get("existing") == "old");
+  REQUIRE(handle->get("third") == "3");
+  REQUIRE_FALSE(handle->has("first"));
+  REQUIRE_FALSE(handle->has("second"));
+  REQUIRE_FALSE(handle->has("fourth"));
+  REQUIRE_FALSE(tx2.ro(map_b)->has("other"));
+}
+
 TEST_CASE("Read-only tx")
 {
   kv::Store kv_store;
@@ -1654,7 +2180,7 @@ TEST_CASE("Deserialising from other Store")
   auto handle2 = tx1.rw(private_map);
   handle1->put(42, "aardvark");
   handle2->put(14, "alligator");
-  auto [success, data, hooks] = tx1.commit_reserved();
+  auto [success, data, hooks, digest] = tx1.commit_reserved();
   REQUIRE(success == kv::CommitResult::SUCCESS);
 
   kv::Store clone;
@@ -1687,7 +2213,7 @@ TEST_CASE("Deserialise return status")
     auto tx = store.create_reserved_tx(store.next_txid());
     auto data_handle = tx.rw(data);
     data_handle->put(42, 42);
-    auto [success, data, hooks] = tx.commit_reserved();
+    auto [success, data, hooks, digest] = tx.commit_reserved();
     REQUIRE(success == kv::CommitResult::SUCCESS);
 
     REQUIRE(
@@ -1702,7 +2228,7 @@ TEST_CASE("Deserialise return status")
     ccf::PrimarySignature sigv(kv::test::PrimaryNodeId, 2);
     sig_handle->put(sigv);
     tree_handle->put({});
-    auto [success, data, hooks] = tx.commit_reserved();
+    auto [success, data, hooks, digest] = tx.commit_reserved();
     REQUIRE(success == kv::CommitResult::SUCCESS);
 
     REQUIRE(
@@ -1718,7 +2244,7 @@ TEST_CASE("Deserialise return status")
     ccf::PrimarySignature sigv(kv::test::PrimaryNodeId, 2);
     sig_handle->put(sigv);
     data_handle->put(43, 43);
-    auto [success, data, hooks] = tx.commit_reserved();
+    auto [success, data, hooks, digest] = tx.commit_reserved();
     REQUIRE(success == kv::CommitResult::SUCCESS);
 
     REQUIRE(
@@ -8,6 +8,9 @@
 #include "kv/kv_types.h"
 #include "kv/untyped_map_handle.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <functional>
 #include <list>
 #include <optional>
@@ -24,9 +27,18 @@ namespace kv::untyped
       writes(w)
     {}
 
+    LocalCommit(Version v, State&& s, const ChangeSetWrite& w) :
+      version(v),
+      state(std::move(s)),
+      writes(w.begin(), w.end())
+    {}
+
     Version version;
     State state;
     Write writes;
+    // Only maintained if the map is ordered
+    OrderedKeys keys;
+    Indexes indexes;
     LocalCommit* next = nullptr;
     LocalCommit* prev = nullptr;
   };
@@ -73,6 +85,7 @@ namespace kv::untyped
 
     using CommitHook = CommitHook<Write>;
     using MapHook = MapHook<Write>;
+    using IndexExtractor = untyped::IndexExtractor;
 
   private:
     AbstractStore* store;
@@ -81,9 +94,162 @@ namespace kv::untyped
     MapHook hook = nullptr;
     std::list<std::pair<Version, Write>> commit_deltas;
     std::mutex sl;
+
+    // Incremented when sl is locked and when it is unlocked, so that it is odd
+    // while the map is locked
+    std::atomic<size_t> lock_count = 0;
+
+    // Copy of the latest commit in the roll, which read-only transactions can
+    // pin without locking the map. It is republished when the map is unlocked
+    // after the roll has changed.
+    struct Latest
+    {
+      size_t rollback_counter;
+      Version version;
+      State state;
+      State committed;
+      std::optional<OrderedKeys> keys;
+      Indexes indexes;
+    };
+    std::shared_ptr<const Latest> latest = nullptr;
+    bool latest_stale = true;
+
+    void publish_latest()
+    {
+      const auto tail = roll.commits->get_tail();
+      auto l = std::make_shared<Latest>();
+      l->rollback_counter = roll.rollback_counter;
+      l->version = tail->version;
+      l->state = tail->state;
+      l->committed = roll.commits->get_head()->state;
+      if (ordered)
+      {
+        l->keys = tail->keys;
+      }
+      l->indexes = tail->indexes;
+      std::atomic_store(&latest, std::shared_ptr<const Latest>(std::move(l)));
+      latest_stale = false;
+    }
+
+    // Keys are hashed onto a fixed number of locks, so that transactions
+    // writing disjoint keys of this map can be prepared concurrently, and
+    // only take sl to publish their writes (see apply_changes())
+    static constexpr size_t key_lock_count = 64;
+    std::array<std::mutex, key_lock_count> key_locks;
+
     const SecurityDomain security_domain;
     const bool replicated;
     const bool include_conflict_read_version;
+    // Whether each commit in the roll indexes its keys. Swapped along with the
+    // roll.
+    bool ordered;
+
+    // Definitions of the secondary indexes maintained over this map, by name
+    std::map<std::string, std::shared_ptr<const IndexExtractor>>
+      index_extractors;
+
+    static void add_to_index(Index& index, const K& index_key, const K& k)
+    {
+      auto keys = index.state.getp(index_key);
+      index.state = index.state.put(
+        index_key,
+        (keys == nullptr ? IndexedKeys() : *keys).put(k, {}));
+    }
+
+    static void remove_from_index(
+      Index& index, const K& index_key, const K& k)
+    {
+      auto keys = index.state.getp(index_key);
+      if (keys == nullptr)
+      {
+        return;
+      }
+
+      auto remaining = keys->remove(k);
+      index.state = remaining.empty() ? index.state.remove(index_key) :
+                                        index.state.put(index_key, remaining);
+    }
+
+    // Moves k from the index entry of its previous value (if any) to that of
+    // its new value (if any)
+    static void update_indexes(
+      Indexes& indexes,
+      const K& k,
+      const VersionV* previous,
+      const std::optional<V>& value)
+    {
+      for (auto& [_, index] : indexes)
+      {
+        const auto& extract = *index.extractor;
+        std::optional<K> previous_key = std::nullopt;
+        if (previous != nullptr && !is_deleted(previous->version))
+        {
+          previous_key = extract(previous->value);
+        }
+        std::optional<K> new_key = std::nullopt;
+        if (value.has_value())
+        {
+          new_key = extract(value.value());
+        }
+
+        if (previous_key == new_key)
+        {
+          continue;
+        }
+
+        if (previous_key.has_value())
+        {
+          remove_from_index(index, previous_key.value(), k);
+        }
+        if (new_key.has_value())
+        {
+          add_to_index(index, new_key.value(), k);
+        }
+      }
+    }
+
+    static Index build_index(
+      const std::shared_ptr<const IndexExtractor>& extractor,
+      const State& state)
+    {
+      Index index{extractor, {}};
+      state.foreach([&index](const K& k, const VersionV& v) {
+        if (!is_deleted(v.version))
+        {
+          const auto index_key = (*index.extractor)(v.value);
+          if (index_key.has_value())
+          {
+            add_to_index(index, index_key.value(), k);
+          }
+        }
+        return true;
+      });
+      return index;
+    }
+
+    // Recomputes every index of each commit in the roll from its state
+    void rebuild_indexes()
+    {
+      latest_stale = true;
+      for (auto c = roll.commits->get_head(); c != nullptr; c = c->next)
+      {
+        c->indexes.clear();
+        for (const auto& [name, extractor] : index_extractors)
+        {
+          c->indexes[name] = build_index(extractor, c->state);
+        }
+      }
+    }
+
+    static OrderedKeys get_ordered_keys(const State& state)
+    {
+      OrderedKeys keys;
+      state.foreach([&keys](const K& k, const VersionV&) {
+        keys = keys.put(k, {});
+        return true;
+      });
+      return keys;
+    }
 
   public:
     class HandleCommitter : public AbstractCommitter
@@ -98,6 +264,11 @@ namespace kv::untyped
       bool changes = false;
       bool committed_writes = false;
 
+      // Indices of the key locks held, in increasing order
+      std::vector<size_t> locked_keys;
+      bool all_keys_locked = false;
+      bool prepare_unlocked = false;
+
     public:
       HandleCommitter(Map& m, ChangeSet& change_set_) :
         map(m),
@@ -144,16 +315,33 @@ namespace kv::untyped
           return true;
         }
 
+        // If the map is not locked, only the keys of this transaction are, so
+        // the current state is read under a short map lock. Other keys may
+        // then be written concurrently, but are not checked here.
+        size_t rollback_counter;
+        Version current_version;
+        State current_state;
+        {
+          std::unique_lock<std::mutex> guard(map.sl, std::defer_lock);
+          if (prepare_unlocked)
+          {
+            guard.lock();
+          }
+          auto current = roll.commits->get_tail();
+          rollback_counter = roll.rollback_counter;
+          current_version = current->version;
+          current_state = current->state;
+        }
+
         // If the parent map has rolled back since this transaction began, this
         // transaction must fail.
-        if (change_set.rollback_counter != roll.rollback_counter)
+        if (change_set.rollback_counter != rollback_counter)
           return false;
 
         // If we have iterated over the map, check for a global version match.
-        auto current = roll.commits->get_tail();
         if (
           (change_set.read_version != NoVersion) &&
-          (change_set.read_version != current->version))
+          (change_set.read_version != current_version))
         {
           LOG_DEBUG_FMT("Read version {} is invalid", change_set.read_version);
           return false;
@@ -164,7 +352,7 @@ namespace kv::untyped
              ++it)
         {
           // Get the value from the current state.
-          auto search = current->state.get(it->first);
+          auto search = current_state.get(it->first);
 
           if (std::get<0>(it->second) == NoVersion)
           {
@@ -212,7 +400,7 @@ namespace kv::untyped
                it != change_set.writes.end();
                ++it)
           {
-            auto search = current->state.get(it->first);
+            auto search = current_state.get(it->first);
             if (search.has_value() && max_conflict_version != kv::NoVersion)
             {
               max_conflict_version = std::max(
@@ -243,8 +431,10 @@ namespace kv::untyped
           return;
         }
 
+        // All writes are applied to a transient copy of the current state, so
+        // that the nodes they create are only allocated once
         auto& roll = map.get_roll();
-        auto state = roll.commits->get_tail()->state;
+        auto state = roll.commits->get_tail()->state.transient();
 
         DeletableVersion v = static_cast<DeletableVersion>(v_);
 
@@ -260,14 +450,17 @@ namespace kv::untyped
             {
               continue;
             }
-            state = state.put(
-              it->first, VersionV{search->version, v_, search->value});
+            state.put(it->first, VersionV{search->version, v_, search->value});
           }
           if (change_set.writes.empty())
           {
             commit_version = change_set.start_version;
-            map.roll.commits->insert_back(map.roll.create_new_local_commit(
-              commit_version, std::move(state), change_set.writes));
+            auto c = map.roll.create_new_local_commit(
+              commit_version, state.persistent(), change_set.writes);
+            c->keys = roll.commits->get_tail()->keys;
+            c->indexes = roll.commits->get_tail()->indexes;
+            map.roll.commits->insert_back(c);
+            map.latest_stale = true;
             return;
           }
         }
@@ -276,6 +469,9 @@ namespace kv::untyped
         commit_version = v;
         committed_writes = true;
 
+        auto keys = roll.commits->get_tail()->keys;
+        auto indexes = roll.commits->get_tail()->indexes;
+
         for (auto it = change_set.writes.begin(); it != change_set.writes.end();
              ++it)
         {
@@ -283,25 +479,42 @@ namespace kv::untyped
           {
             // Write the new value with the global version.
             changes = true;
-            state = state.put(it->first, VersionV{v, v_, it->second.value()});
+            if (map.ordered && keys.getp(it->first) == nullptr)
+            {
+              keys = keys.put(it->first, {});
+            }
+            if (!indexes.empty())
+            {
+              update_indexes(
+                indexes, it->first, state.getp(it->first), it->second);
+            }
+            state.put(it->first, VersionV{v, v_, it->second.value()});
           }
           else
           {
             // Write an empty value with the deleted global version only if
             // the key exists.
-            auto search = state.get(it->first);
-            if (search.has_value())
+            auto search = state.getp(it->first);
+            if (search != nullptr)
             {
               changes = true;
-              state = state.put(it->first, VersionV{-v, v_, {}});
+              if (!indexes.empty())
+              {
+                update_indexes(indexes, it->first, search, std::nullopt);
+              }
+              state.put(it->first, VersionV{-v, v_, {}});
             }
           }
         }
 
         if (changes)
         {
-          map.roll.commits->insert_back(map.roll.create_new_local_commit(
-            v, std::move(state), change_set.writes));
+          auto c = map.roll.create_new_local_commit(
+            v, state.persistent(), change_set.writes);
+          c->keys = std::move(keys);
+          c->indexes = std::move(indexes);
+          map.roll.commits->insert_back(c);
+          map.latest_stale = true;
         }
       }
 
@@ -316,6 +529,65 @@ namespace kv::untyped
         return map.trigger_map_hook(commit_version, change_set.writes);
       }
 
+      bool depends_on_keys_only() override
+      {
+        // A transaction that has iterated over the map depends on all of its
+        // keys
+        return change_set.read_version == NoVersion;
+      }
+
+      void lock_keys(bool prepare_unlocked_) override
+      {
+        prepare_unlocked = prepare_unlocked_;
+        if (!depends_on_keys_only())
+        {
+          map.lock_all_keys();
+          all_keys_locked = true;
+          return;
+        }
+
+        const H hasher;
+        for (const auto& [k, _] : change_set.reads)
+        {
+          locked_keys.push_back(hasher(k) % key_lock_count);
+        }
+        for (const auto& [k, _] : change_set.writes)
+        {
+          locked_keys.push_back(hasher(k) % key_lock_count);
+        }
+        std::sort(locked_keys.begin(), locked_keys.end());
+        locked_keys.erase(
+          std::unique(locked_keys.begin(), locked_keys.end()),
+          locked_keys.end());
+
+        for (auto i : locked_keys)
+        {
+          map.key_locks[i].lock();
+        }
+      }
+
+      void unlock_keys() override
+      {
+        if (all_keys_locked)
+        {
+          map.unlock_all_keys();
+          all_keys_locked = false;
+          return;
+        }
+
+        for (auto it = locked_keys.rbegin(); it != locked_keys.rend(); ++it)
+        {
+          map.key_locks[*it].unlock();
+        }
+        locked_keys.clear();
+      }
+
+      bool revalidate() override
+      {
+        // The map may have rolled back since prepare()
+        return change_set.rollback_counter == map.roll.rollback_counter;
+      }
+
       void set_commit_version(Version v)
       {
         commit_version = v;
@@ -343,14 +615,23 @@ namespace kv::untyped
         map_snapshot(std::move(map_snapshot_))
       {}
 
-      void serialise(KvStoreSerialiser& s) override
+      std::pair<size_t, std::optional<size_t>> serialise_segment(
+        KvStoreSerialiser& s, size_t from, size_t max_size) override
       {
+        const auto [to, size] = map_snapshot.get_segment(from, max_size);
+
         s.start_map(name, security_domain);
         s.serialise_entry_version(version);
 
-        std::vector<uint8_t> ret(map_snapshot.get_serialized_size());
-        map_snapshot.serialize(ret.data());
+        std::vector<uint8_t> ret(size);
+        map_snapshot.serialize_segment(from, to, ret.data());
         s.serialise_raw(ret);
+
+        if (to < map_snapshot.size())
+        {
+          return {size, to};
+        }
+        return {size, std::nullopt};
       }
 
       SecurityDomain get_security_domain() override
@@ -367,15 +648,18 @@ namespace kv::untyped
       const std::string& name_,
       SecurityDomain security_domain_,
       bool replicated_,
-      bool include_conflict_read_version_) :
+      bool include_conflict_read_version_,
+      bool ordered_ = false) :
       AbstractMap(name_),
       store(store_),
       roll{std::make_unique<LocalCommits>(), 0, {}},
       security_domain(security_domain_),
       replicated(replicated_),
-      include_conflict_read_version(include_conflict_read_version_)
+      include_conflict_read_version(include_conflict_read_version_),
+      ordered(ordered_)
     {
       roll.reset_commits();
+      publish_latest();
     }
 
     Map(const Map& that) = delete;
@@ -387,7 +671,8 @@ namespace kv::untyped
         name,
         security_domain,
         replicated,
-        include_conflict_read_version);
+        include_conflict_read_version,
+        other->is_map_ordered(name));
     }
 
     void serialise_changes(
@@ -484,6 +769,27 @@ namespace kv::untyped
         return true;
       }
 
+      bool depends_on_keys_only() override
+      {
+        // Applying a snapshot replaces the whole map
+        return false;
+      }
+
+      void lock_keys(bool) override
+      {
+        map.lock_all_keys();
+      }
+
+      void unlock_keys() override
+      {
+        map.unlock_all_keys();
+      }
+
+      bool revalidate() override
+      {
+        return true;
+      }
+
       void commit(Version, bool) override
       {
         // Version argument is ignored. The version of the roll after the
@@ -491,11 +797,20 @@ namespace kv::untyped
         // snapshot was taken.
         map.roll.reset_commits();
         map.roll.rollback_counter++;
+        map.latest_stale = true;
 
         auto r = map.roll.commits->get_head();
 
         r->state = change_set.state;
         r->version = change_set.version;
+        if (map.ordered)
+        {
+          r->keys = get_ordered_keys(r->state);
+        }
+        for (const auto& [name, extractor] : map.index_extractors)
+        {
+          r->indexes[name] = build_index(extractor, r->state);
+        }
 
         // Executing hooks from snapshot requires copying the entire snapshotted
         // state so only do it if there's a hook on the table
@@ -518,14 +833,33 @@ namespace kv::untyped
       }
     };
 
-    ChangeSetPtr deserialise_snapshot_changes(KvStoreDeserialiser& d)
+    ChangeSetPtr deserialise_snapshot_changes(
+      KvStoreDeserialiser& d, const AbstractChangeSet* previous = nullptr)
     {
-      // Create a new empty change set, deserialising d's contents into it.
+      // Create a new empty change set, deserialising d's contents into it. If
+      // the map's snapshot was serialised in several segments, previous holds
+      // the change set deserialised from the segments before this one.
       auto v = d.deserialise_entry_version();
       auto map_snapshot = d.deserialise_raw();
 
+      State state;
+      if (previous != nullptr)
+      {
+        auto previous_snapshot =
+          dynamic_cast<const SnapshotChangeSet*>(previous);
+        if (previous_snapshot == nullptr || previous_snapshot->version != v)
+        {
+          throw std::logic_error(fmt::format(
+            "Snapshot segment of map {} at version {} does not follow the "
+            "previous segment",
+            name,
+            v));
+        }
+        state = previous_snapshot->state;
+      }
+
       return std::make_unique<SnapshotChangeSet>(
-        State::deserialize_map(map_snapshot), v);
+        State::deserialize_map(map_snapshot, std::move(state)), v);
     }
 
     ChangeSetPtr deserialise_changes(KvStoreDeserialiser& d, Version version)
@@ -619,6 +953,30 @@ namespace kv::untyped
       hook = nullptr;
     }
 
+    /** Define a secondary index over the values of this map, which is
+     * maintained as transactions are committed. Its state is derived from the
+     * map's on each node, and is not replicated. It is computed from the
+     * current state of the map when defined, and recomputed whenever a
+     * snapshot is applied.
+     *
+     * The Map expects to be locked while the index is defined.
+     *
+     * @param name Name of the index
+     * @param extractor function returning the index key of a value, if any
+     */
+    void set_index(const std::string& name, const IndexExtractor& extractor)
+    {
+      index_extractors[name] =
+        std::make_shared<const IndexExtractor>(extractor);
+      rebuild_indexes();
+    }
+
+    void unset_index(const std::string& name)
+    {
+      index_extractors.erase(name);
+      rebuild_indexes();
+    }
+
     /** Set handler to be called on global transaction commit
      *
      * @param hook function to be called on global transaction commit
@@ -729,7 +1087,7 @@ namespace kv::untyped
       }
 
       return std::make_unique<Snapshot>(
-        name, security_domain, r->version, StateSnapshot(r->state));
+        name, security_domain, r->version, StateSnapshot(r->state, ordered));
     }
 
     void compact(Version v) override
@@ -765,6 +1123,7 @@ namespace kv::untyped
 
         auto c = roll.commits->pop();
         roll.empty_commits.insert(c);
+        latest_stale = true;
       }
 
       // There is only one roll. We may need to call the commit hook.
@@ -810,7 +1169,10 @@ namespace kv::untyped
       }
 
       if (advance)
+      {
         roll.rollback_counter++;
+        latest_stale = true;
+      }
     }
 
     void clear() override
@@ -819,18 +1181,41 @@ namespace kv::untyped
       // The Map expects to be locked before clearing it.
       roll.reset_commits();
       roll.rollback_counter = 0;
+      latest_stale = true;
     }
 
     void lock() override
     {
       sl.lock();
+      ++lock_count;
     }
 
     void unlock() override
     {
+      if (latest_stale)
+      {
+        publish_latest();
+      }
+      ++lock_count;
       sl.unlock();
     }
 
+    void lock_all_keys()
+    {
+      for (auto& l : key_locks)
+      {
+        l.lock();
+      }
+    }
+
+    void unlock_all_keys()
+    {
+      for (auto it = key_locks.rbegin(); it != key_locks.rend(); ++it)
+      {
+        it->unlock();
+      }
+    }
+
     void swap(AbstractMap* map_) override
     {
       Map* map = dynamic_cast<Map*>(map_);
@@ -839,9 +1224,20 @@ namespace kv::untyped
           "Attempted to swap maps with incompatible types");
 
       std::swap(roll, map->roll);
+      std::swap(ordered, map->ordered);
+      latest_stale = true;
+      map->latest_stale = true;
+
+      // Indexes are defined per map, so are rebuilt over the swapped rolls
+      if (!index_extractors.empty() || !map->index_extractors.empty())
+      {
+        rebuild_indexes();
+        map->rebuild_indexes();
+      }
     }
 
-    ChangeSetPtr create_change_set(Version version)
+    ChangeSetPtr create_change_set(
+      Version version, const std::shared_ptr<ds::Arena>& arena = nullptr)
     {
       lock();
 
@@ -857,7 +1253,10 @@ namespace kv::untyped
             roll.rollback_counter,
             current->state,
             roll.commits->get_head()->state,
-            current->version);
+            current->version,
+            ordered ? std::make_optional(current->keys) : std::nullopt,
+            current->indexes,
+            arena);
           break;
         }
       }
@@ -869,6 +1268,53 @@ namespace kv::untyped
       return changes;
     }
 
+    /** Creates a change set over the latest state of this map, if it was
+     * committed at or before version, without locking the map. Reads through
+     * this change set are not recorded, so it cannot be committed.
+     *
+     * Any transaction writing this map holds its lock from before it is
+     * assigned a version until its writes are published. So if the map is not
+     * locked while its latest state is pinned, every write to it at or before
+     * version is visible. Otherwise, this falls back to create_change_set().
+     * Either way, the change set reflects the state of this map at version, so
+     * every map of a transaction is read at the same version.
+     */
+    ChangeSetPtr create_read_only_change_set(
+      Version version, const std::shared_ptr<ds::Arena>& arena = nullptr)
+    {
+      ChangeSetPtr changes = nullptr;
+
+      const auto count = lock_count.load();
+      if (count % 2 == 0)
+      {
+        const auto pinned = std::atomic_load(&latest);
+        if (
+          pinned != nullptr && lock_count.load() == count &&
+          pinned->version <= version)
+        {
+          changes = std::make_unique<untyped::ChangeSet>(
+            pinned->rollback_counter,
+            pinned->state,
+            pinned->committed,
+            pinned->version,
+            pinned->keys,
+            pinned->indexes,
+            arena);
+        }
+      }
+
+      if (changes == nullptr)
+      {
+        changes = create_change_set(version, arena);
+      }
+
+      if (changes != nullptr)
+      {
+        changes->record_reads = false;
+      }
+      return changes;
+    }
+
     Roll& get_roll()
     {
       return roll;
@@ -882,5 +1328,15 @@ namespace kv::untyped
       }
       return nullptr;
     }
+
+    ConsensusHookPtr trigger_map_hook(
+      Version version, const ChangeSetWrite& writes)
+    {
+      if (hook)
+      {
+        return hook(version, Write(writes.begin(), writes.end()));
+      }
+      return nullptr;
+    }
   };
 }
\ No newline at end of file
@@ -6,6 +6,10 @@
 #include "kv/kv_types.h"
 #include "kv/serialised_entry.h"
 
+#include <algorithm>
+#include <optional>
+#include <vector>
+
 namespace kv::untyped
 {
   using SerialisedEntry = kv::serialisers::SerialisedEntry;
@@ -16,6 +20,14 @@ namespace kv::untyped
     kv::State<SerialisedEntry, SerialisedEntry, SerialisedKeyHasher>;
   using Read = kv::Read<SerialisedEntry>;
   using Write = kv::Write<SerialisedEntry, SerialisedEntry>;
+  using ChangeSetWrite = kv::ChangeSetWrite<SerialisedEntry, SerialisedEntry>;
+  using OrderedKeys = kv::OrderedKeys<SerialisedEntry>;
+  using IndexExtractor = kv::IndexExtractor<SerialisedEntry, SerialisedEntry>;
+  using IndexedKeys = kv::IndexedKeys<SerialisedEntry, SerialisedKeyHasher>;
+  using Index =
+    kv::Index<SerialisedEntry, SerialisedEntry, SerialisedKeyHasher>;
+  using Indexes =
+    kv::Indexes<SerialisedEntry, SerialisedEntry, SerialisedKeyHasher>;
   using ChangeSet =
     kv::ChangeSet<SerialisedEntry, SerialisedEntry, SerialisedKeyHasher>;
   using ChangeSetPtr = std::unique_ptr<ChangeSet>;
@@ -63,14 +75,12 @@ namespace kv::untyped
       const auto search = tx_changes.state.getp(key);
       if (search == nullptr)
       {
-        tx_changes.reads.insert(
-          std::make_pair(key, std::make_tuple(NoVersion, NoVersion)));
+        record_read(key, NoVersion, NoVersion);
         return nullptr;
       }
 
       // Record the version that we depend on.
-      tx_changes.reads.insert(std::make_pair(
-        key, std::make_tuple(search->version, search->read_version)));
+      record_read(key, search->version, search->read_version);
 
       // If the key has been deleted, return empty.
       if (is_deleted(search->version))
@@ -82,6 +92,20 @@ namespace kv::untyped
       return &search->value;
     }
 
+    // Records that this transaction depends on key being at version, unless
+    // it is only read from
+    void record_read(
+      const KeyType& key,
+      DeletableVersion version,
+      LastReadVersion last_read_version)
+    {
+      if (tx_changes.record_reads)
+      {
+        tx_changes.reads.insert(
+          std::make_pair(key, std::make_tuple(version, last_read_version)));
+      }
+    }
+
   public:
     MapHandle(ChangeSet& cs, const std::string& map_name) :
       tx_changes(cs),
@@ -109,14 +133,12 @@ namespace kv::untyped
       const auto search = tx_changes.state.getp(key);
       if (search == nullptr)
       {
-        tx_changes.reads.insert(
-          std::make_pair(key, std::make_tuple(NoVersion, NoVersion)));
+        record_read(key, NoVersion, NoVersion);
         return std::nullopt;
       }
 
       // Record the version that we depend on.
-      tx_changes.reads.insert(std::make_pair(
-        key, std::make_tuple(search->version, search->read_version)));
+      record_read(key, search->version, search->read_version);
 
       // If the key has been deleted, return empty. NB: We still depend on this
       // version with the call above, but we don't distinguish deleted from
@@ -129,6 +151,12 @@ namespace kv::untyped
       return search->version;
     }
 
+    std::pair<size_t, Version> get_map_state_version() const
+    {
+      return std::make_pair(
+        tx_changes.rollback_counter, tx_changes.start_version);
+    }
+
     std::optional<ValueType> get_globally_committed(const KeyType& key)
     {
       // If there is no committed value, return empty.
@@ -162,7 +190,7 @@ namespace kv::untyped
     {
       LOG_TRACE_FMT("KV[{}]::put({}, {})", map_name, key, value);
       // Record in the write set.
-      tx_changes.writes[key] = value;
+      tx_changes.set_write(key, value);
     }
 
     bool remove(const KeyType& key)
@@ -177,12 +205,12 @@ namespace kv::untyped
         {
           // this key only exists locally, there is no reason to maintain and
           // serialise it
-          tx_changes.writes.erase(key);
+          tx_changes.erase_write(key);
         }
         else
         {
           // If we have written, change the write set to indicate a remove.
-          write->second = std::nullopt;
+          tx_changes.set_write(key, std::nullopt);
         }
 
         return true;
@@ -195,7 +223,7 @@ namespace kv::untyped
       }
 
       // Record in the write set.
-      tx_changes.writes[key] = std::nullopt;
+      tx_changes.set_write(key, std::nullopt);
       return true;
     }
 
@@ -216,8 +244,9 @@ namespace kv::untyped
       // Take a snapshot copy of the writes. This is what we will iterate over,
       // while any additional modifications made by the functor will modify the
       // original tx_changes.writes, and be visible outside of the functor's
-      // args
-      auto w = tx_changes.writes;
+      // args. The copy is not allocated from the transaction's arena, so that
+      // it is freed on return.
+      const Write w(tx_changes.writes.begin(), tx_changes.writes.end());
       bool should_continue = true;
 
       tx_changes.state.foreach(
@@ -249,6 +278,190 @@ namespace kv::untyped
       }
     }
 
+    // Calls f on each entry with a key in [from, to), in key order, until f
+    // returns false. If to is nullopt, the range has no upper bound. Like
+    // foreach, this records a dependency on the whole map, and does not visit
+    // modifications made by f.
+    template <class F>
+    void range(
+      const KeyType& from, const std::optional<KeyType>& to, F&& f)
+    {
+      // Record a global read dependency.
+      tx_changes.read_version = tx_changes.start_version;
+
+      if (to.has_value() && !(from < to.value()))
+      {
+        return;
+      }
+
+      // Snapshot copy of this transaction's writes within the range, as in
+      // foreach
+      const Write w(
+        tx_changes.writes.lower_bound(from),
+        to.has_value() ? tx_changes.writes.lower_bound(to.value()) :
+                         tx_changes.writes.end());
+      auto write = w.begin();
+      bool should_continue = true;
+
+      // Visits the writes ordered before k, then k itself, which is present in
+      // the state. Returns false once the range or the iteration is finished.
+      auto visit = [&](const KeyType& k) {
+        if (to.has_value() && !(k < to.value()))
+        {
+          return false;
+        }
+
+        for (; write != w.end() && write->first < k; ++write)
+        {
+          if (write->second.has_value())
+          {
+            should_continue = f(write->first, write->second.value());
+            if (!should_continue)
+            {
+              return false;
+            }
+          }
+        }
+
+        if (write != w.end() && !(k < write->first))
+        {
+          // Overwritten or removed by this transaction
+          if (write->second.has_value())
+          {
+            should_continue = f(write->first, write->second.value());
+          }
+          ++write;
+          return should_continue;
+        }
+
+        auto v = tx_changes.state.getp(k);
+        if (v != nullptr && !is_deleted(v->version))
+        {
+          should_continue = f(k, v->value);
+        }
+        return should_continue;
+      };
+
+      if (tx_changes.keys.has_value())
+      {
+        tx_changes.keys->foreach_from(
+          from, [&visit](const KeyType& k, const auto&) { return visit(k); });
+      }
+      else
+      {
+        // The map is not ordered, so the range must be found by scanning all
+        // of its keys
+        std::vector<KeyType> keys;
+        tx_changes.state.foreach([&](const KeyType& k, const VersionV&) {
+          if (!(k < from) && (!to.has_value() || k < to.value()))
+          {
+            keys.push_back(k);
+          }
+          return true;
+        });
+        std::sort(keys.begin(), keys.end());
+
+        for (const auto& k : keys)
+        {
+          if (!visit(k))
+          {
+            break;
+          }
+        }
+      }
+
+      if (should_continue)
+      {
+        for (; write != w.end(); ++write)
+        {
+          if (write->second.has_value())
+          {
+            if (!f(write->first, write->second.value()))
+            {
+              break;
+            }
+          }
+        }
+      }
+    }
+
+    // Returns the first entry with a key not less than key, if there is one
+    std::optional<std::pair<KeyType, ValueType>> lower_bound(
+      const KeyType& key)
+    {
+      std::optional<std::pair<KeyType, ValueType>> entry = std::nullopt;
+      range(key, std::nullopt, [&entry](const KeyType& k, const ValueType& v) {
+        entry = std::make_pair(k, v);
+        return false;
+      });
+      return entry;
+    }
+
+    // Calls f on each entry whose key starts with prefix, in key order, until
+    // f returns false
+    template <class F>
+    void foreach_prefix(const KeyType& prefix, F&& f)
+    {
+      range(prefix, std::nullopt, [&](const KeyType& k, const ValueType& v) {
+        return k.size() >= prefix.size() &&
+          std::equal(prefix.begin(), prefix.end(), k.begin()) && f(k, v);
+      });
+    }
+
+    // Calls f on each entry whose value the named index maps to index_key,
+    // until f returns false. This includes the entries written by this
+    // transaction. Since other transactions may concurrently add entries to
+    // the index, this records a dependency on the whole map, like foreach.
+    template <class F>
+    void foreach_indexed(
+      const std::string& index_name, const KeyType& index_key, F&& f)
+    {
+      const auto index = tx_changes.indexes.find(index_name);
+      if (index == tx_changes.indexes.end())
+      {
+        throw std::logic_error(
+          fmt::format("Map {} has no index {}", map_name, index_name));
+      }
+
+      // Record a global read dependency.
+      tx_changes.read_version = tx_changes.start_version;
+
+      // Snapshot copy of the writes, as in foreach
+      const Write w(tx_changes.writes.begin(), tx_changes.writes.end());
+      bool should_continue = true;
+
+      auto keys = index->second.state.getp(index_key);
+      if (keys != nullptr)
+      {
+        keys->foreach([&](const KeyType& k, const auto&) {
+          if (w.find(k) == w.end())
+          {
+            auto v = tx_changes.state.getp(k);
+            if (v != nullptr && !is_deleted(v->version))
+            {
+              should_continue = f(k, v->value);
+            }
+          }
+          return should_continue;
+        });
+      }
+
+      if (should_continue)
+      {
+        const auto& extract = *index->second.extractor;
+        for (const auto& [k, v] : w)
+        {
+          if (v.has_value() && extract(v.value()) == index_key)
+          {
+            if (!f(k, v.value()))
+            {
+              break;
+            }
+          }
+        }
+      }
+    }
+
     size_t size()
     {
       size_t size_ = 0;
@@ -104,6 +104,8 @@ namespace ccf
       "public:ccf.internal.snapshot_evidence";
     static constexpr auto SIGNATURES = "public:ccf.internal.signatures";
     static constexpr auto SERIALISED_MERKLE_TREE = "public:ccf.internal.tree";
+    static constexpr auto SERIALISED_MERKLE_TREE_DELTA =
+      "public:ccf.internal.tree_delta";
     static constexpr auto VALUES = "public:ccf.internal.values";
 
     // Consensus
@@ -5,6 +5,8 @@
 #include "ccf/historical_queries_interface.h"
 #include "consensus/ledger_enclave_types.h"
 #include "ds/ccf_assert.h"
+#include "ds/lru.h"
+#include "kv/serialised_entry_format.h"
 #include "kv/store.h"
 #include "node/encryptor.h"
 #include "node/history.h"
@@ -26,12 +28,21 @@ namespace ccf::historical
     return signatures->get();
   }
 
+  // Returns the full serialised tree recorded by a signature, or its delta from
+  // the last full tree
   static std::optional<std::vector<uint8_t>> get_tree(const StorePtr& sig_store)
   {
     auto tx = sig_store->create_read_only_tx();
     auto tree =
       tx.ro<ccf::SerialisedMerkleTree>(ccf::Tables::SERIALISED_MERKLE_TREE);
-    return tree->get();
+    if (tree->has())
+    {
+      return tree->get();
+    }
+
+    auto tree_delta = tx.ro<ccf::SerialisedMerkleTreeDelta>(
+      ccf::Tables::SERIALISED_MERKLE_TREE_DELTA);
+    return tree_delta->get();
   }
 
   class StateCache : public AbstractStateCache
@@ -87,6 +98,8 @@ namespace ccf::historical
       crypto::Sha256Hash entry_digest = {};
       StorePtr store = nullptr;
       bool is_signature = false;
+      // Only set for signatures, to the full serialised tree they recorded
+      std::vector<uint8_t> tree = {};
       TxReceiptPtr receipt = nullptr;
       ccf::TxID transaction_id;
     };
@@ -224,7 +237,7 @@ namespace ccf::historical
           // Iterate through earlier indices. If this signature covers them (and
           // the digests match), move them to Trusted
           const auto sig = get_signature(new_details->store);
-          ccf::MerkleTreeHistory tree(get_tree(new_details->store).value());
+          ccf::MerkleTreeHistory tree(new_details->tree);
 
           for (auto seqno = first_requested_seqno; seqno < new_seqno; ++seqno)
           {
@@ -282,7 +295,7 @@ namespace ccf::historical
               if (details->store != nullptr && details->is_signature)
               {
                 const auto sig = get_signature(details->store);
-                ccf::MerkleTreeHistory tree(get_tree(details->store).value());
+                ccf::MerkleTreeHistory tree(details->tree);
                 if (tree.in_range(new_seqno))
                 {
                   const auto trusted_digest = tree.get_leaf(new_seqno);
@@ -312,7 +325,7 @@ namespace ccf::historical
             if (details->store != nullptr && details->is_signature)
             {
               const auto sig = get_signature(details->store);
-              ccf::MerkleTreeHistory tree(get_tree(details->store).value());
+              ccf::MerkleTreeHistory tree(details->tree);
               if (tree.in_range(new_seqno))
               {
                 const auto trusted_digest = tree.get_leaf(new_seqno);
@@ -357,22 +370,89 @@ namespace ccf::historical
 
     std::set<ccf::SeqNo> pending_fetches;
 
+    // Full trees recorded by recently fetched signatures, which signatures
+    // recording deltas extend
+    static constexpr size_t max_full_trees = 16;
+    LRU<ccf::SeqNo, std::vector<uint8_t>> full_trees{max_full_trees};
+
+    // Signature entries whose tree is a delta from a full tree which is not
+    // known yet, by seqno of the signature recording that full tree
+    std::map<ccf::SeqNo, std::vector<std::pair<ccf::SeqNo, LedgerEntry>>>
+      awaiting_full_tree;
+
     ExpiryDuration default_expiry_duration = std::chrono::seconds(1800);
 
-    void fetch_entry_at(ccf::SeqNo seqno)
+    void request_entries_from_host(ccf::SeqNo from, ccf::SeqNo to)
     {
-      const auto ib = pending_fetches.insert(seqno);
-      if (ib.second)
+      if (from == to)
       {
-        // Newly requested seqno
         RINGBUFFER_WRITE_MESSAGE(
           consensus::ledger_get,
           to_host,
-          static_cast<consensus::Index>(seqno),
+          static_cast<consensus::Index>(from),
+          consensus::LedgerRequestPurpose::HistoricalQuery);
+      }
+      else
+      {
+        RINGBUFFER_WRITE_MESSAGE(
+          consensus::ledger_get_range,
+          to_host,
+          static_cast<consensus::Index>(from),
+          static_cast<consensus::Index>(to),
           consensus::LedgerRequestPurpose::HistoricalQuery);
       }
     }
 
+    // Requests all entries in [from, to] that are not already being fetched,
+    // with a single request to the host per contiguous run
+    void fetch_entries_range(ccf::SeqNo from, ccf::SeqNo to)
+    {
+      std::optional<ccf::SeqNo> run_start = std::nullopt;
+      for (auto seqno = from; seqno <= to; ++seqno)
+      {
+        const auto ib = pending_fetches.insert(seqno);
+        if (ib.second)
+        {
+          // Newly requested seqno
+          if (!run_start.has_value())
+          {
+            run_start = seqno;
+          }
+        }
+        else if (run_start.has_value())
+        {
+          request_entries_from_host(run_start.value(), seqno - 1);
+          run_start.reset();
+        }
+      }
+
+      if (run_start.has_value())
+      {
+        request_entries_from_host(run_start.value(), to);
+      }
+    }
+
+    void fetch_entry_at(ccf::SeqNo seqno)
+    {
+      fetch_entries_range(seqno, seqno);
+    }
+
+    // Fetches a (sorted) set of seqnos, coalescing contiguous seqnos
+    void fetch_entries(const std::set<ccf::SeqNo>& seqnos)
+    {
+      auto it = seqnos.begin();
+      while (it != seqnos.end())
+      {
+        const auto run_start = *it;
+        auto run_end = run_start;
+        while (++it != seqnos.end() && *it == run_end + 1)
+        {
+          run_end = *it;
+        }
+        fetch_entries_range(run_start, run_end);
+      }
+    }
+
     std::optional<ccf::NodeInfo> get_node_info(const ccf::NodeId& node_id)
     {
       // Current solution: Use current state of Nodes table from real store.
@@ -385,8 +465,11 @@ namespace ccf::historical
     }
 
     // Returns true if this is a valid signature that passes our verification
-    // checks
-    bool verify_signature(const StorePtr& sig_store, ccf::SeqNo sig_seqno)
+    // checks, given the full tree it recorded
+    bool verify_signature(
+      const StorePtr& sig_store,
+      const std::vector<uint8_t>& serialised_tree,
+      ccf::SeqNo sig_seqno)
     {
       const auto sig = get_signature(sig_store);
       if (!sig.has_value())
@@ -395,15 +478,8 @@ namespace ccf::historical
         return false;
       }
 
-      const auto tree_ = get_tree(sig_store);
-      if (!tree_.has_value())
-      {
-        LOG_FAIL_FMT("Signature at {}: Missing tree value", sig_seqno);
-        return false;
-      }
-
       // Build tree from signature
-      ccf::MerkleTreeHistory tree(tree_.value());
+      ccf::MerkleTreeHistory tree(serialised_tree);
       const auto real_root = tree.get_root();
       if (real_root != sig->root)
       {
@@ -468,7 +544,8 @@ namespace ccf::historical
       const StorePtr& store,
       const crypto::Sha256Hash& entry_digest,
       ccf::SeqNo seqno,
-      bool is_signature)
+      bool is_signature,
+      const std::vector<uint8_t>& tree)
     {
       auto request_it = requests.begin();
       while (request_it != requests.end())
@@ -503,12 +580,8 @@ namespace ccf::historical
           {
             // Newly have all required secrets - begin fetching the actual
             // entries
-            for (auto seqno = request.first_requested_seqno;
-                 seqno <= request.last_requested_seqno;
-                 ++seqno)
-            {
-              fetch_entry_at(seqno);
-            }
+            fetch_entries_range(
+              request.first_requested_seqno, request.last_requested_seqno);
           }
 
           // In either case, done with this request, try the next
@@ -544,6 +617,8 @@ namespace ccf::historical
           details->is_signature = is_signature;
           if (is_signature)
           {
+            details->tree = tree;
+
             // Construct a signature receipt
             const auto sig = get_signature(details->store);
             assert(sig.has_value());
@@ -660,10 +735,7 @@ namespace ccf::historical
         // If we have sufficiently early secrets, begin fetching any newly
         // requested entries. If we don't fall into this branch, they'll only
         // begin to be fetched once the secret arrives.
-        for (const auto new_seqno : new_indices)
-        {
-          fetch_entry_at(new_seqno);
-        }
+        fetch_entries(new_indices);
       }
 
       // Reset the expiry timer as this has just been requested
@@ -773,6 +845,31 @@ namespace ccf::historical
       ccf::SeqNo start_seqno,
       ccf::SeqNo end_seqno,
       ExpiryDuration seconds_until_expiry) override
+    {
+      auto range =
+        get_state_range(handle, start_seqno, end_seqno, seconds_until_expiry);
+      std::vector<StorePtr> stores;
+      for (size_t i = 0; i < range.size(); i++)
+      {
+        stores.push_back(range[i]->store);
+      }
+      return stores;
+    }
+
+    std::vector<StorePtr> get_store_range(
+      RequestHandle handle,
+      ccf::SeqNo start_seqno,
+      ccf::SeqNo end_seqno) override
+    {
+      return get_store_range(
+        handle, start_seqno, end_seqno, default_expiry_duration);
+    }
+
+    std::vector<StatePtr> get_state_range(
+      RequestHandle handle,
+      ccf::SeqNo start_seqno,
+      ccf::SeqNo end_seqno,
+      ExpiryDuration seconds_until_expiry) override
     {
       if (end_seqno < start_seqno)
       {
@@ -783,22 +880,16 @@ namespace ccf::historical
       }
 
       const auto tail_length = end_seqno - start_seqno;
-      auto range = get_store_range_internal(
+      return get_store_range_internal(
         handle, start_seqno, tail_length, seconds_until_expiry);
-      std::vector<StorePtr> stores;
-      for (size_t i = 0; i < range.size(); i++)
-      {
-        stores.push_back(range[i]->store);
-      }
-      return stores;
     }
 
-    std::vector<StorePtr> get_store_range(
+    std::vector<StatePtr> get_state_range(
       RequestHandle handle,
       ccf::SeqNo start_seqno,
       ccf::SeqNo end_seqno) override
     {
-      return get_store_range(
+      return get_state_range(
         handle, start_seqno, end_seqno, default_expiry_duration);
     }
 
@@ -826,6 +917,39 @@ namespace ccf::historical
 
       pending_fetches.erase(it);
 
+      const auto result = process_ledger_entry(seqno, data);
+
+      // Signatures recording a delta from the full tree at this seqno can now
+      // be processed, or must be given up on
+      const auto awaiting_it = awaiting_full_tree.find(seqno);
+      if (awaiting_it != awaiting_full_tree.end())
+      {
+        const auto awaiting = std::move(awaiting_it->second);
+        awaiting_full_tree.erase(awaiting_it);
+
+        for (const auto& [awaiting_seqno, awaiting_data] : awaiting)
+        {
+          if (!full_trees.contains(seqno))
+          {
+            LOG_FAIL_FMT(
+              "Signature at {}: No full tree at {} to resolve its delta from",
+              awaiting_seqno,
+              seqno);
+            delete_all_interested_requests(awaiting_seqno);
+          }
+          else
+          {
+            process_ledger_entry(awaiting_seqno, awaiting_data);
+          }
+        }
+      }
+
+      return result;
+    }
+
+    // Called with requests_lock held
+    bool process_ledger_entry(ccf::SeqNo seqno, const LedgerEntry& data)
+    {
       // Create a new store and try to deserialise this entry into it
       StorePtr store = std::make_shared<kv::Store>(
         false /* Do not start from very first seqno */,
@@ -881,15 +1005,57 @@ namespace ccf::historical
 
       const auto is_signature =
         deserialise_result == kv::ApplyResult::PASS_SIGNATURE;
+      std::vector<uint8_t> tree = {};
       if (is_signature)
       {
+        auto tree_ = get_tree(store);
+        if (!tree_.has_value())
+        {
+          LOG_FAIL_FMT("Signature at {}: Missing tree value", seqno);
+          delete_all_interested_requests(seqno);
+          return false;
+        }
+        tree = std::move(tree_.value());
+
+        const auto is_delta = ccf::is_tree_delta(tree);
+        if (is_delta)
+        {
+          // The full tree this extends is recorded by an earlier signature,
+          // which must be fetched before this can be verified
+          const auto keyframe = ccf::get_tree_delta_keyframe(tree);
+          const auto full_tree = full_trees.find(keyframe);
+          if (full_tree == full_trees.end())
+          {
+            awaiting_full_tree[keyframe].emplace_back(seqno, data);
+            fetch_entry_at(keyframe);
+            return true;
+          }
+
+          try
+          {
+            tree = ccf::MerkleTreeHistory::resolve_delta(
+              tree, full_tree->second);
+          }
+          catch (const std::exception& e)
+          {
+            LOG_FAIL_FMT("Signature at {}: {}", seqno, e.what());
+            delete_all_interested_requests(seqno);
+            return false;
+          }
+        }
+
         // This looks like a signature - check that we trust it
-        if (!verify_signature(store, seqno))
+        if (!verify_signature(store, tree, seqno))
         {
           LOG_FAIL_FMT("Bad signature at {}", seqno);
           delete_all_interested_requests(seqno);
           return false;
         }
+
+        if (!is_delta)
+        {
+          full_trees.insert(seqno, std::vector<uint8_t>(tree));
+        }
       }
 
       LOG_DEBUG_FMT(
@@ -897,11 +1063,65 @@ namespace ccf::historical
         seqno,
         (size_t)deserialise_result);
       const auto entry_digest = crypto::Sha256Hash(data);
-      process_deserialised_store(store, entry_digest, seqno, is_signature);
+      process_deserialised_store(
+        store, entry_digest, seqno, is_signature, tree);
 
       return true;
     }
 
+    // Handles contiguous framed entries in [from, to], as sent by the host in
+    // response to a range request. Returns the number of accepted entries.
+    size_t handle_ledger_entries(
+      ccf::SeqNo from, ccf::SeqNo to, const LedgerEntry& framed_entries)
+    {
+      const uint8_t* data = framed_entries.data();
+      size_t size = framed_entries.size();
+      size_t accepted = 0;
+
+      for (auto seqno = from; seqno <= to; ++seqno)
+      {
+        if (size < kv::serialised_entry_header_size)
+        {
+          LOG_FAIL_FMT(
+            "Range of historical entries {}-{} is truncated at {}",
+            from,
+            to,
+            seqno);
+          handle_no_entry_range(seqno, to);
+          break;
+        }
+
+        auto header = serialized::peek<kv::SerialisedEntryHeader>(data, size);
+        const auto entry_size = kv::serialised_entry_header_size + header.size;
+        if (size < entry_size)
+        {
+          LOG_FAIL_FMT(
+            "Range of historical entries {}-{} is truncated at {}",
+            from,
+            to,
+            seqno);
+          handle_no_entry_range(seqno, to);
+          break;
+        }
+
+        if (handle_ledger_entry(seqno, LedgerEntry(data, data + entry_size)))
+        {
+          accepted++;
+        }
+        serialized::skip(data, size, entry_size);
+      }
+
+      return accepted;
+    }
+
+    void handle_no_entry_range(ccf::SeqNo from, ccf::SeqNo to)
+    {
+      for (auto seqno = from; seqno <= to; ++seqno)
+      {
+        handle_no_entry(seqno);
+      }
+    }
+
     void handle_no_entry(ccf::SeqNo seqno)
     {
       std::lock_guard<std::mutex> guard(requests_lock);
@@ -917,6 +1137,16 @@ namespace ccf::historical
 
         pending_fetches.erase(fetches_it);
       }
+
+      const auto awaiting_it = awaiting_full_tree.find(seqno);
+      if (awaiting_it != awaiting_full_tree.end())
+      {
+        for (const auto& [awaiting_seqno, _] : awaiting_it->second)
+        {
+          delete_all_interested_requests(awaiting_seqno);
+        }
+        awaiting_full_tree.erase(awaiting_it);
+      }
     }
 
     void tick(const std::chrono::milliseconds& elapsed_ms)
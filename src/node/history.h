@@ -3,6 +3,7 @@
 #pragma once
 
 #include "crypto/hash.h"
+#include "crypto/sha256_multi.h"
 #include "crypto/verifier.h"
 #include "ds/dl_list.h"
 #include "ds/logger.h"
@@ -181,6 +182,11 @@ namespace ccf
 
     void try_emit_signature() override {}
 
+    bool sign_frozen_signature() override
+    {
+      return false;
+    }
+
     bool add_request(
       kv::TxHistory::RequestID,
       const std::vector<uint8_t>&,
@@ -218,8 +224,129 @@ namespace ccf
       return {};
     }
   };
+}
+
+namespace ccf
+{
+  /** Merkle tree of the ledger. This is merklecpp's tree with SHA-256 node
+   * hashes, except that its dirty nodes are hashed a level at a time, with
+   * the fastest batched SHA-256 kernel supported by the CPU (see
+   * crypto::sha256_pairs()), before its root, paths or serialisation are
+   * extracted, or it is flushed. These are the same as those of the base tree.
+   */
+  class HistoryTree : public merkle::TreeT<32, merkle::sha256_openssl>
+  {
+    using Base = merkle::TreeT<32, merkle::sha256_openssl>;
+
+    // Dirty nodes to hash, by height, and the arguments of
+    // crypto::sha256_pairs() for each chunk of a level
+    std::vector<Node*> dirty_stack;
+    std::vector<std::vector<Node*>> dirty_levels;
+    static constexpr size_t chunk_size = 64;
+    const uint8_t* lefts[chunk_size];
+    const uint8_t* rights[chunk_size];
+    uint8_t* outputs[chunk_size];
+
+    void hash_dirty_levels()
+    {
+      insert_leaves(true);
+      if (_root == nullptr || !_root->dirty)
+      {
+        return;
+      }
+
+      // Children always have a smaller height than their parent, so all dirty
+      // nodes of one height can be hashed at once, starting with the lowest
+      if (dirty_levels.size() < _root->height)
+      {
+        dirty_levels.resize(_root->height);
+      }
+
+      dirty_stack.push_back(_root);
+      while (!dirty_stack.empty())
+      {
+        auto n = dirty_stack.back();
+        dirty_stack.pop_back();
+        dirty_levels[n->height - 1].push_back(n);
+        if (n->left->dirty)
+        {
+          dirty_stack.push_back(n->left);
+        }
+        if (n->right->dirty)
+        {
+          dirty_stack.push_back(n->right);
+        }
+      }
+
+      for (auto& level : dirty_levels)
+      {
+        for (size_t i = 0; i < level.size(); i += chunk_size)
+        {
+          const auto count = std::min(chunk_size, level.size() - i);
+          for (size_t j = 0; j < count; ++j)
+          {
+            const auto n = level[i + j];
+            lefts[j] = n->left->hash.bytes;
+            rights[j] = n->right->hash.bytes;
+            outputs[j] = n->hash.bytes;
+          }
+          crypto::sha256_pairs(lefts, rights, outputs, count);
+        }
+
+        statistics.num_hash += level.size();
+        for (auto n : level)
+        {
+          n->dirty = false;
+        }
+        level.clear();
+      }
+    }
 
-  typedef merkle::TreeT<32, merkle::sha256_openssl> HistoryTree;
+  public:
+    using Base::Base;
+
+    const Hash& root()
+    {
+      hash_dirty_levels();
+      return Base::root();
+    }
+
+    std::shared_ptr<Hash> past_root(size_t index)
+    {
+      hash_dirty_levels();
+      return Base::past_root(index);
+    }
+
+    std::shared_ptr<Path> path(size_t index)
+    {
+      hash_dirty_levels();
+      return Base::path(index);
+    }
+
+    std::shared_ptr<Path> past_path(size_t index, size_t as_of)
+    {
+      hash_dirty_levels();
+      return Base::past_path(index, as_of);
+    }
+
+    void flush_to(size_t index)
+    {
+      hash_dirty_levels();
+      Base::flush_to(index);
+    }
+
+    void serialise(std::vector<uint8_t>& bytes)
+    {
+      hash_dirty_levels();
+      Base::serialise(bytes);
+    }
+
+    void serialise(size_t from, size_t to, std::vector<uint8_t>& bytes)
+    {
+      hash_dirty_levels();
+      Base::serialise(from, to, bytes);
+    }
+  };
 
   class Proof
   {
@@ -281,6 +408,44 @@ namespace ccf
     }
   };
 
+  // With tree keyframes, only every so many signatures record the full
+  // serialised Merkle tree. The others record a delta from the last one which
+  // did (see MerkleTreeHistory::serialise_delta()), which starts with a marker
+  // that cannot be the leaf count of a full tree, followed by the seqno of the
+  // signature recording the full tree it extends.
+  static constexpr uint64_t tree_delta_marker = UINT64_MAX;
+  static constexpr size_t tree_delta_header_size = 2 * sizeof(uint64_t);
+
+  static bool is_tree_delta(const std::vector<uint8_t>& serialised)
+  {
+    size_t position = 0;
+    return serialised.size() >= tree_delta_header_size &&
+      merkle::deserialise_uint64_t(serialised, position) == tree_delta_marker;
+  }
+
+  static ccf::SeqNo get_tree_delta_keyframe(const std::vector<uint8_t>& delta)
+  {
+    size_t position = sizeof(uint64_t);
+    return merkle::deserialise_uint64_t(delta, position);
+  }
+
+  template <typename Tx>
+  static void put_serialised_tree(Tx& tx, std::vector<uint8_t>&& serialised)
+  {
+    if (is_tree_delta(serialised))
+    {
+      auto tree_delta = tx.template rw<ccf::SerialisedMerkleTreeDelta>(
+        ccf::Tables::SERIALISED_MERKLE_TREE_DELTA);
+      tree_delta->put(std::move(serialised));
+    }
+    else
+    {
+      auto tree = tx.template rw<ccf::SerialisedMerkleTree>(
+        ccf::Tables::SERIALISED_MERKLE_TREE);
+      tree->put(std::move(serialised));
+    }
+  }
+
   template <class T>
   class MerkleTreeHistoryPendingTx : public kv::PendingTx
   {
@@ -312,8 +477,6 @@ namespace ccf
       auto sig = store.create_reserved_tx(txid);
       auto signatures =
         sig.template rw<ccf::Signatures>(ccf::Tables::SIGNATURES);
-      auto serialised_tree = sig.template rw<ccf::SerialisedMerkleTree>(
-        ccf::Tables::SERIALISED_MERKLE_TREE);
       crypto::Sha256Hash root = history.get_replicated_state_root();
 
       Nonce hashed_nonce;
@@ -365,12 +528,45 @@ namespace ccf
       }
 
       signatures->put(sig_value);
-      serialised_tree->put(
+      put_serialised_tree(
+        sig,
         history.serialise_tree(commit_txid.previous_version, txid.version - 1));
       return sig.commit_reserved();
     }
   };
 
+  // Signature transaction whose root has already been signed, and whose tree
+  // has already been serialised, when it is committed
+  class PreparedSignaturePendingTx : public kv::PendingTx
+  {
+    kv::TxID txid;
+    kv::Store& store;
+    PrimarySignature sig_value;
+    std::vector<uint8_t> serialised_tree;
+
+  public:
+    PreparedSignaturePendingTx(
+      kv::TxID txid_,
+      kv::Store& store_,
+      PrimarySignature&& sig_value_,
+      std::vector<uint8_t>&& serialised_tree_) :
+      txid(txid_),
+      store(store_),
+      sig_value(std::move(sig_value_)),
+      serialised_tree(std::move(serialised_tree_))
+    {}
+
+    kv::PendingTxInfo call() override
+    {
+      auto sig = store.create_reserved_tx(txid);
+      auto signatures =
+        sig.template rw<ccf::Signatures>(ccf::Tables::SIGNATURES);
+      signatures->put(sig_value);
+      put_serialised_tree(sig, std::move(serialised_tree));
+      return sig.commit_reserved();
+    }
+  };
+
   class MerkleTreeHistory
   {
     HistoryTree* tree;
@@ -474,6 +670,127 @@ namespace ccf
       return output;
     }
 
+    /** Serialises the leaves from @p from to @p to as a delta from the full
+     * tree of the leaves from @p keyframe_from to @p keyframe_to, recorded by
+     * the signature at @p keyframe. The delta only holds the leaves after
+     * @p keyframe_to, and the nodes on the left edge of the tree which are
+     * not on that of the keyframe's tree.
+     */
+    std::vector<uint8_t> serialise_delta(
+      size_t from,
+      size_t to,
+      ccf::SeqNo keyframe,
+      size_t keyframe_from,
+      size_t keyframe_to)
+    {
+      if (from < keyframe_from || to <= keyframe_to)
+      {
+        throw std::logic_error(fmt::format(
+          "Cannot serialise leaves {}-{} as a delta from leaves {}-{}",
+          from,
+          to,
+          keyframe_from,
+          keyframe_to));
+      }
+
+      std::vector<uint8_t> output;
+      merkle::serialise_uint64_t(tree_delta_marker, output);
+      merkle::serialise_uint64_t(keyframe, output);
+      merkle::serialise_uint64_t(to - from + 1, output);
+      merkle::serialise_uint64_t(from, output);
+      for (auto i = std::max(from, keyframe_to + 1); i <= to; ++i)
+      {
+        tree->leaf(i).serialise(output);
+      }
+
+      // A single leaf serialised from from is followed by the left edge of
+      // the tree at from, of which only the nodes not shared with the
+      // keyframe's tree are kept
+      std::vector<uint8_t> left_edge;
+      tree->serialise(from, from, left_edge);
+      const auto left_edge_begin =
+        left_edge.begin() + 2 * sizeof(uint64_t) + crypto::Sha256Hash::SIZE;
+      output.insert(
+        output.end(),
+        left_edge_begin,
+        left_edge.end() -
+          shared_frontier_size(from, keyframe_from) * crypto::Sha256Hash::SIZE);
+
+      LOG_TRACE_FMT(
+        "mt_serialize_delta_size ({},{}) {}", from, to, output.size());
+      return output;
+    }
+
+    /** Restores the full serialised tree from @p delta and the full tree it
+     * extends, @p keyframe_tree
+     */
+    static std::vector<uint8_t> resolve_delta(
+      const std::vector<uint8_t>& delta,
+      const std::vector<uint8_t>& keyframe_tree)
+    {
+      constexpr auto header_size = 2 * sizeof(uint64_t);
+      constexpr auto hash_size = crypto::Sha256Hash::SIZE;
+      if (
+        !is_tree_delta(delta) ||
+        delta.size() < tree_delta_header_size + header_size ||
+        keyframe_tree.size() < header_size)
+      {
+        throw std::logic_error("Invalid serialised tree delta");
+      }
+
+      size_t position = tree_delta_header_size;
+      const auto count = merkle::deserialise_uint64_t(delta, position);
+      const auto from = merkle::deserialise_uint64_t(delta, position);
+      position = 0;
+      const auto keyframe_count =
+        merkle::deserialise_uint64_t(keyframe_tree, position);
+      const auto keyframe_from =
+        merkle::deserialise_uint64_t(keyframe_tree, position);
+      const auto to = from + count - 1;
+      const auto keyframe_to = keyframe_from + keyframe_count - 1;
+      if (
+        count == 0 || keyframe_count == 0 || from < keyframe_from ||
+        to <= keyframe_to)
+      {
+        throw std::logic_error("Invalid serialised tree delta");
+      }
+
+      // Leaves from from to keyframe_to are only in the keyframe's tree
+      const auto keyframe_leaves =
+        from <= keyframe_to ? keyframe_to - from + 1 : 0;
+      const auto delta_leaves = count - keyframe_leaves;
+      const auto shared_size = shared_frontier_size(from, keyframe_from);
+      const auto delta_edge_size = __builtin_popcountll(from) - shared_size;
+      if (
+        delta.size() !=
+          tree_delta_header_size + header_size +
+            (delta_leaves + delta_edge_size) * hash_size ||
+        keyframe_tree.size() <
+          header_size + (keyframe_count + shared_size) * hash_size)
+      {
+        throw std::logic_error("Invalid serialised tree delta");
+      }
+
+      std::vector<uint8_t> serialised;
+      serialised.reserve(
+        header_size + (count + __builtin_popcountll(from)) * hash_size);
+      const auto delta_begin = delta.begin() + tree_delta_header_size;
+      serialised.insert(serialised.end(), delta_begin, delta_begin + header_size);
+      const auto keyframe_leaves_begin = keyframe_tree.begin() + header_size +
+        (from - keyframe_from) * hash_size;
+      serialised.insert(
+        serialised.end(),
+        keyframe_leaves_begin,
+        keyframe_leaves_begin + keyframe_leaves * hash_size);
+      serialised.insert(
+        serialised.end(), delta_begin + header_size, delta.end());
+      serialised.insert(
+        serialised.end(),
+        keyframe_tree.end() - shared_size * hash_size,
+        keyframe_tree.end());
+      return serialised;
+    }
+
     uint64_t begin_index()
     {
       return tree->min_index();
@@ -496,6 +813,23 @@ namespace ccf
       std::copy(leaf.bytes, leaf.bytes + leaf.size(), result.h.begin());
       return result;
     }
+
+  private:
+    // The left edge of a tree serialised from leaf index from holds a node for
+    // each bit set in from, serialised lowest first. Those above the highest
+    // bit in which from and keyframe_from differ cover the same leaves in both
+    // trees, and are the last ones serialised.
+    static size_t shared_frontier_size(uint64_t from, uint64_t keyframe_from)
+    {
+      const auto differing = from ^ keyframe_from;
+      if (differing == 0)
+      {
+        return __builtin_popcountll(from);
+      }
+
+      const auto shift = 64 - __builtin_clzll(differing);
+      return shift < 64 ? __builtin_popcountll(from >> shift) : 0;
+    }
   };
 
   template <class T>
@@ -515,6 +849,129 @@ namespace ccf
     kv::Term term_of_last_version = 0;
     kv::Term term_of_next_version;
 
+    // With async signatures, the root of the tree is signed on the main
+    // thread rather than when the signature transaction is sequenced. Its
+    // version is reserved when it is emitted, and later transactions are
+    // queued behind it until it is committed. A committer which would wait for
+    // the signature to be committed signs it itself (see
+    // sign_frozen_signature()), so that the main thread does not deadlock
+    // when it commits transactions.
+    bool async_signatures;
+
+    // Every tree_keyframe_interval-th signature records the full serialised
+    // tree, and the others a delta from the last one which did (all of them
+    // record the full tree if 0). Protected by state_lock, and reset on
+    // rollback, so that deltas only extend the most recent full tree in the
+    // ledger.
+    struct TreeKeyframe
+    {
+      kv::Version seqno;
+      size_t from;
+      size_t to;
+      size_t deltas = 0;
+    };
+    size_t tree_keyframe_interval;
+    std::optional<TreeKeyframe> tree_keyframe = std::nullopt;
+
+    // Held from the emission of an async signature until it is committed or
+    // dropped, so that a single one is in flight at a time
+    std::atomic<bool> signing = false;
+
+    // Async signature whose version is reserved, until every transaction
+    // before it has been appended to the tree (protected by state_lock)
+    std::optional<std::pair<kv::TxID, kv::Consensus::SignableTxIndices>>
+      pending_signature = std::nullopt;
+
+    // Incremented on each rollback, which drops the async signature in flight
+    // (protected by state_lock)
+    size_t rollback_generation = 0;
+
+    // Async signature whose root is frozen, until it is signed and committed
+    // by the first thread to get to it: the main thread, or a committer
+    // waiting for the signature's version to be sequenced (protected by
+    // frozen_signature_lock)
+    struct FrozenSignature
+    {
+      kv::TxID txid;
+      kv::Consensus::SignableTxIndices commit_txid;
+      crypto::Sha256Hash root;
+      size_t generation;
+    };
+    std::mutex frozen_signature_lock;
+    std::optional<FrozenSignature> frozen_signature = std::nullopt;
+
+    struct SignRootMsg
+    {
+      SignRootMsg(HashedTxHistory<T>* self_) : self(self_) {}
+
+      HashedTxHistory<T>* self;
+    };
+
+    static void sign_root(std::unique_ptr<threading::Tmsg<SignRootMsg>> msg)
+    {
+      msg->data.self->sign_frozen_signature();
+    }
+
+    // Called with state_lock held
+    std::vector<uint8_t> serialise_tree_unsafe(size_t from, size_t to)
+    {
+      if (
+        tree_keyframe.has_value() &&
+        ++tree_keyframe->deltas < tree_keyframe_interval)
+      {
+        return replicated_state_tree.serialise_delta(
+          from,
+          to,
+          tree_keyframe->seqno,
+          tree_keyframe->from,
+          tree_keyframe->to);
+      }
+
+      if (tree_keyframe_interval > 1)
+      {
+        // The signature at to + 1 records this full tree
+        tree_keyframe =
+          TreeKeyframe{static_cast<kv::Version>(to + 1), from, to};
+      }
+      return replicated_state_tree.serialise(from, to);
+    }
+
+    // Called with state_lock held
+    void append_hash(crypto::Sha256Hash& rh)
+    {
+      log_hash(rh, APPEND);
+      replicated_state_tree.append(rh);
+
+      if (
+        pending_signature.has_value() &&
+        replicated_state_tree.end_index() + 1 ==
+          pending_signature->first.version)
+      {
+        freeze_pending_signature();
+      }
+    }
+
+    // Called with state_lock held, once the tree ends just before the pending
+    // signature
+    void freeze_pending_signature()
+    {
+      const auto [txid, commit_txid] = pending_signature.value();
+      pending_signature.reset();
+
+      {
+        std::lock_guard<std::mutex> guard(frozen_signature_lock);
+        frozen_signature = FrozenSignature{txid,
+                                           commit_txid,
+                                           replicated_state_tree.get_root(),
+                                           rollback_generation};
+      }
+
+      auto msg =
+        std::make_unique<threading::Tmsg<SignRootMsg>>(&sign_root, this);
+      threading::ThreadMessaging::thread_messaging.add_task(
+        threading::MAIN_THREAD_ID, std::move(msg));
+    }
+
   public:
     HashedTxHistory(
       kv::Store& store_,
@@ -522,12 +979,16 @@ namespace ccf
       crypto::KeyPair& kp_,
       size_t sig_tx_interval_ = 0,
       size_t sig_ms_interval_ = 0,
-      bool signature_timer = false) :
+      bool signature_timer = false,
+      bool async_signatures_ = false,
+      size_t tree_keyframe_interval_ = 0) :
       store(store_),
       id(id_),
       kp(kp_),
       sig_tx_interval(sig_tx_interval_),
-      sig_ms_interval(sig_ms_interval_)
+      sig_ms_interval(sig_ms_interval_),
+      async_signatures(async_signatures_),
+      tree_keyframe_interval(tree_keyframe_interval_)
     {
       if (signature_timer)
       {
@@ -629,6 +1090,32 @@ namespace ccf
         return false;
       }
 
+      // If the signature at which the snapshot was taken recorded a delta, it
+      // extends the most recent full tree, which is also in the snapshot
+      auto tree_delta_h = tx.template ro<ccf::SerialisedMerkleTreeDelta>(
+        ccf::Tables::SERIALISED_MERKLE_TREE_DELTA);
+      auto tree_delta = tree_delta_h->get();
+      if (tree_delta.has_value())
+      {
+        const auto tree_version = tree_h->get_version_of_previous_write();
+        const auto tree_delta_version =
+          tree_delta_h->get_version_of_previous_write();
+        if (tree_delta_version > tree_version)
+        {
+          if (get_tree_delta_keyframe(tree_delta.value()) != tree_version)
+          {
+            LOG_FAIL_FMT(
+              "Serialised tree delta at {} does not extend tree at {}",
+              tree_delta_version.value(),
+              tree_version.value());
+            return false;
+          }
+
+          tree = MerkleTreeHistory::resolve_delta(
+            tree_delta.value(), tree.value());
+        }
+      }
+
       CCF_ASSERT_FMT(
         !replicated_state_tree.in_range(1),
         "Tree is not empty before initialising from snapshot");
@@ -736,7 +1223,7 @@ namespace ccf
     std::vector<uint8_t> serialise_tree(size_t from, size_t to) override
     {
       std::lock_guard<std::mutex> guard(state_lock);
-      return replicated_state_tree.serialise(from, to);
+      return serialise_tree_unsafe(from, to);
     }
 
     void set_term(kv::Term t) override
@@ -757,6 +1244,14 @@ namespace ccf
       term_of_next_version = term_of_next_version_;
       replicated_state_tree.retract(tx_id.version);
       log_hash(replicated_state_tree.get_root(), ROLLBACK);
+      tree_keyframe.reset();
+
+      ++rollback_generation;
+      if (pending_signature.has_value())
+      {
+        pending_signature.reset();
+        signing.store(false);
+      }
     }
 
     void compact(kv::Version v) override
@@ -809,6 +1304,25 @@ namespace ccf
         return;
       }
 
+      // Signing asynchronously requires another thread than the ones
+      // executing transactions, which may wait for the signature's version
+      // to be sequenced
+      const bool async = async_signatures &&
+        consensus->type() == ConsensusType::CFT &&
+        threading::ThreadMessaging::thread_count > 1;
+      size_t generation = 0;
+      if (async)
+      {
+        if (signing.exchange(true))
+        {
+          // The previous signature has not been committed yet
+          return;
+        }
+
+        std::lock_guard<std::mutex> guard(state_lock);
+        generation = rollback_generation;
+      }
+
       auto commit_txid = signable_txid.value();
       auto txid = store.next_txid();
 
@@ -824,6 +1338,24 @@ namespace ccf
         commit_txid.version,
         commit_txid.previous_version);
 
+      if (async)
+      {
+        std::lock_guard<std::mutex> guard(state_lock);
+        if (generation != rollback_generation)
+        {
+          // Rolled back since the version was reserved
+          signing.store(false);
+          return;
+        }
+
+        pending_signature = std::make_pair(txid, commit_txid);
+        if (replicated_state_tree.end_index() + 1 == txid.version)
+        {
+          freeze_pending_signature();
+        }
+        return;
+      }
+
       store.commit(
         txid,
         std::make_unique<MerkleTreeHistoryPendingTx<T>>(
@@ -831,6 +1363,58 @@ namespace ccf
         true);
     }
 
+    bool sign_frozen_signature() override
+    {
+      std::optional<FrozenSignature> frozen = std::nullopt;
+      {
+        std::lock_guard<std::mutex> guard(frozen_signature_lock);
+        std::swap(frozen, frozen_signature);
+      }
+
+      if (!frozen.has_value())
+      {
+        return false;
+      }
+
+      const auto& txid = frozen->txid;
+      const auto& commit_txid = frozen->commit_txid;
+      const auto& root = frozen->root;
+
+      Nonce hashed_nonce;
+      hashed_nonce.h.fill(0);
+      PrimarySignature sig_value(
+        id,
+        txid.version,
+        txid.term,
+        commit_txid.version,
+        commit_txid.term,
+        root,
+        hashed_nonce,
+        kp.sign_hash(root.h.data(), root.h.size()));
+
+      std::vector<uint8_t> serialised_tree;
+      {
+        std::lock_guard<std::mutex> guard(state_lock);
+        if (frozen->generation != rollback_generation)
+        {
+          LOG_DEBUG_FMT("Dropping signature at {}, rolled back", txid.version);
+          signing.store(false);
+          return true;
+        }
+
+        serialised_tree = serialise_tree_unsafe(
+          commit_txid.previous_version, txid.version - 1);
+      }
+
+      store.commit(
+        txid,
+        std::make_unique<PreparedSignaturePendingTx>(
+          txid, store, std::move(sig_value), std::move(serialised_tree)),
+        true);
+      signing.store(false);
+      return true;
+    }
+
     std::vector<uint8_t> get_proof(kv::Version index) override
     {
       std::lock_guard<std::mutex> guard(state_lock);
@@ -872,8 +1456,32 @@ namespace ccf
     {
       std::lock_guard<std::mutex> guard(state_lock);
       crypto::Sha256Hash rh({data.data(), data.size()});
-      log_hash(rh, APPEND);
-      replicated_state_tree.append(rh);
+      append_hash(rh);
+    }
+
+    void append_entries(const std::vector<kv::TxHistory::Entry>& entries)
+      override
+    {
+      // Most entries were hashed by the thread that serialised them. The
+      // others are hashed here, together, and before taking the lock.
+      std::vector<CBuffer> inputs;
+      for (const auto& entry : entries)
+      {
+        if (!entry.digest.has_value())
+        {
+          inputs.emplace_back(entry.data->data(), entry.data->size());
+        }
+      }
+      auto hashes = crypto::sha256_multi(inputs);
+
+      std::lock_guard<std::mutex> guard(state_lock);
+      auto next_hash = hashes.begin();
+      for (const auto& entry : entries)
+      {
+        auto rh =
+          entry.digest.has_value() ? entry.digest.value() : *next_hash++;
+        append_hash(rh);
+      }
     }
   };
 
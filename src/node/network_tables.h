@@ -90,11 +90,12 @@ namespace ccf
     Secrets secrets;
     SnapshotEvidence snapshot_evidence;
 
-    // The signatures and serialised_tree tables should always be written to at
-    // the same time so that the root of the tree in the signatures table
-    // matches the serialised Merkle tree.
+    // The signatures table should always be written to at the same time as
+    // the serialised_tree or serialise_tree_delta table, so that the root of
+    // the tree in the signatures table matches the serialised Merkle tree.
     Signatures signatures;
     SerialisedMerkleTree serialise_tree;
+    SerialisedMerkleTreeDelta serialise_tree_delta;
 
     //
     // bft related tables
@@ -136,6 +137,7 @@ namespace ccf
       snapshot_evidence(Tables::SNAPSHOT_EVIDENCE),
       signatures(Tables::SIGNATURES),
       serialise_tree(Tables::SERIALISED_MERKLE_TREE),
+      serialise_tree_delta(Tables::SERIALISED_MERKLE_TREE_DELTA),
       bft_requests_map(Tables::AFT_REQUESTS),
       backup_signatures_map(Tables::BACKUP_SIGNATURES),
       revealed_nonces_map(Tables::NONCES),
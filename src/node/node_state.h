@@ -5,6 +5,7 @@
 #include "blit.h"
 #include "consensus/aft/raft_consensus.h"
 #include "consensus/ledger_enclave.h"
+#include "consensus/ledger_fetch_window.h"
 #include "crypto/entropy.h"
 #include "crypto/pem.h"
 #include "crypto/symmetric_key.h"
@@ -138,6 +139,10 @@ namespace ccf
     RecoveredEncryptedLedgerSecrets recovery_ledger_secrets;
     consensus::Index ledger_idx = 0;
 
+    // Ledger entries are fetched from the host ahead of being replayed, so
+    // that deserialising one batch overlaps with reading the next one
+    consensus::LedgerFetchWindow recovery_fetch;
+
     //
     // JWT key auto-refresh
     //
@@ -145,8 +150,23 @@ namespace ccf
 
     struct StartupSnapshotInfo
     {
-      std::vector<uint8_t>& raw;
-      consensus::Index seqno;
+      // The snapshot is read from the host chunk by chunk, and each chunk is
+      // hashed and deserialised as it is received (see
+      // read_startup_snapshot()). It is first read to verify it and to apply
+      // its public maps to store. The private maps can only be deserialised
+      // once the ledger secrets are known, after joining or on private
+      // recovery, so the snapshot is then read again rather than kept in the
+      // enclave.
+      size_t size;
+      // Offset of the next chunk to be received, while the snapshot is read
+      size_t offset = 0;
+      std::unique_ptr<kv::Store::SnapshotLoader> loader = nullptr;
+      std::shared_ptr<crypto::ISha256Hash> hasher = nullptr;
+      crypto::Sha256Hash hash;
+      // View history recorded in the snapshot, when it is read on join
+      std::vector<kv::Version> view_history;
+
+      consensus::Index seqno = 0;
       consensus::Index evidence_seqno;
 
       // Store used to verify a snapshot (either created fresh when a node joins
@@ -160,25 +180,27 @@ namespace ccf
       bool has_evidence = false;
       bool is_evidence_committed = false;
 
+      // Set when the node joins a service that is recovering its public
+      // ledger
+      bool join_public_only = false;
+
       StartupSnapshotInfo(
         const std::shared_ptr<kv::Store>& store_,
-        std::vector<uint8_t>& raw_,
-        consensus::Index seqno_,
+        size_t size_,
         consensus::Index evidence_seqno_) :
-        raw(raw_),
-        seqno(seqno_),
+        size(size_),
         evidence_seqno(evidence_seqno_),
         store(store_)
       {}
 
-      bool is_snapshot_verified()
+      bool is_reading() const
       {
-        return has_evidence && is_evidence_committed;
+        return loader != nullptr;
       }
 
-      ~StartupSnapshotInfo()
+      bool is_snapshot_verified()
       {
-        reset_data(raw);
+        return has_evidence && is_evidence_committed;
       }
     };
     std::unique_ptr<StartupSnapshotInfo> startup_snapshot_info = nullptr;
@@ -220,32 +242,98 @@ namespace ccf
         snapshot_store = network.tables;
       }
 
-      LOG_INFO_FMT(
-        "Deserialising public snapshot ({})", config.startup_snapshot.size());
+      // The public maps of the snapshot are deserialised as its chunks are
+      // read from the host (see start_ledger_recovery())
+      startup_snapshot_info = std::make_unique<StartupSnapshotInfo>(
+        snapshot_store,
+        config.startup_snapshot_size,
+        config.startup_snapshot_evidence_seqno);
+    }
+
+    void read_startup_snapshot(
+      const std::shared_ptr<kv::Store>& store,
+      std::vector<kv::Version>* view_history_,
+      bool public_only)
+    {
+      auto& info = *startup_snapshot_info;
+      info.offset = 0;
+      info.loader = std::make_unique<kv::Store::SnapshotLoader>(
+        *store, view_history_, public_only);
+      info.hasher = crypto::make_incremental_sha256();
+      read_startup_snapshot_chunk(0);
+    }
+
+    void read_startup_snapshot_chunk(size_t offset)
+    {
+      RINGBUFFER_WRITE_MESSAGE(
+        consensus::startup_snapshot_get, to_host, offset);
+    }
+
+    void startup_snapshot_loaded_unsafe()
+    {
+      auto& info = *startup_snapshot_info;
+
+      const auto hash = info.hasher->finalise();
+      info.hasher.reset();
+      auto loader = std::move(info.loader);
+
+      const bool verifying = sm.check(State::verifyingSnapshot) ||
+        sm.check(State::readingPublicLedger);
+      if (!verifying && hash != info.hash)
+      {
+        // The snapshot is read again from the host once the ledger secrets
+        // are known, and should not differ from the one verified before
+        throw std::logic_error(fmt::format(
+          "Startup snapshot read again from host does not match snapshot "
+          "verified at seqno {}",
+          info.seqno));
+      }
 
       kv::ConsensusHookPtrs hooks;
-      auto rc = snapshot_store->deserialise_snapshot(
-        config.startup_snapshot, hooks, &view_history, true);
+      auto rc = loader->finish(hooks);
       if (rc != kv::ApplyResult::PASS)
       {
         throw std::logic_error(
-          fmt::format("Failed to apply public snapshot: {}", rc));
+          fmt::format("Failed to apply startup snapshot: {}", rc));
+      }
+
+      if (sm.check(State::pending))
+      {
+        join_from_startup_snapshot_unsafe(hooks);
+        return;
+      }
+
+      if (sm.check(State::readingPrivateLedger))
+      {
+        LOG_INFO_FMT(
+          "Private snapshot deserialised for recovery at seqno {}",
+          recovery_store->current_version());
+        startup_snapshot_info.reset();
+
+        ledger_idx = recovery_store->current_version();
+        start_ledger_fetch();
+        return;
       }
 
+      info.hash = hash;
+
       LOG_INFO_FMT(
         "Public snapshot deserialised at seqno {}",
-        snapshot_store->current_version());
+        info.store->current_version());
 
-      startup_seqno = snapshot_store->current_version();
+      startup_seqno = info.store->current_version();
 
-      ledger_idx = snapshot_store->current_version();
+      ledger_idx = info.store->current_version();
       last_recovered_signed_idx = ledger_idx;
+      info.seqno = ledger_idx;
 
-      startup_snapshot_info = std::make_unique<StartupSnapshotInfo>(
-        snapshot_store,
-        config.startup_snapshot,
-        ledger_idx,
-        config.startup_snapshot_evidence_seqno);
+      if (sm.check(State::readingPublicLedger))
+      {
+        snapshotter->set_last_snapshot_idx(ledger_idx);
+      }
+
+      LOG_INFO_FMT("Starting to read public ledger");
+      start_ledger_fetch();
     }
 
   public:
@@ -405,7 +493,7 @@ namespace ccf
           node_cert = create_self_signed_node_cert();
           accept_node_tls_connections();
 
-          if (!config.startup_snapshot.empty())
+          if (config.startup_snapshot_size > 0)
           {
             initialise_startup_snapshot();
             sm.advance(State::verifyingSnapshot);
@@ -436,13 +524,12 @@ namespace ccf
           setup_encryptor();
 
           setup_snapshotter();
-          bool from_snapshot = !config.startup_snapshot.empty();
+          bool from_snapshot = config.startup_snapshot_size > 0;
           setup_recovery_hook();
 
           if (from_snapshot)
           {
             initialise_startup_snapshot(true);
-            snapshotter->set_last_snapshot_idx(ledger_idx);
           }
 
           accept_network_tls_connections();
@@ -481,7 +568,9 @@ namespace ccf
           http::HeaderMap&& headers,
           std::vector<uint8_t>&& data) {
           std::lock_guard<std::mutex> guard(lock);
-          if (!sm.check(State::pending))
+          if (
+            !sm.check(State::pending) ||
+            (startup_snapshot_info && startup_snapshot_info->is_reading()))
           {
             return false;
           }
@@ -576,78 +665,21 @@ namespace ccf
             if (startup_snapshot_info)
             {
               // It is only possible to deserialise the entire snapshot then,
-              // once the ledger secrets have been passed in by the network
+              // once the ledger secrets have been passed in by the network.
+              // The node joins once the snapshot, read again from the host,
+              // is applied (see join_from_startup_snapshot_unsafe())
               LOG_DEBUG_FMT(
-                "Deserialising snapshot ({})",
-                startup_snapshot_info->raw.size());
-              std::vector<kv::Version> view_history;
-              kv::ConsensusHookPtrs hooks;
-              auto rc = network.tables->deserialise_snapshot(
-                startup_snapshot_info->raw,
-                hooks,
-                &view_history,
+                "Deserialising snapshot ({})", startup_snapshot_info->size);
+              startup_snapshot_info->join_public_only =
+                resp.network_info.public_only;
+              read_startup_snapshot(
+                network.tables,
+                &startup_snapshot_info->view_history,
                 resp.network_info.public_only);
-              if (rc != kv::ApplyResult::PASS)
-              {
-                throw std::logic_error(
-                  fmt::format("Failed to apply snapshot on join: {}", rc));
-              }
-
-              for (auto& hook : hooks)
-              {
-                hook->call(consensus.get());
-              }
-
-              auto tx = network.tables->create_read_only_tx();
-              auto signatures = tx.ro(network.signatures);
-              auto sig = signatures->get();
-              if (!sig.has_value())
-              {
-                throw std::logic_error(
-                  fmt::format("No signatures found after applying snapshot"));
-              }
-
-              auto seqno = network.tables->current_version();
-              consensus->init_as_backup(seqno, sig->view, view_history);
-
-              if (!resp.network_info.public_only)
-              {
-                // Only clear snapshot if not recovering. When joining the
-                // public network the snapshot is used later to initialise the
-                // recovery store
-                startup_snapshot_info.reset();
-              }
-
-              LOG_INFO_FMT(
-                "Joiner successfully resumed from snapshot at seqno {} and "
-                "view {}",
-                seqno,
-                sig->view);
+              return true;
             }
 
-            open_frontend(ActorsType::members);
-
-            accept_network_tls_connections();
-
-            if (resp.network_info.public_only)
-            {
-              sm.advance(State::partOfPublicNetwork);
-            }
-            else
-            {
-              reset_data(quote_info.quote);
-              reset_data(quote_info.endorsements);
-              sm.advance(State::partOfNetwork);
-            }
-
-            LOG_INFO_FMT(
-              "Node has now joined the network as node {}: {}",
-              self,
-              (resp.network_info.public_only ? "public only" : "all domains"));
-
-            // The network identity is now known, the user frontend can be
-            // opened once the KV state catches up
-            open_user_frontend();
+            complete_join_unsafe(resp.network_info.public_only);
           }
           else if (resp.node_status == NodeStatus::PENDING)
           {
@@ -685,6 +717,74 @@ namespace ccf
       join_client->send_request(r.build_request());
     }
 
+    void join_from_startup_snapshot_unsafe(kv::ConsensusHookPtrs& hooks)
+    {
+      for (auto& hook : hooks)
+      {
+        hook->call(consensus.get());
+      }
+
+      auto tx = network.tables->create_read_only_tx();
+      auto signatures = tx.ro(network.signatures);
+      auto sig = signatures->get();
+      if (!sig.has_value())
+      {
+        throw std::logic_error(
+          fmt::format("No signatures found after applying snapshot"));
+      }
+
+      auto seqno = network.tables->current_version();
+      consensus->init_as_backup(
+        seqno, sig->view, startup_snapshot_info->view_history);
+
+      const auto public_only = startup_snapshot_info->join_public_only;
+      if (public_only)
+      {
+        // Only clear snapshot if not recovering. When joining the public
+        // network the snapshot is read again later to initialise the recovery
+        // store
+        startup_snapshot_info->view_history.clear();
+      }
+      else
+      {
+        startup_snapshot_info.reset();
+      }
+
+      LOG_INFO_FMT(
+        "Joiner successfully resumed from snapshot at seqno {} and view {}",
+        seqno,
+        sig->view);
+
+      complete_join_unsafe(public_only);
+    }
+
+    void complete_join_unsafe(bool public_only)
+    {
+      open_frontend(ActorsType::members);
+
+      accept_network_tls_connections();
+
+      if (public_only)
+      {
+        sm.advance(State::partOfPublicNetwork);
+      }
+      else
+      {
+        reset_data(quote_info.quote);
+        reset_data(quote_info.endorsements);
+        sm.advance(State::partOfNetwork);
+      }
+
+      LOG_INFO_FMT(
+        "Node has now joined the network as node {}: {}",
+        self,
+        (public_only ? "public only" : "all domains"));
+
+      // The network identity is now known, the user frontend can be
+      // opened once the KV state catches up
+      open_user_frontend();
+    }
+
     void start_join_timer()
     {
       initiate_join();
@@ -764,14 +864,146 @@ namespace ccf
           State::verifyingSnapshot));
       }
 
+      if (startup_snapshot_info)
+      {
+        LOG_INFO_FMT(
+          "Starting to read public snapshot ({})",
+          startup_snapshot_info->size);
+        read_startup_snapshot(
+          startup_snapshot_info->store, &view_history, true);
+        return;
+      }
+
       LOG_INFO_FMT("Starting to read public ledger");
-      read_ledger_idx(++ledger_idx);
+      start_ledger_fetch();
     }
 
-    void recover_public_ledger_entry(const std::vector<uint8_t>& ledger_entry)
+    void recover_startup_snapshot_chunk(
+      size_t offset, const std::vector<uint8_t>& chunk)
     {
       std::lock_guard<std::mutex> guard(lock);
 
+      if (
+        startup_snapshot_info == nullptr ||
+        !startup_snapshot_info->is_reading() ||
+        offset != startup_snapshot_info->offset)
+      {
+        LOG_FAIL_FMT(
+          "Ignoring unexpected startup snapshot chunk at {}", offset);
+        return;
+      }
+
+      auto& info = *startup_snapshot_info;
+      if (chunk.empty() || chunk.size() > info.size - offset)
+      {
+        throw std::logic_error(fmt::format(
+          "Startup snapshot chunk at {} exceeds snapshot size {}",
+          offset,
+          info.size));
+      }
+
+      // Request the next chunk before applying this one, so that the host
+      // reads it while this one is being deserialised
+      const auto next_offset = offset + chunk.size();
+      if (next_offset < info.size)
+      {
+        read_startup_snapshot_chunk(next_offset);
+      }
+
+      LOG_DEBUG_FMT(
+        "Deserialising startup snapshot chunk at {} ({})",
+        offset,
+        chunk.size());
+
+      info.offset = next_offset;
+      info.hasher->update_hash({chunk.data(), chunk.size()});
+      if (!info.loader->load_chunk(chunk.data(), chunk.size()))
+      {
+        throw std::logic_error(fmt::format(
+          "Failed to apply startup snapshot chunk at {}", offset));
+      }
+
+      if (next_offset == info.size)
+      {
+        startup_snapshot_loaded_unsafe();
+      }
+    }
+
+    void recover_startup_snapshot_missing(size_t offset)
+    {
+      // Node should shutdown if the startup snapshot cannot be read
+      throw std::logic_error(
+        fmt::format("Could not read startup snapshot chunk at {}", offset));
+    }
+
+    void recover_ledger_entries(
+      consensus::Index from,
+      consensus::Index to,
+      const std::vector<uint8_t>& framed_entries)
+    {
+      std::lock_guard<std::mutex> guard(lock);
+
+      if (!is_reading_ledger(from))
+      {
+        return;
+      }
+
+      const auto entries = recovery_fetch.receive(from, to, framed_entries);
+
+      // Request the following entries before replaying these, so that the
+      // host reads them while this batch is being deserialised
+      read_ledger_ranges(recovery_fetch.fetch());
+
+      for (const auto& entry : entries)
+      {
+        const bool keep_reading = sm.check(State::readingPrivateLedger) ?
+          recover_private_ledger_entry_unsafe(entry) :
+          recover_public_ledger_entry_unsafe(entry);
+        if (!keep_reading)
+        {
+          return;
+        }
+      }
+
+      if (recovery_fetch.at_end())
+      {
+        recover_ledger_fetch_end_unsafe();
+      }
+    }
+
+    void recover_ledger_missing(consensus::Index from, consensus::Index to)
+    {
+      std::lock_guard<std::mutex> guard(lock);
+
+      if (!is_reading_ledger(from))
+      {
+        return;
+      }
+
+      LOG_DEBUG_FMT("Ledger entries {}-{} are not all available", from, to);
+      read_ledger_ranges(recovery_fetch.missing(from, to));
+
+      if (recovery_fetch.at_end())
+      {
+        recover_ledger_fetch_end_unsafe();
+      }
+    }
+
+    void recover_ledger_fetch_end_unsafe()
+    {
+      if (sm.check(State::verifyingSnapshot))
+      {
+        verify_snapshot_end_unsafe();
+      }
+      else
+      {
+        recover_ledger_end_unsafe();
+      }
+    }
+
+    bool recover_public_ledger_entry_unsafe(
+      const std::vector<uint8_t>& ledger_entry)
+    {
       std::shared_ptr<kv::Store> store;
       if (sm.check(State::readingPublicLedger))
       {
@@ -788,11 +1020,15 @@ namespace ccf
           "Node should be in state {} or {} to recover public ledger entry",
           State::readingPublicLedger,
           State::verifyingSnapshot);
-        return;
+        return false;
       }
 
-      LOG_INFO_FMT(
-        "Deserialising public ledger entry ({})", ledger_entry.size());
+      ++ledger_idx;
+
+      LOG_DEBUG_FMT(
+        "Deserialising public ledger entry {} ({})",
+        ledger_idx,
+        ledger_entry.size());
 
       auto r = store->deserialize(ledger_entry, ConsensusType::CFT, true);
       auto result = r->apply();
@@ -800,7 +1036,7 @@ namespace ccf
       {
         LOG_FAIL_FMT("Failed to deserialise entry in public ledger");
         recover_public_ledger_end_unsafe();
-        return;
+        return false;
       }
 
       // Not synchronised because consensus isn't effectively running then
@@ -876,7 +1112,7 @@ namespace ccf
             throw std::logic_error("Invalid snapshot evidence");
           }
 
-          if (evidence->hash == crypto::Sha256Hash(startup_snapshot_info->raw))
+          if (evidence->hash == startup_snapshot_info->hash)
           {
             LOG_DEBUG_FMT(
               "Snapshot evidence for snapshot found at {}",
@@ -886,12 +1122,11 @@ namespace ccf
         }
       }
 
-      read_ledger_idx(++ledger_idx);
+      return true;
     }
 
-    void verify_snapshot_end()
+    void verify_snapshot_end_unsafe()
     {
-      std::lock_guard<std::mutex> guard(lock);
       if (!sm.check(State::verifyingSnapshot))
       {
         LOG_FAIL_FMT(
@@ -1071,18 +1306,22 @@ namespace ccf
     //
     // funcs in state "readingPrivateLedger"
     //
-    void recover_private_ledger_entry(const std::vector<uint8_t>& ledger_entry)
+    bool recover_private_ledger_entry_unsafe(
+      const std::vector<uint8_t>& ledger_entry)
     {
-      std::lock_guard<std::mutex> guard(lock);
       if (!sm.check(State::readingPrivateLedger))
       {
         LOG_FAIL_FMT(
           "Node is state {} cannot recover private ledger entry", sm.value());
-        return;
+        return false;
       }
 
-      LOG_INFO_FMT(
-        "Deserialising private ledger entry ({})", ledger_entry.size());
+      ++ledger_idx;
+
+      LOG_DEBUG_FMT(
+        "Deserialising private ledger entry {} ({})",
+        ledger_idx,
+        ledger_entry.size());
 
       // When reading the private ledger, deserialise in the recovery store
       auto result =
@@ -1094,7 +1333,7 @@ namespace ccf
         // be discarded
         recovery_store->rollback({0, ledger_idx - 1}, 0);
         recover_private_ledger_end_unsafe();
-        return;
+        return false;
       }
 
       if (result == kv::ApplyResult::PASS_SIGNATURE)
@@ -1106,11 +1345,10 @@ namespace ccf
       {
         LOG_INFO_FMT("Reached recovery final version at {}", recovery_v);
         recover_private_ledger_end_unsafe();
+        return false;
       }
-      else
-      {
-        read_ledger_idx(++ledger_idx);
-      }
+
+      return true;
     }
 
     void recover_private_ledger_end_unsafe()
@@ -1214,10 +1452,8 @@ namespace ccf
     //
     // funcs in state "readingPublicLedger" or "readingPrivateLedger"
     //
-    void recover_ledger_end()
+    void recover_ledger_end_unsafe()
     {
-      std::lock_guard<std::mutex> guard(lock);
-
       if (is_reading_public_ledger())
       {
         recover_public_ledger_end_unsafe();
@@ -1260,28 +1496,31 @@ namespace ccf
       auto h = dynamic_cast<MerkleTxHistory*>(history.get());
       recovery_root = h->get_replicated_state_root();
 
+      LOG_DEBUG_FMT(
+        "Recovery store successfully setup at {}. Target recovery seqno: {}",
+        recovery_store->current_version(),
+        recovery_v);
+    }
+
+    void start_private_ledger_recovery_unsafe()
+    {
+      // Start reading private security domain of ledger
+      sm.advance(State::readingPrivateLedger);
+
       if (startup_snapshot_info)
       {
+        // The private ledger is read once the entire snapshot, read again
+        // from the host now that the ledger secrets are known, is applied to
+        // the recovery store (see startup_snapshot_loaded_unsafe())
         LOG_INFO_FMT(
           "Deserialising private snapshot for recovery ({})",
-          startup_snapshot_info->raw.size());
-        std::vector<kv::Version> view_history;
-        kv::ConsensusHookPtrs hooks;
-        auto rc = recovery_store->deserialise_snapshot(
-          startup_snapshot_info->raw, hooks, &view_history);
-        if (rc != kv::ApplyResult::PASS)
-        {
-          throw std::logic_error(fmt::format(
-            "Could not deserialise snapshot in recovery store: {}", rc));
-        }
-
-        startup_snapshot_info.reset();
+          startup_snapshot_info->size);
+        read_startup_snapshot(recovery_store, nullptr, false);
+        return;
       }
 
-      LOG_DEBUG_FMT(
-        "Recovery store successfully setup at {}. Target recovery seqno: {}",
-        recovery_store->current_version(),
-        recovery_v);
+      ledger_idx = recovery_store->current_version();
+      start_ledger_fetch();
     }
 
     void trigger_recovery_shares_refresh(kv::Tx& tx) override
@@ -1384,11 +1623,7 @@ namespace ccf
       setup_private_recovery_store();
       reset_recovery_hook();
 
-      // Start reading private security domain of ledger
-      ledger_idx = recovery_store->current_version();
-      read_ledger_idx(++ledger_idx);
-
-      sm.advance(State::readingPrivateLedger);
+      start_private_ledger_recovery_unsafe();
     }
 
     //
@@ -1420,6 +1655,14 @@ namespace ccf
       consensus->periodic_end();
     }
 
+    void ledger_flushed(consensus::Index idx, size_t generation)
+    {
+      if (consensus != nullptr)
+      {
+        consensus->ledger_flushed(idx, generation);
+      }
+    }
+
     void recv_node_inbound(const uint8_t* data, size_t size)
     {
       auto [msg_type, from, payload] =
@@ -1777,11 +2020,7 @@ namespace ccf
       reset_recovery_hook();
       setup_one_off_secret_hook();
 
-      // Start reading private security domain of ledger
-      ledger_idx = recovery_store->current_version();
-      read_ledger_idx(++ledger_idx);
-
-      sm.advance(State::readingPrivateLedger);
+      start_private_ledger_recovery_unsafe();
     }
 
     void setup_basic_hooks()
@@ -1974,7 +2213,9 @@ namespace ccf
         std::chrono::milliseconds(consensus_config.bft_view_change_timeout),
         sig_tx_interval,
         public_only,
-        initial_state);
+        initial_state,
+        consensus_config.parallel_deserialisation,
+        consensus_config.wait_for_ledger_flush);
 
       consensus = std::make_shared<RaftConsensusType>(
         std::move(raft), network.consensus_type);
@@ -2011,7 +2252,9 @@ namespace ccf
         *node_sign_kp,
         sig_tx_interval,
         sig_ms_interval,
-        true);
+        true,
+        config.async_signatures,
+        config.tree_keyframe_interval);
 
       network.tables->set_history(history);
     }
@@ -2043,7 +2286,11 @@ namespace ccf
     void setup_snapshotter()
     {
       snapshotter = std::make_shared<Snapshotter>(
-        writer_factory, network.tables, config.snapshot_tx_interval);
+        writer_factory,
+        network.tables,
+        config.snapshot_tx_interval,
+        config.snapshot_chunk_bytes,
+        config.snapshot_parallel_serialisation);
     }
 
     void setup_tracker_store()
@@ -2055,18 +2302,77 @@ namespace ccf
       }
     }
 
-    void read_ledger_idx(consensus::Index idx)
+    void read_ledger_range(consensus::Index from, consensus::Index to)
     {
-      RINGBUFFER_WRITE_MESSAGE(
-        consensus::ledger_get,
-        to_host,
-        idx,
-        consensus::LedgerRequestPurpose::Recovery);
+      if (from == to)
+      {
+        RINGBUFFER_WRITE_MESSAGE(
+          consensus::ledger_get,
+          to_host,
+          from,
+          consensus::LedgerRequestPurpose::Recovery);
+      }
+      else
+      {
+        RINGBUFFER_WRITE_MESSAGE(
+          consensus::ledger_get_range,
+          to_host,
+          from,
+          to,
+          consensus::LedgerRequestPurpose::Recovery);
+      }
+    }
+
+    void read_ledger_ranges(
+      const std::vector<consensus::LedgerFetchWindow::Range>& ranges)
+    {
+      for (const auto& [from, to] : ranges)
+      {
+        read_ledger_range(from, to);
+      }
+    }
+
+    void start_ledger_fetch()
+    {
+      // Private recovery stops at the last version recovered from the public
+      // ledger, so never read past it
+      std::optional<consensus::Index> last_idx = std::nullopt;
+      if (sm.check(State::readingPrivateLedger))
+      {
+        last_idx = recovery_v;
+      }
+
+      recovery_fetch = consensus::LedgerFetchWindow(
+        config.ledger_recovery.fetch_batch_size,
+        config.ledger_recovery.fetch_window);
+      read_ledger_ranges(recovery_fetch.start(ledger_idx, last_idx));
+    }
+
+    bool is_reading_ledger(consensus::Index from)
+    {
+      if (
+        !sm.check(State::readingPublicLedger) &&
+        !sm.check(State::verifyingSnapshot) &&
+        !sm.check(State::readingPrivateLedger))
+      {
+        LOG_DEBUG_FMT(
+          "Ignoring ledger entries from {}: node is in state {}",
+          from,
+          sm.value());
+        return false;
+      }
+
+      return true;
     }
 
     void ledger_truncate(consensus::Index idx)
     {
-      RINGBUFFER_WRITE_MESSAGE(consensus::ledger_truncate, to_host, idx);
+      // Only called before consensus is created, which starts from the first
+      // generation of the ledger
+      CCF_ASSERT(
+        consensus == nullptr,
+        "Ledger should be truncated by consensus once it is created");
+      RINGBUFFER_WRITE_MESSAGE(consensus::ledger_truncate, to_host, idx, 0);
     }
   };
 }
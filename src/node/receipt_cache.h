@@ -0,0 +1,296 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the Apache 2.0 License.
+#pragma once
+
+#include "ccf/historical_queries_interface.h"
+#include "ds/lru.h"
+#include "kv/store.h"
+#include "node/entities.h"
+#include "node/history.h"
+#include "node/signatures.h"
+
+#include <map>
+#include <mutex>
+
+namespace ccf
+{
+  /** Receipts for committed transactions, served from memory rather than by
+   * fetching ledger entries from the host or walking the history's tree.
+   *
+   * Hooks on the signatures and serialised tree tables record each signature
+   * as it is committed, with the Merkle tree it signed (or the delta from the
+   * last full tree). As soon as both are recorded, the receipts for every
+   * transaction the signature covers are built in one pass over its tree, and
+   * kept in a bounded LRU keyed by seqno. Receipts evicted from the LRU are
+   * built again from the recorded signature when they are next requested,
+   * provided they are in the range it covers.
+   */
+  class ReceiptCache
+  {
+  public:
+    static constexpr size_t default_max_receipts = 10000;
+    static constexpr size_t default_max_signatures = 100;
+
+  private:
+    struct CommittedSignature
+    {
+      std::optional<PrimarySignature> sig = std::nullopt;
+      std::vector<uint8_t> tree = {};
+      bool has_tree = false;
+      // First seqno whose receipt is built from this signature, known once
+      // its receipts have been built
+      std::optional<ccf::SeqNo> covered_from = std::nullopt;
+    };
+    using RecordedSignatures = std::map<ccf::SeqNo, CommittedSignature>;
+
+    // Recorded signature whose tree is resolved, ready to build receipts from
+    struct ResolvedSignature
+    {
+      PrimarySignature sig;
+      std::vector<uint8_t> tree;
+      // Receipts for the transactions up to the previous recorded signature
+      // are built from that signature instead
+      ccf::SeqNo first_seqno;
+    };
+
+    kv::Store& store;
+
+    // Recorded signatures, by seqno. Only held briefly, and never while
+    // receipts are built.
+    std::mutex signatures_lock;
+    RecordedSignatures signatures;
+    std::map<ccf::SeqNo, std::vector<uint8_t>> full_trees;
+    size_t max_signatures;
+
+    std::mutex receipts_lock;
+    LRU<ccf::SeqNo, historical::TxReceiptPtr> receipts;
+
+    // Called with signatures_lock held
+    RecordedSignatures::iterator record(ccf::SeqNo seqno)
+    {
+      auto it = signatures.try_emplace(seqno).first;
+      while (signatures.size() > max_signatures && signatures.begin() != it)
+      {
+        signatures.erase(signatures.begin());
+      }
+      return it;
+    }
+
+    // Called with signatures_lock held
+    RecordedSignatures::iterator record_tree(
+      ccf::SeqNo seqno, std::vector<uint8_t>&& tree)
+    {
+      if (!is_tree_delta(tree))
+      {
+        full_trees[seqno] = tree;
+        while (full_trees.size() > max_signatures)
+        {
+          full_trees.erase(full_trees.begin());
+        }
+      }
+
+      auto it = record(seqno);
+      it->second.tree = std::move(tree);
+      it->second.has_tree = true;
+      return it;
+    }
+
+    // Returns the recorded signature at it with its tree resolved, unless it
+    // is incomplete or its delta's full tree is no longer recorded. Called
+    // with signatures_lock held.
+    std::optional<ResolvedSignature> resolve(
+      RecordedSignatures::const_iterator it)
+    {
+      const auto& committed = it->second;
+      if (!committed.sig.has_value() || !committed.has_tree)
+      {
+        return std::nullopt;
+      }
+
+      auto tree = committed.tree;
+      if (is_tree_delta(tree))
+      {
+        const auto full_tree = full_trees.find(get_tree_delta_keyframe(tree));
+        if (full_tree == full_trees.end())
+        {
+          return std::nullopt;
+        }
+
+        tree = MerkleTreeHistory::resolve_delta(tree, full_tree->second);
+      }
+
+      const auto first_seqno =
+        it == signatures.begin() ? 0 : std::prev(it)->first + 1;
+      return ResolvedSignature{
+        committed.sig.value(), std::move(tree), first_seqno};
+    }
+
+    // Returns the first recorded signature at or after seqno, resolved
+    std::optional<ResolvedSignature> resolve_signature_covering(
+      ccf::SeqNo seqno)
+    {
+      std::lock_guard<std::mutex> guard(signatures_lock);
+      auto it = signatures.lower_bound(seqno);
+      if (it == signatures.end())
+      {
+        return std::nullopt;
+      }
+
+      const auto& covered_from = it->second.covered_from;
+      if (covered_from.has_value() && seqno < covered_from.value())
+      {
+        return std::nullopt;
+      }
+
+      return resolve(it);
+    }
+
+    void record_covered_from(ccf::SeqNo sig_seqno, ccf::SeqNo covered_from)
+    {
+      std::lock_guard<std::mutex> guard(signatures_lock);
+      auto it = signatures.find(sig_seqno);
+      if (it != signatures.end())
+      {
+        it->second.covered_from = covered_from;
+      }
+    }
+
+    // Returns the receipt for target, if it is one of those built, since the
+    // LRU may not hold all of them. Called with receipts_lock held.
+    historical::TxReceiptPtr build(
+      const ResolvedSignature& resolved, ccf::SeqNo target = 0)
+    {
+      const auto& sig = resolved.sig;
+      historical::TxReceiptPtr target_receipt = nullptr;
+      const auto add =
+        [&](ccf::SeqNo seqno, historical::TxReceiptPtr receipt) {
+          if (seqno == target)
+          {
+            target_receipt = receipt;
+          }
+          receipts.insert(seqno, std::move(receipt));
+        };
+
+      add(
+        sig.seqno,
+        std::make_shared<historical::TxReceipt>(
+          sig.sig, sig.root.h, nullptr, sig.node));
+
+      // The tree starts at the last committed version as of the signature,
+      // which is itself covered by an earlier signature, as are the leaves up
+      // to the previous recorded signature
+      MerkleTreeHistory tree(resolved.tree);
+      const auto first_seqno = std::max<uint64_t>(
+        tree.begin_index() + 1, static_cast<uint64_t>(resolved.first_seqno));
+      record_covered_from(sig.seqno, first_seqno);
+      for (auto seqno = first_seqno; seqno <= tree.end_index(); ++seqno)
+      {
+        auto proof = tree.get_proof(seqno);
+        add(
+          seqno,
+          std::make_shared<historical::TxReceipt>(
+            sig.sig, proof.get_root(), proof.get_path(), sig.node));
+      }
+      return target_receipt;
+    }
+
+    void build_eagerly(const std::optional<ResolvedSignature>& resolved)
+    {
+      if (resolved.has_value())
+      {
+        std::lock_guard<std::mutex> guard(receipts_lock);
+        build(resolved.value());
+      }
+    }
+
+  public:
+    ReceiptCache(
+      kv::Store& store_,
+      size_t max_receipts = default_max_receipts,
+      size_t max_signatures_ = default_max_signatures) :
+      store(store_),
+      max_signatures(max_signatures_),
+      receipts(max_receipts)
+    {
+      store.set_global_hook(
+        Tables::SIGNATURES,
+        [this](kv::Version version, const kv::untyped::Write& w) {
+          std::optional<ResolvedSignature> resolved = std::nullopt;
+          for (const auto& [k, v] : w)
+          {
+            if (v.has_value())
+            {
+              auto sig = Signatures::ValueSerialiser::from_serialised(*v);
+              std::lock_guard<std::mutex> guard(signatures_lock);
+              auto it = record(version);
+              it->second.sig = std::move(sig);
+              resolved = resolve(it);
+            }
+          }
+          build_eagerly(resolved);
+        });
+
+      const auto tree_hook =
+        [this](kv::Version version, const kv::untyped::Write& w) {
+          std::optional<ResolvedSignature> resolved = std::nullopt;
+          for (const auto& [k, v] : w)
+          {
+            if (v.has_value())
+            {
+              auto tree =
+                SerialisedMerkleTree::ValueSerialiser::from_serialised(*v);
+              std::lock_guard<std::mutex> guard(signatures_lock);
+              resolved = resolve(record_tree(version, std::move(tree)));
+            }
+          }
+          build_eagerly(resolved);
+        };
+      store.set_global_hook(Tables::SERIALISED_MERKLE_TREE, tree_hook);
+      store.set_global_hook(Tables::SERIALISED_MERKLE_TREE_DELTA, tree_hook);
+    }
+
+    ~ReceiptCache()
+    {
+      store.unset_global_hook(Tables::SIGNATURES);
+      store.unset_global_hook(Tables::SERIALISED_MERKLE_TREE);
+      store.unset_global_hook(Tables::SERIALISED_MERKLE_TREE_DELTA);
+    }
+
+    /** Returns the receipt for the committed transaction at @p seqno, or
+     * nullptr, without building any, if it is not covered by a recorded
+     * signature
+     */
+    historical::TxReceiptPtr get(ccf::SeqNo seqno)
+    {
+      std::lock_guard<std::mutex> guard(receipts_lock);
+      auto it = receipts.find(seqno);
+      if (it != receipts.end())
+      {
+        return it->second;
+      }
+
+      const auto resolved = resolve_signature_covering(seqno);
+      if (!resolved.has_value())
+      {
+        return nullptr;
+      }
+
+      return build(resolved.value(), seqno);
+    }
+
+    /** Returns the receipts for the committed transactions from @p from to
+     * @p to inclusive, in order. Those which are not covered by a recorded
+     * signature are nullptr, and should be fetched by a historical query.
+     */
+    std::vector<historical::TxReceiptPtr> get_range(
+      ccf::SeqNo from, ccf::SeqNo to)
+    {
+      std::vector<historical::TxReceiptPtr> result;
+      for (auto seqno = from; seqno <= to; ++seqno)
+      {
+        result.push_back(get(seqno));
+      }
+      return result;
+    }
+  };
+}
@@ -146,6 +146,66 @@ namespace ccf
       }
     }
 
+    // Executes each operation of a batch request in turn, within the same
+    // transaction. The writes of an operation which fails, or does not apply
+    // its writes, are rolled back without affecting the others.
+    void execute_batch(
+      const endpoints::EndpointDefinitionPtr& endpoint,
+      endpoints::EndpointContext& args)
+    {
+      const auto operations = args.rpc_ctx->get_batch_operations();
+      for (const auto& op : operations)
+      {
+        const auto savepoint = args.tx.savepoint();
+        auto op_args =
+          endpoints::EndpointContext(op, std::move(args.caller), args.tx);
+
+        bool apply_writes = false;
+        try
+        {
+          endpoints.execute_endpoint(endpoint, op_args);
+          apply_writes = op->should_apply_writes();
+        }
+        catch (const kv::CompactedVersionConflict&)
+        {
+          // The whole batch is retried
+          args.caller = std::move(op_args.caller);
+          throw;
+        }
+        catch (RpcException& e)
+        {
+          op->set_error(std::move(e.error));
+        }
+        catch (JsonParseError& e)
+        {
+          op->set_error(
+            HTTP_STATUS_BAD_REQUEST,
+            ccf::errors::InvalidInput,
+            fmt::format("At {}: {}", e.pointer(), e.what()));
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+          op->set_error(
+            HTTP_STATUS_BAD_REQUEST, ccf::errors::InvalidInput, e.what());
+        }
+        catch (const std::exception& e)
+        {
+          op->set_error(
+            HTTP_STATUS_INTERNAL_SERVER_ERROR,
+            ccf::errors::InternalError,
+            e.what());
+        }
+
+        args.caller = std::move(op_args.caller);
+        if (!apply_writes)
+        {
+          args.tx.rollback_to(savepoint);
+        }
+      }
+
+      args.rpc_ctx->set_batch_response(operations);
+    }
+
     std::optional<std::vector<uint8_t>> process_command(
       std::shared_ptr<enclave::RpcContext> ctx,
       kv::CommittableTx& tx,
@@ -219,6 +279,17 @@ namespace ccf
         }
       }
 
+      if (ctx->is_batch_request() && !endpoint->properties.batchable)
+      {
+        ctx->set_error(
+          HTTP_STATUS_BAD_REQUEST,
+          ccf::errors::InvalidHeaderValue,
+          fmt::format(
+            "{} does not accept batch requests.", ctx->get_method()));
+        update_metrics(ctx, endpoint);
+        return ctx->serialise_response();
+      }
+
       update_history();
 
       const bool is_primary = (consensus == nullptr) ||
@@ -269,6 +340,13 @@ namespace ccf
       size_t attempts = 0;
       constexpr auto max_attempts = 30;
 
+      // Read-only endpoints are executed over the latest state of the KV,
+      // without locking maps, recording reads or committing. If one writes
+      // nonetheless, it is executed again as a regular transaction.
+      bool read_only_snapshot =
+        endpoint->properties.mode == endpoints::Mode::ReadOnly &&
+        prescribed_commit_version == kv::NoVersion && !pre_exec;
+
       while (attempts < max_attempts)
       {
         if (attempts > 0)
@@ -285,12 +363,28 @@ namespace ccf
 
         try
         {
+          if (read_only_snapshot)
+          {
+            // Dispatch and authentication have already read from tx, so the
+            // snapshot is taken on a fresh transaction
+            tx = tables.create_tx();
+            set_root_on_proposals(*ctx, tx);
+            tx.set_read_only_snapshot();
+          }
+
           if (pre_exec)
           {
             pre_exec(tx, *ctx.get());
           }
 
-          endpoints.execute_endpoint(endpoint, args);
+          if (ctx->is_batch_request())
+          {
+            execute_batch(endpoint, args);
+          }
+          else
+          {
+            endpoints.execute_endpoint(endpoint, args);
+          }
 
           if (!ctx->should_apply_writes())
           {
@@ -298,6 +392,12 @@ namespace ccf
             return ctx->serialise_response();
           }
 
+          if (read_only_snapshot && tx.has_writes())
+          {
+            read_only_snapshot = false;
+            continue;
+          }
+
           kv::CommitResult result;
           bool track_read_versions =
             (consensus != nullptr && consensus->type() == ConsensusType::BFT);
@@ -492,7 +492,7 @@ namespace ccf
       openapi_info.description =
         "This API is used to submit and query proposals which affect CCF's "
         "public governance tables.";
-      openapi_info.document_version = "1.1.0";
+      openapi_info.document_version = "1.2.0";
     }
 
     static std::optional<MemberId> get_caller_member_id(
@@ -228,7 +228,7 @@ namespace ccf
       openapi_info.description =
         "This API provides public, uncredentialed access to service and node "
         "state.";
-      openapi_info.document_version = "1.4.0";
+      openapi_info.document_version = "1.5.0";
     }
 
     void init_handlers() override
@@ -201,6 +201,40 @@ public:
   }
 };
 
+class TestBatchFrontend : public BaseTestFrontend
+{
+public:
+  kv::Map<size_t, size_t> values;
+
+  TestBatchFrontend(kv::Store& tables) :
+    BaseTestFrontend(tables),
+    values("test_values")
+  {
+    open();
+
+    auto set_value = [this](ccf::endpoints::EndpointContext& ctx) {
+      const auto parsed =
+        nlohmann::json::parse(ctx.rpc_ctx->get_request_body());
+
+      auto vs = ctx.tx.rw(values);
+      vs->put(parsed["key"].get<size_t>(), parsed["value"].get<size_t>());
+
+      if (parsed.value("fail", false))
+      {
+        throw ccf::RpcException(
+          HTTP_STATUS_BAD_REQUEST, ccf::errors::InvalidInput, "Failed");
+      }
+
+      ctx.rpc_ctx->set_response_status(HTTP_STATUS_OK);
+      ctx.rpc_ctx->set_response_body(parsed["key"].dump());
+      ctx.rpc_ctx->set_response_header(
+        http::headers::CONTENT_TYPE, http::headervalues::contenttype::JSON);
+    };
+    make_endpoint("/set", HTTP_POST, set_value).set_batchable(true).install();
+    make_endpoint("/set_one", HTTP_POST, set_value).install();
+  }
+};
+
 class TestAlternativeHandlerTypes : public BaseTestFrontend
 {
 public:
@@ -229,6 +263,40 @@ public:
   }
 };
 
+class TestReadOnlyFrontend : public BaseTestFrontend
+{
+public:
+  kv::Map<size_t, size_t> values;
+
+  TestReadOnlyFrontend(kv::Store& tables) :
+    BaseTestFrontend(tables),
+    values("test_values")
+  {
+    open();
+
+    auto get_value = [this](ccf::endpoints::ReadOnlyEndpointContext& ctx) {
+      const auto v = ctx.tx.ro(values)->get(0);
+      ctx.rpc_ctx->set_response_status(HTTP_STATUS_OK);
+      ctx.rpc_ctx->set_response_body(nlohmann::json(v).dump());
+    };
+    endpoints
+      .make_read_only_endpoint(
+        "/get_value", HTTP_GET, get_value, {user_cert_auth_policy})
+      .install();
+
+    // As a JS endpoint declared with "mode": "readonly" may do
+    auto set_value = [this](ccf::endpoints::EndpointContext& ctx) {
+      auto vs = ctx.tx.rw(values);
+      vs->put(0, vs->get(0).value_or(0) + 1);
+      ctx.rpc_ctx->set_response_status(HTTP_STATUS_OK);
+    };
+    auto endpoint = make_endpoint(
+      "/set_value", HTTP_POST, set_value, {user_cert_auth_policy});
+    endpoint.properties.mode = ccf::endpoints::Mode::ReadOnly;
+    endpoint.install();
+  }
+};
+
 class TestTemplatedPaths : public BaseTestFrontend
 {
 public:
@@ -245,6 +313,24 @@ public:
   }
 };
 
+class TestTemplatedSegments : public BaseTestFrontend
+{
+public:
+  TestTemplatedSegments(kv::Store& tables) : BaseTestFrontend(tables)
+  {
+    open();
+
+    auto endpoint = [this](auto& ctx) {
+      nlohmann::json response_body = ctx.rpc_ctx->get_request_path_params();
+      ctx.rpc_ctx->set_response_body(response_body.dump(2));
+      ctx.rpc_ctx->set_response_status(HTTP_STATUS_OK);
+    };
+    make_endpoint("/records/{id}.json", HTTP_POST, endpoint).install();
+    make_endpoint("/records/{id}/{field}", HTTP_POST, endpoint).install();
+    make_endpoint("/records/{id}", HTTP_GET, endpoint).install();
+  }
+};
+
 class TestMemberFrontend : public MemberRpcFrontend
 {
 public:
@@ -1074,6 +1160,67 @@ TEST_CASE("Explicit commitability")
   }
 }
 
+TEST_CASE("Batch requests")
+{
+  NetworkState network;
+  prepare_callers(network);
+  TestBatchFrontend frontend(*network.tables);
+
+  auto make_batch = [](const std::string& method, const nlohmann::json& ops) {
+    http::Request request(method, HTTP_POST);
+    request.set_header(http::headers::CCF_BATCH, "true");
+    request.set_header(
+      http::headers::CONTENT_TYPE, http::headervalues::contenttype::JSON);
+    const auto s = ops.dump();
+    const std::vector<uint8_t> body(s.begin(), s.end());
+    request.set_body(&body);
+    return request.build_request();
+  };
+
+  {
+    INFO("Operations are executed and committed together");
+    const auto ops = nlohmann::json::array(
+      {{{"key", 1}, {"value", 10}},
+       {{"key", 2}, {"value", 20}, {"fail", true}},
+       {{"key", 3}, {"value", 30}},
+       {{"key", 1}, {"value", 11}, {"fail", true}}});
+
+    auto rpc_ctx =
+      enclave::make_rpc_context(user_session, make_batch("set", ops));
+    const auto response = parse_response(frontend.process(rpc_ctx).value());
+    REQUIRE(response.status == HTTP_STATUS_OK);
+
+    const auto results = nlohmann::json::parse(response.body);
+    REQUIRE(results.size() == ops.size());
+    CHECK(results[0]["status"] == HTTP_STATUS_OK);
+    CHECK(results[0]["body"] == 1);
+    CHECK(results[1]["status"] == HTTP_STATUS_BAD_REQUEST);
+    CHECK(results[1]["body"]["error"]["code"] == ccf::errors::InvalidInput);
+    CHECK(results[2]["status"] == HTTP_STATUS_OK);
+    CHECK(results[3]["status"] == HTTP_STATUS_BAD_REQUEST);
+
+    INFO("Only the writes of failed operations are rolled back");
+    auto tx = network.tables->create_tx();
+    auto values = tx.ro(frontend.values);
+    CHECK(values->get(1) == 10);
+    CHECK_FALSE(values->has(2));
+    CHECK(values->get(3) == 30);
+  }
+
+  {
+    INFO("Batch requests to other endpoints are rejected");
+    const auto ops = nlohmann::json::array({{{"key", 4}, {"value", 40}}});
+
+    auto rpc_ctx =
+      enclave::make_rpc_context(user_session, make_batch("set_one", ops));
+    const auto response = parse_response(frontend.process(rpc_ctx).value());
+    CHECK(response.status == HTTP_STATUS_BAD_REQUEST);
+
+    auto tx = network.tables->create_tx();
+    CHECK_FALSE(tx.ro(frontend.values)->has(4));
+  }
+}
+
 TEST_CASE("Alternative endpoints")
 {
   NetworkState network;
@@ -1101,6 +1248,47 @@ TEST_CASE("Alternative endpoints")
   }
 }
 
+TEST_CASE("Read-only endpoints")
+{
+  NetworkState network;
+  prepare_callers(network);
+  TestReadOnlyFrontend frontend(*network.tables);
+
+  auto get_value = [&](const std::shared_ptr<enclave::SessionContext>& s) {
+    http::Request request("get_value", HTTP_GET);
+    auto rpc_ctx = enclave::make_rpc_context(s, request.build_request());
+    return parse_response(frontend.process(rpc_ctx).value());
+  };
+
+  {
+    INFO("Authenticated read-only endpoints are executed over a snapshot");
+    const auto response = get_value(user_session);
+    REQUIRE(response.status == HTTP_STATUS_OK);
+    CHECK(nlohmann::json::parse(response.body).is_null());
+
+    CHECK(get_value(invalid_session).status == HTTP_STATUS_UNAUTHORIZED);
+  }
+
+  {
+    INFO("Read-only endpoints which write are committed as regular ones");
+    const auto version = network.tables->current_version();
+    for (size_t i = 1; i <= 2; ++i)
+    {
+      http::Request request("set_value", HTTP_POST);
+      auto rpc_ctx =
+        enclave::make_rpc_context(user_session, request.build_request());
+      const auto response =
+        parse_response(frontend.process(rpc_ctx).value());
+      REQUIRE(response.status == HTTP_STATUS_OK);
+      CHECK(network.tables->current_version() == version + i);
+
+      const auto read = get_value(user_session);
+      REQUIRE(read.status == HTTP_STATUS_OK);
+      CHECK(nlohmann::json::parse(read.body) == i);
+    }
+  }
+}
+
 TEST_CASE("Templated paths")
 {
   NetworkState network;
@@ -1146,6 +1334,58 @@ TEST_CASE("Templated paths")
   }
 }
 
+TEST_CASE("Templated path segments")
+{
+  NetworkState network;
+  prepare_callers(network);
+  TestTemplatedSegments frontend(*network.tables);
+
+  auto process = [&](const std::string& path) {
+    auto request = create_simple_request(path);
+    const auto serialized_request = request.build_request();
+
+    auto rpc_ctx = enclave::make_rpc_context(user_session, serialized_request);
+    return parse_response(frontend.process(rpc_ctx).value());
+  };
+
+  {
+    INFO("Template within a segment");
+    const auto response = process("/records/42.json");
+    CHECK(response.status == HTTP_STATUS_OK);
+
+    std::map<std::string, std::string> expected_mapping;
+    expected_mapping["id"] = "42";
+
+    const auto response_json = nlohmann::json::parse(response.body);
+    CHECK(response_json.get<decltype(expected_mapping)>() == expected_mapping);
+  }
+
+  {
+    INFO("Templates spanning several segments");
+    const auto response = process("/records/42/name");
+    CHECK(response.status == HTTP_STATUS_OK);
+
+    std::map<std::string, std::string> expected_mapping;
+    expected_mapping["id"] = "42";
+    expected_mapping["field"] = "name";
+
+    const auto response_json = nlohmann::json::parse(response.body);
+    CHECK(response_json.get<decltype(expected_mapping)>() == expected_mapping);
+  }
+
+  {
+    INFO("Templated path only installed for another verb");
+    const auto response = process("/records/42");
+    CHECK(response.status == HTTP_STATUS_METHOD_NOT_ALLOWED);
+  }
+
+  {
+    INFO("Templates do not match empty or partial segments");
+    CHECK(process("/records//name").status == HTTP_STATUS_NOT_FOUND);
+    CHECK(process("/records/42/name/x").status == HTTP_STATUS_NOT_FOUND);
+  }
+}
+
 TEST_CASE("Signed read requests can be executed on backup")
 {
   NetworkState network;
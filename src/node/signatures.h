@@ -59,4 +59,9 @@ namespace ccf
 
   // Serialised Merkle tree at most recent signature is a single Value in the KV
   using SerialisedMerkleTree = kv::RawCopySerialisedValue<std::vector<uint8_t>>;
+
+  // Signatures which do not record their full tree instead record a delta from
+  // the most recent one which did
+  using SerialisedMerkleTreeDelta =
+    kv::RawCopySerialisedValue<std::vector<uint8_t>>;
 }
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include "node/network_state.h"
 #include "node/snapshot_evidence.h"
 
+#include <atomic>
 #include <deque>
 #include <optional>
 
@@ -31,6 +32,14 @@ namespace ccf
     // Snapshots are never generated by default (e.g. during public recovery)
     size_t snapshot_tx_interval = max_tx_interval;
 
+    // Approximate size of each chunk of a serialised snapshot. If 0, each
+    // snapshot is serialised as a single chunk.
+    size_t snapshot_chunk_size = 0;
+
+    // When this is set, the maps of each snapshot are serialised on all
+    // worker threads
+    bool parallel_serialisation = false;
+
     struct SnapshotInfo
     {
       consensus::Index idx;
@@ -55,13 +64,21 @@ namespace ccf
     // Indices at which a snapshot will be next generated
     std::deque<consensus::Index> next_snapshot_indices;
 
-    void record_snapshot(
-      consensus::Index idx,
-      consensus::Index evidence_idx,
-      const std::vector<uint8_t>& serialised_snapshot)
+    void record_snapshot_chunk(
+      consensus::Index idx, const std::vector<uint8_t>& serialised_chunk)
     {
       RINGBUFFER_WRITE_MESSAGE(
-        consensus::snapshot, to_host, idx, evidence_idx, serialised_snapshot);
+        consensus::snapshot_chunk, to_host, idx, serialised_chunk);
+    }
+
+    void record_snapshot(consensus::Index idx, consensus::Index evidence_idx)
+    {
+      RINGBUFFER_WRITE_MESSAGE(consensus::snapshot, to_host, idx, evidence_idx);
+    }
+
+    void abort_snapshot(consensus::Index idx)
+    {
+      RINGBUFFER_WRITE_MESSAGE(consensus::snapshot_abort, to_host, idx);
     }
 
     void commit_snapshot(
@@ -87,13 +104,224 @@ namespace ccf
     void snapshot_(
       std::unique_ptr<kv::AbstractStore::AbstractSnapshot> snapshot)
     {
+      // Worker threads are 1 to thread_count - 1
+      const size_t worker_count = threading::ThreadMessaging::thread_count - 1;
+      if (parallel_serialisation && worker_count > 1)
+      {
+        serialise_snapshot_maps(std::move(snapshot));
+        return;
+      }
+
       auto snapshot_version = snapshot->get_version();
 
-      auto serialised_snapshot = store->serialise_snapshot(std::move(snapshot));
+      // Each chunk is passed on to the host as soon as it is serialised, so
+      // that the whole serialised snapshot is never held in memory. The
+      // snapshot hash covers all chunks, in order.
+      auto snapshot_hasher = crypto::make_incremental_sha256();
+      store->serialise_snapshot_chunks(
+        std::move(snapshot),
+        snapshot_chunk_size,
+        [this, snapshot_version, &snapshot_hasher](
+          std::vector<uint8_t>&& serialised_chunk) {
+          snapshot_hasher->update_hash(
+            {serialised_chunk.data(), serialised_chunk.size()});
+          record_snapshot_chunk(snapshot_version, serialised_chunk);
+        });
+
+      commit_snapshot_evidence(snapshot_version, snapshot_hasher->finalise());
+    }
+
+    struct ParallelSnapshot
+    {
+      ParallelSnapshot(
+        std::shared_ptr<Snapshotter> self_,
+        std::unique_ptr<kv::AbstractStore::AbstractSnapshot> snapshot_) :
+        self(self_),
+        snapshot(std::move(snapshot_)),
+        map_count(snapshot->get_map_count()),
+        map_chunks(map_count),
+        hasher(crypto::make_incremental_sha256())
+      {}
+
+      std::shared_ptr<Snapshotter> self;
+      std::unique_ptr<kv::AbstractStore::AbstractSnapshot> snapshot;
+      size_t map_count;
+
+      std::mutex lock;
+      // Chunks of each map, in serialisation order, once serialised and until
+      // passed on to the host
+      std::vector<std::optional<std::vector<std::vector<uint8_t>>>> map_chunks;
+      // Index of the next map whose chunks are passed on to the host
+      size_t next_map_idx = 0;
+      // Set while a thread is passing chunks on to the host
+      bool recording = false;
+      bool failed = false;
+
+      // Only used by the thread passing chunks on to the host
+      std::shared_ptr<crypto::ISha256Hash> hasher;
+    };
+
+    struct AsyncMapSerialisation
+    {
+      AsyncMapSerialisation(
+        std::shared_ptr<ParallelSnapshot> parallel_snapshot_, size_t map_idx_) :
+        parallel_snapshot(parallel_snapshot_),
+        map_idx(map_idx_)
+      {}
+
+      std::shared_ptr<ParallelSnapshot> parallel_snapshot;
+      size_t map_idx;
+    };
+
+    void serialise_snapshot_maps(
+      std::unique_ptr<kv::AbstractStore::AbstractSnapshot> snapshot)
+    {
+      // Each map is serialised into chunks of its own, with one task per map,
+      // so that maps can be serialised concurrently. The chunks are passed on
+      // to the host in map order, as soon as those of all preceding maps have
+      // been, so that the serialised snapshot only depends on the state and
+      // the chunk size.
+      auto parallel_snapshot = std::make_shared<ParallelSnapshot>(
+        shared_from_this(), std::move(snapshot));
+      record_parallel_snapshot_chunk(
+        *parallel_snapshot,
+        parallel_snapshot->snapshot->serialise_header_chunk(
+          store->get_encryptor()));
+
+      if (parallel_snapshot->map_count == 0)
+      {
+        record_parallel_snapshot_end(*parallel_snapshot);
+        return;
+      }
+
+      uint32_t task_idx = 0;
+      for (size_t i = 0; i < parallel_snapshot->map_count; ++i)
+      {
+        auto msg = std::make_unique<threading::Tmsg<AsyncMapSerialisation>>(
+          &serialise_map_chunks_cb, parallel_snapshot, i);
+        threading::ThreadMessaging::thread_messaging.add_task(
+          threading::ThreadMessaging::get_execution_thread(task_idx++),
+          std::move(msg));
+      }
+    }
+
+    static void serialise_map_chunks_cb(
+      std::unique_ptr<threading::Tmsg<AsyncMapSerialisation>> msg)
+    {
+      auto& parallel_snapshot = msg->data.parallel_snapshot;
+      auto& self = parallel_snapshot->self;
+      const auto map_idx = msg->data.map_idx;
+
+      std::vector<std::vector<uint8_t>> chunks;
+      bool failed = false;
+      try
+      {
+        chunks = parallel_snapshot->snapshot->serialise_map_chunks(
+          self->store->get_encryptor(), map_idx, self->snapshot_chunk_size);
+      }
+      catch (const std::exception& e)
+      {
+        LOG_FAIL_FMT(
+          "Could not serialise map {} of snapshot at {}: {}",
+          map_idx,
+          parallel_snapshot->snapshot->get_version(),
+          e.what());
+        failed = true;
+      }
+
+      {
+        std::lock_guard<std::mutex> guard(parallel_snapshot->lock);
+        parallel_snapshot->map_chunks[map_idx] = std::move(chunks);
+        parallel_snapshot->failed |= failed;
+        if (parallel_snapshot->recording)
+        {
+          // The thread recording chunks records these too, if they are next
+          return;
+        }
+        parallel_snapshot->recording = true;
+      }
+
+      self->record_map_chunks(*parallel_snapshot);
+    }
+
+    // Passes on to the host the chunks of the maps which are next in order
+    // and serialised, until the next map is not serialised yet
+    void record_map_chunks(ParallelSnapshot& parallel_snapshot)
+    {
+      while (true)
+      {
+        std::vector<std::vector<std::vector<uint8_t>>> ready;
+        {
+          std::lock_guard<std::mutex> guard(parallel_snapshot.lock);
+          auto& next = parallel_snapshot.next_map_idx;
+          auto& map_chunks = parallel_snapshot.map_chunks;
+          while (next < parallel_snapshot.map_count &&
+                 map_chunks[next].has_value())
+          {
+            ready.push_back(std::move(map_chunks[next].value()));
+            map_chunks[next].reset();
+            ++next;
+          }
+
+          if (ready.empty())
+          {
+            parallel_snapshot.recording = false;
+            return;
+          }
+        }
+
+        for (auto& chunks : ready)
+        {
+          for (auto& chunk : chunks)
+          {
+            record_parallel_snapshot_chunk(parallel_snapshot, std::move(chunk));
+          }
+        }
+
+        bool done = false;
+        {
+          std::lock_guard<std::mutex> guard(parallel_snapshot.lock);
+          done = parallel_snapshot.next_map_idx == parallel_snapshot.map_count;
+        }
 
+        if (done)
+        {
+          record_parallel_snapshot_end(parallel_snapshot);
+          return;
+        }
+      }
+    }
+
+    void record_parallel_snapshot_chunk(
+      ParallelSnapshot& parallel_snapshot,
+      std::vector<uint8_t>&& serialised_chunk)
+    {
+      parallel_snapshot.hasher->update_hash(
+        {serialised_chunk.data(), serialised_chunk.size()});
+      record_snapshot_chunk(
+        parallel_snapshot.snapshot->get_version(), serialised_chunk);
+      serialised_chunk.clear();
+      serialised_chunk.shrink_to_fit();
+    }
+
+    void record_parallel_snapshot_end(ParallelSnapshot& parallel_snapshot)
+    {
+      const auto snapshot_version = parallel_snapshot.snapshot->get_version();
+      if (parallel_snapshot.failed)
+      {
+        abort_snapshot(snapshot_version);
+        return;
+      }
+
+      commit_snapshot_evidence(
+        snapshot_version, parallel_snapshot.hasher->finalise());
+    }
+
+    void commit_snapshot_evidence(
+      kv::Version snapshot_version, const crypto::Sha256Hash& snapshot_hash)
+    {
       auto tx = store->create_tx();
       auto evidence = tx.rw<SnapshotEvidence>(Tables::SNAPSHOT_EVIDENCE);
-      auto snapshot_hash = crypto::Sha256Hash(serialised_snapshot);
       evidence->put(0, {snapshot_hash, snapshot_version});
 
       auto rc = tx.commit();
@@ -103,12 +331,13 @@ namespace ccf
           "Could not commit snapshot evidence for seqno {}: {}",
           snapshot_version,
           rc);
+        abort_snapshot(snapshot_version);
         return;
       }
 
       auto evidence_version = tx.commit_version();
 
-      record_snapshot(snapshot_version, evidence_version, serialised_snapshot);
+      record_snapshot(snapshot_version, evidence_version);
       consensus::Index snapshot_idx =
         static_cast<consensus::Index>(snapshot_version);
       consensus::Index snapshot_evidence_idx =
@@ -141,9 +370,7 @@ namespace ccf
           if (idx > it->evidence_commit_idx.value())
           {
             commit_snapshot(it->idx, idx);
-            auto it_ = it;
-            it++;
-            snapshot_evidence_indices.erase(it_);
+            it = snapshot_evidence_indices.erase(it);
             continue;
           }
         }
@@ -159,10 +386,14 @@ namespace ccf
     Snapshotter(
       ringbuffer::AbstractWriterFactory& writer_factory,
       std::shared_ptr<kv::Store>& store_,
-      size_t snapshot_tx_interval_) :
+      size_t snapshot_tx_interval_,
+      size_t snapshot_chunk_size_ = 0,
+      bool parallel_serialisation_ = false) :
       to_host(writer_factory.create_writer_to_outside()),
       store(store_),
-      snapshot_tx_interval(snapshot_tx_interval_)
+      snapshot_tx_interval(snapshot_tx_interval_),
+      snapshot_chunk_size(snapshot_chunk_size_),
+      parallel_serialisation(parallel_serialisation_)
     {
       next_snapshot_indices.push_back(last_snapshot_idx);
     }
@@ -361,6 +361,81 @@ TEST_CASE("Backup catchup from many ledger secrets")
   }
 }
 
+TEST_CASE("Backup prepares entries ahead of applying them")
+{
+  auto consensus = std::make_shared<kv::test::StubConsensus>();
+  StringString map("map");
+  kv::Store primary_store;
+  kv::Store backup_store;
+
+  auto primary_ledger_secrets = std::make_shared<ccf::LedgerSecrets>();
+  primary_ledger_secrets->init();
+  primary_store.set_encryptor(
+    std::make_shared<ccf::NodeEncryptor>(primary_ledger_secrets));
+  primary_store.set_consensus(consensus);
+
+  auto tx = primary_store.create_tx();
+  auto backup_ledger_secrets = std::make_shared<ccf::LedgerSecrets>();
+  backup_ledger_secrets->init_from_map(primary_ledger_secrets->get(tx));
+  backup_store.set_encryptor(
+    std::make_shared<ccf::NodeEncryptor>(backup_ledger_secrets));
+
+  INFO("Entries prepared out of order are applied in order");
+  {
+    auto current_version = primary_store.current_version();
+    for (size_t i = 2; i < 6; ++i)
+    {
+      commit_one(primary_store, map);
+      auto new_ledger_secret = ccf::make_ledger_secret();
+      auto ledger_secret_for_backup = new_ledger_secret;
+      primary_ledger_secrets->set_secret(
+        current_version + i, std::move(new_ledger_secret));
+      backup_ledger_secrets->set_secret(
+        current_version + i, std::move(ledger_secret_for_backup));
+    }
+
+    std::vector<std::unique_ptr<kv::AbstractExecutionWrapper>> entries;
+    auto next_entry = consensus->pop_oldest_entry();
+    while (next_entry.has_value())
+    {
+      entries.push_back(backup_store.deserialize(
+        *std::get<1>(next_entry.value()), ConsensusType::CFT));
+      next_entry = consensus->pop_oldest_entry();
+    }
+
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+    {
+      (*it)->prepare();
+    }
+
+    for (auto& entry : entries)
+    {
+      REQUIRE(entry->apply() == kv::ApplyResult::PASS);
+    }
+  }
+
+  INFO("Entry prepared before its ledger secret is known is still applied");
+  {
+    auto new_ledger_secret = ccf::make_ledger_secret();
+    auto ledger_secret_for_backup = new_ledger_secret;
+    const auto rekey_version = primary_store.current_version() + 1;
+    primary_ledger_secrets->set_secret(
+      rekey_version, std::move(new_ledger_secret));
+    commit_one(primary_store, map);
+
+    auto entry = backup_store.deserialize(
+      *consensus->get_latest_data(), ConsensusType::CFT);
+    entry->prepare();
+
+    // In practice, the backup learns the new secret when applying the entry
+    // that precedes it
+    backup_ledger_secrets->set_secret(
+      rekey_version, std::move(ledger_secret_for_backup));
+
+    REQUIRE(entry->apply() == kv::ApplyResult::PASS);
+  }
+}
+
 TEST_CASE("KV integrity verification")
 {
   auto consensus = std::make_shared<kv::test::StubConsensus>();
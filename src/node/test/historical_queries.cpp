@@ -600,6 +600,96 @@ TEST_CASE("StateCache range queries")
   }
 }
 
+TEST_CASE("StateCache batched range fetches")
+{
+  auto state = create_and_init_state();
+  auto& kv_store = *state.kv_store;
+
+  const auto begin_seqno = kv_store.current_version() + 1;
+  const auto end_seqno = write_transactions_and_signature(kv_store, 20);
+
+  auto writer = std::make_shared<StubWriter>();
+  ccf::historical::StateCache cache(kv_store, state.ledger_secrets, writer);
+  auto ledger = construct_host_ledger(state.kv_store->get_consensus());
+
+  const ccf::historical::RequestHandle default_handle = 0;
+  const auto range_start = begin_seqno + 2;
+  const auto range_end = end_seqno;
+
+  {
+    INFO("Contiguous range is requested from the host in a single message");
+    REQUIRE(
+      cache.get_store_range(default_handle, range_start, range_end).empty());
+    REQUIRE(writer->writes.size() == 1);
+
+    const auto& write = writer->writes.front();
+    REQUIRE(write.m == consensus::ledger_get_range);
+    const uint8_t* data = write.contents.data();
+    size_t size = write.contents.size();
+    auto [from, to, purpose] =
+      ringbuffer::read_message<consensus::ledger_get_range>(data, size);
+    REQUIRE(from == range_start);
+    REQUIRE(to == range_end);
+    REQUIRE(purpose == consensus::LedgerRequestPurpose::HistoricalQuery);
+  }
+
+  {
+    INFO("Extending the range only requests new entries");
+    REQUIRE(cache.get_store_range(default_handle, range_start - 2, range_end)
+              .empty());
+    REQUIRE(writer->writes.size() == 2);
+
+    const auto& write = writer->writes.back();
+    REQUIRE(write.m == consensus::ledger_get_range);
+    const uint8_t* data = write.contents.data();
+    size_t size = write.contents.size();
+    auto [from, to, purpose] =
+      ringbuffer::read_message<consensus::ledger_get_range>(data, size);
+    REQUIRE(from == range_start - 2);
+    REQUIRE(to == range_start - 1);
+  }
+
+  {
+    INFO("Cache accepts framed range of entries");
+    std::vector<uint8_t> framed_entries;
+    for (auto seqno = range_start - 2; seqno <= range_end; ++seqno)
+    {
+      const auto& entry = ledger.at(seqno);
+      framed_entries.insert(framed_entries.end(), entry.begin(), entry.end());
+    }
+
+    REQUIRE(
+      cache.handle_ledger_entries(
+        range_start - 2, range_end, framed_entries) ==
+      range_end - range_start + 3);
+
+    auto stores =
+      cache.get_store_range(default_handle, range_start - 2, range_end);
+    REQUIRE(stores.size() == range_end - range_start + 3);
+    for (size_t i = 0; i < stores.size() - 1; ++i)
+    {
+      validate_business_transaction(stores[i], range_start - 2 + i);
+    }
+  }
+
+  {
+    INFO("Truncated ranges are rejected");
+    const auto other_handle = 1;
+    REQUIRE(
+      cache.get_store_range(other_handle, begin_seqno, begin_seqno + 1)
+        .empty());
+
+    const auto& entry = ledger.at(begin_seqno);
+    std::vector<uint8_t> truncated(entry.begin(), entry.end() - 1);
+    REQUIRE(
+      cache.handle_ledger_entries(begin_seqno, begin_seqno + 1, truncated) ==
+      0);
+    REQUIRE(
+      cache.get_store_range(other_handle, begin_seqno, begin_seqno + 1)
+        .empty());
+  }
+}
+
 TEST_CASE("StateCache concurrent access")
 {
   auto state = create_and_init_state();
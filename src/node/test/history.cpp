@@ -9,6 +9,7 @@
 #include "kv/test/stub_consensus.h"
 #include "node/entities.h"
 #include "node/nodes.h"
+#include "node/receipt_cache.h"
 #include "node/signatures.h"
 
 #define DOCTEST_CONFIG_IMPLEMENT
@@ -117,6 +118,70 @@ TEST_CASE("Check signature verification")
   }
 }
 
+TEST_CASE("Entries hashed on commit match entries hashed on deserialisation")
+{
+  auto encryptor = std::make_shared<kv::NullTxEncryptor>();
+
+  kv::Store primary_store;
+  primary_store.set_encryptor(encryptor);
+
+  kv::Store backup_store;
+  backup_store.set_encryptor(encryptor);
+
+  auto kp = crypto::make_key_pair();
+
+  std::shared_ptr<kv::Consensus> consensus =
+    std::make_shared<DummyConsensus>(&backup_store);
+  primary_store.set_consensus(consensus);
+  std::shared_ptr<kv::Consensus> null_consensus =
+    std::make_shared<DummyConsensus>(nullptr);
+  backup_store.set_consensus(null_consensus);
+
+  std::shared_ptr<kv::TxHistory> primary_history =
+    std::make_shared<ccf::MerkleTxHistory>(
+      primary_store, kv::test::PrimaryNodeId, *kp);
+  primary_store.set_history(primary_history);
+
+  std::shared_ptr<kv::TxHistory> backup_history =
+    std::make_shared<ccf::MerkleTxHistory>(
+      backup_store, kv::test::FirstBackupNodeId, *kp);
+  backup_store.set_history(backup_history);
+
+  ccf::Nodes nodes(ccf::Tables::NODES);
+  kv::Map<size_t, std::vector<uint8_t>> table("public:table");
+
+  INFO("Write certificate");
+  {
+    auto txs = primary_store.create_tx();
+    auto tx = txs.rw(nodes);
+    ccf::NodeInfo ni;
+    ni.cert = kp->self_sign("CN=name");
+    tx->put(kv::test::PrimaryNodeId, ni);
+    REQUIRE(txs.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  // The primary hashes each entry when it is committed, while the backup
+  // hashes it when it is deserialised
+  for (size_t size : {1, 1 << 10, 1 << 20})
+  {
+    auto tx = primary_store.create_tx();
+    tx.rw(table)->put(size, std::vector<uint8_t>(size, 42));
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  primary_history->emit_signature();
+  REQUIRE(backup_store.current_version() == 5);
+
+  for (size_t i = 1; i <= 4; ++i)
+  {
+    REQUIRE(
+      primary_history->get_raw_leaf(i) == backup_history->get_raw_leaf(i));
+  }
+  REQUIRE(
+    primary_history->get_replicated_state_root() ==
+    backup_history->get_replicated_state_root());
+}
+
 TEST_CASE("Check signing works across rollback")
 {
   auto encryptor = std::make_shared<kv::NullTxEncryptor>();
@@ -210,6 +275,151 @@ TEST_CASE("Check signing works across rollback")
   }
 }
 
+class BatchDummyConsensus : public DummyConsensus
+{
+public:
+  using DummyConsensus::DummyConsensus;
+
+  bool replicate(const kv::BatchVector& entries, ccf::View view) override
+  {
+    for (const auto& [version, data, committable, hooks] : entries)
+    {
+      if (
+        store->deserialize(*data, ConsensusType::CFT)->apply() ==
+        kv::ApplyResult::FAIL)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// Sets the number of threads until the end of a test, and restores it even
+// if the test fails
+class ThreadCountGuard
+{
+  uint16_t previous;
+
+public:
+  ThreadCountGuard(uint16_t count) :
+    previous(threading::ThreadMessaging::thread_count.exchange(count))
+  {}
+
+  ~ThreadCountGuard()
+  {
+    threading::ThreadMessaging::thread_count = previous;
+  }
+};
+
+TEST_CASE("Async signatures")
+{
+  // Async signatures are signed on the main thread, when there are worker
+  // threads
+  ThreadCountGuard thread_count_guard(2);
+
+  auto encryptor = std::make_shared<kv::NullTxEncryptor>();
+
+  kv::Store primary_store;
+  primary_store.set_encryptor(encryptor);
+
+  kv::Store backup_store;
+  backup_store.set_encryptor(encryptor);
+
+  ccf::Nodes nodes(ccf::Tables::NODES);
+  MapT table("public:table");
+
+  auto kp = crypto::make_key_pair();
+
+  std::shared_ptr<kv::Consensus> consensus =
+    std::make_shared<BatchDummyConsensus>(&backup_store);
+  primary_store.set_consensus(consensus);
+  std::shared_ptr<kv::Consensus> null_consensus =
+    std::make_shared<DummyConsensus>(nullptr);
+  backup_store.set_consensus(null_consensus);
+
+  std::shared_ptr<kv::TxHistory> primary_history =
+    std::make_shared<ccf::MerkleTxHistory>(
+      primary_store, kv::test::PrimaryNodeId, *kp, 0, 0, false, true);
+  primary_store.set_history(primary_history);
+
+  std::shared_ptr<kv::TxHistory> backup_history =
+    std::make_shared<ccf::MerkleTxHistory>(
+      backup_store, kv::test::FirstBackupNodeId, *kp);
+  backup_store.set_history(backup_history);
+
+  INFO("Write certificate");
+  {
+    auto txs = primary_store.create_tx();
+    auto tx = txs.rw(nodes);
+    ccf::NodeInfo ni;
+    ni.cert = kp->self_sign("CN=name");
+    tx->put(kv::test::PrimaryNodeId, ni);
+    REQUIRE(txs.commit() == kv::CommitResult::SUCCESS);
+    REQUIRE(backup_store.current_version() == 1);
+  }
+
+  INFO("Emit signature, reserving its version");
+  {
+    primary_history->emit_signature();
+    REQUIRE(primary_store.current_version() == 2);
+    REQUIRE(backup_store.current_version() == 1);
+  }
+
+  INFO("Later transactions commit, but wait for the signature");
+  {
+    auto txs = primary_store.create_tx();
+    txs.rw(table)->put(0, 1);
+    REQUIRE(txs.commit() == kv::CommitResult::SUCCESS);
+    REQUIRE(txs.commit_version() == 3);
+    REQUIRE(backup_store.current_version() == 1);
+  }
+
+  INFO("A single signature is in flight at a time");
+  {
+    primary_history->emit_signature();
+    REQUIRE(primary_store.current_version() == 3);
+  }
+
+  INFO("Signature is signed on the main thread, and verified on the backup");
+  {
+    REQUIRE(threading::ThreadMessaging::thread_messaging.run_one());
+    REQUIRE(backup_store.current_version() == 3);
+
+    auto txs = backup_store.create_read_only_tx();
+    auto sig = txs.ro<ccf::Signatures>(ccf::Tables::SIGNATURES)->get();
+    REQUIRE(sig.has_value());
+    REQUIRE(sig->seqno == 2);
+    REQUIRE(sig->commit_seqno == 0);
+  }
+
+  INFO("A committer waiting for the signature signs it");
+  {
+    primary_history->emit_signature();
+    const auto sig_version = primary_store.current_version();
+
+    // Without the main thread, until the ring of pending transactions is full
+    auto version = sig_version;
+    while (version < sig_version + kv::PendingTxRing::capacity)
+    {
+      auto txs = primary_store.create_tx();
+      txs.rw(table)->put(0, version);
+      REQUIRE(txs.commit() == kv::CommitResult::SUCCESS);
+      version = txs.commit_version();
+    }
+    REQUIRE(backup_store.current_version() == version);
+
+    auto txs = backup_store.create_read_only_tx();
+    auto sig = txs.ro<ccf::Signatures>(ccf::Tables::SIGNATURES)->get();
+    REQUIRE(sig.has_value());
+    REQUIRE(sig->seqno == sig_version);
+
+    // The main thread then finds nothing left to sign
+    REQUIRE(threading::ThreadMessaging::thread_messaging.run_one());
+    REQUIRE(backup_store.current_version() == version);
+  }
+}
+
 class CompactingConsensus : public kv::test::StubConsensus
 {
 public:
@@ -456,6 +666,382 @@ TEST_CASE(
   }
 }
 
+TEST_CASE("Receipts are built from committed signatures")
+{
+  auto encryptor = std::make_shared<kv::NullTxEncryptor>();
+
+  kv::Store store;
+  store.set_encryptor(encryptor);
+  auto consensus = std::make_shared<CompactingConsensus>(&store);
+  store.set_consensus(consensus);
+
+  auto kp = crypto::make_key_pair();
+  auto history = std::make_shared<ccf::MerkleTxHistory>(
+    store, kv::test::PrimaryNodeId, *kp);
+  store.set_history(history);
+
+  ccf::ReceiptCache receipt_cache(store);
+
+  MapT table("public:table");
+  constexpr size_t tx_count = 10;
+  for (size_t i = 0; i < tx_count; ++i)
+  {
+    auto tx = store.create_tx();
+    tx.rw(table)->put(0, i);
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+
+  INFO("No receipts before the transactions are covered by a signature");
+  {
+    REQUIRE(receipt_cache.get(1) == nullptr);
+  }
+
+  const auto root = history->get_replicated_state_root();
+  history->emit_signature();
+  const ccf::SeqNo sig_seqno = tx_count + 1;
+  REQUIRE(store.current_version() == sig_seqno);
+
+  INFO("Receipts for covered transactions prove their leaves");
+  {
+    for (ccf::SeqNo seqno = 1; seqno < sig_seqno; ++seqno)
+    {
+      auto receipt = receipt_cache.get(seqno);
+      REQUIRE(receipt != nullptr);
+      REQUIRE(receipt->node_id == kv::test::PrimaryNodeId);
+      REQUIRE(receipt->root == ccf::HistoryTree::Hash(root.h));
+      REQUIRE(receipt->path != nullptr);
+      REQUIRE(receipt->path->verify(receipt->root));
+
+      const auto& leaf = receipt->path->leaf();
+      REQUIRE(
+        history->get_raw_leaf(seqno) ==
+        std::vector<uint8_t>(leaf.bytes, leaf.bytes + leaf.size()));
+    }
+  }
+
+  INFO("The signature's own receipt has no path");
+  {
+    auto receipt = receipt_cache.get(sig_seqno);
+    REQUIRE(receipt != nullptr);
+    REQUIRE(receipt->path == nullptr);
+    REQUIRE(receipt->root == ccf::HistoryTree::Hash(root.h));
+  }
+
+  INFO("Ranges hold no receipts for transactions which are not covered");
+  {
+    auto tx = store.create_tx();
+    tx.rw(table)->put(0, tx_count);
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+
+    const auto receipts = receipt_cache.get_range(sig_seqno - 1, sig_seqno + 1);
+    REQUIRE(receipts.size() == 3);
+    REQUIRE(receipts[0] == receipt_cache.get(sig_seqno - 1));
+    REQUIRE(receipts[1] == receipt_cache.get(sig_seqno));
+    REQUIRE(receipts[2] == nullptr);
+  }
+}
+
+TEST_CASE("Receipts evicted from the cache are built again")
+{
+  auto encryptor = std::make_shared<kv::NullTxEncryptor>();
+
+  kv::Store store;
+  store.set_encryptor(encryptor);
+  auto consensus = std::make_shared<CompactingConsensus>(&store);
+  store.set_consensus(consensus);
+
+  auto kp = crypto::make_key_pair();
+  auto history = std::make_shared<ccf::MerkleTxHistory>(
+    store, kv::test::PrimaryNodeId, *kp);
+  store.set_history(history);
+
+  constexpr size_t max_receipts = 2;
+  ccf::ReceiptCache receipt_cache(store, max_receipts);
+
+  MapT table("public:table");
+  constexpr size_t sig_count = 3;
+  constexpr size_t tx_count = 5;
+  for (size_t i = 0; i < sig_count; ++i)
+  {
+    for (size_t j = 0; j < tx_count; ++j)
+    {
+      auto tx = store.create_tx();
+      tx.rw(table)->put(0, j);
+      REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    }
+    history->emit_signature();
+  }
+
+  for (ccf::SeqNo seqno = 1; seqno <= store.current_version(); ++seqno)
+  {
+    auto receipt = receipt_cache.get(seqno);
+    REQUIRE(receipt != nullptr);
+    if (receipt->path != nullptr)
+    {
+      REQUIRE(receipt->path->verify(receipt->root));
+      const auto& leaf = receipt->path->leaf();
+      REQUIRE(
+        history->get_raw_leaf(seqno) ==
+        std::vector<uint8_t>(leaf.bytes, leaf.bytes + leaf.size()));
+    }
+    else
+    {
+      REQUIRE(seqno % (tx_count + 1) == 0);
+    }
+  }
+}
+
+// Signs trees which start at the last signature, as if it were committed
+class SignatureCommittingConsensus : public CompactingConsensus
+{
+public:
+  ccf::SeqNo last_signature = 0;
+
+  SignatureCommittingConsensus(kv::Store* store_) :
+    CompactingConsensus(store_)
+  {}
+
+  std::optional<SignableTxIndices> get_signable_txid() override
+  {
+    SignableTxIndices r;
+    r.term = 2;
+    r.version = last_signature;
+    r.previous_version = last_signature;
+    return r;
+  }
+};
+
+TEST_CASE("Receipts are not built for transactions no signature covers")
+{
+  auto encryptor = std::make_shared<kv::NullTxEncryptor>();
+
+  kv::Store store;
+  store.set_encryptor(encryptor);
+  auto consensus = std::make_shared<SignatureCommittingConsensus>(&store);
+  store.set_consensus(consensus);
+
+  auto kp = crypto::make_key_pair();
+  auto history = std::make_shared<ccf::MerkleTxHistory>(
+    store, kv::test::PrimaryNodeId, *kp);
+  store.set_history(history);
+
+  constexpr size_t max_receipts = 2;
+  constexpr size_t max_signatures = 1;
+  ccf::ReceiptCache receipt_cache(store, max_receipts, max_signatures);
+
+  MapT table("public:table");
+  constexpr size_t sig_count = 2;
+  constexpr size_t tx_count = 5;
+  for (size_t i = 0; i < sig_count; ++i)
+  {
+    for (size_t j = 0; j < tx_count; ++j)
+    {
+      auto tx = store.create_tx();
+      tx.rw(table)->put(0, j);
+      REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+    }
+    history->emit_signature();
+    consensus->last_signature = store.current_version();
+  }
+
+  const auto last_seqno = store.current_version();
+  const auto cached = receipt_cache.get(last_seqno - 1);
+  REQUIRE(cached != nullptr);
+
+  INFO("Transactions before the last signature's tree have no receipt");
+  {
+    for (ccf::SeqNo seqno = 1; seqno <= tx_count + 1; ++seqno)
+    {
+      REQUIRE(receipt_cache.get(seqno) == nullptr);
+    }
+
+    const auto receipts = receipt_cache.get_range(1, tx_count + 1);
+    REQUIRE(receipts.size() == tx_count + 1);
+    for (const auto& receipt : receipts)
+    {
+      REQUIRE(receipt == nullptr);
+    }
+  }
+
+  INFO("Looking them up does not build the last signature's receipts again");
+  {
+    REQUIRE(receipt_cache.get(last_seqno - 1) == cached);
+  }
+}
+
+TEST_CASE("History tree hashes as merklecpp's tree does")
+{
+  ccf::HistoryTree batched;
+  merkle::TreeT<32, merkle::sha256_openssl> unbatched;
+
+  constexpr size_t leaf_count = 300;
+  for (size_t i = 0; i < leaf_count; ++i)
+  {
+    crypto::Sha256Hash leaf(std::to_string(i));
+    batched.insert(merkle::Hash(leaf.h));
+    unbatched.insert(merkle::Hash(leaf.h));
+
+    // Extract the roots and flush at irregular intervals, so that the dirty
+    // nodes span several levels, on both sides of flushed subtrees
+    if (i % 7 == 0 || i % 11 == 0)
+    {
+      REQUIRE(batched.root() == unbatched.root());
+    }
+    if (i % 50 == 49)
+    {
+      batched.flush_to(i - 20);
+      unbatched.flush_to(i - 20);
+    }
+  }
+
+  for (auto i = batched.min_index(); i <= batched.max_index(); ++i)
+  {
+    REQUIRE(*batched.path(i) == *unbatched.path(i));
+  }
+
+  std::vector<uint8_t> batched_serialised, unbatched_serialised;
+  batched.serialise(batched_serialised);
+  unbatched.serialise(unbatched_serialised);
+  REQUIRE(batched_serialised == unbatched_serialised);
+}
+
+TEST_CASE("Tree deltas resolve to the full serialised tree")
+{
+  ccf::MerkleTreeHistory tree;
+  constexpr size_t leaf_count = 40;
+  for (size_t i = 0; i < leaf_count; ++i)
+  {
+    crypto::Sha256Hash leaf(std::to_string(i));
+    tree.append(leaf);
+  }
+
+  constexpr ccf::SeqNo keyframe = 7;
+  constexpr auto to = leaf_count - 1;
+  for (size_t keyframe_from = 0; keyframe_from < to; ++keyframe_from)
+  {
+    for (size_t keyframe_to = keyframe_from; keyframe_to < to; ++keyframe_to)
+    {
+      const auto keyframe_tree = tree.serialise(keyframe_from, keyframe_to);
+      for (size_t from = keyframe_from; from <= to; ++from)
+      {
+        const auto delta =
+          tree.serialise_delta(from, to, keyframe, keyframe_from, keyframe_to);
+        REQUIRE(ccf::is_tree_delta(delta));
+        REQUIRE(ccf::get_tree_delta_keyframe(delta) == keyframe);
+        REQUIRE(
+          ccf::MerkleTreeHistory::resolve_delta(delta, keyframe_tree) ==
+          tree.serialise(from, to));
+      }
+    }
+  }
+
+  INFO("Deltas only hold the leaves after the keyframe");
+  {
+    const auto delta = tree.serialise_delta(8, to, keyframe, 8, 20);
+    REQUIRE(
+      delta.size() ==
+      ccf::tree_delta_header_size + 2 * sizeof(uint64_t) +
+        (to - 20) * crypto::Sha256Hash::SIZE);
+  }
+
+  INFO("Full trees are not deltas, and truncated deltas are rejected");
+  {
+    const auto full_tree = tree.serialise(3, 10);
+    REQUIRE_FALSE(ccf::is_tree_delta(full_tree));
+
+    auto delta = tree.serialise_delta(5, to, keyframe, 3, 10);
+    delta.resize(delta.size() - crypto::Sha256Hash::SIZE);
+    REQUIRE_THROWS_AS(
+      ccf::MerkleTreeHistory::resolve_delta(delta, full_tree),
+      std::logic_error);
+    delta.resize(ccf::tree_delta_header_size);
+    REQUIRE_THROWS_AS(
+      ccf::MerkleTreeHistory::resolve_delta(delta, full_tree),
+      std::logic_error);
+  }
+}
+
+TEST_CASE("Signatures record tree deltas between keyframes")
+{
+  auto encryptor = std::make_shared<kv::NullTxEncryptor>();
+
+  kv::Store store;
+  store.set_encryptor(encryptor);
+  auto consensus = std::make_shared<CompactingConsensus>(&store);
+  store.set_consensus(consensus);
+
+  constexpr size_t tree_keyframe_interval = 3;
+  auto kp = crypto::make_key_pair();
+  auto history = std::make_shared<ccf::MerkleTxHistory>(
+    store,
+    kv::test::PrimaryNodeId,
+    *kp,
+    0,
+    0,
+    false,
+    false,
+    tree_keyframe_interval);
+  store.set_history(history);
+
+  ccf::ReceiptCache receipt_cache(store);
+
+  MapT table("public:table");
+  constexpr size_t sig_count = 7;
+  for (size_t i = 0; i < sig_count; ++i)
+  {
+    auto tx = store.create_tx();
+    tx.rw(table)->put(0, i);
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+
+    history->emit_signature();
+    const auto sig_seqno = store.current_version();
+
+    auto read_tx = store.create_read_only_tx();
+    auto tree = read_tx.ro<ccf::SerialisedMerkleTree>(
+      ccf::Tables::SERIALISED_MERKLE_TREE);
+    auto tree_delta = read_tx.ro<ccf::SerialisedMerkleTreeDelta>(
+      ccf::Tables::SERIALISED_MERKLE_TREE_DELTA);
+
+    if (i % tree_keyframe_interval == 0)
+    {
+      REQUIRE(tree->get_version_of_previous_write() == sig_seqno);
+      REQUIRE_FALSE(ccf::is_tree_delta(tree->get().value()));
+    }
+    else
+    {
+      REQUIRE(tree_delta->get_version_of_previous_write() == sig_seqno);
+      REQUIRE(
+        ccf::get_tree_delta_keyframe(tree_delta->get().value()) ==
+        tree->get_version_of_previous_write());
+    }
+
+    INFO("Receipts are built from both full trees and deltas");
+    {
+      auto receipt = receipt_cache.get(sig_seqno - 1);
+      REQUIRE(receipt != nullptr);
+      REQUIRE(receipt->path != nullptr);
+      REQUIRE(receipt->path->verify(receipt->root));
+    }
+  }
+
+  INFO("Rollback starts a new keyframe");
+  {
+    store.rollback(
+      {store.commit_view(), store.current_version()}, store.commit_view());
+
+    auto tx = store.create_tx();
+    tx.rw(table)->put(0, sig_count);
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+
+    history->emit_signature();
+
+    auto read_tx = store.create_read_only_tx();
+    auto tree = read_tx.ro<ccf::SerialisedMerkleTree>(
+      ccf::Tables::SERIALISED_MERKLE_TREE);
+    REQUIRE(tree->get_version_of_previous_write() == store.current_version());
+  }
+}
+
 int main(int argc, char** argv)
 {
   doctest::Context context;
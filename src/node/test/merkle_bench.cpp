@@ -85,6 +85,42 @@ static void append_flush(picobench::state& s)
   s.stop_timer();
 }
 
+// The history tree hashes each level of dirty nodes at once. The tree it
+// derives from hashes them one at a time instead, for comparison.
+using UnbatchedHistoryTree = merkle::TreeT<32, merkle::sha256_openssl>;
+
+// Appends leaves, computing the root every 1000 leaves as signatures do
+template <class Tree>
+static void append_root(picobench::state& s)
+{
+  Tree t;
+  vector<merkle::Hash> hashes;
+  std::random_device r;
+
+  for (size_t i = 0; i < s.iterations(); ++i)
+  {
+    merkle::Hash h;
+    for (size_t j = 0; j < h.size(); j++)
+      h.bytes[j] = r();
+
+    hashes.emplace_back(h);
+  }
+
+  size_t index = 0;
+  s.start_timer();
+  for (auto _ : s)
+  {
+    (void)_;
+    t.insert(hashes[index++]);
+    if (index % 1000 == 0)
+      do_not_optimize(t.root());
+
+    clobber_memory();
+  }
+  do_not_optimize(t.root());
+  s.stop_timer();
+}
+
 static void append_get_proof_verify(picobench::state& s)
 {
   ccf::MerkleTreeHistory t;
@@ -202,6 +238,11 @@ PICOBENCH_SUITE("append_retract");
 PICOBENCH(append_retract).iterations(sizes).samples(10).baseline();
 PICOBENCH_SUITE("append_flush");
 PICOBENCH(append_flush).iterations(sizes).samples(10).baseline();
+PICOBENCH_SUITE("append_root");
+auto append_root_unbatched = append_root<UnbatchedHistoryTree>;
+PICOBENCH(append_root_unbatched).iterations(sizes).samples(10).baseline();
+auto append_root_batched = append_root<ccf::HistoryTree>;
+PICOBENCH(append_root_batched).iterations(sizes).samples(10);
 PICOBENCH_SUITE("append_get_proof_verify");
 PICOBENCH(append_get_proof_verify).iterations(sizes).samples(10).baseline();
 PICOBENCH_SUITE("append_get_proof_verify_v");
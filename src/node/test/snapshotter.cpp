@@ -26,6 +26,11 @@ auto read_ringbuffer_out(ringbuffer::Circuit& circuit)
     -1, [&idx](ringbuffer::Message m, const uint8_t* data, size_t size) {
       switch (m)
       {
+        case consensus::snapshot_chunk:
+        {
+          // Chunks precede the message completing the snapshot
+          break;
+        }
         case consensus::snapshot:
         case consensus::snapshot_commit:
         {
@@ -256,4 +261,118 @@ TEST_CASE("Rollback before evidence is committed")
       read_ringbuffer_out(eio) ==
       rb_msg({consensus::snapshot_commit, snapshot_idx}));
   }
-}
\ No newline at end of file
+}
+TEST_CASE("Parallel snapshot serialisation")
+{
+  // Maps are serialised on worker threads 1 and 2, whose tasks are run here
+  // in an arbitrary order
+  threading::ThreadMessaging::thread_count = 3;
+
+  ccf::NetworkState network;
+
+  auto in_buffer = std::make_unique<ringbuffer::TestBuffer>(buffer_size);
+  auto out_buffer = std::make_unique<ringbuffer::TestBuffer>(buffer_size * 8);
+  ringbuffer::Circuit eio(in_buffer->bd, out_buffer->bd);
+
+  std::unique_ptr<ringbuffer::WriterFactory> writer_factory =
+    std::make_unique<ringbuffer::WriterFactory>(eio);
+
+  constexpr size_t map_count = 4;
+  constexpr size_t chunk_size = 256;
+  {
+    auto tx = network.tables->create_tx();
+    for (size_t i = 0; i < map_count; ++i)
+    {
+      auto map = tx.rw<StringString>(fmt::format("public:map{}", i));
+      for (size_t j = 0; j < 20; ++j)
+      {
+        map->put(fmt::format("key {}", j), fmt::format("value {}", j));
+      }
+    }
+    REQUIRE(tx.commit() == kv::CommitResult::SUCCESS);
+  }
+  size_t snapshot_idx = network.tables->current_version();
+
+  auto snapshotter = std::make_shared<ccf::Snapshotter>(
+    *writer_factory, network.tables, snapshot_idx, chunk_size, true);
+
+  auto read_chunks = [&](std::optional<rb_msg>& end) {
+    std::vector<std::vector<uint8_t>> chunks;
+    eio.read_from_inside().read(
+      -1, [&](ringbuffer::Message m, const uint8_t* data, size_t size) {
+        REQUIRE_FALSE(end.has_value());
+        if (m == consensus::snapshot_chunk)
+        {
+          auto [idx, chunk] =
+            ringbuffer::read_message<consensus::snapshot_chunk>(data, size);
+          REQUIRE(idx == snapshot_idx);
+          chunks.push_back(chunk);
+        }
+        else
+        {
+          REQUIRE(m == consensus::snapshot);
+          end = {m, serialized::read<consensus::Index>(data, size)};
+        }
+      });
+    return chunks;
+  };
+
+  auto snapshot = network.tables->snapshot(snapshot_idx);
+  const auto encryptor = network.tables->get_encryptor();
+  REQUIRE(snapshot->get_map_count() == map_count);
+  std::vector<std::vector<std::vector<uint8_t>>> expected_map_chunks;
+  for (size_t i = 0; i < map_count; ++i)
+  {
+    expected_map_chunks.push_back(
+      snapshot->serialise_map_chunks(encryptor, i, chunk_size));
+    REQUIRE(expected_map_chunks.back().size() > 1);
+  }
+
+  auto& thread_messaging = threading::ThreadMessaging::thread_messaging;
+  std::optional<rb_msg> end = std::nullopt;
+
+  INFO("Header chunk is recorded first");
+  {
+    REQUIRE(snapshotter->record_committable(snapshot_idx));
+    snapshotter->commit(snapshot_idx, true);
+    REQUIRE(
+      (thread_messaging.get_task(1).run_next_task() ||
+       thread_messaging.get_task(2).run_next_task()));
+    REQUIRE(
+      read_chunks(end) ==
+      std::vector<std::vector<uint8_t>>{
+        snapshot->serialise_header_chunk(encryptor)});
+  }
+
+  INFO("Chunks of a map are held until those of preceding maps are recorded");
+  {
+    // Maps 1 and 3 are serialised on thread 2, maps 0 and 2 on thread 1
+    REQUIRE(thread_messaging.get_task(2).run_next_task());
+    REQUIRE(read_chunks(end).empty());
+
+    REQUIRE(thread_messaging.get_task(1).run_next_task());
+    auto expected = expected_map_chunks[0];
+    expected.insert(
+      expected.end(),
+      expected_map_chunks[1].begin(),
+      expected_map_chunks[1].end());
+    REQUIRE(read_chunks(end) == expected);
+
+    REQUIRE(thread_messaging.get_task(2).run_next_task());
+    REQUIRE(read_chunks(end).empty());
+  }
+
+  INFO("Snapshot is complete once all maps are recorded");
+  {
+    REQUIRE(thread_messaging.get_task(1).run_next_task());
+    auto expected = expected_map_chunks[2];
+    expected.insert(
+      expected.end(),
+      expected_map_chunks[3].begin(),
+      expected_map_chunks[3].end());
+    REQUIRE(read_chunks(end) == expected);
+    REQUIRE(end == rb_msg({consensus::snapshot, snapshot_idx}));
+  }
+
+  threading::ThreadMessaging::thread_count = 1;
+}
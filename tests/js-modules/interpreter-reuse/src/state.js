@@ -0,0 +1,39 @@
+// Module globals live as long as the interpreter which evaluated the module,
+// i.e. across the requests handled by the same thread, until the app's
+// modules are updated.
+let requestCount = 0;
+let keptRequest = null;
+let keptMap = null;
+
+export function count() {
+  requestCount += 1;
+  return { body: { count: requestCount } };
+}
+
+export function keep_request(request) {
+  keptRequest = request;
+  keptMap = ccf.kv["public:records"];
+  return { body: { kept: true } };
+}
+
+function tryUse(f) {
+  try {
+    f();
+    return "usable";
+  } catch (e) {
+    return e.message;
+  }
+}
+
+export function use_kept_request() {
+  if (keptRequest === null) {
+    return { body: { kept: false } };
+  }
+  return {
+    body: {
+      kept: true,
+      body: tryUse(() => keptRequest.body.text()),
+      map: tryUse(() => keptMap.has(new ArrayBuffer(8))),
+    },
+  };
+}
@@ -115,6 +115,55 @@ def test_bytecode_cache(network, args):
     return network
 
 
+@reqs.description("Test reuse of JS interpreters across requests")
+def test_interpreter_reuse(network, args):
+    primary, _ = network.find_nodes()
+
+    # Module globals persist across the requests handled by the same thread,
+    # until the app's modules are updated
+    bundle_dir = os.path.join(THIS_DIR, "interpreter-reuse")
+    network.consortium.set_js_app(primary, bundle_dir)
+
+    def get_counts(client, n):
+        counts = []
+        for _ in range(n):
+            r = client.post("/app/count", {})
+            assert r.status_code == http.HTTPStatus.OK, r.status_code
+            counts.append(r.body.json()["count"])
+        return counts
+
+    LOG.info("Verifying that interpreters are reused across requests")
+    request_count = 2 * (args.worker_threads + 1)
+    with primary.client("user0") as c:
+        counts = get_counts(c, request_count)
+        assert counts[0] == 1, counts
+        assert max(counts) > 1, counts
+
+    LOG.info("Verifying that interpreters are discarded when modules change")
+    network.consortium.set_js_app(primary, bundle_dir)
+    with primary.client("user0") as c:
+        counts = get_counts(c, request_count)
+        assert counts[0] == 1, counts
+        assert max(counts) > 1, counts
+
+    LOG.info("Verifying that request objects kept in globals are detached")
+    with primary.client("user0") as c:
+        r = c.post("/app/keep_request", {"foo": "bar"})
+        assert r.status_code == http.HTTPStatus.OK, r.status_code
+        for _ in range(request_count):
+            r = c.post("/app/use_kept_request", {})
+            assert r.status_code == http.HTTPStatus.OK, r.status_code
+            body = r.body.json()
+            if body["kept"]:
+                assert "only valid during the request" in body["body"], body
+                assert "only valid during the request" in body["map"], body
+                break
+        else:
+            assert False, "Kept request was never used by another request"
+
+    return network
+
+
 @reqs.description("Test js app bundle")
 def test_app_bundle(network, args):
     primary, _ = network.find_nodes()
@@ -579,6 +628,7 @@ def run(args):
         network.start_and_join(args)
         network = test_module_import(network, args)
         network = test_bytecode_cache(network, args)
+        network = test_interpreter_reuse(network, args)
         network = test_app_bundle(network, args)
         network = test_dynamic_endpoints(network, args)
         network = test_npm_app(network, args)